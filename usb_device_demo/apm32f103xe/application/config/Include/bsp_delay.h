@@ -31,12 +31,13 @@
 #include "apm32f10x.h"
 #include "apm32f10x_misc.h"
 
-/* 100KHz */
+/* 1KHz, one tick per millisecond */
 #define SYSTICK_FRQ         1000U
 
 /* function declaration*/
 void APM_DelayInit(void);
-void APM_DelayTickDec(void);
+void APM_IncTick(void);
+uint32_t APM_GetTick(void);
 
 /* Delay*/
 void APM_DelayMs(__IO uint32_t nms);
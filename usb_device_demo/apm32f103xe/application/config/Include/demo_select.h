@@ -0,0 +1,42 @@
+/**
+  * @file    demo_select.h
+  * @author  LuckkMaker
+  * @brief   USB demo selection, shared by main.h and usb_config.h
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef DEMO_SELECT_H
+#define DEMO_SELECT_H
+
+/*!< kept free of device includes, usb_config.h sizes the stack buffers per demo */
+
+#define DEMO_CDC_ACM_HID                    0
+#define DEMO_DFU                            2
+#define DEMO_CDC_BENCH                      4
+
+/* Select USB device demo
+*   DEMO_CDC_ACM_HID:       CDC ACM + custom HID composite device
+*   DEMO_DFU:               DFU 1.1 device programming the upper half of the flash
+*   DEMO_CDC_BENCH:         CDC ACM bulk throughput benchmark, see tools/cdc_bench.c
+*/
+#ifndef DEMO_SELECT
+#define DEMO_SELECT                         DEMO_CDC_ACM_HID
+#endif /* DEMO_SELECT */
+
+#endif /* DEMO_SELECT_H */
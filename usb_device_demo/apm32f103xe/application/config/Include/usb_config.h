@@ -27,12 +27,24 @@
 #ifndef CHERRYUSB_CONFIG_H
 #define CHERRYUSB_CONFIG_H
 
+#include "demo_select.h"
+
 //-------- <<< Use Configuration Wizard in Context Menu >>> --------------------
 #define CHERRYUSB_VERSION                           0x010300
 #define CHERRYUSB_VERSION_STR                       "v1.3.0"
 
 // <h> USB Common Configuration
+//  <q> Deferred log, USB_LOG_* queued in dlog.c and printed by dlog_flush()
+#ifndef CONFIG_USB_DLOG
+#define CONFIG_USB_DLOG                             1
+#endif
+
+#if CONFIG_USB_DLOG
+#include "dlog.h"
+#define CONFIG_USB_PRINTF(...)                      DLOG(__VA_ARGS__)
+#else
 #define CONFIG_USB_PRINTF(...)                      printf(__VA_ARGS__)
+#endif
 
 #define usb_malloc(size)                            malloc(size)
 #define usb_free(ptr)                               free(ptr)
@@ -90,8 +102,14 @@
 // </h>
 
 // <h> USB Device Stack Configuration
-//  <o> EP0 IN and OUT transfer buffer size <512=>512
+//  <o> EP0 IN and OUT transfer buffer size <512=>512 <1024=>1024 <2048=>2048
+//  <i> Also the DFU wTransferSize, a larger block takes fewer GETSTATUS round trips,
+//  <i> the other demos keep 512
+#if (DEMO_SELECT == DEMO_DFU)
+#define CONFIG_USBDEV_REQUEST_BUFFER_LEN            2048
+#else
 #define CONFIG_USBDEV_REQUEST_BUFFER_LEN            512
+#endif
 //  <c> Setup Packet Log for Debug
 //#define CONFIG_USBDEV_SETUP_LOG_PRINT
 //  </c>
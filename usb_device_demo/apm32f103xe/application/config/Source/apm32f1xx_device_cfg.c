@@ -50,5 +50,8 @@
  */
 void SPD_DeviceConfig(void)
 {
+    /* all 4 priority bits preempt, the reset value leaves none and every
+     * NVIC_EnableIRQRequest() priority would collapse to 0 */
+    NVIC_ConfigPriorityGroup(NVIC_PRIORITY_GROUP_4);
     APM_DelayInit();
 }
@@ -26,7 +26,8 @@
 /* Includes */
 #include "bsp_delay.h"
 
-__IO uint32_t delayTick;
+/* Milliseconds since APM_DelayInit() */
+static __IO uint32_t sysTick;
 
 /*!
  * @brief       Configures Delay.
@@ -37,7 +38,7 @@ __IO uint32_t delayTick;
  */
 void APM_DelayInit(void)
 {
-    if (SysTick_Config(SystemCoreClock / 1000 / SYSTICK_FRQ))
+    if (SysTick_Config(SystemCoreClock / SYSTICK_FRQ))
     {
         while (1);
     }
@@ -46,18 +47,27 @@ void APM_DelayInit(void)
 }
 
 /*!
- * @brief       Decrement tick
+ * @brief       Increment tick, called from the SysTick handler
  *
  * @param       None
  *
  * @retval      None
  */
-void APM_DelayTickDec(void)
+void APM_IncTick(void)
 {
-    if (delayTick != 0x00)
-    {
-        delayTick--;
-    }
+    sysTick++;
+}
+
+/*!
+ * @brief       Get tick
+ *
+ * @param       None
+ *
+ * @retval      Milliseconds since APM_DelayInit()
+ */
+uint32_t APM_GetTick(void)
+{
+    return sysTick;
 }
 
 /*!
@@ -68,12 +78,23 @@ void APM_DelayTickDec(void)
  *              @arg nus
  *
  * @retval      None
+ *
+ * @note        Counts the SysTick down counter, no interrupt per microsecond
  */
 void APM_DelayUs(__IO uint32_t nus)
 {
-    delayTick = nus;
+    uint32_t reload = SysTick->LOAD + 1U;
+    uint32_t ticks = nus * (SystemCoreClock / 1000000U);
+    uint32_t last = SysTick->VAL;
+    uint32_t elapsed = 0U;
+    uint32_t now;
 
-    while (delayTick != 0);
+    while (elapsed < ticks)
+    {
+        now = SysTick->VAL;
+        elapsed += (last >= now) ? (last - now) : (last + reload - now);
+        last = now;
+    }
 }
 
 /*!
@@ -87,7 +108,7 @@ void APM_DelayUs(__IO uint32_t nus)
  */
 void APM_DelayMs(__IO uint32_t nms)
 {
-    delayTick = nms * 1000;
+    uint32_t start = sysTick;
 
-    while (delayTick != 0);
+    while ((sysTick - start) < nms);
 }
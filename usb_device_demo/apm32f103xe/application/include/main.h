@@ -39,6 +39,10 @@
 #include "apm32f10x_usart.h"
 #include "apm32f10x_misc.h"
 #include "apm32f10x_usb.h"
+#include "apm32f10x_fmc.h"
+#include "apm32f10x_dma.h"
+#include "apm32f10x_crc.h"
+#include "demo_select.h"
 
 /* Exported macro *********************************************************/
 #define USB1                                0
@@ -49,6 +53,7 @@
 *   USB2:   Private FIFO.Not share whith CAN1
 */
 #define USB_SELECT                          USB2
+
 /* Exported typedef *******************************************************/
 
 /* Exported function prototypes *******************************************/
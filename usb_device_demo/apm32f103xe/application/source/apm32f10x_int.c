@@ -27,6 +27,10 @@
 #include "main.h"
 #include "apm32f10x_int.h"
 #include "bsp_delay.h"
+#include "crc32_stream.h"
+#include "cycle_prof.h"
+#include "uart_log.h"
+#include "usbd_fsdev_hp.h"
 
 extern void USBD_IRQHandler(uint8_t busid);
 
@@ -152,7 +156,8 @@ void PendSV_Handler(void)
  */
 void SysTick_Handler(void)
 {
-    APM_DelayTickDec();
+    APM_IncTick();
+    CYCLE_PROF_SYSTICK_HOOK();
 }
 
 
@@ -180,7 +185,10 @@ void USBD2_LP_IRQHandler(void)
 #endif /* USB_SELECT */
 #endif
 {
+    CYCLE_PROF_BEGIN(USB_IRQ);
+    usbd_fsdev_hp_lp_handler();
     USBD_IRQHandler(0);
+    CYCLE_PROF_END(USB_IRQ);
 }
 
 
@@ -206,7 +214,37 @@ void USBD2_HP_IRQHandler(void)
 #endif /* USB_SELECT */
 #endif
 {
-    
+    usbd_fsdev_hp_irq_handler();
 }
 
 #endif /* defined (USB_DEVICE) */
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+/*!
+ * @brief   This function handles DMA1 channel 1 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA1_Channel1_IRQHandler(void)
+{
+    crc32_stream_dma_irq_handler();
+}
+#endif /* CRC32_STREAM_BACKEND */
+
+#if UART_LOG_ENABLE
+/*!
+ * @brief   This function handles DMA1 channel 4 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA1_Channel4_IRQHandler(void)
+{
+    uart_log_dma_irq_handler();
+}
+#endif /* UART_LOG_ENABLE */
@@ -10,8 +10,9 @@
 /* Private includes ----------------------------------------------------------*/
 #include "usbd_cdc.h"
 #include "usbd_hid.h"
-
-/* Private typedef -----------------------------------------------------------*/
+#include "hid_report_queue.h"
+#include "cycle_prof.h"
+#include "usbd_ep_static.h"
 
 /* Private define ------------------------------------------------------------*/
 #define USBD_VID           0x314B
@@ -30,7 +31,7 @@
 #define HID_IN_EP_INTERVAL      4
 #else
 #define HID_IN_EP_SIZE          64
-#define HID_IN_EP_INTERVAL      10
+#define HID_IN_EP_INTERVAL      1
 #endif  // CONFIG_USB_HS
 
 #define HID_OUT_EP              0x02
@@ -39,7 +40,7 @@
 #define HID_OUT_EP_INTERVAL     4
 #else
 #define HID_OUT_EP_SIZE         64
-#define HID_OUT_EP_INTERVAL     10
+#define HID_OUT_EP_INTERVAL     1
 #endif  // CONFIG_USB_HS
 
 #ifdef CONFIG_USB_HS
@@ -48,11 +49,44 @@
 #define CDC_MAX_MPS 64
 #endif
 
+/*!< registered endpoints, the CDC ones are described by CDC_ACM_DESCRIPTOR_INIT */
+#define CDC_EP_LIST(EP) \
+    EP(CDC_OUT_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usbd_cdc_acm_bulk_out) \
+    EP(CDC_IN_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usbd_cdc_acm_bulk_in)
+
+#define HID_EP_LIST(EP) \
+    EP(HID_IN_EP, USB_ENDPOINT_TYPE_INTERRUPT, HID_IN_EP_SIZE, HID_IN_EP_INTERVAL, usbd_hid_custom_in_callback) \
+    EP(HID_OUT_EP, USB_ENDPOINT_TYPE_INTERRUPT, HID_OUT_EP_SIZE, HID_OUT_EP_INTERVAL, usbd_hid_custom_out_callback)
+
+#define CDC_ACM_HID_EP_LIST(EP) CDC_EP_LIST(EP) HID_EP_LIST(EP)
+
 /*!< config descriptor size */
 #define USB_CONFIG_SIZE (9 + CDC_ACM_DESCRIPTOR_LEN + USB_HID_CONFIG_DESC_SIZ)
 
 #define USB_HID_CONFIG_DESC_SIZ (9 + 9 + 7 + 7)
 
+/* Private typedef -----------------------------------------------------------*/
+/*!< transfer buffers of one bus */
+struct cdc_acm_hid_bufs {
+    USB_MEM_ALIGNX uint8_t cdc_read[CDC_MAX_MPS];
+    USB_MEM_ALIGNX uint8_t cdc_write[CDC_MAX_MPS];
+    USB_MEM_ALIGNX uint8_t hid_read[HID_OUT_EP_SIZE];
+    USB_MEM_ALIGNX uint8_t hid_send[HID_IN_EP_SIZE];
+};
+
+/*!< state of one bus, written from its own USB interrupt and the main loop only */
+struct cdc_acm_hid_ctx {
+    struct usbd_interface cdc_intf0;
+    struct usbd_interface cdc_intf1;
+    struct usbd_interface hid_intf;
+    volatile bool ep_tx_busy;
+    volatile bool dtr_enable;
+    /*!< bus suspended, cdc_acm_data_send() stops waiting for the host */
+    volatile bool suspended;
+    /*!< hid OUT endpoint left NAKing until the report queue has room */
+    volatile bool hid_out_paused;
+};
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 /*!< global descriptor */
@@ -83,20 +117,8 @@ const uint8_t cdc_acm_hid_descriptor[] = {
     0x22,                          /* bDescriptorType */
     HID_CUSTOM_REPORT_DESC_SIZE,   /* wItemLength: Total length of Report descriptor */
     0x00,
-    /******************** Descriptor of Custom in endpoint ********************/
-    0x07,                          /* bLength: Endpoint Descriptor size */
-    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
-    HID_IN_EP,                     /* bEndpointAddress: Endpoint Address (IN) */
-    0x03,                          /* bmAttributes: Interrupt endpoint */
-    WBVAL(HID_IN_EP_SIZE),         /* wMaxPacketSize: 4 Byte max */
-    HID_IN_EP_INTERVAL,            /* bInterval: Polling Interval */
-    /******************** Descriptor of Custom out endpoint ********************/
-    0x07,                          /* bLength: Endpoint Descriptor size */
-    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
-    HID_OUT_EP,                    /* bEndpointAddress: Endpoint Address (OUT) */
-    0x03,                          /* bmAttributes: Interrupt endpoint */
-    WBVAL(HID_OUT_EP_SIZE),        /* wMaxPacketSize: 4 Byte max */
-    HID_OUT_EP_INTERVAL,           /* bInterval: Polling Interval */
+    /******************** Descriptor of Custom endpoints ********************/
+    HID_EP_LIST(USBD_EP_STATIC_DESC)
     ///////////////////////////////////////
     /// string0 descriptor
     ///////////////////////////////////////
@@ -220,40 +242,41 @@ const uint8_t hid_custom_report_desc[HID_CUSTOM_REPORT_DESC_SIZE] = {
 #endif
 };
 
-/* 2048 is only for test speed , please use CDC_MAX_MPS for common*/
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t cdc_read_buffer[CDC_MAX_MPS];
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t cdc_write_buffer[CDC_MAX_MPS];
-
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t hid_read_buffer[HID_OUT_EP_SIZE];
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t hid_send_buffer[HID_IN_EP_SIZE];
-
-#define HID_STATE_IDLE 0
-#define HID_STATE_BUSY 1
+/*!< the buffers of each bus, cdc_write only feeds cdc_acm_data_send_with_dtr_test() */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static struct cdc_acm_hid_bufs bus_bufs[CONFIG_USBDEV_MAX_BUS];
 
-/*!< hid state ! Data can be sent only when state is idle  */
-static volatile uint8_t custom_state;
-
-volatile bool ep_tx_busy_flag = false;
+static struct cdc_acm_hid_ctx bus_ctx[CONFIG_USBDEV_MAX_BUS];
 
 /* Private function prototypes -----------------------------------------------*/
 
 void usbd_event_handler(uint8_t busid, uint8_t event) {
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+
+    usb_pm_event_handler(busid, event);
+
     switch (event) {
         case USBD_EVENT_RESET:
+            ctx->suspended = false;
+            hid_report_queue_set_active(busid, false);
             break;
         case USBD_EVENT_CONNECTED:
             break;
         case USBD_EVENT_DISCONNECTED:
             break;
         case USBD_EVENT_RESUME:
+            ctx->suspended = false;
             break;
         case USBD_EVENT_SUSPEND:
+            ctx->suspended = true;
             break;
         case USBD_EVENT_CONFIGURED:
-            ep_tx_busy_flag = false;
+            ctx->suspended = false;
+            ctx->ep_tx_busy = false;
+            ctx->hid_out_paused = false;
+            hid_report_queue_set_active(busid, true);
             /* setup first out ep read transfer */
-            usbd_ep_start_read(busid, CDC_OUT_EP, cdc_read_buffer, CDC_MAX_MPS);
-            usbd_ep_start_read(busid, HID_OUT_EP, hid_read_buffer, HID_OUT_EP_SIZE);
+            usbd_ep_start_read(busid, CDC_OUT_EP, bus_bufs[busid].cdc_read, CDC_MAX_MPS);
+            usbd_ep_start_read(busid, HID_OUT_EP, bus_bufs[busid].hid_read, HID_OUT_EP_SIZE);
             break;
         case USBD_EVENT_SET_REMOTE_WAKEUP:
             break;
@@ -267,6 +290,11 @@ void usbd_event_handler(uint8_t busid, uint8_t event) {
 
 /* External functions --------------------------------------------------------*/
 
+__WEAK void usb_pm_event_handler(uint8_t busid, uint8_t event) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(event);
+}
+
 __WEAK void usbd_cdc_get_out_data(uint8_t busid, uint8_t *data, uint32_t len) {
     ARG_UNUSED(busid);
     ARG_UNUSED(data);
@@ -274,84 +302,98 @@ __WEAK void usbd_cdc_get_out_data(uint8_t busid, uint8_t *data, uint32_t len) {
 }
 
 void usbd_cdc_acm_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    uint8_t *buf = bus_bufs[busid].cdc_read;
+
+    CYCLE_PROF_BEGIN(CDC_OUT);
+
 //    USB_LOG_RAW("actual out len:%d\r\n", nbytes);
 //    for (int i = 0; i < nbytes; i++) {
-//        printf("%02x ", cdc_read_buffer[i]);
+//        printf("%02x ", buf[i]);
 //    }
 //    printf("\r\n");
-    usbd_cdc_get_out_data(busid, cdc_read_buffer, nbytes);
+    usbd_cdc_get_out_data(busid, buf, nbytes);
 
     /* setup next out ep read transfer */
-    usbd_ep_start_read(busid, CDC_OUT_EP, cdc_read_buffer, sizeof(cdc_read_buffer));
+    usbd_ep_start_read(busid, CDC_OUT_EP, buf, sizeof(bus_bufs[busid].cdc_read));
+
+    CYCLE_PROF_END(CDC_OUT);
 }
 
 void usbd_cdc_acm_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
     // USB_LOG_RAW("actual in len:%d\r\n", nbytes);
+    CYCLE_PROF_BEGIN(CDC_IN);
 
     if ((nbytes % usbd_get_ep_mps(busid, ep)) == 0 && nbytes) {
         /* send zlp */
         usbd_ep_start_write(busid, CDC_IN_EP, NULL, 0);
     } else {
-        ep_tx_busy_flag = false;
+        bus_ctx[busid].ep_tx_busy = false;
     }
+
+    CYCLE_PROF_END(CDC_IN);
 }
 
 static void usbd_hid_custom_in_callback(uint8_t busid, uint8_t ep, uint32_t nbytes) {
-    (void)busid;
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+
     (void)ep;
-    USB_LOG_RAW("actual in len:%d\r\n", nbytes);
-    custom_state = HID_STATE_IDLE;
+    (void)nbytes;
+    CYCLE_PROF_BEGIN(HID_IN);
+
+    /* next queued report goes out on the next poll */
+    hid_report_queue_in_complete(busid);
+
+    if (ctx->hid_out_paused && hid_report_queue_space(busid)) {
+        ctx->hid_out_paused = false;
+        usbd_ep_start_read(busid, HID_OUT_EP, bus_bufs[busid].hid_read, HID_OUT_EP_SIZE);
+    }
+
+    CYCLE_PROF_END(HID_IN);
 }
 
 static void usbd_hid_custom_out_callback(uint8_t busid, uint8_t ep, uint32_t nbytes) {
-    USB_LOG_RAW("actual out len:%d\r\n", nbytes);
-    usbd_ep_start_read(busid, ep, hid_read_buffer, HID_IN_EP_SIZE);
-    hid_read_buffer[0] = 0x02; /* IN: report id */
-    usbd_ep_start_write(busid, HID_IN_EP, hid_read_buffer, nbytes);
-}
+    uint8_t *buf = bus_bufs[busid].hid_read;
 
-/*!< endpoint call back */
-struct usbd_endpoint cdc_out_ep = {
-    .ep_addr = CDC_OUT_EP,
-    .ep_cb = usbd_cdc_acm_bulk_out
-};
+    CYCLE_PROF_BEGIN(HID_OUT);
 
-struct usbd_endpoint cdc_in_ep = {
-    .ep_addr = CDC_IN_EP,
-    .ep_cb = usbd_cdc_acm_bulk_in
-};
+    /* echo, the queue copies the report so the read can be re-armed at once */
+    buf[0] = 0x02; /* IN: report id */
+    hid_report_queue_push(busid, buf, nbytes);
 
-struct usbd_endpoint custom_hid_in_ep = {
-    .ep_cb = usbd_hid_custom_in_callback,
-    .ep_addr = HID_IN_EP
-};
+    if (hid_report_queue_space(busid)) {
+        usbd_ep_start_read(busid, ep, buf, HID_OUT_EP_SIZE);
+    } else {
+        bus_ctx[busid].hid_out_paused = true;
+    }
 
-struct usbd_endpoint custom_hid_out_ep = {
-    .ep_cb = usbd_hid_custom_out_callback,
-    .ep_addr = HID_OUT_EP
-};
+    CYCLE_PROF_END(HID_OUT);
+}
 
-struct usbd_interface cdc_intf0;
-struct usbd_interface cdc_intf1;
-struct usbd_interface hid_intf;
+/*!< endpoint call back, the same table serves every bus */
+USBD_EP_STATIC_TABLE(cdc_acm_hid_eps, CDC_ACM_HID_EP_LIST);
 
 int cdc_acm_hid_init(uint8_t busid, uint32_t reg_base) {
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+    uint8_t *cdc_write = bus_bufs[busid].cdc_write;
     int ret;
 
     const uint8_t data[10] = { 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x30 };
 
-    memcpy(&cdc_write_buffer[0], data, 10);
-    memset(&cdc_write_buffer[10], 'a', CDC_MAX_MPS - 10);
+    memcpy(&cdc_write[0], data, 10);
+    memset(&cdc_write[10], 'a', CDC_MAX_MPS - 10);
 
     usbd_desc_register(busid, cdc_acm_hid_descriptor);
-    usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &cdc_intf0));
-    usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &cdc_intf1));
-    usbd_add_endpoint(busid, &cdc_out_ep);
-    usbd_add_endpoint(busid, &cdc_in_ep);
-
-    usbd_add_interface(busid, usbd_hid_init_intf(busid, &hid_intf, hid_custom_report_desc, HID_CUSTOM_REPORT_DESC_SIZE));
-    usbd_add_endpoint(busid, &custom_hid_in_ep);
-    usbd_add_endpoint(busid, &custom_hid_out_ep);
+    usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &ctx->cdc_intf0));
+    usbd_add_interface(busid, usbd_cdc_acm_init_intf(busid, &ctx->cdc_intf1));
+    usbd_add_interface(busid, usbd_hid_init_intf(busid, &ctx->hid_intf, hid_custom_report_desc, HID_CUSTOM_REPORT_DESC_SIZE));
+    usbd_ep_static_register(busid, cdc_acm_hid_eps, USBD_EP_STATIC_COUNT(cdc_acm_hid_eps));
+    hid_report_queue_init(busid, HID_IN_EP, bus_bufs[busid].hid_send);
+
+#if CYCLE_PROF_ENABLE
+    /* any interface will do, the requests have the device as recipient */
+    cycle_prof_init();
+    ctx->cdc_intf0.vendor_handler = cycle_prof_vendor_handler;
+#endif
 
     ret = usbd_initialize(busid, reg_base, usbd_event_handler);
 
@@ -360,8 +402,6 @@ int cdc_acm_hid_init(uint8_t busid, uint32_t reg_base) {
 
 /********************** CDC ACM **************************/
 
-volatile uint8_t dtr_enable = 0;
-
 void usbd_cdc_acm_get_line_coding(uint8_t busid, uint8_t intf, struct cdc_line_coding *line_coding) {
     line_coding->dwDTERate = 115200;    /* baudrate */
     line_coding->bDataBits = 8;         /* data bits */
@@ -376,11 +416,9 @@ void usbd_cdc_acm_set_line_coding(uint8_t busid, uint8_t intf, struct cdc_line_c
 }
 
 void usbd_cdc_acm_set_dtr(uint8_t busid, uint8_t intf, bool dtr) {
-    if (dtr) {
-        dtr_enable = 1;
-    } else {
-        dtr_enable = 0;
-    }
+    ARG_UNUSED(intf);
+
+    bus_ctx[busid].dtr_enable = dtr;
 }
 
 void usbd_cdc_acm_set_rts(uint8_t busid, uint8_t intf, bool rts) {
@@ -395,20 +433,58 @@ void usbd_cdc_acm_send_break(uint8_t busid, uint8_t intf) {
 }
 
 void cdc_acm_data_send_with_dtr_test(uint8_t busid) {
-    if (dtr_enable) {
-        ep_tx_busy_flag = true;
-        memset(&cdc_write_buffer[0], 'a', 10);
-        usbd_ep_start_write(busid, CDC_IN_EP, cdc_write_buffer, 10);
-        while (ep_tx_busy_flag) {
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+
+    if (ctx->dtr_enable) {
+        ctx->ep_tx_busy = true;
+        memset(&bus_bufs[busid].cdc_write[0], 'a', 10);
+        usbd_ep_start_write(busid, CDC_IN_EP, bus_bufs[busid].cdc_write, 10);
+        while (ctx->ep_tx_busy) {
         }
     }
 }
 
+/*!< starts a write without waiting, -1 if one is in flight or the bus is
+ *   suspended, data has to stay valid until cdc_acm_tx_busy() drops */
+int cdc_acm_data_write(uint8_t busid, const uint8_t *data, uint32_t len) {
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+
+    if (ctx->ep_tx_busy || ctx->suspended) {
+        return -1;
+    }
+
+    ctx->ep_tx_busy = true;
+    usbd_ep_start_write(busid, CDC_IN_EP, data, len);
+
+    return 0;
+}
+
+/*!< returns 1 if the bus got suspended first, the write then completes
+ *   after the resume and data has to stay valid until then */
 uint8_t cdc_acm_data_send(uint8_t busid, uint8_t *data, uint32_t len) {
-    ep_tx_busy_flag = true;
+    struct cdc_acm_hid_ctx *ctx = &bus_ctx[busid];
+
+    while (ctx->ep_tx_busy) {
+        if (ctx->suspended) {
+            return 1;
+        }
+    }
+
+    ctx->ep_tx_busy = true;
     usbd_ep_start_write(busid, CDC_IN_EP, data, len);
-    while (ep_tx_busy_flag) {
+    while (ctx->ep_tx_busy) {
+        if (ctx->suspended) {
+            return 1;
+        }
     }
 
     return 0;
 }
+
+bool cdc_acm_tx_busy(uint8_t busid) {
+    return bus_ctx[busid].ep_tx_busy;
+}
+
+bool cdc_acm_dtr(uint8_t busid) {
+    return bus_ctx[busid].dtr_enable;
+}
@@ -36,19 +36,16 @@ extern "C" {
 
 extern const uint8_t cdc_acm_hid_descriptor[];
 extern const uint8_t hid_custom_report_desc[HID_CUSTOM_REPORT_DESC_SIZE];
-extern struct usbd_interface cdc_intf0;
-extern struct usbd_interface cdc_intf1;
-extern struct usbd_interface hid_intf;
-extern struct usbd_endpoint cdc_out_ep;
-extern struct usbd_endpoint cdc_in_ep;
-extern struct usbd_endpoint custom_hid_in_ep;
-extern struct usbd_endpoint custom_hid_out_ep;
 
 int cdc_acm_hid_init(uint8_t busid, uint32_t reg_base);
 uint8_t cdc_acm_data_send(uint8_t busid, uint8_t *data, uint32_t len);
+int cdc_acm_data_write(uint8_t busid, const uint8_t *data, uint32_t len);
 void usbd_cdc_get_out_data(uint8_t busid, uint8_t *data, uint32_t len);
 void usbd_event_handler(uint8_t busid, uint8_t event);
+void usb_pm_event_handler(uint8_t busid, uint8_t event);
 void cdc_acm_data_send_with_dtr_test(uint8_t busid);
+bool cdc_acm_tx_busy(uint8_t busid);
+bool cdc_acm_dtr(uint8_t busid);
 
 #ifdef __cplusplus
 }
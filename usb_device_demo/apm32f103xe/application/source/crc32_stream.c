@@ -0,0 +1,301 @@
+/**
+  * @file    crc32_stream.c
+  * @author  LuckkMaker
+  * @brief   Streaming CRC-32 on the CRC unit, fed by DMA
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Buffers handed to crc32_stream_feed() are queued and pushed into CRC->DATA by
+  * a DMA1 memory-to-memory channel, the next one is started from the transfer
+  * complete interrupt. The buffer is the "peripheral" side of the channel so it
+  * is the one that increments. The caller keeps the buffer untouched until its
+  * callback ran or crc32_stream_busy() returns false.
+  *
+  * The DMA interrupt uses the USB interrupt priority, so callbacks may touch USB
+  * class state directly.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "crc32_stream.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct crc32_stream_req {
+    const uint32_t *buf;
+    uint32_t words;
+    bool reset;
+    crc32_stream_cb_t cb;
+    void *arg;
+};
+
+/* Private define ------------------------------------------------------------*/
+/*!< CHNDATA is 16 bits wide */
+#define CRC32_STREAM_DMA_MAX    0xFFFFU
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/*!< CRC of one nibble shifted out of the top of the register */
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000U, 0x04C11DB7U, 0x09823B6EU, 0x0D4326D9U,
+    0x130476DCU, 0x17C56B6BU, 0x1A864DB2U, 0x1E475005U,
+    0x2608EDB8U, 0x22C9F00FU, 0x2F8AD6D6U, 0x2B4BCB61U,
+    0x350C9B64U, 0x31CD86D3U, 0x3C8EA00AU, 0x384FBDBDU
+};
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+static uint32_t crc_sw_value = CRC32_STREAM_INIT_VALUE;
+#endif
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+static DMA_Config_T crc_dma_config;
+
+static struct crc32_stream_req crc_queue[CRC32_STREAM_QUEUE_DEPTH];
+static uint32_t crc_head;
+static uint32_t crc_tail;
+static volatile uint32_t crc_cnt;
+static volatile bool crc_running;
+static uint32_t crc_chunk;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+static void crc32_stream_start(void) {
+    struct crc32_stream_req *req;
+
+    if (crc_running || (crc_cnt == 0)) {
+        return;
+    }
+
+    req = &crc_queue[crc_tail];
+    if (req->reset) {
+        CRC_ResetDATA();
+        req->reset = false;
+    }
+
+    crc_chunk = (req->words > CRC32_STREAM_DMA_MAX) ? CRC32_STREAM_DMA_MAX : req->words;
+    crc_running = true;
+
+    DMA_Disable(CRC32_STREAM_DMA_CHANNEL);
+    crc_dma_config.peripheralBaseAddr = (uint32_t)req->buf;
+    crc_dma_config.bufferSize = crc_chunk;
+    DMA_Config(CRC32_STREAM_DMA_CHANNEL, &crc_dma_config);
+    DMA_EnableInterrupt(CRC32_STREAM_DMA_CHANNEL, DMA_INT_TC | DMA_INT_TERR);
+    DMA_Enable(CRC32_STREAM_DMA_CHANNEL);
+}
+
+/**
+ * @brief   DMA channel interrupt, called from the channel IRQ handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void crc32_stream_dma_irq_handler(void) {
+    struct crc32_stream_req *req = &crc_queue[crc_tail];
+
+    if (DMA_ReadIntFlag(CRC32_STREAM_DMA_FLAG_TERR)) {
+        /* finish the request, the wrong CRC is caught by whoever checks it */
+        crc_chunk = req->words;
+    } else if (!DMA_ReadIntFlag(CRC32_STREAM_DMA_FLAG_TC)) {
+        return;
+    }
+
+    DMA_ClearIntFlag(CRC32_STREAM_DMA_FLAG_GINT);
+    DMA_Disable(CRC32_STREAM_DMA_CHANNEL);
+
+    crc_running = false;
+    req->buf += crc_chunk;
+    req->words -= crc_chunk;
+
+    if (req->words == 0) {
+        if (req->cb != NULL) {
+            req->cb(CRC_ReadCRC(), req->arg);
+        }
+        crc_tail = (crc_tail + 1) % CRC32_STREAM_QUEUE_DEPTH;
+        crc_cnt--;
+    }
+
+    crc32_stream_start();
+}
+#else
+void crc32_stream_dma_irq_handler(void) {
+}
+#endif
+
+void crc32_stream_init(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+    crc_sw_value = CRC32_STREAM_INIT_VALUE;
+#else
+    RCM_EnableAHBPeriphClock(RCM_AHB_PERIPH_CRC);
+    CRC_ResetDATA();
+#endif
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    RCM_EnableAHBPeriphClock(RCM_AHB_PERIPH_DMA1);
+
+    crc_dma_config.peripheralBaseAddr   = 0;
+    crc_dma_config.memoryBaseAddr       = (uint32_t)&CRC->DATA;
+    crc_dma_config.dir                  = DMA_DIR_PERIPHERAL_SRC;
+    crc_dma_config.bufferSize           = 0;
+    crc_dma_config.peripheralInc        = DMA_PERIPHERAL_INC_ENABLE;
+    crc_dma_config.memoryInc            = DMA_MEMORY_INC_DISABLE;
+    crc_dma_config.peripheralDataSize   = DMA_PERIPHERAL_DATA_SIZE_WOED;
+    crc_dma_config.memoryDataSize       = DMA_MEMORY_DATA_SIZE_WOED;
+    crc_dma_config.loopMode             = DMA_MODE_NORMAL;
+    crc_dma_config.priority             = DMA_PRIORITY_LOW;
+    crc_dma_config.M2M                  = DMA_M2MEN_ENABLE;
+
+    DMA_Reset(CRC32_STREAM_DMA_CHANNEL);
+    DMA_ClearIntFlag(CRC32_STREAM_DMA_FLAG_GINT);
+
+    crc_head = 0;
+    crc_tail = 0;
+    crc_cnt = 0;
+    crc_running = false;
+
+    /* same priority as USBD, see file header */
+    NVIC_EnableIRQRequest(CRC32_STREAM_DMA_IRQn, 1, 0);
+#endif
+}
+
+/**
+ * @brief   Queue a buffer for the running CRC
+ *
+ * @param   buf   word aligned buffer, left untouched until consumed
+ *
+ * @param   words number of 32-bit words
+ *
+ * @param   reset restart from CRC32_STREAM_INIT_VALUE before this buffer
+ *
+ * @param   cb    called with the running CRC once the buffer is consumed, may be NULL
+ *
+ * @param   arg   passed to cb
+ *
+ * @retval  0 on success, -1 if the queue is full
+ */
+int crc32_stream_feed(const uint32_t *buf, uint32_t words, bool reset, crc32_stream_cb_t cb, void *arg) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    uint32_t primask;
+
+    if (words == 0) {
+        return -1;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (crc_cnt == CRC32_STREAM_QUEUE_DEPTH) {
+        __set_PRIMASK(primask);
+        return -1;
+    }
+
+    crc_queue[crc_head].buf = buf;
+    crc_queue[crc_head].words = words;
+    crc_queue[crc_head].reset = reset;
+    crc_queue[crc_head].cb = cb;
+    crc_queue[crc_head].arg = arg;
+    crc_head = (crc_head + 1) % CRC32_STREAM_QUEUE_DEPTH;
+    crc_cnt++;
+
+    crc32_stream_start();
+
+    __set_PRIMASK(primask);
+#elif (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_CPU)
+    uint32_t crc;
+
+    if (reset) {
+        CRC_ResetDATA();
+    }
+
+    crc = CRC_CalculateBlockCRC((uint32_t *)buf, words);
+    if (cb != NULL) {
+        cb(crc, arg);
+    }
+#else
+    if (reset) {
+        crc_sw_value = CRC32_STREAM_INIT_VALUE;
+    }
+
+    crc_sw_value = crc32_sw_update(crc_sw_value, buf, words);
+    if (cb != NULL) {
+        cb(crc_sw_value, arg);
+    }
+#endif
+
+    return 0;
+}
+
+bool crc32_stream_busy(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    return (crc_cnt != 0);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief   Running CRC, valid once crc32_stream_busy() returns false
+ *
+ * @param   None
+ *
+ * @retval  CRC value
+ */
+uint32_t crc32_stream_value(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+    return crc_sw_value;
+#else
+    return CRC_ReadCRC();
+#endif
+}
+
+uint32_t crc32_stream_calc(const uint32_t *buf, uint32_t words) {
+    if (crc32_stream_feed(buf, words, true, NULL, NULL) != 0) {
+        return crc32_sw_update(CRC32_STREAM_INIT_VALUE, buf, words);
+    }
+
+    while (crc32_stream_busy()) {
+    }
+
+    return crc32_stream_value();
+}
+
+/**
+ * @brief   Software CRC, same result as the CRC unit
+ *
+ * @param   crc   running value, CRC32_STREAM_INIT_VALUE to start
+ *
+ * @param   buf   word aligned buffer
+ *
+ * @param   words number of 32-bit words
+ *
+ * @retval  updated CRC value
+ */
+uint32_t crc32_sw_update(uint32_t crc, const uint32_t *buf, uint32_t words) {
+    uint32_t i;
+
+    while (words--) {
+        crc ^= *buf++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc << 4) ^ crc32_nibble_table[crc >> 28];
+        }
+    }
+
+    return crc;
+}
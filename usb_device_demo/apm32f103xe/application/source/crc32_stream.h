@@ -0,0 +1,78 @@
+/**
+  * @file    crc32_stream.h
+  * @author  LuckkMaker
+  * @brief   Header for crc32_stream.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef CRC32_STREAM_H
+#define CRC32_STREAM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< CRC-32 of the CRC unit: poly 0x04C11DB7, init 0xFFFFFFFF, 32-bit words
+ *   MSB first, no reflection, no final XOR. Appending the CRC of an image as
+ *   one more word makes the CRC of the whole image 0, see tools/crc32_image.py */
+
+#define CRC32_STREAM_BACKEND_DMA    0   /*!< CRC unit fed by DMA1 memory-to-memory */
+#define CRC32_STREAM_BACKEND_CPU    1   /*!< CRC unit fed by the CPU */
+#define CRC32_STREAM_BACKEND_SW     2   /*!< nibble table, no peripheral used */
+
+#ifndef CRC32_STREAM_BACKEND
+#define CRC32_STREAM_BACKEND        CRC32_STREAM_BACKEND_DMA
+#endif
+
+/*!< buffers that may wait for the DMA */
+#ifndef CRC32_STREAM_QUEUE_DEPTH
+#define CRC32_STREAM_QUEUE_DEPTH    4U
+#endif
+
+/*!< any free DMA1 channel works for memory-to-memory */
+#ifndef CRC32_STREAM_DMA_CHANNEL
+#define CRC32_STREAM_DMA_CHANNEL    DMA1_Channel1
+#define CRC32_STREAM_DMA_IRQn       DMA1_Channel1_IRQn
+#define CRC32_STREAM_DMA_FLAG_TC    DMA1_INT_FLAG_TC1
+#define CRC32_STREAM_DMA_FLAG_TERR  DMA1_INT_FLAG_TERR1
+#define CRC32_STREAM_DMA_FLAG_GINT  DMA1_INT_FLAG_GINT1
+#endif
+
+#define CRC32_STREAM_INIT_VALUE     0xFFFFFFFFU
+
+/*!< called with the running CRC once a buffer is consumed, from the DMA interrupt */
+typedef void (*crc32_stream_cb_t)(uint32_t crc, void *arg);
+
+void crc32_stream_init(void);
+int crc32_stream_feed(const uint32_t *buf, uint32_t words, bool reset, crc32_stream_cb_t cb, void *arg);
+bool crc32_stream_busy(void);
+uint32_t crc32_stream_value(void);
+uint32_t crc32_stream_calc(const uint32_t *buf, uint32_t words);
+uint32_t crc32_sw_update(uint32_t crc, const uint32_t *buf, uint32_t words);
+void crc32_stream_dma_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CRC32_STREAM_H */
@@ -0,0 +1,147 @@
+/**
+  * @file    dfu_flash.c
+  * @author  LuckkMaker
+  * @brief   Flash backend of the DFU demo, erase and program run from RAM
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * dfu_flash_erase() and dfu_flash_program() are placed in .RamFunc and touch the
+  * FMC registers directly, so the busy wait loop never fetches from the array
+  * being written. Interrupt handlers still live in flash, the core stalls on them
+  * until the current half-word (or the page erase) is done.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dfu_flash.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define DFU_FLASH_STS_ERRORS    (FMC_FLAG_PE | FMC_FLAG_WPE)
+
+/*!< high density devices, 2 KB pages */
+#define DFU_FLASH_PAGE_SIZE     0x800U
+
+/*!< typical figures from the datasheet */
+#define DFU_FLASH_HWORD_PROG_US 52U
+#define DFU_FLASH_PAGE_ERASE_MS 40U
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+int dfu_flash_unlock(void) {
+    FMC_Unlock();
+
+    return FMC->CTRL2_B.LOCK ? -1 : 0;
+}
+
+void dfu_flash_lock(void) {
+    FMC_Lock();
+}
+
+/**
+ * @brief   Size of the erase unit holding addr
+ *
+ * @param   addr flash address
+ *
+ * @retval  page size in bytes
+ */
+uint32_t dfu_flash_sector_size(uint32_t addr) {
+    (void)addr;
+
+    return DFU_FLASH_PAGE_SIZE;
+}
+
+uint32_t dfu_flash_erase_time(uint32_t addr) {
+    (void)addr;
+
+    return DFU_FLASH_PAGE_ERASE_MS;
+}
+
+uint32_t dfu_flash_program_time(uint32_t len) {
+    return ((len / 2U) * DFU_FLASH_HWORD_PROG_US + 999U) / 1000U;
+}
+
+/**
+ * @brief   Erase the page holding addr
+ *
+ * @param   addr any address inside the page
+ *
+ * @retval  0 on success, -1 on a flash error
+ */
+__RAM_FUNC int dfu_flash_erase(uint32_t addr) {
+    while (FMC->STS_B.BUSYF) {
+    }
+    FMC->STS = DFU_FLASH_STS_ERRORS | FMC_FLAG_OC;
+
+    FMC->CTRL2_B.PAGEERA = BIT_SET;
+    FMC->ADDR = addr & ~(DFU_FLASH_PAGE_SIZE - 1U);
+    FMC->CTRL2_B.STA = BIT_SET;
+    __DSB();
+
+    while (FMC->STS_B.BUSYF) {
+    }
+
+    FMC->CTRL2_B.PAGEERA = BIT_RESET;
+
+    return (FMC->STS & DFU_FLASH_STS_ERRORS) ? -1 : 0;
+}
+
+/**
+ * @brief   Program an erased area
+ *
+ * @param   addr destination, half-word aligned
+ *
+ * @param   buf  half-word aligned source in RAM
+ *
+ * @param   len  byte count, multiple of DFU_FLASH_PROGRAM_ALIGN
+ *
+ * @retval  0 on success, -1 on a flash error
+ */
+__RAM_FUNC int dfu_flash_program(uint32_t addr, const uint8_t *buf, uint32_t len) {
+    __IO uint16_t *dst = (__IO uint16_t *)addr;
+    const uint16_t *src = (const uint16_t *)buf;
+    uint32_t n = len / DFU_FLASH_PROGRAM_ALIGN;
+    uint32_t sts = 0;
+
+    while (FMC->STS_B.BUSYF) {
+    }
+    FMC->STS = DFU_FLASH_STS_ERRORS | FMC_FLAG_OC;
+
+    FMC->CTRL2_B.PG = BIT_SET;
+
+    while (n--) {
+        *dst++ = *src++;
+        __DSB();
+
+        while (FMC->STS_B.BUSYF) {
+        }
+
+        sts = FMC->STS & DFU_FLASH_STS_ERRORS;
+        if (sts) {
+            break;
+        }
+    }
+
+    FMC->CTRL2_B.PG = BIT_RESET;
+
+    return sts ? -1 : 0;
+}
@@ -0,0 +1,84 @@
+/**
+  * @file    dlog.h
+  * @author  LuckkMaker
+  * @brief   Header for dlog.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef DLOG_H
+#define DLOG_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< included from usb_config.h, keep this header free of device includes */
+
+#define DLOG_MODE_TEXT              0   /*!< dlog_flush() formats with printf */
+#define DLOG_MODE_BINARY            1   /*!< dlog_flush() writes the raw records, see tools/dlog_decode.py */
+
+#ifndef DLOG_MODE
+#define DLOG_MODE                   DLOG_MODE_TEXT
+#endif
+
+/*!< records in the ring, a power of two */
+#ifndef DLOG_DEPTH
+#define DLOG_DEPTH                  64U
+#endif
+
+/*!< 32-bit arguments per record, the rest is dropped */
+#define DLOG_MAX_ARGS               6U
+
+/*!< record: format address, header, arguments, 32 bytes little endian */
+#define DLOG_RECORD_WORDS           (2U + DLOG_MAX_ARGS)
+#define DLOG_HDR_MAGIC              0xD1U
+#define DLOG_HDR(nargs, seq)        ((DLOG_HDR_MAGIC << 24) | ((uint32_t)(nargs) << 16) | ((seq) & 0xFFFFU))
+
+/*!< counts the arguments after the format, up to 10, DLOG() rejects more than DLOG_MAX_ARGS */
+#define DLOG_NARGS(...)             DLOG_NARGS_(__VA_ARGS__, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DLOG_NARGS_(fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, n, ...) n
+
+/**
+ * @brief   printf-like, stores the format address and the raw arguments
+ *
+ * Arguments are taken as 32-bit words: integers, characters and pointers.
+ * 64-bit and floating point arguments are not supported. A %s argument is
+ * read when the record is formatted, so it has to be a string constant.
+ * More than DLOG_MAX_ARGS arguments does not compile.
+ */
+#define DLOG(...)                                                                                  \
+    do {                                                                                           \
+        _Static_assert(DLOG_NARGS(__VA_ARGS__) <= DLOG_MAX_ARGS, "DLOG: too many arguments");      \
+        dlog_write(DLOG_NARGS(__VA_ARGS__), __VA_ARGS__);                                          \
+    } while (0)
+
+void dlog_write(uint32_t nargs, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void dlog_flush(void);
+uint32_t dlog_read(uint32_t *buf, uint32_t records);
+uint32_t dlog_dropped(void);
+void dlog_sink(const uint8_t *data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DLOG_H */
@@ -0,0 +1,286 @@
+/**
+  * @file    hid_report_queue.c
+  * @author  LuckkMaker
+  * @brief   Queued HID IN reports, one transfer per polling interval
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Exactly one IN transfer is armed at a time and the next one is started from
+  * the IN complete callback, so the endpoint carries one report per bInterval
+  * and nothing is written to the TX buffer while the core reads it.
+  *
+  * Two kinds of reports:
+  *   - event reports (hid_report_queue_push), kept in order, refused when the
+  *     queue is full,
+  *   - input-state reports (hid_report_queue_set_state), one slot per report
+  *     ID, a newer value overwrites one not sent yet.
+  * Event reports go first, state slots are served round robin after them.
+  *
+  * Reports are copied on entry, the caller may reuse its buffer right away.
+  * Each device bus has a queue of its own, the busid selects it.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "hid_report_queue.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct hid_report_slot {
+    uint32_t len;
+    uint8_t data[HID_REPORT_QUEUE_MAX_SIZE];
+};
+
+/*!< one queue per device bus */
+struct hid_report_queue {
+    struct hid_report_slot fifo[HID_REPORT_QUEUE_DEPTH];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t cnt;
+
+    struct hid_report_slot state[HID_REPORT_QUEUE_STATE_SLOTS];
+    uint32_t state_dirty;
+    uint32_t state_next;
+
+    uint8_t *tx_buf;
+    uint8_t ep;
+    volatile bool busy;
+    volatile bool active;
+
+    struct hid_report_queue_stats stats;
+};
+
+/* Private define ------------------------------------------------------------*/
+#if (HID_REPORT_QUEUE_STATE_SLOTS > 32U)
+#error "HID_REPORT_QUEUE_STATE_SLOTS must fit the dirty mask"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define HID_REPORT_LOCK(m)      do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define HID_REPORT_UNLOCK(m)    __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+static struct hid_report_queue report_queue[CONFIG_USBDEV_MAX_BUS];
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/* call with interrupts masked or from the USB interrupt */
+static void hid_report_queue_kick(uint8_t busid) {
+    struct hid_report_queue *q = &report_queue[busid];
+    struct hid_report_slot *slot = NULL;
+    uint32_t i;
+    uint32_t n;
+
+    if (q->busy || !q->active) {
+        return;
+    }
+
+    if (q->cnt) {
+        slot = &q->fifo[q->tail];
+        q->tail = (q->tail + 1) % HID_REPORT_QUEUE_DEPTH;
+        q->cnt--;
+    } else if (q->state_dirty) {
+        for (n = 0; n < HID_REPORT_QUEUE_STATE_SLOTS; n++) {
+            i = (q->state_next + n) % HID_REPORT_QUEUE_STATE_SLOTS;
+            if (q->state_dirty & (1UL << i)) {
+                slot = &q->state[i];
+                q->state_dirty &= ~(1UL << i);
+                q->state_next = (i + 1) % HID_REPORT_QUEUE_STATE_SLOTS;
+                break;
+            }
+        }
+    }
+
+    if (slot == NULL) {
+        return;
+    }
+
+    memcpy(q->tx_buf, slot->data, slot->len);
+    q->busy = true;
+    usbd_ep_start_write(busid, q->ep, q->tx_buf, slot->len);
+}
+
+/**
+ * @brief   Bind the queue of a bus to an interrupt IN endpoint
+ *
+ * @param   busid  USB bus
+ *
+ * @param   ep     IN endpoint address
+ *
+ * @param   tx_buf transfer buffer of HID_REPORT_QUEUE_MAX_SIZE bytes, only used by the queue
+ *
+ * @retval  None
+ */
+void hid_report_queue_init(uint8_t busid, uint8_t ep, uint8_t *tx_buf) {
+    report_queue[busid].ep = ep;
+    report_queue[busid].tx_buf = tx_buf;
+    hid_report_queue_set_active(busid, false);
+}
+
+/**
+ * @brief   Flush the queue and the state slots, then allow or stop transfers
+ *
+ * @param   busid  USB bus
+ *
+ * @param   active true once the configuration is set, false on reset
+ *
+ * @retval  None
+ */
+void hid_report_queue_set_active(uint8_t busid, bool active) {
+    struct hid_report_queue *q = &report_queue[busid];
+    uint32_t primask;
+    uint32_t i;
+
+    HID_REPORT_LOCK(primask);
+    /* nothing from before the switch is sent or holds a report ID */
+    for (i = 0; i < HID_REPORT_QUEUE_DEPTH; i++) {
+        q->fifo[i].len = 0;
+    }
+    for (i = 0; i < HID_REPORT_QUEUE_STATE_SLOTS; i++) {
+        q->state[i].len = 0;
+    }
+    q->head = 0;
+    q->tail = 0;
+    q->cnt = 0;
+    q->state_dirty = 0;
+    q->state_next = 0;
+    q->busy = false;
+    q->active = active;
+    HID_REPORT_UNLOCK(primask);
+}
+
+/**
+ * @brief   Queue an event report
+ *
+ * @param   busid  USB bus
+ *
+ * @param   report report, ID first
+ *
+ * @param   len    byte count
+ *
+ * @retval  0 on success, -1 if the queue is full or len is too large
+ */
+int hid_report_queue_push(uint8_t busid, const uint8_t *report, uint32_t len) {
+    struct hid_report_queue *q = &report_queue[busid];
+    uint32_t primask;
+
+    if ((len == 0) || (len > HID_REPORT_QUEUE_MAX_SIZE)) {
+        return -1;
+    }
+
+    HID_REPORT_LOCK(primask);
+
+    if (q->cnt == HID_REPORT_QUEUE_DEPTH) {
+        q->stats.dropped++;
+        HID_REPORT_UNLOCK(primask);
+        return -1;
+    }
+
+    memcpy(q->fifo[q->head].data, report, len);
+    q->fifo[q->head].len = len;
+    q->head = (q->head + 1) % HID_REPORT_QUEUE_DEPTH;
+    q->cnt++;
+    q->stats.queued++;
+
+    hid_report_queue_kick(busid);
+
+    HID_REPORT_UNLOCK(primask);
+
+    return 0;
+}
+
+/**
+ * @brief   Publish the latest value of an input-state report
+ *
+ * @param   busid  USB bus
+ *
+ * @param   report report, ID first, the ID selects the slot
+ *
+ * @param   len    byte count
+ *
+ * @retval  0 on success, -1 if no slot is left for a new ID or len is too large
+ */
+int hid_report_queue_set_state(uint8_t busid, const uint8_t *report, uint32_t len) {
+    struct hid_report_queue *q = &report_queue[busid];
+    uint32_t primask;
+    uint32_t i;
+    int free_slot = -1;
+
+    if ((len == 0) || (len > HID_REPORT_QUEUE_MAX_SIZE)) {
+        return -1;
+    }
+
+    HID_REPORT_LOCK(primask);
+
+    for (i = 0; i < HID_REPORT_QUEUE_STATE_SLOTS; i++) {
+        if (q->state[i].len && (q->state[i].data[0] == report[0])) {
+            break;
+        }
+        if ((free_slot < 0) && (q->state[i].len == 0)) {
+            free_slot = (int)i;
+        }
+    }
+
+    if (i == HID_REPORT_QUEUE_STATE_SLOTS) {
+        if (free_slot < 0) {
+            HID_REPORT_UNLOCK(primask);
+            return -1;
+        }
+        i = (uint32_t)free_slot;
+    }
+
+    if (q->state_dirty & (1UL << i)) {
+        q->stats.coalesced++;
+    }
+
+    memcpy(q->state[i].data, report, len);
+    q->state[i].len = len;
+    q->state_dirty |= (1UL << i);
+
+    hid_report_queue_kick(busid);
+
+    HID_REPORT_UNLOCK(primask);
+
+    return 0;
+}
+
+uint32_t hid_report_queue_space(uint8_t busid) {
+    return HID_REPORT_QUEUE_DEPTH - report_queue[busid].cnt;
+}
+
+/**
+ * @brief   IN complete, call from the endpoint callback
+ *
+ * @param   busid  USB bus
+ *
+ * @retval  None
+ */
+void hid_report_queue_in_complete(uint8_t busid) {
+    report_queue[busid].busy = false;
+    report_queue[busid].stats.sent++;
+
+    hid_report_queue_kick(busid);
+}
+
+void hid_report_queue_get_stats(uint8_t busid, struct hid_report_queue_stats *stats) {
+    uint32_t primask;
+
+    HID_REPORT_LOCK(primask);
+    memcpy(stats, &report_queue[busid].stats, sizeof(*stats));
+    HID_REPORT_UNLOCK(primask);
+}
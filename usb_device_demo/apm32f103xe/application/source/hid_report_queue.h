@@ -0,0 +1,74 @@
+/**
+  * @file    hid_report_queue.h
+  * @author  LuckkMaker
+  * @brief   Header for hid_report_queue.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef HID_REPORT_QUEUE_H
+#define HID_REPORT_QUEUE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< event reports that may wait for the IN endpoint */
+#ifndef HID_REPORT_QUEUE_DEPTH
+#define HID_REPORT_QUEUE_DEPTH      8U
+#endif
+
+/*!< largest report, report ID included */
+#ifndef HID_REPORT_QUEUE_MAX_SIZE
+#ifdef CONFIG_USB_HS
+#define HID_REPORT_QUEUE_MAX_SIZE   1024U
+#else
+#define HID_REPORT_QUEUE_MAX_SIZE   64U
+#endif
+#endif
+
+/*!< input-state reports kept as latest value, one slot per report ID */
+#ifndef HID_REPORT_QUEUE_STATE_SLOTS
+#define HID_REPORT_QUEUE_STATE_SLOTS 4U
+#endif
+
+struct hid_report_queue_stats {
+    uint32_t queued;            /*!< event reports accepted */
+    uint32_t sent;              /*!< IN transfers completed */
+    uint32_t dropped;           /*!< event reports refused, queue full */
+    uint32_t coalesced;         /*!< state reports overwritten before they were sent */
+};
+
+void hid_report_queue_init(uint8_t busid, uint8_t ep, uint8_t *tx_buf);
+void hid_report_queue_set_active(uint8_t busid, bool active);
+int hid_report_queue_push(uint8_t busid, const uint8_t *report, uint32_t len);
+int hid_report_queue_set_state(uint8_t busid, const uint8_t *report, uint32_t len);
+uint32_t hid_report_queue_space(uint8_t busid);
+void hid_report_queue_in_complete(uint8_t busid);
+void hid_report_queue_get_stats(uint8_t busid, struct hid_report_queue_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* HID_REPORT_QUEUE_H */
@@ -30,8 +30,17 @@
 #include "apm32f1xx_device_cfg.h"
 #include "bsp_delay.h"
 #include "cdc_acm_hid.h"
+#include "usb_dfu.h"
+#include "usb_cdc_bench.h"
+#include "dlog.h"
+#include "uart_log.h"
+#include "usbd_fsdev_hp.h"
+#include "sched.h"
 
 /* Private macro **********************************************************/
+#define HELLO_PERIOD_MS                     500U
+#define LOG_PERIOD_MS                       10U
+#define REPORT_PERIOD_MS                    10000U
 
 /* Private typedef ********************************************************/
 
@@ -43,6 +52,32 @@
 
 /* External functions *****************************************************/
 
+#if (DEMO_SELECT == DEMO_CDC_ACM_HID) || (DEMO_SELECT == DEMO_CDC_BENCH)
+static void log_task(void *arg)
+{
+    (void)arg;
+    dlog_flush();
+}
+
+#if SCHED_STATS_ENABLE
+static void report_task(void *arg)
+{
+    (void)arg;
+    sched_report();
+}
+#endif /* SCHED_STATS_ENABLE */
+#endif /* DEMO_SELECT */
+
+#if (DEMO_SELECT == DEMO_CDC_ACM_HID)
+static void hello_task(void *arg)
+{
+    (void)arg;
+
+    /* Skipped while the last one is still in flight */
+    cdc_acm_data_write(0, (const uint8_t *)"Hello World!\r\n", 14);
+}
+#endif /* DEMO_SELECT */
+
 /**
  * @brief   Main program
  *
@@ -54,34 +89,48 @@ int main(void)
 {
     /* Device configuration */
     SPD_DeviceConfig();
+    uart_log_init();
 
-    cdc_acm_hid_init(0, USBD_BASE);
+#if (DEMO_SELECT == DEMO_DFU)
+    usb_dfu_init(0, USBD_BASE);
 
     /* Infinite loop */
     while (1)
     {
-        cdc_acm_data_send(0, "Hello World!\r\n", 14);
-        APM_DelayMs(500U);
+        dlog_flush();
+        usb_dfu_poll();
     }
+#elif (DEMO_SELECT == DEMO_CDC_BENCH)
+    usb_cdc_bench_init(0, USBD_BASE);
+
+    sched_task_add("log", log_task, NULL, LOG_PERIOD_MS);
+#if SCHED_STATS_ENABLE
+    sched_task_add("report", report_task, NULL, REPORT_PERIOD_MS);
+#endif /* SCHED_STATS_ENABLE */
+
+    /* Infinite loop */
+    sched_run();
+#else
+    cdc_acm_hid_init(0, USBD_BASE);
+
+    sched_task_add("log", log_task, NULL, LOG_PERIOD_MS);
+    sched_task_add("hello", hello_task, NULL, HELLO_PERIOD_MS);
+#if SCHED_STATS_ENABLE
+    sched_task_add("report", report_task, NULL, REPORT_PERIOD_MS);
+#endif /* SCHED_STATS_ENABLE */
+
+    /* Infinite loop */
+    sched_run();
+#endif /* DEMO_SELECT */
 }
 
 void usb_dc_low_level_init(void)
 {
     RCM_EnableAPB1PeriphClock(RCM_APB1_PERIPH_USB);
 
-#ifdef APM32F10X_HD
-#if USB_SELECT == USB1
-    NVIC_EnableIRQRequest(USBD1_LP_CAN1_RX0_IRQn, 1, 0);
-#else
-    NVIC_EnableIRQRequest(USBD2_LP_CAN2_RX0_IRQn, 1, 0);
-#endif
-#else
-#if USB_SELECT == USB1
-    NVIC_EnableIRQRequest(USBD1_LP_CAN1_RX0_IRQn, 1, 0);
-#else
-    NVIC_EnableIRQRequest(USBD2_LP_IRQn, 1, 0);
-#endif
-#endif
+    NVIC_EnableIRQRequest(USBD_FSDEV_LP_IRQn, USBD_FSDEV_LP_PRIO, 0);
+    /* correct transfers of double buffered endpoints, see usbd_fsdev_hp.c */
+    NVIC_EnableIRQRequest(USBD_FSDEV_HP_IRQn, USBD_FSDEV_HP_PRIO, 0);
 
 #if USB_SELECT == USB1
     USBD2_Disable(USBD);
@@ -94,19 +143,8 @@ void usb_dc_low_level_deinit(void)
 {
     RCM_DisableAPB1PeriphClock(RCM_APB1_PERIPH_USB);
 
-#ifdef APM32F10X_HD
-#if USB_SELECT == USB1
-    NVIC_DisableIRQRequest(USBD1_LP_CAN1_RX0_IRQn);
-#else
-    NVIC_DisableIRQRequest(USBD2_LP_CAN2_RX0_IRQn);
-#endif
-#else
-#if USB_SELECT == USB1
-    NVIC_DisableIRQRequest(USBD1_LP_CAN1_RX0_IRQn);
-#else
-    NVIC_DisableIRQRequest(USBD2_LP_IRQn);
-#endif
-#endif
+    NVIC_DisableIRQRequest(USBD_FSDEV_HP_IRQn);
+    NVIC_DisableIRQRequest(USBD_FSDEV_LP_IRQn);
 
 #if USB_SELECT == USB1
     USBD2_Enable(USBD);
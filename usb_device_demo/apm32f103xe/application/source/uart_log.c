@@ -0,0 +1,362 @@
+/**
+  * @file    uart_log.c
+  * @author  LuckkMaker
+  * @brief   Buffered stdout on the USART, drained by DMA
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * _write() copies into a byte ring and returns, the contiguous part of the
+  * ring behind the read side is sent by a DMA1 channel into USART->DATA. The
+  * half transfer interrupt gives the first half of a transfer back to writers,
+  * the transfer complete interrupt the rest, then starts the next part.
+  *
+  * The ring is only touched with interrupts masked, for the length of a
+  * memcpy, so _write() may be called from any context. Whether printf itself
+  * may is up to the C library, DLOG() is the interrupt safe way to log.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_log.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <stdbool.h>
+#include <string.h>
+#include "dlog.h"
+
+#if UART_LOG_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#if (UART_LOG_BUF_SIZE & (UART_LOG_BUF_SIZE - 1U)) || (UART_LOG_BUF_SIZE > 0x8000U)
+#error "UART_LOG_BUF_SIZE must be a power of two, up to 32 KB"
+#endif
+
+#define UART_LOG_MASK               (UART_LOG_BUF_SIZE - 1U)
+
+/* Private macro -------------------------------------------------------------*/
+#define UART_LOG_LOCK(m)            do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define UART_LOG_UNLOCK(m)          __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+static DMA_Config_T log_dma_config;
+
+static uint8_t log_buf[UART_LOG_BUF_SIZE];
+/*!< free running: tail <= dma_pos <= head, [tail, dma_pos) is with the DMA */
+static volatile uint32_t log_head;
+static volatile uint32_t log_tail;
+static uint32_t log_dma_pos;
+static uint32_t log_dma_len;
+static uint32_t log_dma_released;
+static volatile bool log_busy;
+static bool log_ready;
+static struct uart_log_stats log_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/*!< called with interrupts masked */
+static void uart_log_kick(void) {
+    uint32_t len;
+    uint32_t off;
+
+    if (log_busy || (log_dma_pos == log_head)) {
+        return;
+    }
+
+    off = log_dma_pos & UART_LOG_MASK;
+    len = log_head - log_dma_pos;
+    if (len > (UART_LOG_BUF_SIZE - off)) {
+        len = UART_LOG_BUF_SIZE - off;
+    }
+
+    DMA_Disable(UART_LOG_DMA_CHANNEL);
+    log_dma_config.memoryBaseAddr = (uint32_t)&log_buf[off];
+    log_dma_config.bufferSize = len;
+    DMA_Config(UART_LOG_DMA_CHANNEL, &log_dma_config);
+    DMA_EnableInterrupt(UART_LOG_DMA_CHANNEL, DMA_INT_TC | DMA_INT_HT | DMA_INT_TERR);
+    DMA_Enable(UART_LOG_DMA_CHANNEL);
+
+    log_busy = true;
+    log_dma_len = len;
+    log_dma_released = 0;
+    log_dma_pos += len;
+    log_stats.dma_starts++;
+}
+
+#if (UART_LOG_POLICY == UART_LOG_POLICY_OVERWRITE)
+/*!< called with interrupts masked, the oldest queued bytes make room */
+static void uart_log_overwrite(uint32_t need) {
+    uint32_t keep;
+    uint32_t i;
+
+    keep = log_head - log_dma_pos - need;
+    for (i = 0; i < keep; i++) {
+        log_buf[(log_dma_pos + i) & UART_LOG_MASK] = log_buf[(log_dma_pos + need + i) & UART_LOG_MASK];
+    }
+    log_head -= need;
+    log_stats.overwritten += need;
+}
+#endif /* UART_LOG_POLICY */
+
+static void uart_log_copy(const uint8_t *data, uint32_t len) {
+    uint32_t off = log_head & UART_LOG_MASK;
+    uint32_t first = UART_LOG_BUF_SIZE - off;
+    uint32_t used;
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&log_buf[off], data, first);
+    memcpy(&log_buf[0], data + first, len - first);
+
+    log_head += len;
+    log_stats.written += len;
+    used = log_head - log_tail;
+    if (used > log_stats.peak) {
+        log_stats.peak = used;
+    }
+}
+
+/**
+ * @brief   USART and DMA setup, before the first printf
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void uart_log_init(void) {
+    GPIO_Config_T gpioConfig;
+    USART_Config_T usartConfig;
+
+    UART_LOG_CLK_ENABLE();
+
+    /* USART TX pin configuration */
+    gpioConfig.pin      = UART_LOG_TX_PIN;
+    gpioConfig.mode     = GPIO_MODE_AF_PP;
+    gpioConfig.speed    = GPIO_SPEED_50MHz;
+    GPIO_Config(UART_LOG_TX_PORT, &gpioConfig);
+
+    usartConfig.baudRate        = UART_LOG_BAUDRATE;
+    usartConfig.wordLength      = USART_WORD_LEN_8B;
+    usartConfig.stopBits        = USART_STOP_BIT_1;
+    usartConfig.parity          = USART_PARITY_NONE;
+    usartConfig.mode            = USART_MODE_TX;
+    usartConfig.hardwareFlow    = USART_HARDWARE_FLOW_NONE;
+    USART_Config(UART_LOG_USART, &usartConfig);
+    USART_EnableDMA(UART_LOG_USART, USART_DMA_TX);
+    USART_Enable(UART_LOG_USART);
+
+    log_dma_config.peripheralBaseAddr   = (uint32_t)&UART_LOG_USART->DATA;
+    log_dma_config.memoryBaseAddr       = 0;
+    log_dma_config.dir                  = DMA_DIR_PERIPHERAL_DST;
+    log_dma_config.bufferSize           = 0;
+    log_dma_config.peripheralInc        = DMA_PERIPHERAL_INC_DISABLE;
+    log_dma_config.memoryInc            = DMA_MEMORY_INC_ENABLE;
+    log_dma_config.peripheralDataSize   = DMA_PERIPHERAL_DATA_SIZE_BYTE;
+    log_dma_config.memoryDataSize       = DMA_MEMORY_DATA_SIZE_BYTE;
+    log_dma_config.loopMode             = DMA_MODE_NORMAL;
+    log_dma_config.priority             = DMA_PRIORITY_LOW;
+    log_dma_config.M2M                  = DMA_M2MEN_DISABLE;
+
+    DMA_Reset(UART_LOG_DMA_CHANNEL);
+    DMA_ClearIntFlag(UART_LOG_DMA_FLAG_GINT);
+
+    log_head = 0;
+    log_tail = 0;
+    log_dma_pos = 0;
+    log_busy = false;
+    memset(&log_stats, 0, sizeof(log_stats));
+    log_ready = true;
+
+    /* below USB, the ring lock masks everything anyway */
+    NVIC_EnableIRQRequest(UART_LOG_DMA_IRQn, 2, 0);
+}
+
+/**
+ * @brief   Queue bytes for the USART, applying UART_LOG_POLICY when full
+ *
+ * @param   data   bytes, copied before returning
+ *
+ * @param   len    number of bytes
+ *
+ * @retval  bytes queued
+ */
+uint32_t uart_log_write(const uint8_t *data, uint32_t len) {
+    uint32_t primask;
+    uint32_t room;
+    uint32_t done = 0;
+    uint32_t n;
+
+    if (!log_ready) {
+        return 0;
+    }
+
+    while (done < len) {
+        n = len - done;
+
+        UART_LOG_LOCK(primask);
+        room = UART_LOG_BUF_SIZE - (log_head - log_tail);
+
+#if (UART_LOG_POLICY == UART_LOG_POLICY_OVERWRITE)
+        if (n > room) {
+            /* only bytes not yet with the DMA can go */
+            uint32_t max = UART_LOG_BUF_SIZE - (log_dma_pos - log_tail);
+
+            if (n > max) {
+                log_stats.dropped += n - max;
+                done += n - max;
+                n = max;
+            }
+            if (n > room) {
+                uart_log_overwrite(n - room);
+            }
+            room = n;
+        }
+#elif (UART_LOG_POLICY == UART_LOG_POLICY_BLOCK)
+        if ((n > room) && ((__get_IPSR() != 0U) || (primask != 0U))) {
+            /* nobody would drain the ring while this context waits */
+            log_stats.dropped += n;
+            UART_LOG_UNLOCK(primask);
+            break;
+        }
+#endif /* UART_LOG_POLICY */
+
+        if (n > room) {
+#if (UART_LOG_POLICY == UART_LOG_POLICY_BLOCK)
+            /* whatever fits now, wait for the DMA to free more */
+            n = room;
+#else
+            log_stats.dropped += n;
+            UART_LOG_UNLOCK(primask);
+            break;
+#endif /* UART_LOG_POLICY */
+        }
+
+        uart_log_copy(data + done, n);
+        done += n;
+        uart_log_kick();
+        UART_LOG_UNLOCK(primask);
+    }
+
+    return done;
+}
+
+/**
+ * @brief   Wait until everything queued left the ring, thread mode only
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void uart_log_drain(void) {
+    while (log_busy || (log_tail != log_head)) {
+    }
+}
+
+void uart_log_get_stats(struct uart_log_stats *stats) {
+    uint32_t primask;
+
+    UART_LOG_LOCK(primask);
+    *stats = log_stats;
+    UART_LOG_UNLOCK(primask);
+}
+
+/**
+ * @brief   DMA channel interrupt, called from the channel IRQ handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void uart_log_dma_irq_handler(void) {
+    uint32_t primask;
+    uint32_t half;
+
+    UART_LOG_LOCK(primask);
+    if (DMA_ReadIntFlag(UART_LOG_DMA_FLAG_HT)) {
+        DMA_ClearIntFlag(UART_LOG_DMA_FLAG_HT);
+        half = log_dma_len / 2U;
+        log_tail += half - log_dma_released;
+        log_dma_released = half;
+    }
+
+    if (DMA_ReadIntFlag(UART_LOG_DMA_FLAG_TERR)) {
+        /* the channel stopped, its bytes are given up */
+        log_stats.errors++;
+    } else if (!DMA_ReadIntFlag(UART_LOG_DMA_FLAG_TC)) {
+        UART_LOG_UNLOCK(primask);
+        return;
+    }
+
+    DMA_ClearIntFlag(UART_LOG_DMA_FLAG_GINT);
+    DMA_Disable(UART_LOG_DMA_CHANNEL);
+
+    log_tail = log_dma_pos;
+    log_busy = false;
+    uart_log_kick();
+    UART_LOG_UNLOCK(primask);
+}
+
+/**
+ * @brief   stdout and stderr, replaces the __io_putchar() loop of syscalls.c
+ *
+ * @param   file   ignored
+ *
+ * @param   ptr    bytes
+ *
+ * @param   len    number of bytes
+ *
+ * @retval  len, bytes the policy drops are not reported to the C library
+ */
+int _write(int file, char *ptr, int len) {
+    (void)file;
+
+    if (len > 0) {
+        uart_log_write((const uint8_t *)ptr, (uint32_t)len);
+    }
+    return len;
+}
+
+/**
+ * @brief   Binary records of dlog.c, interleaved with stdout
+ */
+void dlog_sink(const uint8_t *data, uint32_t len) {
+    uart_log_write(data, len);
+}
+
+#else
+
+void uart_log_init(void) {
+}
+
+uint32_t uart_log_write(const uint8_t *data, uint32_t len) {
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+void uart_log_drain(void) {
+}
+
+void uart_log_get_stats(struct uart_log_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void uart_log_dma_irq_handler(void) {
+}
+
+#endif /* UART_LOG_ENABLE */
@@ -0,0 +1,67 @@
+/**
+  * @file    usb_dfu.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_dfu.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_DFU_H
+#define USB_DFU_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+#include "dfu_flash.h"
+#include "crc32_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< wTransferSize, one DNLOAD block per control transfer */
+#ifndef USB_DFU_TRANSFER_SIZE
+#define USB_DFU_TRANSFER_SIZE       CONFIG_USBDEV_REQUEST_BUFFER_LEN
+#endif
+
+/*!< 1: fail manifestation unless the image ends with its own CRC-32 (tools/crc32_image.py),
+ *   0: only report the CRC */
+#ifndef USB_DFU_CHECK_CRC
+#define USB_DFU_CHECK_CRC           0
+#endif
+
+/*!< figures of the last download, times measured with the DWT cycle counter */
+struct usb_dfu_stats {
+    uint32_t image_size;        /*!< bytes programmed */
+    uint32_t blocks;            /*!< DNLOAD blocks */
+    uint32_t total_ms;          /*!< first DNLOAD to end of manifestation */
+    uint32_t erase_ms;          /*!< time spent in sector erase */
+    uint32_t program_ms;        /*!< time spent programming and verifying */
+    uint32_t busy_polls;        /*!< GETSTATUS answered with dfuDNBUSY, host waited on flash */
+    uint32_t image_crc;         /*!< CRC-32 of the received image, 0 if it carries its own CRC */
+};
+
+int usb_dfu_init(uint8_t busid, uint32_t reg_base);
+void usb_dfu_poll(void);
+void usb_dfu_get_stats(struct usb_dfu_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_DFU_H */
@@ -0,0 +1,102 @@
+/**
+  * @file    usbd_ep_static.h
+  * @author  LuckkMaker
+  * @brief   Endpoint maps fixed at compile time
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * A demo lists its endpoints once, as an X-macro of
+  * EP(addr, type, mps, interval, callback) entries:
+  *
+  *   #define DEMO_EP_LIST(EP) \
+  *       EP(0x01, USB_ENDPOINT_TYPE_BULK, 64, 0x00, demo_bulk_out) \
+  *       EP(0x81, USB_ENDPOINT_TYPE_BULK, 64, 0x00, demo_bulk_in)
+  *
+  *   USBD_EP_STATIC_TABLE(demo_eps, DEMO_EP_LIST);
+  *
+  * and gets from it:
+  *   - the endpoint to callback map as a const table in flash,
+  *   - endpoint descriptors, DEMO_EP_LIST(USBD_EP_STATIC_DESC) inside the
+  *     descriptor array,
+  *   - build errors for an endpoint the core tables (CONFIG_USBDEV_EP_NUM)
+  *     cannot hold, one used twice, or a max packet size over the limit of
+  *     its type at the configured speed.
+  *
+  * usbd_ep_static_register() hands the table to the core, which keeps only
+  * the callback in its per-endpoint slot and never writes the entry.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USBD_EP_STATIC_H
+#define USBD_EP_STATIC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef CONFIG_USB_HS
+#define USBD_EP_STATIC_MPS_MAX(type)    (((type) == USB_ENDPOINT_TYPE_BULK) ? 512U : 1024U)
+#else
+#define USBD_EP_STATIC_MPS_MAX(type)    (((type) == USB_ENDPOINT_TYPE_ISOCHRONOUS) ? 1023U : 64U)
+#endif
+
+/*!< bit of an endpoint in a 32-bit map, IN in the upper half */
+#define USBD_EP_STATIC_BIT(addr)        (1UL << (((addr) & 0x0FU) + (((addr) & 0x80U) ? 16U : 0U)))
+
+/*!< X-macro expanders, the list passes each entry to one of these */
+#define USBD_EP_STATIC_ENTRY(addr, type, mps, interval, cb) \
+    { .ep_addr = (addr), .ep_cb = (cb) },
+
+#define USBD_EP_STATIC_DESC(addr, type, mps, interval, cb) \
+    USB_ENDPOINT_DESCRIPTOR_INIT(addr, type, mps, interval),
+
+#define USBD_EP_STATIC_SUM(addr, type, mps, interval, cb) \
+    + USBD_EP_STATIC_BIT(addr)
+
+#define USBD_EP_STATIC_OR(addr, type, mps, interval, cb) \
+    | USBD_EP_STATIC_BIT(addr)
+
+#define USBD_EP_STATIC_CHECK(addr, type, mps, interval, cb)                                         \
+    _Static_assert((((addr) & 0x7FU) != 0U) && (((addr) & 0x7FU) < CONFIG_USBDEV_EP_NUM),          \
+                   "endpoint " #addr " outside CONFIG_USBDEV_EP_NUM");                              \
+    _Static_assert((mps) <= USBD_EP_STATIC_MPS_MAX(type), "endpoint " #addr " max packet size too large");
+
+/*!< const endpoint map called name, checked at compile time */
+#define USBD_EP_STATIC_TABLE(name, list)                                                            \
+    list(USBD_EP_STATIC_CHECK)                                                                      \
+    _Static_assert((0UL list(USBD_EP_STATIC_SUM)) == (0UL list(USBD_EP_STATIC_OR)),                 \
+                   #list " uses an endpoint twice");                                                \
+    static const struct usbd_endpoint name[] = { list(USBD_EP_STATIC_ENTRY) }
+
+#define USBD_EP_STATIC_COUNT(name)      (sizeof(name) / sizeof((name)[0]))
+
+static inline void usbd_ep_static_register(uint8_t busid, const struct usbd_endpoint *table, uint32_t count) {
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        usbd_add_endpoint(busid, (struct usbd_endpoint *)&table[i]);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USBD_EP_STATIC_H */
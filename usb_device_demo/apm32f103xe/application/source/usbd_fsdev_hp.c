@@ -0,0 +1,301 @@
+/**
+  * @file    usbd_fsdev_hp.c
+  * @author  LuckkMaker
+  * @brief   Double buffered bulk IN endpoint serviced from the USB HP vector
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The USBD raises its HP vector only for correct transfers of isochronous
+  * and double buffered bulk endpoints. CherryUSB runs every endpoint single
+  * buffered from the LP vector, so a streaming IN endpoint NAKs from the
+  * moment a packet is acknowledged until the LP vector, maybe behind a
+  * control transfer, has copied the next one into the PMA.
+  *
+  * An endpoint opened here is taken over after CherryUSB configured it: the
+  * KIND bit makes it double buffered, buffer 0 stays at the PMA address
+  * CherryUSB gave it, buffer 1 goes to USBD_FSDEV_HP_PMA_ADDR. The core
+  * sends the buffer DTOG_TX selects and NAKs while DTOG_TX equals SW_BUF
+  * (DTOG_RX of an IN endpoint), software owns the SW_BUF buffer. On each
+  * acknowledged packet the HP vector releases the buffer loaded meanwhile by
+  * toggling SW_BUF and loads the next packet into the one just sent, so the
+  * host finds a packet ready as long as the HP vector keeps up with one
+  * packet time.
+  *
+  * A transfer is complete once its last packet is in the PMA, the callback
+  * runs from the LP vector, pended for it, in the same context as all other
+  * CherryUSB callbacks. The endpoint register must own both directions,
+  * so its OUT half stays unused. Isochronous IN is not covered: the core
+  * toggles it every frame whatever software did, it needs a frame driven
+  * feed instead.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_fsdev_hp.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+struct usbd_fsdev_hp_in {
+    USBD_T *usbx;
+    usbd_fsdev_hp_cb_t cb;
+    uint16_t pma[2];            /*!< buffer 0 in the TX descriptor fields, buffer 1 in the RX ones */
+    uint16_t mps;
+    uint8_t ep;                 /*!< endpoint register, the endpoint number */
+    uint8_t sw_buf;             /*!< buffer software owns, SW_BUF */
+    volatile bool open;
+    bool loaded;                /*!< the sw_buf buffer holds the next packet */
+    bool on_bus;                /*!< a released buffer waits for its ACK */
+    bool pending;               /*!< the transfer has packets not yet loaded */
+    volatile bool done;         /*!< completion waits for the LP vector */
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t ofs;
+};
+
+/* Private define ------------------------------------------------------------*/
+/*!< written as 1 to leave the rc_w0 flags alone, see usbd_fsdev_hp_write_epr() */
+#define USBD_FSDEV_HP_EPR_KEEP      (USBD_EP_BIT_CTFR | USBD_EP_BIT_CTFT)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct usbd_fsdev_hp_in hp_in;
+static struct usbd_fsdev_hp_stats hp_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/*!< the SPD helpers write the flags back as read, a CTR the core sets in
+ *   between would be lost, here they are written as 1 unless cleared */
+static void usbd_fsdev_hp_write_epr(uint32_t toggle, uint32_t clear) {
+    uint32_t reg = hp_in.usbx->EP[hp_in.ep].EP & USBD_EP_MASK_DEFAULT;
+
+    hp_in.usbx->EP[hp_in.ep].EP = ((reg | USBD_FSDEV_HP_EPR_KEEP) & ~clear) | toggle;
+}
+
+/*!< next packet of the transfer into the software buffer */
+static void usbd_fsdev_hp_load(void) {
+    uint32_t n = hp_in.len - hp_in.ofs;
+
+    if (n > hp_in.mps) {
+        n = hp_in.mps;
+    }
+
+    if (n != 0U) {
+        USBD_EP_WritePacketData(hp_in.usbx, hp_in.pma[hp_in.sw_buf], (uint8_t *)&hp_in.data[hp_in.ofs], n);
+    }
+    if (hp_in.sw_buf == 0U) {
+        USBD_EP_SetTxCnt(hp_in.usbx, hp_in.ep, n);
+    } else {
+        /* count of buffer 1, the RX count field of a double buffered IN */
+        USBD_EP_SetBuffer0TxCnt(hp_in.usbx, hp_in.ep, n);
+    }
+    hp_in.ofs += n;
+    hp_in.loaded = true;
+
+    if (hp_in.ofs >= hp_in.len) {
+        hp_in.pending = false;
+        hp_in.done = true;
+        USBD_FSDEV_HP_PEND_LP();
+    }
+}
+
+/*!< hand the loaded buffer to the core, the other one becomes software's */
+static void usbd_fsdev_hp_release(void) {
+    usbd_fsdev_hp_write_epr(USBD_EP_BIT_RXDTOG, 0U);
+    hp_in.sw_buf ^= 1U;
+    hp_in.loaded = false;
+    hp_in.on_bus = true;
+}
+
+/**
+ * @brief   Take over a configured bulk IN endpoint as double buffered
+ *
+ * @param   usbx      USB peripheral
+ *
+ * @param   ep_addr   IN endpoint, opened by CherryUSB and idle
+ *
+ * @param   mps       max packet size
+ *
+ * @param   cb        completion, from the LP vector
+ *
+ * @retval  0 on success, -1 on a bad endpoint
+ */
+int usbd_fsdev_hp_in_open(USBD_T *usbx, uint8_t ep_addr, uint16_t mps, usbd_fsdev_hp_cb_t cb) {
+    uint8_t ep = ep_addr & 0x0FU;
+
+    if (!(ep_addr & 0x80U) || (ep == 0U) || (mps == 0U) || (mps > 64U) ||
+        ((USBD_FSDEV_HP_PMA_ADDR + mps) > 512U)) {
+        return -1;
+    }
+
+    USBD_FSDEV_HP_MASK();
+
+    memset(&hp_in, 0, sizeof(hp_in));
+    hp_in.usbx = usbx;
+    hp_in.cb = cb;
+    hp_in.ep = ep;
+    hp_in.mps = mps;
+    hp_in.pma[0] = (uint16_t)USBD_EP_ReadTxAddr(usbx, ep);
+    hp_in.pma[1] = USBD_FSDEV_HP_PMA_ADDR;
+
+    USBD_EP_SetTxStatus(usbx, ep, USBD_EP_STATUS_NAK);
+    USBD_EP_SetKind(usbx, ep);
+    USBD_EP_SetRxAddr(usbx, ep, hp_in.pma[1]);
+    USBD_EP_SetTxCnt(usbx, ep, 0U);
+    USBD_EP_SetBuffer0TxCnt(usbx, ep, 0U);
+
+    /* SW_BUF = DTOG_TX: nothing released, the data toggle runs on */
+    hp_in.sw_buf = (usbx->EP[ep].EP & USBD_EP_BIT_TXDTOG) ? 1U : 0U;
+    if (!(usbx->EP[ep].EP & USBD_EP_BIT_RXDTOG) != !hp_in.sw_buf) {
+        usbd_fsdev_hp_write_epr(USBD_EP_BIT_RXDTOG, 0U);
+    }
+    usbd_fsdev_hp_write_epr(0U, USBD_EP_BIT_CTFT);
+
+    /* STS stays VALID, the SW_BUF / DTOG_TX pair does the NAKing */
+    USBD_EP_SetTxStatus(usbx, ep, USBD_EP_STATUS_VALID);
+    hp_in.open = true;
+
+    USBD_FSDEV_HP_UNMASK();
+
+    return 0;
+}
+
+/**
+ * @brief   Give the endpoint back single buffered and NAKing
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usbd_fsdev_hp_in_close(void) {
+    uint32_t reg;
+
+    if (!hp_in.open) {
+        return;
+    }
+
+    USBD_FSDEV_HP_MASK();
+
+    hp_in.open = false;
+    hp_in.pending = false;
+    hp_in.done = false;
+
+    /* a bus reset cleared the register already, it is no longer this endpoint */
+    reg = hp_in.usbx->EP[hp_in.ep].EP;
+    if (((reg & USBD_EP_BIT_ADDR) == hp_in.ep) && (reg & USBD_EP_BIT_KIND)) {
+        USBD_EP_SetTxStatus(hp_in.usbx, hp_in.ep, USBD_EP_STATUS_NAK);
+        USBD_EP_ResetKind(hp_in.usbx, hp_in.ep);
+    }
+
+    USBD_FSDEV_HP_UNMASK();
+}
+
+/**
+ * @brief   Queue a transfer, no ZLP is added
+ *
+ * @param   data   bytes to send, read until the completion
+ *
+ * @param   len    length, 0 sends one zero length packet
+ *
+ * @retval  0 on success, -1 if closed or the last transfer is not complete
+ */
+int usbd_fsdev_hp_in_write(const uint8_t *data, uint32_t len) {
+    int ret = -1;
+
+    USBD_FSDEV_HP_MASK();
+
+    if (hp_in.open && !hp_in.pending && !hp_in.done) {
+        hp_in.data = data;
+        hp_in.len = len;
+        hp_in.ofs = 0;
+        hp_in.pending = true;
+
+        if (!hp_in.loaded) {
+            usbd_fsdev_hp_load();
+        }
+        if (!hp_in.on_bus) {
+            usbd_fsdev_hp_release();
+            if (hp_in.pending) {
+                usbd_fsdev_hp_load();
+            }
+        }
+        ret = 0;
+    }
+
+    USBD_FSDEV_HP_UNMASK();
+
+    return ret;
+}
+
+bool usbd_fsdev_hp_in_busy(void) {
+    return hp_in.pending || hp_in.done;
+}
+
+/**
+ * @brief   Correct transfer of the endpoint, called from the USB HP vector
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usbd_fsdev_hp_irq_handler(void) {
+    if (!hp_in.open || !(hp_in.usbx->EP[hp_in.ep].EP & USBD_EP_BIT_CTFT)) {
+        return;
+    }
+
+    usbd_fsdev_hp_write_epr(0U, USBD_EP_BIT_CTFT);
+    hp_in.on_bus = false;
+    hp_stats.packets++;
+
+    if (!hp_in.loaded) {
+        /* nothing behind it, NAKs until the next write */
+        hp_stats.underruns++;
+        return;
+    }
+
+    usbd_fsdev_hp_release();
+    if (hp_in.pending) {
+        usbd_fsdev_hp_load();
+        hp_stats.refills++;
+    }
+}
+
+/**
+ * @brief   Completion of a loaded transfer, first thing in the USB LP vector
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usbd_fsdev_hp_lp_handler(void) {
+    if (!hp_in.done) {
+        return;
+    }
+
+    hp_in.done = false;
+    hp_stats.transfers++;
+    if (hp_in.cb != NULL) {
+        hp_in.cb(hp_in.len);
+    }
+}
+
+void usbd_fsdev_hp_get_stats(struct usbd_fsdev_hp_stats *stats) {
+    USBD_FSDEV_HP_MASK();
+    *stats = hp_stats;
+    USBD_FSDEV_HP_UNMASK();
+}
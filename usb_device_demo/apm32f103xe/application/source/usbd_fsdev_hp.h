@@ -0,0 +1,106 @@
+/**
+  * @file    usbd_fsdev_hp.h
+  * @author  LuckkMaker
+  * @brief   Header for usbd_fsdev_hp.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USBD_FSDEV_HP_H
+#define USBD_FSDEV_HP_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< vectors of the selected USB peripheral */
+#ifdef APM32F10X_HD
+#if USB_SELECT == USB1
+#define USBD_FSDEV_LP_IRQn          USBD1_LP_CAN1_RX0_IRQn
+#define USBD_FSDEV_HP_IRQn          USBD1_HP_CAN1_TX_IRQn
+#else
+#define USBD_FSDEV_LP_IRQn          USBD2_LP_CAN2_RX0_IRQn
+#define USBD_FSDEV_HP_IRQn          USBD2_HP_CAN2_TX_IRQn
+#endif /* USB_SELECT */
+#else
+#if USB_SELECT == USB1
+#define USBD_FSDEV_LP_IRQn          USBD1_LP_CAN1_RX0_IRQn
+#define USBD_FSDEV_HP_IRQn          USBD1_HP_CAN1_TX_IRQn
+#else
+#define USBD_FSDEV_LP_IRQn          USBD2_LP_IRQn
+#define USBD_FSDEV_HP_IRQn          USBD2_HP_IRQn
+#endif /* USB_SELECT */
+#endif
+
+/*!< preemption priorities, the HP vector must preempt the LP one */
+#ifndef USBD_FSDEV_LP_PRIO
+#define USBD_FSDEV_LP_PRIO          1U
+#endif
+
+#ifndef USBD_FSDEV_HP_PRIO
+#define USBD_FSDEV_HP_PRIO          0U
+#endif
+
+#if USBD_FSDEV_HP_PRIO >= USBD_FSDEV_LP_PRIO
+#error "USBD_FSDEV_HP_PRIO must be a higher priority (lower value) than USBD_FSDEV_LP_PRIO"
+#endif
+
+/*!< PMA offset of the second buffer, the top of the 512 byte PMA is left
+ *   free by the CherryUSB allocator, which fills it from the bottom */
+#ifndef USBD_FSDEV_HP_PMA_ADDR
+#define USBD_FSDEV_HP_PMA_ADDR      (512U - 64U)
+#endif
+
+/*!< masking of the HP vector around the LP side of a stream and the way a
+ *   completion is handed to the LP vector, replaced by the host model bench */
+#ifndef USBD_FSDEV_HP_MASK
+#define USBD_FSDEV_HP_MASK()        NVIC_DisableIRQ(USBD_FSDEV_HP_IRQn)
+#define USBD_FSDEV_HP_UNMASK()      NVIC_EnableIRQ(USBD_FSDEV_HP_IRQn)
+#endif
+
+#ifndef USBD_FSDEV_HP_PEND_LP
+#define USBD_FSDEV_HP_PEND_LP()     NVIC_SetPendingIRQ(USBD_FSDEV_LP_IRQn)
+#endif
+
+/*!< a transfer is in the PMA, called from the LP vector with its length */
+typedef void (*usbd_fsdev_hp_cb_t)(uint32_t nbytes);
+
+struct usbd_fsdev_hp_stats {
+    uint32_t packets;           /*!< packets acknowledged by the host */
+    uint32_t transfers;         /*!< transfers completed */
+    uint32_t refills;           /*!< buffers refilled from the HP vector */
+    uint32_t underruns;         /*!< packets acknowledged with no next packet ready, the host got NAKs */
+};
+
+int usbd_fsdev_hp_in_open(USBD_T *usbx, uint8_t ep_addr, uint16_t mps, usbd_fsdev_hp_cb_t cb);
+void usbd_fsdev_hp_in_close(void);
+int usbd_fsdev_hp_in_write(const uint8_t *data, uint32_t len);
+bool usbd_fsdev_hp_in_busy(void);
+void usbd_fsdev_hp_irq_handler(void);
+void usbd_fsdev_hp_lp_handler(void);
+void usbd_fsdev_hp_get_stats(struct usbd_fsdev_hp_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USBD_FSDEV_HP_H */
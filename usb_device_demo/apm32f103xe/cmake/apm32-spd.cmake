@@ -1,19 +1,45 @@
+# APM32 SPD module selection, one option per standard peripheral driver.
+# The SPD has no module switches of its own, the drivers are included by
+# the files using them, so an option only decides what is compiled.
+# The defaults are the modules the demos use.
+set(APM32_SPD_DIR "driver/APM32F10x_StdPeriphDriver/src")
+
+macro(apm32_spd_module name default)
+    option(APM32_SPD_${name} "SPD ${name} module" ${default})
+    if(APM32_SPD_${name})
+        foreach(src ${ARGN})
+            list(APPEND APM32_SPD_CORE_SOURCES "${APM32_SPD_DIR}/apm32f10x_${src}.c")
+        endforeach()
+    endif()
+endmacro()
+
 # APM32 SPD core sources
-file(GLOB_RECURSE APM32_SPD_CORE_SOURCES
-    "application/*.*"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_dma.c"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_misc.c"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_rcm.c"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_gpio.c"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_pmu.c"
-    "driver/APM32F10x_StdPeriphDriver/src/apm32f10x_usb.c"
+set(APM32_SPD_CORE_SOURCES
+    "application/config/Source/apm32f1xx_device_cfg.c"
+    "application/config/Source/bsp_delay.c"
+    "application/source/apm32f10x_int.c"
+    "application/source/cdc_acm_hid.c"
+    "application/source/crc32_stream.c"
+    "application/source/cycle_prof.c"
+    "application/source/dfu_flash.c"
+    "application/source/dlog.c"
+    "application/source/hid_report_queue.c"
+    "application/source/main.c"
+    "application/source/sched.c"
+    "application/source/syscalls.c"
+    "application/source/sysmem.c"
+    "application/source/system_apm32f10x.c"
+    "application/source/uart_log.c"
+    "application/source/usb_cdc_bench.c"
+    "application/source/usb_dfu.c"
+    "application/source/usbd_fsdev_hp.c"
     "driver/Device/Geehy/APM32F10x/Source/gcc/startup_apm32f10x_hd.S"
 )
 
 # APM32 SPD core includes
 set(APM32_SPD_CORE_INCLUDES
     "application/include"
-    "application/config/include"
+    "application/config/Include"
     "driver/APM32F10x_StdPeriphDriver/inc"
     "driver/Device/Geehy/APM32F10x/Include"
     "driver/CMSIS/Include"
@@ -23,4 +49,34 @@ set(APM32_SPD_CORE_INCLUDES
 set(APM32_SPD_CORE_DEFINES
     "APM32F10X_HD"
     "USB_DEVICE"
-)
\ No newline at end of file
+)
+
+# APM32 SPD modules, name, default, sources without the apm32f10x_ prefix
+apm32_spd_module(ADC        OFF adc)
+apm32_spd_module(BAKPR      OFF bakpr)
+apm32_spd_module(CAN        OFF can)
+apm32_spd_module(CRC        ON  crc)
+apm32_spd_module(DAC        OFF dac)
+apm32_spd_module(DBGMCU     OFF dbgmcu)
+apm32_spd_module(DMA        ON  dma)
+apm32_spd_module(DMC        OFF dmc)
+apm32_spd_module(EINT       OFF eint)
+apm32_spd_module(FMC        ON  fmc)
+apm32_spd_module(GPIO       ON  gpio)
+apm32_spd_module(I2C        OFF i2c)
+apm32_spd_module(IWDT       OFF iwdt)
+apm32_spd_module(MISC       ON  misc)
+apm32_spd_module(PMU        ON  pmu)
+apm32_spd_module(QSPI       OFF qspi)
+apm32_spd_module(RCM        ON  rcm)
+apm32_spd_module(RTC        OFF rtc)
+apm32_spd_module(SCI2C      OFF sci2c)
+apm32_spd_module(SDIO       OFF sdio)
+apm32_spd_module(SMC        OFF smc)
+apm32_spd_module(SPI        OFF spi)
+apm32_spd_module(TMR        OFF tmr)
+apm32_spd_module(USART      ON  usart)
+apm32_spd_module(USB        ON  usb)
+apm32_spd_module(USB_DEVICE OFF usb_device)
+apm32_spd_module(USB_HOST   OFF usb_host)
+apm32_spd_module(WWDT       OFF wwdt)
@@ -692,6 +692,8 @@ void USBD_EP_SetTxRxStatus(USBD_T *usbx, uint8_t epNum, USBD_EP_STATUS_T txStatu
 uint16_t USBD_EP_ReadStatus(USBD_T *usbx, uint8_t epNum);
 uint32_t USBD_EP_ReadTxCnt(USBD_T *usbx, uint8_t epNum);
 uint32_t USBD_EP_ReadRxCnt(USBD_T *usbx, uint8_t epNum);
+uint32_t USBD_EP_ReadTxAddr(USBD_T *usbx, uint8_t epNum);
+uint32_t USBD_EP_ReadRxAddr(USBD_T *usbx, uint8_t epNum);
 void USBD_EP_SetTxAddr(USBD_T *usbx, uint8_t epNum, uint16_t addr);
 void USBD_EP_SetRxAddr(USBD_T *usbx, uint8_t epNum, uint16_t addr);
 void USBD_EP_SetTxCnt(USBD_T *usbx, uint8_t epNum, uint32_t cnt);
@@ -0,0 +1,98 @@
+/**
+  * @file    FreeRTOSConfig.h
+  * @author  LuckkMaker
+  * @brief   FreeRTOS kernel configuration, used when CONFIG_USB_OSAL is 1
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Every kernel object is allocated statically by usb_osal_freertos.c, the
+  * kernel heap is left out. The syscall priority is the one OTG_FS_IRQn
+  * and the other DMA and peripheral interrupts run at, group 4 priority 1,
+  * so the USB interrupt may give semaphores while the critical sections of
+  * the stack still mask it. Nothing at priority 0 may call the kernel.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+/* Includes ------------------------------------------------------------------*/
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+#include <stdint.h>
+extern uint32_t SystemCoreClock;
+void DAL_ErrorHandler(void);
+void usb_osal_thread_cleanup(void *tcb);
+#endif
+
+#define configUSE_PREEMPTION                        1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION     1
+#define configUSE_TICKLESS_IDLE                     0
+#define configCPU_CLOCK_HZ                          (SystemCoreClock)
+#define configTICK_RATE_HZ                          1000U
+#define configMAX_PRIORITIES                        16
+#define configMINIMAL_STACK_SIZE                    128U
+#define configMAX_TASK_NAME_LEN                     12
+#define configUSE_16_BIT_TICKS                      0
+#define configIDLE_SHOULD_YIELD                     1
+#define configUSE_MUTEXES                           1
+#define configUSE_RECURSIVE_MUTEXES                 0
+#define configUSE_COUNTING_SEMAPHORES               1
+#define configQUEUE_REGISTRY_SIZE                   0
+#define configUSE_IDLE_HOOK                         0
+#define configUSE_TICK_HOOK                         0
+#define configCHECK_FOR_STACK_OVERFLOW              2
+#define configUSE_MALLOC_FAILED_HOOK                0
+
+/* Memory allocation, static only */
+#define configSUPPORT_STATIC_ALLOCATION             1
+#define configSUPPORT_DYNAMIC_ALLOCATION            0
+
+/* Software timers, usb_osal_timer_create() */
+#define configUSE_TIMERS                            1
+#define configTIMER_TASK_PRIORITY                   (configMAX_PRIORITIES - 1)
+#define configTIMER_QUEUE_LENGTH                    8
+#define configTIMER_TASK_STACK_DEPTH                256U
+
+/* Optional functions */
+#define INCLUDE_vTaskDelete                         1
+#define INCLUDE_vTaskDelay                          1
+#define INCLUDE_eTaskGetState                       1
+#define INCLUDE_xTaskGetSchedulerState              1
+#define INCLUDE_xTaskGetCurrentTaskHandle           1
+#define INCLUDE_xTimerPendFunctionCall              1
+
+/* Cortex-M4 interrupt priorities, 4 bits on the APM32F4 */
+#define configPRIO_BITS                             4
+#define configLIBRARY_LOWEST_INTERRUPT_PRIORITY     15
+#define configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY 1
+
+#define configKERNEL_INTERRUPT_PRIORITY             (configLIBRARY_LOWEST_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+#define configMAX_SYSCALL_INTERRUPT_PRIORITY        (configLIBRARY_MAX_SYSCALL_INTERRUPT_PRIORITY << (8 - configPRIO_BITS))
+
+#define configASSERT(x)                             do { if ((x) == 0) { DAL_ErrorHandler(); } } while (0)
+
+/* Hands a deleted thread's TCB and stack back to the pool, once the kernel
+ * is done with them: at once for another thread, in the idle task for the
+ * thread that deleted itself */
+#define portCLEAN_UP_TCB(pxTCB)                     usb_osal_thread_cleanup(pxTCB)
+
+/* Kernel exception handlers, apm32f4xx_int.c leaves them out with the OSAL.
+ * SysTick stays there, it also runs the DAL tick */
+#define vPortSVCHandler                             SVC_Handler
+#define xPortPendSVHandler                          PendSV_Handler
+
+#endif /* FREERTOS_CONFIG_H */
@@ -42,14 +42,18 @@
 
 /* DAL module configuration */
 #define DAL_MODULE_ENABLED
+
+/* Module selection of builds without cmake/apm32-dal.cmake, the CMake build
+   passes the DAL_xxx_MODULE_ENABLED of its APM32_DAL_xxx options instead */
+#ifndef DAL_MODULE_SELECT_EXTERNAL
 //#define DAL_ADC_MODULE_ENABLED
 //#define DAL_CAN_MODULE_ENABLED
-//#define DAL_CRC_MODULE_ENABLED
-//#define DAL_CRYP_MODULE_ENABLED
+#define DAL_CRC_MODULE_ENABLED
+#define DAL_CRYP_MODULE_ENABLED
 //#define DAL_DAC_MODULE_ENABLED
 //#define DAL_DCI_MODULE_ENABLED
 #define DAL_DMA_MODULE_ENABLED
-//#define DAL_ETH_MODULE_ENABLED
+#define DAL_ETH_MODULE_ENABLED
 #define DAL_FLASH_MODULE_ENABLED
 //#define DAL_NAND_MODULE_ENABLED
 //#define DAL_NOR_MODULE_ENABLED
@@ -70,7 +74,7 @@
 //#define DAL_SD_MODULE_ENABLED
 //#define DAL_SPI_MODULE_ENABLED
 //#define DAL_TMR_MODULE_ENABLED
-//#define DAL_UART_MODULE_ENABLED
+#define DAL_UART_MODULE_ENABLED
 //#define DAL_USART_MODULE_ENABLED
 //#define DAL_IRDA_MODULE_ENABLED
 //#define DAL_SMARTCARD_MODULE_ENABLED
@@ -79,6 +83,7 @@
 //#define DAL_PCD_MODULE_ENABLED
 //#define DAL_HCD_MODULE_ENABLED
 //#define DAL_MMC_MODULE_ENABLED
+#endif /* DAL_MODULE_SELECT_EXTERNAL */
 
 /* Value of the external high speed oscillator in Hz */
 #if !defined  (HSE_VALUE) 
@@ -170,6 +175,10 @@
 #define ETH_BUFFER_NUMBER_RX           4U                  /* 4 Rx buffers of size ETH_BUFFER_SIZE_RX  */
 #define ETH_BUFFER_NUMBER_TX           4U                  /* 4 Tx buffers of size ETH_BUFFER_SIZE_TX  */
 
+/* DMA descriptor ring depth, one descriptor per buffer (TX must be a power of 2) */
+#define ETH_RX_DESC_CNT                ETH_BUFFER_NUMBER_RX
+#define ETH_TX_DESC_CNT                ETH_BUFFER_NUMBER_TX
+
 /* Delay and timeout */
 
 /* PHY Reset MAX Delay */
@@ -44,6 +44,7 @@
 /* Exported function prototypes *******************************************/
 void DAL_DeviceConfig(void);
 void DAL_SysClkConfig(void);
+void DAL_SysClkResume(void);
 
 #ifdef __cplusplus
 }
@@ -27,12 +27,29 @@
 #ifndef CHERRYUSB_CONFIG_H
 #define CHERRYUSB_CONFIG_H
 
+#include "demo_select.h"
+
 //-------- <<< Use Configuration Wizard in Context Menu >>> --------------------
 #define CHERRYUSB_VERSION                           0x010300
 #define CHERRYUSB_VERSION_STR                       "v1.3.0"
 
 // <h> USB Common Configuration
+//  <q> Deferred log, USB_LOG_* queued in dlog.c and printed by dlog_flush()
+#ifndef CONFIG_USB_DLOG
+#define CONFIG_USB_DLOG                             1
+#endif
+
+#if CONFIG_USB_DLOG
+#include "dlog.h"
+#define CONFIG_USB_PRINTF(...)                      DLOG(__VA_ARGS__)
+#else
 #define CONFIG_USB_PRINTF(...)                      printf(__VA_ARGS__)
+#endif
+
+//  <q> OSAL, MSC SCSI handling and host PSC work in threads, see usb_osal_freertos.c
+#ifndef CONFIG_USB_OSAL
+#define CONFIG_USB_OSAL                             0
+#endif
 
 #define usb_malloc(size)                            malloc(size)
 #define usb_free(ptr)                               free(ptr)
@@ -52,8 +69,11 @@
 // </h>
 
 // <h> USB Device Port Configuration
-//  <o> Max Bus Number <1=>1
+//  <o> Max Bus Number <1=>1 <2=>2
+//  <i> 2 runs a second DEMO_CDC_ACM_HID device on OTG_HS (embedded FS PHY) as bus 1
+#ifndef CONFIG_USBDEV_MAX_BUS
 #define CONFIG_USBDEV_MAX_BUS                       1
+#endif
 //  <o> Endpoint Number <1-15>
 #define CONFIG_USBDEV_EP_NUM                        4
 
@@ -83,6 +103,9 @@
 // </h>
 
 // <h> USB Host Port Configuration
+//  <i> Device and host are separate stacks with a bus context each, so one
+//  <i> device bus (OTG_FS) and one host bus (OTG_HS) run side by side,
+//  <i> see usb_host_bridge.c
 //  <o> Max Bus Number <1=>1
 #define CONFIG_USBHOST_MAX_BUS                      1
 //  <o> Pipe Number <1-15>
@@ -90,8 +113,14 @@
 // </h>
 
 // <h> USB Device Stack Configuration
-//  <o> EP0 IN and OUT transfer buffer size <512=>512
+//  <o> EP0 IN and OUT transfer buffer size <512=>512 <1024=>1024 <2048=>2048
+//  <i> Also the DFU wTransferSize, a larger block takes fewer GETSTATUS round trips,
+//  <i> the other demos keep 512
+#if (DEMO_SELECT == DEMO_DFU)
+#define CONFIG_USBDEV_REQUEST_BUFFER_LEN            2048
+#else
 #define CONFIG_USBDEV_REQUEST_BUFFER_LEN            512
+#endif
 //  <c> Setup Packet Log for Debug
 //#define CONFIG_USBDEV_SETUP_LOG_PRINT
 //  </c>
@@ -117,7 +146,10 @@
 //  <s> MSC Serial Number String
 #define CONFIG_USBDEV_MSC_VERSION_STRING            "0.0.1"
 //  <c> Enable MSC Thread
-//#define CONFIG_USBDEV_MSC_THREAD
+//  <i> Follows CONFIG_USB_OSAL, the bulk callbacks then only give a semaphore
+#if CONFIG_USB_OSAL
+#define CONFIG_USBDEV_MSC_THREAD
+#endif
 //  </c>
 //  <o> MSC Thread Priority <0-15>
 #define CONFIG_USBDEV_MSC_PRIO                      4
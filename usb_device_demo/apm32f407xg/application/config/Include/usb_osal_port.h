@@ -0,0 +1,92 @@
+/**
+  * @file    usb_osal_port.h
+  * @author  LuckkMaker
+  * @brief   Static object pools of the OSAL ports
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Both ports, usb_osal_freertos.c on the board and usb_osal_pthread.c in
+  * host_sim, take every object from the pools sized here instead of a heap.
+  * Thread stacks are carved from one pool at the stack_size the stack asks
+  * for, CONFIG_USBDEV_MSC_STACKSIZE or CONFIG_USBHOST_PSC_STACKSIZE, and
+  * a deleted thread's stack is reused by the next thread that fits in it.
+  * A create call that finds its pool exhausted returns NULL.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_OSAL_PORT_H
+#define USB_OSAL_PORT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef USB_OSAL_THREAD_MAX
+#define USB_OSAL_THREAD_MAX         4U
+#endif
+
+/*!< bytes shared by all thread stacks: MSC, host PSC and the demo thread */
+#ifndef USB_OSAL_STACK_POOL_SIZE
+#define USB_OSAL_STACK_POOL_SIZE    (CONFIG_USBDEV_MSC_STACKSIZE + CONFIG_USBHOST_PSC_STACKSIZE + 4096U)
+#endif
+
+/*!< the dwc2 HCD takes one per host channel when the host stack runs */
+#ifndef USB_OSAL_SEM_MAX
+#define USB_OSAL_SEM_MAX            (CONFIG_USBHOST_PIPE_NUM + 8U)
+#endif
+
+/*!< counting semaphores, a give past it fails instead of being merged */
+#ifndef USB_OSAL_SEM_COUNT_MAX
+#define USB_OSAL_SEM_COUNT_MAX      0xFFFFU
+#endif
+
+#ifndef USB_OSAL_MUTEX_MAX
+#define USB_OSAL_MUTEX_MAX          4U
+#endif
+
+#ifndef USB_OSAL_MQ_MAX
+#define USB_OSAL_MQ_MAX             4U
+#endif
+
+/*!< message slots shared by all queues */
+#ifndef USB_OSAL_MQ_POOL_SIZE
+#define USB_OSAL_MQ_POOL_SIZE       64U
+#endif
+
+#ifndef USB_OSAL_TIMER_MAX
+#define USB_OSAL_TIMER_MAX          4U
+#endif
+
+/*!< stack of the thread main() hands the demo to once an OS runs */
+#ifndef USB_OSAL_APP_STACKSIZE
+#define USB_OSAL_APP_STACKSIZE      2048U
+#endif
+
+#ifndef USB_OSAL_APP_PRIO
+#define USB_OSAL_APP_PRIO           8U
+#endif
+
+void usb_osal_tick_handler(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_OSAL_PORT_H */
@@ -29,6 +29,8 @@
 /* Private includes *******************************************************/
 
 /* Private macro **********************************************************/
+/* Busy-wait bound for the oscillators in DAL_SysClkResume(), about 8 ms on HSI */
+#define SYSCLK_RESUME_TIMEOUT       0x20000U
 
 /* Private typedef ********************************************************/
 
@@ -109,6 +111,54 @@ void DAL_SysClkConfig(void)
     }
 }
 
+/**
+ * @brief   Restore the system clock after STOP mode
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ * @note    STOP leaves the core on HSI with HSE and the PLL off. The PLL
+ *          factors, bus prescalers, flash latency and voltage scaling set by
+ *          DAL_SysClkConfig() are retained, so only the oscillators are
+ *          switched back on. The parameter checks, tick based timeouts and
+ *          SysTick reprogramming of DAL_RCM_OscConfig() and
+ *          DAL_RCM_ClockConfig() are skipped, which also makes this usable
+ *          with interrupts masked.
+ */
+void DAL_SysClkResume(void)
+{
+    uint32_t timeout;
+
+    if ((RCM->CFG & RCM_CFG_SCLKSWSTS) == RCM_CFG_SCLKSWSTS_PLL)
+    {
+        return;
+    }
+
+    SET_BIT(RCM->CTRL, RCM_CTRL_HSEEN);
+    for (timeout = SYSCLK_RESUME_TIMEOUT; (RCM->CTRL & RCM_CTRL_HSERDYFLG) == 0U; timeout--)
+    {
+        if (timeout == 0U)
+        {
+            DAL_ErrorHandler();
+        }
+    }
+
+    SET_BIT(RCM->CTRL, RCM_CTRL_PLL1EN);
+    for (timeout = SYSCLK_RESUME_TIMEOUT; (RCM->CTRL & RCM_CTRL_PLL1RDYFLG) == 0U; timeout--)
+    {
+        if (timeout == 0U)
+        {
+            DAL_ErrorHandler();
+        }
+    }
+
+    MODIFY_REG(RCM->CFG, RCM_CFG_SCLKSEL, RCM_CFG_SCLKSEL_PLL);
+    while ((RCM->CFG & RCM_CFG_SCLKSWSTS) != RCM_CFG_SCLKSWSTS_PLL)
+    {
+    }
+}
+
 /**
  * @brief     Error handler
  *
@@ -33,6 +33,7 @@
 
 /* Includes ***************************************************************/
 #include "apm32f4xx_dal.h"
+#include "demo_select.h"
 
 /* Exported macro *********************************************************/
 
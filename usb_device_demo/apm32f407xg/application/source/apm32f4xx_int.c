@@ -27,6 +27,13 @@
 #include "apm32f4xx_int.h"
 
 /* Private includes *******************************************************/
+#include "crc32_stream.h"
+#include "cycle_prof.h"
+#include "irq_lat.h"
+#include "secure_crypto.h"
+#include "uart_log.h"
+#include "usb_osal_port.h"
+#include "usb_pm.h"
 
 /* Private macro **********************************************************/
 
@@ -37,9 +44,22 @@
 /* Private function prototypes ********************************************/
 
 /* External variables *****************************************************/
+#if (DEMO_SELECT == DEMO_USB_ETH_BRIDGE)
+extern ETH_HandleTypeDef heth;
+#endif /* DEMO_SELECT */
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+extern DMA_HandleTypeDef hdma_crc;
+#endif /* CRC32_STREAM_BACKEND */
+#if (DEMO_SELECT == DEMO_SECURE_UPLOAD) && (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+extern DMA_HandleTypeDef hdma_cryp_in;
+extern DMA_HandleTypeDef hdma_cryp_out;
+#endif /* SECURE_CRYPTO_BACKEND */
 
 /* External functions *****************************************************/
 extern void USBD_IRQHandler(uint8_t busid);
+#if (DEMO_SELECT == DEMO_USB_HOST_BRIDGE)
+extern void USBH_IRQHandler(uint8_t busid);
+#endif /* DEMO_SELECT */
 
 /**
  * @brief     This function handles NMI exception
@@ -117,6 +137,7 @@ void UsageFault_Handler(void)
     }
 }
 
+#if !CONFIG_USB_OSAL
 /**
  * @brief     This function handles SVCall exception
  *
@@ -128,6 +149,7 @@ void UsageFault_Handler(void)
 void SVC_Handler(void)
 {
 }
+#endif /* CONFIG_USB_OSAL */
 
 /**
  * @brief     This function handles Debug Monitor exception
@@ -141,6 +163,7 @@ void DebugMon_Handler(void)
 {
 }
 
+#if !CONFIG_USB_OSAL
 /**
  * @brief     This function handles PendSV_Handler exception
  *
@@ -152,6 +175,7 @@ void DebugMon_Handler(void)
 void PendSV_Handler(void)
 {
 }
+#endif /* CONFIG_USB_OSAL */
 
 /**
  * @brief     This function handles SysTick request
@@ -164,6 +188,10 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
     DAL_IncTick();
+    CYCLE_PROF_SYSTICK_HOOK();
+#if CONFIG_USB_OSAL
+    usb_osal_tick_handler();
+#endif /* CONFIG_USB_OSAL */
 }
 
 /**
@@ -176,5 +204,161 @@ void SysTick_Handler(void)
  */
 void OTG_FS_IRQHandler(void)
 {
+    IRQ_LAT_USB_ENTRY();
+    USB_PM_USB_IRQ_ENTRY();
+    CYCLE_PROF_BEGIN(USB_IRQ);
     USBD_IRQHandler(0);
+    CYCLE_PROF_END(USB_IRQ);
+    IRQ_LAT_USB_EXIT();
 }
+
+#if (DEMO_SELECT == DEMO_USB_HOST_BRIDGE) || (CONFIG_USBDEV_MAX_BUS > 1)
+/**
+ * @brief   This function handles USB HS Handler, the host of usb_host_bridge
+ *          or device bus 1
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void OTG_HS1_IRQHandler(void)
+{
+#if (DEMO_SELECT == DEMO_USB_HOST_BRIDGE)
+    USBH_IRQHandler(0);
+#else
+    USBD_IRQHandler(1);
+#endif /* DEMO_SELECT */
+}
+#endif /* DEMO_SELECT */
+
+/**
+ * @brief   This function handles USB FS Wakeup Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void OTG_FS_WKUP_IRQHandler(void)
+{
+#if USB_PM_ENABLE
+    usb_pm_wakeup_irq_handler();
+#endif /* USB_PM_ENABLE */
+}
+
+#if USB_PM_ENABLE && USB_PM_KEY_ENABLE
+/**
+ * @brief   This function handles EINT0 Handler, the usb_pm wakeup key
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void EINT0_IRQHandler(void)
+{
+    usb_pm_key_irq_handler();
+}
+#endif /* USB_PM_ENABLE && USB_PM_KEY_ENABLE */
+
+#if IRQ_LAT_ENABLE
+/**
+ * @brief   This function handles TMR2 Handler, the irq_lat test interrupt
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void TMR2_IRQHandler(void)
+{
+    irq_lat_test_irq_handler();
+}
+#endif /* IRQ_LAT_ENABLE */
+
+#if (DEMO_SELECT == DEMO_USB_ETH_BRIDGE)
+/**
+ * @brief   This function handles ETH Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void ETH_IRQHandler(void)
+{
+    DAL_ETH_IRQHandler(&heth);
+}
+#endif /* DEMO_SELECT */
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+/**
+ * @brief   This function handles DMA2 Stream0 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA2_Stream0_IRQHandler(void)
+{
+    DAL_DMA_IRQHandler(&hdma_crc);
+}
+#endif /* CRC32_STREAM_BACKEND */
+
+#if (DEMO_SELECT == DEMO_SECURE_UPLOAD) && (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+/**
+ * @brief   This function handles DMA2 Stream5 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA2_Stream5_IRQHandler(void)
+{
+    DAL_DMA_IRQHandler(&hdma_cryp_out);
+}
+
+/**
+ * @brief   This function handles DMA2 Stream6 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA2_Stream6_IRQHandler(void)
+{
+    DAL_DMA_IRQHandler(&hdma_cryp_in);
+}
+#endif /* SECURE_CRYPTO_BACKEND */
+
+#if UART_LOG_ENABLE
+/**
+ * @brief   This function handles DMA2 Stream7 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void DMA2_Stream7_IRQHandler(void)
+{
+    DAL_DMA_IRQHandler(&hdma_uart_log_tx);
+}
+
+/**
+ * @brief   This function handles USART1 Handler
+ *
+ * @param   None
+ *
+ * @retval  None
+ *
+ */
+void USART1_IRQHandler(void)
+{
+    DAL_UART_IRQHandler(&huart_log);
+}
+#endif /* UART_LOG_ENABLE */
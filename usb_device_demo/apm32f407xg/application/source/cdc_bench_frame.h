@@ -0,0 +1,139 @@
+/**
+  * @file    cdc_bench_frame.h
+  * @author  LuckkMaker
+  * @brief   Command, result and test pattern of the CDC throughput benchmark
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef CDC_BENCH_FRAME_H
+#define CDC_BENCH_FRAME_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< One run, everything on the CDC data pipes so a plain tty will do:
+ *
+ *     host   -> device  command, 16 bytes, see CDC_BENCH_CMD_OFS_*
+ *     IN:       device streams length pattern bytes
+ *     OUT:      host streams length pattern bytes, the device checks them
+ *     LOOP:     the device checks every OUT transfer and echoes it on IN
+ *     device -> host    result, 20 bytes, see CDC_BENCH_RES_OFS_*
+ *
+ *   The pattern is the little-endian byte stream of xorshift32 words started
+ *   from the seed of the command. Shared with tools/cdc_bench.c, no target
+ *   headers here. */
+
+#define CDC_BENCH_CMD_MAGIC         0x4E454243U /*!< "CBEN" */
+#define CDC_BENCH_RES_MAGIC         0x53524243U /*!< "CBRS" */
+
+#define CDC_BENCH_MODE_IN           1U  /*!< device to host */
+#define CDC_BENCH_MODE_OUT          2U  /*!< host to device */
+#define CDC_BENCH_MODE_LOOP         3U  /*!< host to device and back */
+
+#define CDC_BENCH_CMD_SIZE          16U
+#define CDC_BENCH_CMD_OFS_MAGIC     0U  /*!< u32 */
+#define CDC_BENCH_CMD_OFS_MODE      4U  /*!< u8 */
+#define CDC_BENCH_CMD_OFS_RESERVED  5U  /*!< u8, 0 */
+#define CDC_BENCH_CMD_OFS_XFER      6U  /*!< u16, bytes per device transfer, 0 for the largest */
+#define CDC_BENCH_CMD_OFS_LENGTH    8U  /*!< u32, pattern bytes */
+#define CDC_BENCH_CMD_OFS_SEED      12U /*!< u32, not 0 */
+
+#define CDC_BENCH_RES_SIZE          20U
+#define CDC_BENCH_RES_OFS_MAGIC     0U  /*!< u32 */
+#define CDC_BENCH_RES_OFS_MODE      4U  /*!< u32 */
+#define CDC_BENCH_RES_OFS_BYTES     8U  /*!< u32, pattern bytes sent or checked */
+#define CDC_BENCH_RES_OFS_ERRORS    12U /*!< u32, bytes that did not match */
+#define CDC_BENCH_RES_OFS_FIRST     16U /*!< u32, offset of the first mismatch, 0xFFFFFFFF if none */
+
+#define CDC_BENCH_NO_ERROR          0xFFFFFFFFU
+
+struct cdc_bench_pattern {
+    uint32_t state;
+    uint32_t word;
+    uint32_t pos;               /*!< bytes of word already used */
+};
+
+static inline uint32_t cdc_bench_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void cdc_bench_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline void cdc_bench_pattern_init(struct cdc_bench_pattern *pat, uint32_t seed) {
+    pat->state = seed ? seed : 1U;
+    pat->word = 0;
+    pat->pos = 4;
+}
+
+static inline uint8_t cdc_bench_pattern_next(struct cdc_bench_pattern *pat) {
+    uint32_t x;
+
+    if (pat->pos == 4U) {
+        x = pat->state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pat->state = x;
+        pat->word = x;
+        pat->pos = 0;
+    }
+
+    return (uint8_t)(pat->word >> (8U * pat->pos++));
+}
+
+static inline void cdc_bench_pattern_fill(struct cdc_bench_pattern *pat, uint8_t *buf, uint32_t len) {
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = cdc_bench_pattern_next(pat);
+    }
+}
+
+/*!< number of bytes that differ, *first gets the index of the first one */
+static inline uint32_t cdc_bench_pattern_check(struct cdc_bench_pattern *pat, const uint8_t *buf, uint32_t len,
+                                               uint32_t *first) {
+    uint32_t errors = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        if (buf[i] != cdc_bench_pattern_next(pat)) {
+            if (errors == 0) {
+                *first = i;
+            }
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CDC_BENCH_FRAME_H */
@@ -0,0 +1,297 @@
+/**
+  * @file    crc32_stream.c
+  * @author  LuckkMaker
+  * @brief   Streaming CRC-32 on the CRC unit, fed by DMA
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Buffers handed to crc32_stream_feed() are queued and pushed into CRC->DATA by
+  * a DMA2 memory-to-memory stream, the next one is started from the transfer
+  * complete interrupt. The caller keeps the buffer untouched until its callback
+  * ran or crc32_stream_busy() returns false.
+  *
+  * The DMA interrupt uses the USB interrupt priority, so callbacks may touch USB
+  * class state directly.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "crc32_stream.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct crc32_stream_req {
+    const uint32_t *buf;
+    uint32_t words;
+    bool reset;
+    crc32_stream_cb_t cb;
+    void *arg;
+};
+
+/* Private define ------------------------------------------------------------*/
+/*!< NDATA is 16 bits wide */
+#define CRC32_STREAM_DMA_MAX    0xFFFFU
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/*!< CRC of one nibble shifted out of the top of the register */
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000U, 0x04C11DB7U, 0x09823B6EU, 0x0D4326D9U,
+    0x130476DCU, 0x17C56B6BU, 0x1A864DB2U, 0x1E475005U,
+    0x2608EDB8U, 0x22C9F00FU, 0x2F8AD6D6U, 0x2B4BCB61U,
+    0x350C9B64U, 0x31CD86D3U, 0x3C8EA00AU, 0x384FBDBDU
+};
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+static uint32_t crc_sw_value = CRC32_STREAM_INIT_VALUE;
+#else
+static CRC_HandleTypeDef hcrc;
+#endif
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+DMA_HandleTypeDef hdma_crc;
+
+static struct crc32_stream_req crc_queue[CRC32_STREAM_QUEUE_DEPTH];
+static uint32_t crc_head;
+static uint32_t crc_tail;
+static volatile uint32_t crc_cnt;
+static volatile bool crc_running;
+static uint32_t crc_chunk;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+#if (CRC32_STREAM_BACKEND != CRC32_STREAM_BACKEND_SW)
+void DAL_CRC_MspInit(CRC_HandleTypeDef *hcrc) {
+    (void)hcrc;
+
+    __DAL_RCM_CRC_CLK_ENABLE();
+}
+#endif
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+static void crc32_stream_start(void) {
+    struct crc32_stream_req *req;
+
+    if (crc_running || (crc_cnt == 0)) {
+        return;
+    }
+
+    req = &crc_queue[crc_tail];
+    if (req->reset) {
+        __DAL_CRC_DATA_RESET(&hcrc);
+        req->reset = false;
+    }
+
+    crc_chunk = (req->words > CRC32_STREAM_DMA_MAX) ? CRC32_STREAM_DMA_MAX : req->words;
+    crc_running = true;
+    DAL_DMA_Start_IT(&hdma_crc, (uint32_t)req->buf, (uint32_t)&hcrc.Instance->DATA, crc_chunk);
+}
+
+static void crc32_stream_dma_cplt(DMA_HandleTypeDef *hdma) {
+    struct crc32_stream_req *req = &crc_queue[crc_tail];
+
+    (void)hdma;
+
+    crc_running = false;
+    req->buf += crc_chunk;
+    req->words -= crc_chunk;
+
+    if (req->words == 0) {
+        if (req->cb != NULL) {
+            req->cb(hcrc.Instance->DATA, req->arg);
+        }
+        crc_tail = (crc_tail + 1) % CRC32_STREAM_QUEUE_DEPTH;
+        crc_cnt--;
+    }
+
+    crc32_stream_start();
+}
+
+static void crc32_stream_dma_error(DMA_HandleTypeDef *hdma) {
+    /* finish the request, the wrong CRC is caught by whoever checks it */
+    crc_chunk = crc_queue[crc_tail].words;
+    crc32_stream_dma_cplt(hdma);
+}
+#endif
+
+void crc32_stream_init(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+    crc_sw_value = CRC32_STREAM_INIT_VALUE;
+#else
+    hcrc.Instance = CRC;
+    DAL_CRC_Init(&hcrc);
+    __DAL_CRC_DATA_RESET(&hcrc);
+#endif
+
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    __DAL_RCM_DMA2_CLK_ENABLE();
+
+    hdma_crc.Instance                   = CRC32_STREAM_DMA_STREAM;
+    hdma_crc.Init.Channel               = DMA_CHANNEL_0;
+    hdma_crc.Init.Direction             = DMA_MEMORY_TO_MEMORY;
+    hdma_crc.Init.PeriphInc             = DMA_PINC_ENABLE;
+    hdma_crc.Init.MemInc                = DMA_MINC_DISABLE;
+    hdma_crc.Init.PeriphDataAlignment   = DMA_PDATAALIGN_WORD;
+    hdma_crc.Init.MemDataAlignment      = DMA_MDATAALIGN_WORD;
+    hdma_crc.Init.Mode                  = DMA_NORMAL;
+    hdma_crc.Init.Priority              = DMA_PRIORITY_LOW;
+    hdma_crc.Init.FIFOMode              = DMA_FIFOMODE_ENABLE;
+    hdma_crc.Init.FIFOThreshold         = DMA_FIFO_THRESHOLD_FULL;
+    hdma_crc.Init.MemBurst              = DMA_MBURST_SINGLE;
+    hdma_crc.Init.PeriphBurst           = DMA_PBURST_SINGLE;
+    DAL_DMA_Init(&hdma_crc);
+
+    hdma_crc.XferCpltCallback   = crc32_stream_dma_cplt;
+    hdma_crc.XferErrorCallback  = crc32_stream_dma_error;
+
+    crc_head = 0;
+    crc_tail = 0;
+    crc_cnt = 0;
+    crc_running = false;
+
+    /* same priority as OTG_FS, see file header */
+    DAL_NVIC_SetPriority(CRC32_STREAM_DMA_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(CRC32_STREAM_DMA_IRQn);
+#endif
+}
+
+/**
+ * @brief   Queue a buffer for the running CRC
+ *
+ * @param   buf   word aligned buffer, left untouched until consumed
+ *
+ * @param   words number of 32-bit words
+ *
+ * @param   reset restart from CRC32_STREAM_INIT_VALUE before this buffer
+ *
+ * @param   cb    called with the running CRC once the buffer is consumed, may be NULL
+ *
+ * @param   arg   passed to cb
+ *
+ * @retval  0 on success, -1 if the queue is full
+ */
+int crc32_stream_feed(const uint32_t *buf, uint32_t words, bool reset, crc32_stream_cb_t cb, void *arg) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    uint32_t primask;
+
+    if (words == 0) {
+        return -1;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if (crc_cnt == CRC32_STREAM_QUEUE_DEPTH) {
+        __set_PRIMASK(primask);
+        return -1;
+    }
+
+    crc_queue[crc_head].buf = buf;
+    crc_queue[crc_head].words = words;
+    crc_queue[crc_head].reset = reset;
+    crc_queue[crc_head].cb = cb;
+    crc_queue[crc_head].arg = arg;
+    crc_head = (crc_head + 1) % CRC32_STREAM_QUEUE_DEPTH;
+    crc_cnt++;
+
+    crc32_stream_start();
+
+    __set_PRIMASK(primask);
+#elif (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_CPU)
+    uint32_t crc;
+
+    if (reset) {
+        __DAL_CRC_DATA_RESET(&hcrc);
+    }
+
+    crc = DAL_CRC_Accumulate(&hcrc, (uint32_t *)buf, words);
+    if (cb != NULL) {
+        cb(crc, arg);
+    }
+#else
+    if (reset) {
+        crc_sw_value = CRC32_STREAM_INIT_VALUE;
+    }
+
+    crc_sw_value = crc32_sw_update(crc_sw_value, buf, words);
+    if (cb != NULL) {
+        cb(crc_sw_value, arg);
+    }
+#endif
+
+    return 0;
+}
+
+bool crc32_stream_busy(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_DMA)
+    return (crc_cnt != 0);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief   Running CRC, valid once crc32_stream_busy() returns false
+ *
+ * @param   None
+ *
+ * @retval  CRC value
+ */
+uint32_t crc32_stream_value(void) {
+#if (CRC32_STREAM_BACKEND == CRC32_STREAM_BACKEND_SW)
+    return crc_sw_value;
+#else
+    return hcrc.Instance->DATA;
+#endif
+}
+
+uint32_t crc32_stream_calc(const uint32_t *buf, uint32_t words) {
+    if (crc32_stream_feed(buf, words, true, NULL, NULL) != 0) {
+        return crc32_sw_update(CRC32_STREAM_INIT_VALUE, buf, words);
+    }
+
+    while (crc32_stream_busy()) {
+    }
+
+    return crc32_stream_value();
+}
+
+/**
+ * @brief   Software CRC, same result as the CRC unit
+ *
+ * @param   crc   running value, CRC32_STREAM_INIT_VALUE to start
+ *
+ * @param   buf   word aligned buffer
+ *
+ * @param   words number of 32-bit words
+ *
+ * @retval  updated CRC value
+ */
+uint32_t crc32_sw_update(uint32_t crc, const uint32_t *buf, uint32_t words) {
+    uint32_t i;
+
+    while (words--) {
+        crc ^= *buf++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc << 4) ^ crc32_nibble_table[crc >> 28];
+        }
+    }
+
+    return crc;
+}
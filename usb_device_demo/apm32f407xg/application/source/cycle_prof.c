@@ -0,0 +1,259 @@
+/**
+  * @file    cycle_prof.c
+  * @author  LuckkMaker
+  * @brief   Cycle counter probes with min/max/mean and log2 histograms
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * A probe is a CYCLE_PROF_BEGIN(id) / CYCLE_PROF_END(id) pair in one scope.
+  * Probes nest, an outer probe includes the time of the inner ones and of
+  * any interrupt taken meanwhile. Each id should be used from one context.
+  *
+  * Build with -DCYCLE_PROF_ENABLE=1, then read the dump with
+  * tools/cycle_prof.py, which sends CYCLE_PROF_REQ_DUMP on EP0.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "cycle_prof.h"
+
+#if CYCLE_PROF_ENABLE
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct cycle_prof_header {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t probes;
+    uint8_t hist_bins;
+    uint32_t timer_hz;          /*!< counts per second */
+    uint32_t bias;              /*!< cost of an empty probe pair, already subtracted */
+} __PACKED;
+
+struct cycle_prof_record {
+    char name[CYCLE_PROF_NAME_LEN];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[CYCLE_PROF_HIST_BINS];
+} __PACKED;
+
+struct cycle_prof_stat {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[CYCLE_PROF_HIST_BINS];
+};
+
+/* Private define ------------------------------------------------------------*/
+#define CYCLE_PROF_DUMP_SIZE        (sizeof(struct cycle_prof_header) + \
+                                     CYCLE_PROF_PROBE_NUM * sizeof(struct cycle_prof_record))
+
+/* Private macro -------------------------------------------------------------*/
+#define CYCLE_PROF_LOCK(m)          do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define CYCLE_PROF_UNLOCK(m)        __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const cycle_prof_names[CYCLE_PROF_PROBE_NUM] = {
+    [CYCLE_PROF_USB_IRQ] = "usb_irq",
+    [CYCLE_PROF_CDC_OUT] = "cdc_out_cb",
+    [CYCLE_PROF_CDC_IN] = "cdc_in_cb",
+    [CYCLE_PROF_HID_OUT] = "hid_out_cb",
+    [CYCLE_PROF_HID_IN] = "hid_in_cb",
+    [CYCLE_PROF_SOF_LAT] = "sof_lat",
+    [CYCLE_PROF_TEST_LAT] = "test_irq_lat",
+    [CYCLE_PROF_TEST_PREEMPT] = "test_preempt",
+    [CYCLE_PROF_STOP_EXIT] = "stop_exit",
+    [CYCLE_PROF_RESUME_XFER] = "resume_xfer",
+    [CYCLE_PROF_RESUME_XFER_SLP] = "resume_xfer_slp",
+    [CYCLE_PROF_USER0] = "user0",
+    [CYCLE_PROF_USER1] = "user1",
+};
+
+static struct cycle_prof_stat cycle_prof_stats[CYCLE_PROF_PROBE_NUM];
+static uint32_t cycle_prof_bias;
+
+/*!< EP0 sends from here, the snapshot has to outlive the request handler */
+static uint8_t cycle_prof_dump_buf[CYCLE_PROF_DUMP_SIZE] __ALIGNED(4);
+
+#if (CYCLE_PROF_TIMER == CYCLE_PROF_TIMER_SYSTICK)
+volatile uint32_t cycle_prof_systick_base;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/**
+ * @brief   Start the counter and measure the cost of an empty probe
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void cycle_prof_init(void) {
+    uint32_t t0;
+    uint32_t best = UINT32_MAX;
+    uint32_t i;
+
+#if (CYCLE_PROF_TIMER == CYCLE_PROF_TIMER_DWT)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    if (DWT->CTRL & DWT_CTRL_NOCYCCNT_Msk) {
+        USB_LOG_ERR("cycle_prof: no cycle counter, build with CYCLE_PROF_TIMER_SYSTICK\r\n");
+    }
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    for (i = 0; i < 8U; i++) {
+        t0 = cycle_prof_now();
+        t0 = cycle_prof_now() - t0;
+        if (t0 < best) {
+            best = t0;
+        }
+    }
+    cycle_prof_bias = best;
+
+    cycle_prof_clear();
+}
+
+/**
+ * @brief   Account one sample, what CYCLE_PROF_END() calls
+ *
+ * @param   id     probe
+ *
+ * @param   cycles raw duration, the probe cost is taken off here
+ *
+ * @retval  None
+ */
+void cycle_prof_record(enum cycle_prof_id id, uint32_t cycles) {
+    struct cycle_prof_stat *st = &cycle_prof_stats[id];
+    uint32_t primask;
+    uint32_t bin;
+
+    cycles = (cycles > cycle_prof_bias) ? (cycles - cycle_prof_bias) : 0U;
+    bin = cycles ? (31U - __CLZ(cycles)) : 0U;
+
+    CYCLE_PROF_LOCK(primask);
+    st->count++;
+    st->sum += cycles;
+    if (cycles < st->min) {
+        st->min = cycles;
+    }
+    if (cycles > st->max) {
+        st->max = cycles;
+    }
+    st->hist[bin]++;
+    CYCLE_PROF_UNLOCK(primask);
+}
+
+void cycle_prof_clear(void) {
+    uint32_t primask;
+    uint32_t i;
+
+    CYCLE_PROF_LOCK(primask);
+    memset(cycle_prof_stats, 0, sizeof(cycle_prof_stats));
+    for (i = 0; i < CYCLE_PROF_PROBE_NUM; i++) {
+        cycle_prof_stats[i].min = UINT32_MAX;
+    }
+    CYCLE_PROF_UNLOCK(primask);
+}
+
+/**
+ * @brief   Snapshot of all probes in the dump format
+ *
+ * @param   buf    destination
+ *
+ * @param   size   room in buf
+ *
+ * @retval  dump length, 0 if buf is too small
+ */
+uint32_t cycle_prof_dump(uint8_t *buf, uint32_t size) {
+    struct cycle_prof_header hdr;
+    struct cycle_prof_record rec;
+    uint32_t primask;
+    uint32_t i;
+
+    if (size < CYCLE_PROF_DUMP_SIZE) {
+        return 0;
+    }
+
+    hdr.magic = CYCLE_PROF_MAGIC;
+    hdr.version = CYCLE_PROF_VERSION;
+    hdr.probes = CYCLE_PROF_PROBE_NUM;
+    hdr.hist_bins = CYCLE_PROF_HIST_BINS;
+    hdr.timer_hz = SystemCoreClock;
+    hdr.bias = cycle_prof_bias;
+    memcpy(buf, &hdr, sizeof(hdr));
+    buf += sizeof(hdr);
+
+    for (i = 0; i < CYCLE_PROF_PROBE_NUM; i++) {
+        memset(rec.name, 0, sizeof(rec.name));
+        strncpy(rec.name, cycle_prof_names[i], sizeof(rec.name) - 1U);
+
+        /* one probe at a time, the interrupts stay masked only for a copy */
+        CYCLE_PROF_LOCK(primask);
+        rec.count = cycle_prof_stats[i].count;
+        rec.min = rec.count ? cycle_prof_stats[i].min : 0U;
+        rec.max = cycle_prof_stats[i].max;
+        rec.sum = cycle_prof_stats[i].sum;
+        memcpy(rec.hist, cycle_prof_stats[i].hist, sizeof(rec.hist));
+        CYCLE_PROF_UNLOCK(primask);
+
+        memcpy(buf, &rec, sizeof(rec));
+        buf += sizeof(rec);
+    }
+
+    return CYCLE_PROF_DUMP_SIZE;
+}
+
+/**
+ * @brief   Vendor request handler, hooked on an interface of the demo
+ *
+ * @param   busid  USB bus
+ *
+ * @param   setup  setup packet
+ *
+ * @param   data   data stage buffer, redirected to the snapshot for a dump
+ *
+ * @param   len    data stage length
+ *
+ * @retval  0 if handled, -1 to let other handlers or a STALL answer it
+ */
+int cycle_prof_vendor_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len) {
+    ARG_UNUSED(busid);
+
+    switch (setup->bRequest) {
+        case CYCLE_PROF_REQ_DUMP:
+            if (!(setup->bmRequestType & USB_REQUEST_DIR_IN)) {
+                return -1;
+            }
+            *len = cycle_prof_dump(cycle_prof_dump_buf, sizeof(cycle_prof_dump_buf));
+            *data = cycle_prof_dump_buf;
+            return 0;
+
+        case CYCLE_PROF_REQ_CLEAR:
+            cycle_prof_clear();
+            *len = 0;
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+#endif /* CYCLE_PROF_ENABLE */
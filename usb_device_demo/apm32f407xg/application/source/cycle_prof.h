@@ -0,0 +1,130 @@
+/**
+  * @file    cycle_prof.h
+  * @author  LuckkMaker
+  * @brief   Header for cycle_prof.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef CYCLE_PROF_H
+#define CYCLE_PROF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< probes compile to nothing unless enabled */
+#ifndef CYCLE_PROF_ENABLE
+#define CYCLE_PROF_ENABLE           0
+#endif
+
+#define CYCLE_PROF_TIMER_DWT        0   /*!< DWT->CYCCNT, core clock */
+#define CYCLE_PROF_TIMER_SYSTICK    1   /*!< SysTick extended by its interrupt, for cores without CYCCNT; exact
+                                     *   while SysTick is held off for less than one period */
+
+#ifndef CYCLE_PROF_TIMER
+#define CYCLE_PROF_TIMER            CYCLE_PROF_TIMER_DWT
+#endif
+
+/*!< vendor requests on EP0, device recipient */
+#define CYCLE_PROF_REQ_DUMP         0x50    /*!< IN, snapshot of all probes */
+#define CYCLE_PROF_REQ_CLEAR        0x51    /*!< no data stage, restarts every probe */
+
+/*!< dump: header, then one record per probe, little endian, see tools/cycle_prof.py */
+#define CYCLE_PROF_MAGIC            0x46525043U     /*!< "CPRF" */
+#define CYCLE_PROF_VERSION          1U
+#define CYCLE_PROF_NAME_LEN         16U
+#define CYCLE_PROF_HIST_BINS        32U             /*!< bin n counts samples in [2^n, 2^(n+1)), 0 in bin 0 */
+
+/*!< probe points, names in cycle_prof.c */
+enum cycle_prof_id {
+    CYCLE_PROF_USB_IRQ = 0,     /*!< USBD_IRQHandler, everything below runs inside it */
+    CYCLE_PROF_CDC_OUT,         /*!< CDC bulk OUT callback */
+    CYCLE_PROF_CDC_IN,          /*!< CDC bulk IN callback */
+    CYCLE_PROF_HID_OUT,         /*!< HID interrupt OUT callback */
+    CYCLE_PROF_HID_IN,          /*!< HID interrupt IN callback */
+    CYCLE_PROF_SOF_LAT,         /*!< SOF to USB interrupt entry, irq_lat.c */
+    CYCLE_PROF_TEST_LAT,        /*!< test interrupt due to entry, irq_lat.c */
+    CYCLE_PROF_TEST_PREEMPT,    /*!< test interrupt held off its work, irq_lat.c */
+    CYCLE_PROF_STOP_EXIT,       /*!< STOP exit to the PLL running, in HSI cycles, usb_pm.c */
+    CYCLE_PROF_RESUME_XFER,     /*!< USB wakeup interrupt to the first transfer interrupt, usb_pm.c */
+    CYCLE_PROF_RESUME_XFER_SLP, /*!< the same, resumed from the light sleep before STOP */
+    CYCLE_PROF_USER0,           /*!< free, e.g. around the FIFO copy of the port */
+    CYCLE_PROF_USER1,
+    CYCLE_PROF_PROBE_NUM
+};
+
+#if CYCLE_PROF_ENABLE
+
+#if (CYCLE_PROF_TIMER == CYCLE_PROF_TIMER_SYSTICK)
+extern volatile uint32_t cycle_prof_systick_base;
+
+static inline uint32_t cycle_prof_now(void) {
+    uint32_t base;
+    uint32_t val;
+    uint32_t wrap;
+
+    do {
+        base = cycle_prof_systick_base;
+        val = SysTick->VAL;
+        wrap = 0;
+        /* wrapped but the interrupt is held off, e.g. inside the USB ISR */
+        if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+            val = SysTick->VAL;
+            wrap = SysTick->LOAD + 1U;
+        }
+    } while (base != cycle_prof_systick_base);
+
+    return base + wrap + (SysTick->LOAD - val);
+}
+
+#define CYCLE_PROF_SYSTICK_HOOK()   (cycle_prof_systick_base += SysTick->LOAD + 1U)
+#else
+static inline uint32_t cycle_prof_now(void) {
+    return DWT->CYCCNT;
+}
+
+#define CYCLE_PROF_SYSTICK_HOOK()
+#endif /* CYCLE_PROF_TIMER */
+
+#define CYCLE_PROF_BEGIN(id)        const uint32_t cycle_prof_t_##id = cycle_prof_now()
+#define CYCLE_PROF_END(id)          cycle_prof_record(CYCLE_PROF_##id, cycle_prof_now() - cycle_prof_t_##id)
+
+void cycle_prof_init(void);
+void cycle_prof_record(enum cycle_prof_id id, uint32_t cycles);
+void cycle_prof_clear(void);
+uint32_t cycle_prof_dump(uint8_t *buf, uint32_t size);
+int cycle_prof_vendor_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len);
+
+#else
+
+#define CYCLE_PROF_SYSTICK_HOOK()
+#define CYCLE_PROF_BEGIN(id)
+#define CYCLE_PROF_END(id)
+
+#endif /* CYCLE_PROF_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* CYCLE_PROF_H */
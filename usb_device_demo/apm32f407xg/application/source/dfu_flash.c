@@ -0,0 +1,184 @@
+/**
+  * @file    dfu_flash.c
+  * @author  LuckkMaker
+  * @brief   Flash backend of the DFU demo, erase and program run from RAM
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * dfu_flash_erase() and dfu_flash_program() are placed in .RamFunc and touch the
+  * FLASH registers directly, so the busy wait loop never fetches from the array
+  * being written. Interrupt handlers still live in flash, the core stalls on them
+  * until the current word (or the whole sector erase) is done.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dfu_flash.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define DFU_FLASH_STS_ERRORS    (FLASH_STS_OPRERR | FLASH_STS_WPROTERR | FLASH_STS_PGALGERR | \
+                                 FLASH_STS_PGPRLERR | FLASH_STS_PGSEQERR)
+
+#if DFU_FLASH_DOUBLE_WORD
+#define DFU_FLASH_PSIZE         FLASH_PSIZE_DOUBLE_WORD
+#else
+#define DFU_FLASH_PSIZE         FLASH_PSIZE_WORD
+#endif
+
+/*!< typical figures from the datasheet, x32 parallelism */
+#define DFU_FLASH_WORD_PROG_US  16U
+#define DFU_FLASH_ERASE_16K_MS  400U
+#define DFU_FLASH_ERASE_64K_MS  1100U
+#define DFU_FLASH_ERASE_128K_MS 2000U
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+int dfu_flash_unlock(void) {
+    return (DAL_FLASH_Unlock() == DAL_OK) ? 0 : -1;
+}
+
+void dfu_flash_lock(void) {
+    DAL_FLASH_Lock();
+}
+
+/**
+ * @brief   Size of the erase unit holding addr
+ *
+ * @param   addr flash address
+ *
+ * @retval  sector size in bytes
+ */
+uint32_t dfu_flash_sector_size(uint32_t addr) {
+    if (addr < 0x08010000U) {
+        return 0x4000U;
+    } else if (addr < 0x08020000U) {
+        return 0x10000U;
+    }
+
+    return 0x20000U;
+}
+
+uint32_t dfu_flash_erase_time(uint32_t addr) {
+    switch (dfu_flash_sector_size(addr)) {
+        case 0x4000U:
+            return DFU_FLASH_ERASE_16K_MS;
+        case 0x10000U:
+            return DFU_FLASH_ERASE_64K_MS;
+        default:
+            return DFU_FLASH_ERASE_128K_MS;
+    }
+}
+
+uint32_t dfu_flash_program_time(uint32_t len) {
+    return ((len / 4U) * DFU_FLASH_WORD_PROG_US + 999U) / 1000U;
+}
+
+/**
+ * @brief   Erase the sector holding addr
+ *
+ * @param   addr any address inside the sector
+ *
+ * @retval  0 on success, -1 on a flash error
+ */
+__RAM_FUNC int dfu_flash_erase(uint32_t addr) {
+    uint32_t sector;
+    uint32_t sts;
+
+    if (addr < 0x08010000U) {
+        sector = (addr - 0x08000000U) >> 14;
+    } else if (addr < 0x08020000U) {
+        sector = 4U;
+    } else {
+        sector = 5U + ((addr - 0x08020000U) >> 17);
+    }
+
+    while (FLASH->STS & FLASH_STS_BUSY) {
+    }
+    FLASH->STS = DFU_FLASH_STS_ERRORS;
+
+    FLASH->CTRL &= ~(FLASH_CTRL_PGSIZE | FLASH_CTRL_SNUM);
+    FLASH->CTRL |= DFU_FLASH_PSIZE | FLASH_CTRL_SERS | (sector << FLASH_CTRL_SNUM_Pos);
+    FLASH->CTRL |= FLASH_CTRL_START;
+    __DSB();
+
+    while (FLASH->STS & FLASH_STS_BUSY) {
+    }
+
+    FLASH->CTRL &= ~(FLASH_CTRL_SERS | FLASH_CTRL_SNUM);
+    sts = FLASH->STS & DFU_FLASH_STS_ERRORS;
+
+    /* drop data cache lines of the old sector content */
+    if (FLASH->ACCTRL & FLASH_ACCTRL_DCACHEEN) {
+        __DAL_FLASH_DATA_CACHE_DISABLE();
+        __DAL_FLASH_DATA_CACHE_RESET();
+        __DAL_FLASH_DATA_CACHE_ENABLE();
+    }
+
+    return sts ? -1 : 0;
+}
+
+/**
+ * @brief   Program an erased area
+ *
+ * @param   addr destination, aligned to DFU_FLASH_PROGRAM_ALIGN
+ *
+ * @param   buf  word aligned source in RAM
+ *
+ * @param   len  byte count, multiple of DFU_FLASH_PROGRAM_ALIGN
+ *
+ * @retval  0 on success, -1 on a flash error
+ */
+__RAM_FUNC int dfu_flash_program(uint32_t addr, const uint8_t *buf, uint32_t len) {
+    __IO uint32_t *dst = (__IO uint32_t *)addr;
+    const uint32_t *src = (const uint32_t *)buf;
+    uint32_t n = len / DFU_FLASH_PROGRAM_ALIGN;
+    uint32_t sts = 0;
+
+    while (FLASH->STS & FLASH_STS_BUSY) {
+    }
+    FLASH->STS = DFU_FLASH_STS_ERRORS;
+
+    FLASH->CTRL &= ~FLASH_CTRL_PGSIZE;
+    FLASH->CTRL |= DFU_FLASH_PSIZE | FLASH_CTRL_PG;
+
+    while (n--) {
+        *dst++ = *src++;
+#if DFU_FLASH_DOUBLE_WORD
+        __ISB();
+        *dst++ = *src++;
+#endif
+        __DSB();
+
+        while (FLASH->STS & FLASH_STS_BUSY) {
+        }
+
+        sts = FLASH->STS & DFU_FLASH_STS_ERRORS;
+        if (sts) {
+            break;
+        }
+    }
+
+    FLASH->CTRL &= ~FLASH_CTRL_PG;
+
+    return sts ? -1 : 0;
+}
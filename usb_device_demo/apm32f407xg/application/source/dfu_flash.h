@@ -0,0 +1,65 @@
+/**
+  * @file    dfu_flash.h
+  * @author  LuckkMaker
+  * @brief   Header for dfu_flash.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef DFU_FLASH_H
+#define DFU_FLASH_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< download region, sectors 8..11 so the running image in the lower half is untouched */
+#ifndef DFU_FLASH_BASE
+#define DFU_FLASH_BASE              0x08080000U
+#endif
+#ifndef DFU_FLASH_SIZE
+#define DFU_FLASH_SIZE              0x00080000U
+#endif
+
+/*!< x64 parallelism needs an external VPP, the default x32 runs from VDD (2.7V to 3.6V) */
+#ifndef DFU_FLASH_DOUBLE_WORD
+#define DFU_FLASH_DOUBLE_WORD       0
+#endif
+
+#if DFU_FLASH_DOUBLE_WORD
+#define DFU_FLASH_PROGRAM_ALIGN     8U
+#else
+#define DFU_FLASH_PROGRAM_ALIGN     4U
+#endif
+
+int dfu_flash_unlock(void);
+void dfu_flash_lock(void);
+uint32_t dfu_flash_sector_size(uint32_t addr);
+uint32_t dfu_flash_erase_time(uint32_t addr);
+uint32_t dfu_flash_program_time(uint32_t len);
+int dfu_flash_erase(uint32_t addr);
+int dfu_flash_program(uint32_t addr, const uint8_t *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DFU_FLASH_H */
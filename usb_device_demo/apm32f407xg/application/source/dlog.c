@@ -0,0 +1,211 @@
+/**
+  * @file    dlog.c
+  * @author  LuckkMaker
+  * @brief   Deferred binary log, formatted in the main loop or on the host
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * CONFIG_USB_PRINTF() maps to DLOG() (usb_config.h), so every USB_LOG_*
+  * line costs a slot reservation and a few word stores instead of a printf
+  * running in the interrupt. The format string is not copied, its address
+  * is the message ID: it is in flash, and tools/dlog_decode.py finds it in
+  * the ELF file.
+  *
+  * Any context may write, dlog_flush() alone reads:
+  *   - a writer reserves a slot by moving head with LDREX/STREX, fills it and
+  *     publishes it by storing the format address last,
+  *   - the reader stops at the first slot not published yet, so a writer
+  *     preempted between the two steps only delays the records behind it,
+  *   - a full ring drops the new record and counts it.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dlog.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "main.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#if (DLOG_DEPTH & (DLOG_DEPTH - 1U))
+#error "DLOG_DEPTH must be a power of two"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define DLOG_SLOT(i)                dlog_ring[(i) & (DLOG_DEPTH - 1U)]
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t dlog_ring[DLOG_DEPTH][DLOG_RECORD_WORDS];
+static volatile uint32_t dlog_head;
+static volatile uint32_t dlog_tail;
+static volatile uint32_t dlog_drop_count;
+static uint32_t dlog_drop_reported;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void dlog_count_drop(void) {
+    uint32_t n;
+
+    do {
+        n = __LDREXW(&dlog_drop_count);
+    } while (__STREXW(n + 1U, &dlog_drop_count));
+}
+
+/**
+ * @brief   Queue one record, callable from any interrupt
+ *
+ * @param   nargs  number of arguments after fmt, DLOG() counts them
+ *
+ * @param   fmt    printf format, a string constant
+ *
+ * @retval  None
+ */
+void dlog_write(uint32_t nargs, const char *fmt, ...) {
+    uint32_t *slot;
+    uint32_t head;
+    uint32_t i;
+    va_list ap;
+
+    do {
+        head = __LDREXW(&dlog_head);
+        if ((head - dlog_tail) >= DLOG_DEPTH) {
+            __CLREX();
+            dlog_count_drop();
+            return;
+        }
+    } while (__STREXW(head + 1U, &dlog_head));
+
+    if (nargs > DLOG_MAX_ARGS) {
+        nargs = DLOG_MAX_ARGS;
+    }
+
+    slot = DLOG_SLOT(head);
+    slot[1] = DLOG_HDR(nargs, head);
+
+    va_start(ap, fmt);
+    for (i = 0; i < nargs; i++) {
+        slot[2U + i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    /* publish */
+    __DMB();
+    slot[0] = (uint32_t)fmt;
+}
+
+#if (DLOG_MODE == DLOG_MODE_TEXT)
+static void dlog_emit(const uint32_t *rec) {
+    /* unused trailing words are ignored by printf */
+    printf((const char *)rec[0], rec[2], rec[3], rec[4], rec[5], rec[6], rec[7]);
+}
+#else
+static void dlog_emit(const uint32_t *rec) {
+    dlog_sink((const uint8_t *)rec, DLOG_RECORD_WORDS * 4U);
+}
+#endif /* DLOG_MODE */
+
+/**
+ * @brief   Format or send every published record, from the main loop
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void dlog_flush(void) {
+    uint32_t rec[DLOG_RECORD_WORDS];
+    uint32_t *slot;
+    uint32_t dropped;
+
+    while (dlog_tail != dlog_head) {
+        slot = DLOG_SLOT(dlog_tail);
+        if (slot[0] == 0U) {
+            /* reserved, not published yet */
+            break;
+        }
+        __DMB();
+        memcpy(rec, slot, sizeof(rec));
+
+        /* release the slot before the slow part */
+        slot[0] = 0U;
+        __DMB();
+        dlog_tail++;
+
+        dlog_emit(rec);
+    }
+
+    dropped = dlog_drop_count;
+    if (dropped != dlog_drop_reported) {
+        rec[0] = (uint32_t)"dlog: %u records dropped\r\n";
+        rec[1] = DLOG_HDR(1U, 0xFFFFU);
+        rec[2] = dropped - dlog_drop_reported;
+        memset(&rec[3], 0, (DLOG_RECORD_WORDS - 3U) * 4U);
+        dlog_drop_reported = dropped;
+        dlog_emit(rec);
+    }
+}
+
+/**
+ * @brief   Take raw records out of the ring, instead of dlog_flush()
+ *
+ * @param   buf     room for records * DLOG_RECORD_WORDS words
+ *
+ * @param   records max records
+ *
+ * @retval  records copied
+ */
+uint32_t dlog_read(uint32_t *buf, uint32_t records) {
+    uint32_t *slot;
+    uint32_t n = 0;
+
+    while ((n < records) && (dlog_tail != dlog_head)) {
+        slot = DLOG_SLOT(dlog_tail);
+        if (slot[0] == 0U) {
+            break;
+        }
+        __DMB();
+        memcpy(&buf[n * DLOG_RECORD_WORDS], slot, DLOG_RECORD_WORDS * 4U);
+        slot[0] = 0U;
+        __DMB();
+        dlog_tail++;
+        n++;
+    }
+
+    return n;
+}
+
+uint32_t dlog_dropped(void) {
+    return dlog_drop_count;
+}
+
+/**
+ * @brief   Output of the binary mode, stdout by default
+ *
+ * @param   data   whole records
+ *
+ * @param   len    bytes
+ *
+ * @retval  None
+ */
+__WEAK void dlog_sink(const uint8_t *data, uint32_t len) {
+    fflush(stdout);
+    write(STDOUT_FILENO, data, len);
+}
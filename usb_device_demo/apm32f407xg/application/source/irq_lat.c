@@ -0,0 +1,261 @@
+/**
+  * @file    irq_lat.c
+  * @author  LuckkMaker
+  * @brief   USB interrupt latency and preemption measurement
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The OTG_FS core drives a SOF pulse into TMR2 ITR1, CC1 captures it as
+  * trigger input (TRC). When OTG_FS_IRQHandler is entered with the SOF
+  * interrupt pending, counter minus capture is the hardware event to ISR
+  * entry latency, all higher priority interrupts and masked sections
+  * included. SOF is the only USB event that reaches a timer; the pulse
+  * output (GGCCFG.SOFPOUT) and the mask are set here since the driver needs
+  * neither.
+  *
+  * CC2 of the same timer schedules the test interrupt. Its entry latency is
+  * taken against the compare value, its preemption is the run time of a
+  * fixed busy loop minus the same loop measured with interrupts off.
+  *
+  * Samples go to the cycle_prof probes in core cycles, read them with
+  * tools/cycle_prof.py from the CDC ACM HID demo, which serves the dump:
+  *   - sof_lat:       SOF capture to OTG_FS_IRQHandler entry
+  *   - usb_irq:       OTG_FS_IRQHandler run time, the existing probe
+  *   - test_irq_lat:  due time to test interrupt entry
+  *   - test_preempt:  time the test interrupt was held off its work
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "irq_lat.h"
+
+#if IRQ_LAT_ENABLE
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/*!< TS = ITR1, OTG_FS SOF once TMR2_OR remaps it */
+#define IRQ_LAT_TS_ITR1             (1U << TMR_SMCTRL_TRGSEL_Pos)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static uint32_t irq_lat_tick_cycles;    /*!< core cycles per timer tick */
+static uint32_t irq_lat_period;         /*!< test period in ticks */
+static uint32_t irq_lat_work;           /*!< undisturbed test loop in ticks */
+static volatile bool irq_lat_running;   /*!< SOF output kept on, cleared by irq_lat_deinit() */
+static struct irq_lat_stats irq_lat_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static uint32_t irq_lat_timer_clock(void) {
+    uint32_t pclk1 = DAL_RCM_GetPCLK1Freq();
+
+    /* timers on a divided APB run at twice its clock */
+    return ((RCM->CFG & RCM_CFG_APB1PSC) == 0U) ? pclk1 : (2U * pclk1);
+}
+
+static void irq_lat_test_work(void) {
+    volatile uint32_t n;
+
+    for (n = 0; n < IRQ_LAT_TEST_WORK; n++) {
+    }
+}
+
+/**
+ * @brief   Start TMR2, the SOF capture and the test interrupt
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void irq_lat_init(void) {
+    uint32_t clock = irq_lat_timer_clock();
+    uint32_t primask;
+    uint32_t best = UINT32_MAX;
+    uint32_t t0;
+    uint32_t i;
+
+    irq_lat_tick_cycles = SystemCoreClock / clock;
+    if ((SystemCoreClock % clock) != 0U) {
+        USB_LOG_WRN("irq_lat: core clock not a multiple of TMR2, samples rounded\r\n");
+    }
+    irq_lat_period = (uint32_t)(((uint64_t)clock * IRQ_LAT_TEST_PERIOD_US) / 1000000U);
+    memset(&irq_lat_stats, 0, sizeof(irq_lat_stats));
+
+    __DAL_RCM_TMR2_CLK_ENABLE();
+
+    /* runs before the USB stack, the core needs its clock to take the SOF output */
+    __DAL_RCM_USB_OTG_FS_CLK_ENABLE();
+    USB_OTG_FS->GGCCFG |= USB_OTG_GGCCFG_SOFPOUT;
+    irq_lat_running = true;
+
+    IRQ_LAT_TMR->CTRL1 = 0;
+    IRQ_LAT_TMR->PSC = 0;
+    IRQ_LAT_TMR->AUTORLD = 0xFFFFFFFFU;
+    IRQ_LAT_TMR->CEG = TMR_CEG_UEG;
+    IRQ_LAT_TMR->OR = TMR_OR_RMPSEL_1;
+    IRQ_LAT_TMR->SMCTRL = IRQ_LAT_TS_ITR1;
+    IRQ_LAT_TMR->CCM1 = TMR_CCM1_CC1SEL_0 | TMR_CCM1_CC1SEL_1;
+    IRQ_LAT_TMR->CCEN = TMR_CCEN_CC1EN;
+    IRQ_LAT_TMR->STS = 0;
+    IRQ_LAT_TMR->CTRL1 = TMR_CTRL1_CNTEN;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    for (i = 0; i < 4U; i++) {
+        t0 = IRQ_LAT_TMR->CNT;
+        irq_lat_test_work();
+        t0 = IRQ_LAT_TMR->CNT - t0;
+        if (t0 < best) {
+            best = t0;
+        }
+    }
+    irq_lat_work = best;
+    __set_PRIMASK(primask);
+
+    if (irq_lat_period != 0U) {
+        if (irq_lat_work >= irq_lat_period) {
+            USB_LOG_WRN("irq_lat: test work longer than its period\r\n");
+        }
+        IRQ_LAT_TMR->CC2 = IRQ_LAT_TMR->CNT + irq_lat_period;
+        IRQ_LAT_TMR->DIEN = TMR_DIEN_CC2IEN;
+        DAL_NVIC_SetPriority(TMR2_IRQn, IRQ_LAT_TEST_PRIO, 0U);
+        DAL_NVIC_EnableIRQ(TMR2_IRQn);
+    }
+}
+
+/**
+ * @brief   Stop TMR2 and the SOF output, called before the USB core is shut down
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void irq_lat_deinit(void) {
+    irq_lat_running = false;
+
+    DAL_NVIC_DisableIRQ(TMR2_IRQn);
+    IRQ_LAT_TMR->DIEN = 0;
+    IRQ_LAT_TMR->CTRL1 = 0;
+    __DAL_RCM_TMR2_CLK_DISABLE();
+
+    USB_OTG_FS->GGCCFG &= ~USB_OTG_GGCCFG_SOFPOUT;
+    USB_OTG_FS->GINTMASK &= ~USB_OTG_GINTMASK_SOFM;
+}
+
+/**
+ * @brief   Take the SOF latency sample, IRQ_LAT_USB_ENTRY()
+ *
+ * @param   now   counter read on entry
+ *
+ * @retval  1 if the SOF interrupt was pending, for irq_lat_usb_exit()
+ */
+uint32_t irq_lat_usb_entry(uint32_t now) {
+    uint32_t sts;
+    uint32_t lat;
+
+    if (!(USB_OTG_FS->GCINT & USB_OTG_GCINT_SOF)) {
+        return 0;
+    }
+
+    sts = IRQ_LAT_TMR->STS;
+    if (sts & TMR_STS_CC1IFLG) {
+        /* reading CC1 clears the capture flag */
+        lat = now - IRQ_LAT_TMR->CC1;
+        if (sts & TMR_STS_CC1RCFLG) {
+            IRQ_LAT_TMR->STS = ~TMR_STS_CC1RCFLG;
+            irq_lat_stats.sof_overcaptures++;
+            USB_LOG_WRN("irq_lat: SOF interrupt held off over a frame\r\n");
+        } else if ((int32_t)lat >= 0) {
+            /* a capture after the entry read would come out negative */
+            cycle_prof_record(CYCLE_PROF_SOF_LAT, lat * irq_lat_tick_cycles);
+            irq_lat_stats.sof_samples++;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief   Leave the USB interrupt, IRQ_LAT_USB_EXIT()
+ *
+ * @param   sof   irq_lat_usb_entry() result
+ *
+ * @retval  None
+ */
+void irq_lat_usb_exit(uint32_t sof) {
+    if (sof) {
+        USB_OTG_FS->GCINT = USB_OTG_GCINT_SOF;
+    }
+    if (!irq_lat_running) {
+        return;
+    }
+    /* the driver rewrites GGCCFG and a core reset clears the mask, set both again on every way out */
+    USB_OTG_FS->GGCCFG |= USB_OTG_GGCCFG_SOFPOUT;
+    USB_OTG_FS->GINTMASK |= USB_OTG_GINTMASK_SOFM;
+}
+
+/**
+ * @brief   Test interrupt, called from TMR2_IRQHandler
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void irq_lat_test_irq_handler(void) {
+    uint32_t now = IRQ_LAT_TMR->CNT;
+    uint32_t due = IRQ_LAT_TMR->CC2;
+    uint32_t next;
+    uint32_t run;
+
+    if (!(IRQ_LAT_TMR->STS & TMR_STS_CC2IFLG)) {
+        return;
+    }
+    IRQ_LAT_TMR->STS = ~TMR_STS_CC2IFLG;
+
+    /* a resync below may leave a stale flag for a compare still ahead */
+    if ((int32_t)(now - due) < 0) {
+        return;
+    }
+
+    run = IRQ_LAT_TMR->CNT;
+    irq_lat_test_work();
+    run = IRQ_LAT_TMR->CNT - run;
+
+    cycle_prof_record(CYCLE_PROF_TEST_LAT, (now - due) * irq_lat_tick_cycles);
+    cycle_prof_record(CYCLE_PROF_TEST_PREEMPT, (run > irq_lat_work) ? ((run - irq_lat_work) * irq_lat_tick_cycles) : 0U);
+    irq_lat_stats.test_runs++;
+
+    next = due + irq_lat_period;
+    IRQ_LAT_TMR->CC2 = next;
+    if ((int32_t)(IRQ_LAT_TMR->CNT - next) >= 0) {
+        /* the compare only matches on equality, a missed one waits a full wrap */
+        IRQ_LAT_TMR->CC2 = IRQ_LAT_TMR->CNT + irq_lat_period;
+        irq_lat_stats.test_overruns++;
+    }
+}
+
+void irq_lat_get_stats(struct irq_lat_stats *stats) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = irq_lat_stats;
+    __set_PRIMASK(primask);
+}
+
+#endif /* IRQ_LAT_ENABLE */
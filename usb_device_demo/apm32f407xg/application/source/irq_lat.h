@@ -0,0 +1,96 @@
+/**
+  * @file    irq_lat.h
+  * @author  LuckkMaker
+  * @brief   Header for irq_lat.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef IRQ_LAT_H
+#define IRQ_LAT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "cycle_prof.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< measurement mode, the hooks compile to nothing unless enabled */
+#ifndef IRQ_LAT_ENABLE
+#define IRQ_LAT_ENABLE              0
+#endif
+
+/*!< test interrupt on TMR2 compare 2, lower priority than OTG_FS (1) to see
+ *   what the USB ISR costs it, higher to see what it costs the USB ISR */
+#ifndef IRQ_LAT_TEST_PRIO
+#define IRQ_LAT_TEST_PRIO           2U
+#endif
+
+/*!< test interrupt period, 0 leaves it off */
+#ifndef IRQ_LAT_TEST_PERIOD_US
+#define IRQ_LAT_TEST_PERIOD_US      250U
+#endif
+
+/*!< busy loop iterations per test interrupt, the load a control loop would be */
+#ifndef IRQ_LAT_TEST_WORK
+#define IRQ_LAT_TEST_WORK           200U
+#endif
+
+#if IRQ_LAT_ENABLE && !CYCLE_PROF_ENABLE
+#error "IRQ_LAT_ENABLE reports through cycle_prof, build with CYCLE_PROF_ENABLE=1"
+#endif
+
+/*!< TMR2 counts free running, ITR1 remapped to the OTG_FS SOF pulse and captured on CC1 */
+#define IRQ_LAT_TMR                 TMR2
+
+/*!< events the counters do not show as latency samples */
+struct irq_lat_stats {
+    uint32_t sof_samples;       /*!< USB interrupts entered with a captured SOF pending */
+    uint32_t sof_overcaptures;  /*!< SOF captured again before the ISR read it, latency over a frame */
+    uint32_t test_runs;         /*!< test interrupts run */
+    uint32_t test_overruns;     /*!< test interrupts that finished after the next one was due */
+};
+
+#if IRQ_LAT_ENABLE
+
+uint32_t irq_lat_usb_entry(uint32_t now);
+void irq_lat_usb_exit(uint32_t sof);
+
+/*!< first and last thing in OTG_FS_IRQHandler, the counter is read before the call */
+#define IRQ_LAT_USB_ENTRY()         const uint32_t irq_lat_sof = irq_lat_usb_entry(IRQ_LAT_TMR->CNT)
+#define IRQ_LAT_USB_EXIT()          irq_lat_usb_exit(irq_lat_sof)
+
+void irq_lat_init(void);
+void irq_lat_deinit(void);
+void irq_lat_test_irq_handler(void);
+void irq_lat_get_stats(struct irq_lat_stats *stats);
+
+#else
+
+#define IRQ_LAT_USB_ENTRY()
+#define IRQ_LAT_USB_EXIT()
+
+#endif /* IRQ_LAT_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* IRQ_LAT_H */
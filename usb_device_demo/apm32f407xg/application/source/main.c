@@ -29,12 +29,44 @@
 /* Private includes *******************************************************/
 #include "apm32f4xx_device_cfg.h"
 #include "cdc_acm_hid.h"
+#include "usb_eth_bridge.h"
+#include "usb_dfu.h"
+#include "usb_secure.h"
+#include "usb_cdc_bench.h"
+#include "usb_host_bridge.h"
+#include "dlog.h"
+#include "uart_log.h"
+#include "irq_lat.h"
+#include "usb_pm.h"
+#include "sched.h"
+#if CONFIG_USB_OSAL
+#include "usb_osal.h"
+#include "usb_osal_port.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#endif /* CONFIG_USB_OSAL */
 
 /* Private macro **********************************************************/
+#define HELLO_PERIOD_MS                     500U
+#define LOG_PERIOD_MS                       10U
+#define REPORT_PERIOD_MS                    10000U
+
+#if CONFIG_USB_OSAL
+#define APP_RUN()                           app_run()
+#else
+#define APP_RUN()                           sched_run()
+#endif /* CONFIG_USB_OSAL */
 
 /* Private typedef ********************************************************/
 
 /* Private variables ******************************************************/
+#if (DEMO_SELECT == DEMO_CDC_ACM_HID) && USB_PM_ENABLE
+static int usb_pm_task;
+#endif /* DEMO_SELECT */
+#if CONFIG_USB_OSAL && ((DEMO_SELECT == DEMO_CDC_ACM_HID) || (DEMO_SELECT == DEMO_CDC_BENCH) || \
+                        (DEMO_SELECT == DEMO_USB_HOST_BRIDGE))
+static volatile bool app_idle;
+#endif /* CONFIG_USB_OSAL */
 
 /* Private function prototypes ********************************************/
 
@@ -42,6 +74,111 @@
 
 /* External functions *****************************************************/
 
+#if (DEMO_SELECT == DEMO_CDC_ACM_HID) || (DEMO_SELECT == DEMO_CDC_BENCH) || (DEMO_SELECT == DEMO_USB_HOST_BRIDGE)
+static void log_task(void *arg)
+{
+    (void)arg;
+    dlog_flush();
+}
+
+#if SCHED_STATS_ENABLE
+static void report_task(void *arg)
+{
+    (void)arg;
+    sched_report();
+}
+#endif /* SCHED_STATS_ENABLE */
+#endif /* DEMO_SELECT */
+
+#if (DEMO_SELECT == DEMO_CDC_ACM_HID)
+static void hello_task(void *arg)
+{
+    uint8_t busid;
+
+    (void)arg;
+
+#if USB_PM_ENABLE
+    if (usb_pm_suspended())
+    {
+        return;
+    }
+#endif /* USB_PM_ENABLE */
+
+    DAL_GPIO_TogglePin(GPIOE, GPIO_PIN_6);
+    /* Skipped while the last one is still in flight */
+    for (busid = 0U; busid < CONFIG_USBDEV_MAX_BUS; busid++)
+    {
+        cdc_acm_data_write(busid, (const uint8_t *)"Hello World!\r\n", 14);
+    }
+}
+
+#if USB_PM_ENABLE
+static void usb_pm_task_fn(void *arg)
+{
+    (void)arg;
+
+    /* Stays in STOP until the host resumes the bus */
+    usb_pm_poll();
+}
+
+static void usb_pm_notify(void)
+{
+    sched_signal(usb_pm_task);
+}
+#endif /* USB_PM_ENABLE */
+#endif /* DEMO_SELECT */
+
+#if CONFIG_USB_OSAL && ((DEMO_SELECT == DEMO_CDC_ACM_HID) || (DEMO_SELECT == DEMO_CDC_BENCH) || \
+                        (DEMO_SELECT == DEMO_USB_HOST_BRIDGE))
+/**
+ * @brief   Idle hook of the scheduler, replaces its WFI
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void sched_idle(void)
+{
+    /* Called masked, the app thread sleeps once it returns */
+    app_idle = true;
+}
+
+static void app_thread(void *arg)
+{
+    (void)arg;
+
+    while (1)
+    {
+        sched_run_once();
+
+        /* Give the tick to the lower priority threads */
+        if (app_idle)
+        {
+            app_idle = false;
+            usb_osal_msleep(1U);
+        }
+    }
+}
+
+/**
+ * @brief   Run the demo tasks in a thread and start the kernel
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+static void app_run(void)
+{
+    usb_osal_thread_create("app", USB_OSAL_APP_STACKSIZE, USB_OSAL_APP_PRIO, app_thread, NULL);
+    vTaskStartScheduler();
+
+    /* Not reached, the kernel found no memory for the idle task otherwise */
+    while (1)
+    {
+    }
+}
+#endif /* CONFIG_USB_OSAL */
+
 /**
  * @brief   Main program
  *
@@ -53,16 +190,83 @@ int main(void)
 {
     /* Device configuration */
     DAL_DeviceConfig();
+    uart_log_init();
+#if IRQ_LAT_ENABLE
+    irq_lat_init();
+#endif
 
-    cdc_acm_hid_init(0, USB_OTG_FS_PERIPH_BASE);
+#if (DEMO_SELECT == DEMO_USB_ETH_BRIDGE)
+    usb_eth_bridge_init(0, USB_OTG_FS_PERIPH_BASE);
 
     /* Infinite loop */
     while (1)
     {
-        DAL_GPIO_TogglePin(GPIOE, GPIO_PIN_6);
-        cdc_acm_data_send(0, "Hello World!\r\n", 14);
-        DAL_Delay(500U);
+        dlog_flush();
+        usb_eth_bridge_poll();
     }
+#elif (DEMO_SELECT == DEMO_DFU)
+    usb_dfu_init(0, USB_OTG_FS_PERIPH_BASE);
+
+    /* Infinite loop */
+    while (1)
+    {
+        dlog_flush();
+        usb_dfu_poll();
+    }
+#elif (DEMO_SELECT == DEMO_SECURE_UPLOAD)
+    usb_secure_init(0, USB_OTG_FS_PERIPH_BASE);
+
+    /* Infinite loop */
+    while (1)
+    {
+        dlog_flush();
+        usb_secure_poll();
+    }
+#elif (DEMO_SELECT == DEMO_CDC_BENCH)
+    usb_cdc_bench_init(0, USB_OTG_FS_PERIPH_BASE);
+
+    sched_task_add("log", log_task, NULL, LOG_PERIOD_MS);
+#if SCHED_STATS_ENABLE
+    sched_task_add("report", report_task, NULL, REPORT_PERIOD_MS);
+#endif /* SCHED_STATS_ENABLE */
+
+    /* Infinite loop */
+    APP_RUN();
+#elif (DEMO_SELECT == DEMO_USB_HOST_BRIDGE)
+    /* Device to the PC on OTG_FS, host to the downstream device on OTG_HS */
+    usb_host_bridge_init(0, USB_OTG_FS_PERIPH_BASE, 0, USB_OTG_HS_PERIPH_BASE);
+
+    sched_task_add("log", log_task, NULL, LOG_PERIOD_MS);
+#if SCHED_STATS_ENABLE
+    sched_task_add("report", report_task, NULL, REPORT_PERIOD_MS);
+#endif /* SCHED_STATS_ENABLE */
+
+    /* Infinite loop */
+    APP_RUN();
+#else
+    cdc_acm_hid_init(0, USB_OTG_FS_PERIPH_BASE);
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+    /* Second device of its own on OTG_HS, no usb_pm: STOP would freeze it too */
+    cdc_acm_hid_init(1, USB_OTG_HS_PERIPH_BASE);
+#endif /* CONFIG_USBDEV_MAX_BUS */
+#if USB_PM_ENABLE
+    usb_pm_init(0, USB_OTG_FS_PERIPH_BASE);
+#endif /* USB_PM_ENABLE */
+
+    sched_task_add("log", log_task, NULL, LOG_PERIOD_MS);
+    sched_task_add("hello", hello_task, NULL, HELLO_PERIOD_MS);
+#if USB_PM_ENABLE
+    /* Runs on suspend and remote wakeup requests only */
+    usb_pm_task = sched_task_add("usb_pm", usb_pm_task_fn, NULL, 0U);
+    usb_pm_set_notify(usb_pm_notify);
+#endif /* USB_PM_ENABLE */
+#if SCHED_STATS_ENABLE
+    sched_task_add("report", report_task, NULL, REPORT_PERIOD_MS);
+#endif /* SCHED_STATS_ENABLE */
+
+    /* Infinite loop */
+    APP_RUN();
+#endif /* DEMO_SELECT */
 }
 
 void usb_dc_low_level_init(void)
@@ -86,16 +290,65 @@ void usb_dc_low_level_init(void)
     /* Configure interrupt */
     DAL_NVIC_SetPriority(OTG_FS_IRQn, 1U, 0U);
     DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+    /* Called once per bus without the bus id, so both cores come up here */
+    __DAL_RCM_GPIOB_CLK_ENABLE();
+
+    /* USB HS DM, DP pin configuration, embedded FS PHY */
+    GPIO_InitStruct.Pin         = GPIO_PIN_14 | GPIO_PIN_15;
+    GPIO_InitStruct.Alternate   = GPIO_AF12_OTG_HS_FS;
+    DAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    __DAL_RCM_USB_OTG_HS_CLK_ENABLE();
+    __DAL_RCM_USB_OTG_HS_ULPI_CLK_SLEEP_DISABLE();
+
+    /* Same level as OTG_FS, the two buses never preempt each other */
+    DAL_NVIC_SetPriority(OTG_HS_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(OTG_HS_IRQn);
+#endif /* CONFIG_USBDEV_MAX_BUS */
 }
 
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+/* The DCD masks the core's global interrupt before its low level deinit, a running bus keeps it */
+static bool usb_dc_core_stopped(uint32_t reg_base)
+{
+    return (((USB_OTG_GlobalTypeDef *)reg_base)->GAHBCFG & USB_OTG_GAHBCFG_GINTMASK) == 0U;
+}
+#endif /* CONFIG_USBDEV_MAX_BUS */
+
 void usb_dc_low_level_deinit(void)
 {
-    /* Disable peripheral clock */
-    __DAL_RCM_USB_OTG_FS_CLK_DISABLE();
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+    /* Called without the bus id, only the core being deinitialized goes down */
+    bool fs_stop = usb_dc_core_stopped(USB_OTG_FS_PERIPH_BASE);
+    bool hs_stop = usb_dc_core_stopped(USB_OTG_HS_PERIPH_BASE);
+#else
+    bool fs_stop = true;
+#endif /* CONFIG_USBDEV_MAX_BUS */
 
-    /* USB DM, DP pin configuration */
-    DAL_GPIO_DeInit(GPIOA, GPIO_PIN_11 | GPIO_PIN_12);
+    if (fs_stop)
+    {
+#if IRQ_LAT_ENABLE
+        irq_lat_deinit();
+#endif
+
+        /* Disable peripheral clock */
+        __DAL_RCM_USB_OTG_FS_CLK_DISABLE();
 
-    /* Disable peripheral interrupt */
-    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+        /* USB DM, DP pin configuration */
+        DAL_GPIO_DeInit(GPIOA, GPIO_PIN_11 | GPIO_PIN_12);
+
+        /* Disable peripheral interrupt */
+        DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    }
+
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+    if (hs_stop)
+    {
+        __DAL_RCM_USB_OTG_HS_CLK_DISABLE();
+        DAL_GPIO_DeInit(GPIOB, GPIO_PIN_14 | GPIO_PIN_15);
+        DAL_NVIC_DisableIRQ(OTG_HS_IRQn);
+    }
+#endif /* CONFIG_USBDEV_MAX_BUS */
 }
\ No newline at end of file
@@ -0,0 +1,298 @@
+/**
+  * @file    sched.c
+  * @author  LuckkMaker
+  * @brief   Cooperative run to completion scheduler for the demo main loops
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * A task is a function that returns without waiting. It runs when its
+  * period elapsed, when sched_defer() timed it once, or when its event flag
+  * was set by sched_signal(), which interrupts and USB callbacks may call.
+  * A pass of sched_run_once() runs every ready task once, in the order they
+  * were added; a task signaled while it runs runs again on the next pass.
+  *
+  * With nothing ready the pass calls sched_idle() with interrupts masked,
+  * so that an interrupt setting a flag just before cannot be slept through:
+  * WFI still returns for it, and it is taken once the mask is lifted. The
+  * default idle hook is a plain WFI, the 1 ms tick wakes it for the timers.
+  *
+  * With SCHED_STATS_ENABLE each task's runs and run time are kept in
+  * cycle_prof timer counts, sched_report() prints them with the share of
+  * the time since the last sched_stats_clear(). cycle_prof_init() has to
+  * have started the timer, the demos do it in their init.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sched.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+struct sched_task {
+    sched_fn_t fn;
+    void *arg;
+    uint32_t period;            /*!< ms, 0 for tasks run on events and sched_defer() only */
+    uint32_t due;               /*!< tick of the next timed run */
+    bool timed;
+    struct sched_stats stats;
+};
+
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+#define SCHED_LOCK(m)               do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define SCHED_UNLOCK(m)             __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+static struct sched_task sched_tasks[SCHED_TASK_MAX];
+static uint32_t sched_task_num;
+static volatile uint32_t sched_events;
+static uint32_t sched_stats_tick;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static bool sched_due(const struct sched_task *task, uint32_t now) {
+    return task->timed && ((int32_t)(now - task->due) >= 0);
+}
+
+static void sched_exec(struct sched_task *task) {
+#if SCHED_STATS_ENABLE
+    uint32_t t = cycle_prof_now();
+
+    task->fn(task->arg);
+
+    t = cycle_prof_now() - t;
+    task->stats.sum += t;
+    if (t > task->stats.max) {
+        task->stats.max = t;
+    }
+#else
+    task->fn(task->arg);
+#endif
+    task->stats.runs++;
+}
+
+/**
+ * @brief   Add a task
+ *
+ * @param   name        for the stats, a string constant
+ *
+ * @param   fn          task function, must not block
+ *
+ * @param   arg         passed to fn
+ *
+ * @param   period_ms   run every period_ms, 0 only on events and sched_defer()
+ *
+ * @retval  task id, -1 if SCHED_TASK_MAX tasks exist
+ */
+int sched_task_add(const char *name, sched_fn_t fn, void *arg, uint32_t period_ms) {
+    struct sched_task *task;
+
+    if ((fn == NULL) || (sched_task_num >= SCHED_TASK_MAX)) {
+        return -1;
+    }
+
+    task = &sched_tasks[sched_task_num];
+    memset(task, 0, sizeof(*task));
+    task->fn = fn;
+    task->arg = arg;
+    task->period = period_ms;
+    task->due = SCHED_TICK_MS() + period_ms;
+    task->timed = (period_ms != 0U);
+    task->stats.name = name;
+
+    return (int)sched_task_num++;
+}
+
+/**
+ * @brief   Set the event flag of a task, safe from any interrupt
+ *
+ * @param   id   task id
+ *
+ * @retval  None
+ */
+void sched_signal(int id) {
+    uint32_t primask;
+
+    if ((id < 0) || ((uint32_t)id >= sched_task_num)) {
+        return;
+    }
+
+    SCHED_LOCK(primask);
+    sched_events |= 1UL << id;
+    SCHED_UNLOCK(primask);
+}
+
+/**
+ * @brief   Run a task once after a delay, from task context
+ *
+ * @param   id         task id
+ *
+ * @param   delay_ms   delay, replaces the next periodic run
+ *
+ * @retval  None
+ */
+void sched_defer(int id, uint32_t delay_ms) {
+    if ((id < 0) || ((uint32_t)id >= sched_task_num)) {
+        return;
+    }
+
+    sched_tasks[id].due = SCHED_TICK_MS() + delay_ms;
+    sched_tasks[id].timed = true;
+}
+
+/**
+ * @brief   Run every ready task once, sleep if none was
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void sched_run_once(void) {
+    struct sched_task *task;
+    uint32_t primask;
+    uint32_t events;
+    uint32_t now;
+    uint32_t i;
+    bool ran = false;
+
+    SCHED_LOCK(primask);
+    events = sched_events;
+    sched_events = 0;
+    SCHED_UNLOCK(primask);
+
+    now = SCHED_TICK_MS();
+    for (i = 0; i < sched_task_num; i++) {
+        task = &sched_tasks[i];
+        bool run = (events & (1UL << i)) != 0U;
+
+        if (sched_due(task, now)) {
+            run = true;
+            if (task->period == 0U) {
+                task->timed = false;
+            } else {
+                task->due += task->period;
+                /* late by more than a period, skip the missed runs */
+                if (sched_due(task, now)) {
+                    task->due = now + task->period;
+                }
+            }
+        }
+
+        if (run) {
+            sched_exec(task);
+            ran = true;
+        }
+    }
+
+    if (ran) {
+        return;
+    }
+
+    SCHED_LOCK(primask);
+    if (sched_events == 0U) {
+        now = SCHED_TICK_MS();
+        for (i = 0; i < sched_task_num; i++) {
+            if (sched_due(&sched_tasks[i], now)) {
+                break;
+            }
+        }
+        if (i == sched_task_num) {
+            sched_idle();
+        }
+    }
+    SCHED_UNLOCK(primask);
+}
+
+void sched_run(void) {
+    while (1) {
+        sched_run_once();
+    }
+}
+
+/**
+ * @brief   Idle hook, called with interrupts masked, a pending one ends it
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+__WEAK void sched_idle(void) {
+    __WFI();
+}
+
+/**
+ * @brief   Stats of a task
+ *
+ * @param   id      task id
+ *
+ * @param   stats   filled in
+ *
+ * @retval  0 on success, -1 on a bad id
+ */
+int sched_get_stats(int id, struct sched_stats *stats) {
+    if ((id < 0) || ((uint32_t)id >= sched_task_num)) {
+        return -1;
+    }
+
+    *stats = sched_tasks[id].stats;
+
+    return 0;
+}
+
+uint32_t sched_elapsed_ms(void) {
+    return SCHED_TICK_MS() - sched_stats_tick;
+}
+
+void sched_stats_clear(void) {
+    uint32_t i;
+
+    for (i = 0; i < sched_task_num; i++) {
+        sched_tasks[i].stats.runs = 0;
+        sched_tasks[i].stats.max = 0;
+        sched_tasks[i].stats.sum = 0;
+    }
+    sched_stats_tick = SCHED_TICK_MS();
+}
+
+/**
+ * @brief   Print the stats of every task, from task context
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void sched_report(void) {
+    const uint32_t per_us = SystemCoreClock / 1000000U;
+    uint64_t span = (uint64_t)sched_elapsed_ms() * 1000U * per_us;
+    uint32_t i;
+
+    printf("sched %lu ms\r\n", (unsigned long)sched_elapsed_ms());
+    for (i = 0; i < sched_task_num; i++) {
+        const struct sched_stats *s = &sched_tasks[i].stats;
+
+        printf("  %-12s runs %8lu max %6lu us total %8lu us load %3lu.%lu%%\r\n",
+               (s->name != NULL) ? s->name : "?",
+               (unsigned long)s->runs,
+               (unsigned long)(s->max / per_us),
+               (unsigned long)(s->sum / per_us),
+               (unsigned long)(span ? (s->sum * 100U / span) : 0U),
+               (unsigned long)(span ? (s->sum * 1000U / span) % 10U : 0U));
+    }
+}
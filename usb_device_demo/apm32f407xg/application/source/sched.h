@@ -0,0 +1,90 @@
+/**
+  * @file    sched.h
+  * @author  LuckkMaker
+  * @brief   Header for sched.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SCHED_H
+#define SCHED_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "cycle_prof.h"
+#include <stdbool.h>
+#ifndef USE_DAL_DRIVER
+#include "bsp_delay.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< tasks, one event flag bit each */
+#ifndef SCHED_TASK_MAX
+#define SCHED_TASK_MAX              8U
+#endif
+
+#if SCHED_TASK_MAX > 32U
+#error "SCHED_TASK_MAX must fit the 32-bit event word"
+#endif
+
+/*!< millisecond time base of the board */
+#ifndef SCHED_TICK_MS
+#ifdef USE_DAL_DRIVER
+#define SCHED_TICK_MS()             DAL_GetTick()
+#else
+#define SCHED_TICK_MS()             APM_GetTick()
+#endif
+#endif
+
+/*!< run time of each task in cycle_prof timer counts, needs the timer */
+#ifndef SCHED_STATS_ENABLE
+#define SCHED_STATS_ENABLE          CYCLE_PROF_ENABLE
+#endif
+
+#if SCHED_STATS_ENABLE && !CYCLE_PROF_ENABLE
+#error "SCHED_STATS_ENABLE times tasks with cycle_prof, build with CYCLE_PROF_ENABLE=1"
+#endif
+
+typedef void (*sched_fn_t)(void *arg);
+
+struct sched_stats {
+    const char *name;
+    uint32_t runs;
+    uint32_t max;               /*!< longest run, timer counts */
+    uint64_t sum;               /*!< all runs, timer counts */
+};
+
+int sched_task_add(const char *name, sched_fn_t fn, void *arg, uint32_t period_ms);
+void sched_signal(int id);
+void sched_defer(int id, uint32_t delay_ms);
+void sched_run_once(void);
+void sched_run(void) __attribute__((noreturn));
+void sched_idle(void);
+int sched_get_stats(int id, struct sched_stats *stats);
+uint32_t sched_elapsed_ms(void);
+void sched_stats_clear(void);
+void sched_report(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SCHED_H */
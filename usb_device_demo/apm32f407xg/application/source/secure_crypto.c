@@ -0,0 +1,202 @@
+/**
+  * @file    secure_crypto.c
+  * @author  LuckkMaker
+  * @brief   AES-128-CTR for the secure upload, CRYP by DMA or software
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * secure_crypto_run() works in place. With the CRYP backend it only starts the
+  * DMA streams and returns, the CPU is free to hash the same data while the
+  * CRYP decrypts it. The OUT stream trails the IN stream by the CRYP FIFO depth,
+  * so in place is safe.
+  *
+  * The CRYP counter keeps running between calls (CRYP_KEYIVCONFIG_ONCE), every
+  * call but the last of a frame must be a multiple of 16 bytes. The last one is
+  * rounded up, the buffer needs 15 bytes of room past len.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "secure_crypto.h"
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+#define SECURE_LOAD_BE32(p)     (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | \
+                                 ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+
+/* Private variables ---------------------------------------------------------*/
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+DMA_HandleTypeDef hdma_cryp_in;
+DMA_HandleTypeDef hdma_cryp_out;
+
+static CRYP_HandleTypeDef hcryp;
+static uint32_t cryp_key[4];
+static uint32_t cryp_iv[4];
+static volatile bool cryp_busy;
+#else
+static uint8_t sw_key[SW_AES128_KEY_SIZE];
+static struct sw_aes128_ctr sw_ctr;
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+void DAL_CRYP_MspInit(CRYP_HandleTypeDef *hcryp) {
+    __DAL_RCM_CRYP_CLK_ENABLE();
+    __DAL_RCM_DMA2_CLK_ENABLE();
+
+    hdma_cryp_in.Instance                   = DMA2_Stream6;
+    hdma_cryp_in.Init.Channel               = DMA_CHANNEL_2;
+    hdma_cryp_in.Init.Direction             = DMA_MEMORY_TO_PERIPH;
+    hdma_cryp_in.Init.PeriphInc             = DMA_PINC_DISABLE;
+    hdma_cryp_in.Init.MemInc                = DMA_MINC_ENABLE;
+    hdma_cryp_in.Init.PeriphDataAlignment   = DMA_PDATAALIGN_WORD;
+    hdma_cryp_in.Init.MemDataAlignment      = DMA_MDATAALIGN_WORD;
+    hdma_cryp_in.Init.Mode                  = DMA_NORMAL;
+    hdma_cryp_in.Init.Priority              = DMA_PRIORITY_HIGH;
+    hdma_cryp_in.Init.FIFOMode              = DMA_FIFOMODE_DISABLE;
+    DAL_DMA_Init(&hdma_cryp_in);
+    __DAL_LINKDMA(hcryp, hdmain, hdma_cryp_in);
+
+    hdma_cryp_out.Instance                  = DMA2_Stream5;
+    hdma_cryp_out.Init.Channel              = DMA_CHANNEL_2;
+    hdma_cryp_out.Init.Direction            = DMA_PERIPH_TO_MEMORY;
+    hdma_cryp_out.Init.PeriphInc            = DMA_PINC_DISABLE;
+    hdma_cryp_out.Init.MemInc               = DMA_MINC_ENABLE;
+    hdma_cryp_out.Init.PeriphDataAlignment  = DMA_PDATAALIGN_WORD;
+    hdma_cryp_out.Init.MemDataAlignment     = DMA_MDATAALIGN_WORD;
+    hdma_cryp_out.Init.Mode                 = DMA_NORMAL;
+    hdma_cryp_out.Init.Priority             = DMA_PRIORITY_HIGH;
+    hdma_cryp_out.Init.FIFOMode             = DMA_FIFOMODE_DISABLE;
+    DAL_DMA_Init(&hdma_cryp_out);
+    __DAL_LINKDMA(hcryp, hdmaout, hdma_cryp_out);
+
+    /* same priority as OTG_FS */
+    DAL_NVIC_SetPriority(SECURE_CRYPTO_DMA_IN_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(SECURE_CRYPTO_DMA_IN_IRQn);
+    DAL_NVIC_SetPriority(SECURE_CRYPTO_DMA_OUT_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(SECURE_CRYPTO_DMA_OUT_IRQn);
+}
+
+void DAL_CRYP_OutCpltCallback(CRYP_HandleTypeDef *hcryp) {
+    (void)hcryp;
+
+    cryp_busy = false;
+}
+
+void DAL_CRYP_ErrorCallback(CRYP_HandleTypeDef *hcryp) {
+    (void)hcryp;
+
+    /* the frame fails on its tag check, nothing else to do */
+    cryp_busy = false;
+}
+#endif
+
+int secure_crypto_init(const uint8_t key[SW_AES128_KEY_SIZE]) {
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+    uint32_t i;
+
+    /* key registers take big-endian words */
+    for (i = 0; i < 4; i++) {
+        cryp_key[i] = SECURE_LOAD_BE32(&key[4 * i]);
+    }
+
+    hcryp.Instance                  = CRYP;
+    hcryp.Init.DataType             = CRYP_DATATYPE_8B;
+    hcryp.Init.KeySize              = CRYP_KEYSIZE_128B;
+    hcryp.Init.pKey                 = cryp_key;
+    hcryp.Init.pInitVect            = cryp_iv;
+    hcryp.Init.Algorithm            = CRYP_AES_CTR;
+    hcryp.Init.DataWidthUnit        = CRYP_DATAWIDTHUNIT_WORD;
+    hcryp.Init.KeyIVConfigSkip      = CRYP_KEYIVCONFIG_ONCE;
+    cryp_busy = false;
+
+    return (DAL_CRYP_Init(&hcryp) == DAL_OK) ? 0 : -1;
+#else
+    memcpy(sw_key, key, SW_AES128_KEY_SIZE);
+
+    return 0;
+#endif
+}
+
+/**
+ * @brief   Load the initial counter of a new frame
+ *
+ * @param   iv   128-bit big-endian counter
+ *
+ * @retval  None
+ */
+void secure_crypto_start(const uint8_t iv[SW_AES_BLOCK_SIZE]) {
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+    uint32_t i;
+
+    while (cryp_busy) {
+    }
+
+    for (i = 0; i < 4; i++) {
+        cryp_iv[i] = SECURE_LOAD_BE32(&iv[4 * i]);
+    }
+
+    /* next DAL_CRYP_Decrypt_DMA loads key and counter again */
+    hcryp.KeyIVConfig = 0U;
+#else
+    sw_aes128_ctr_init(&sw_ctr, sw_key, iv);
+#endif
+}
+
+/**
+ * @brief   Decrypt in place, see file header for the length rules
+ *
+ * @param   buf  word aligned data
+ *
+ * @param   len  byte count
+ *
+ * @retval  0 once started (CRYP) or done (software), -1 on error
+ */
+int secure_crypto_run(uint8_t *buf, uint32_t len) {
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+    uint32_t words = ((len + SW_AES_BLOCK_SIZE - 1U) & ~(SW_AES_BLOCK_SIZE - 1U)) / 4U;
+
+    if ((len == 0) || (words > 0xFFFFU) || cryp_busy) {
+        return -1;
+    }
+
+    cryp_busy = true;
+    if (DAL_CRYP_Decrypt_DMA(&hcryp, (uint32_t *)buf, (uint16_t)words, (uint32_t *)buf) != DAL_OK) {
+        cryp_busy = false;
+        return -1;
+    }
+#else
+    sw_aes128_ctr_crypt(&sw_ctr, buf, buf, len);
+#endif
+
+    return 0;
+}
+
+bool secure_crypto_busy(void) {
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW)
+    return cryp_busy;
+#else
+    return false;
+#endif
+}
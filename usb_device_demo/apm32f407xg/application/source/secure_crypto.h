@@ -0,0 +1,65 @@
+/**
+  * @file    secure_crypto.h
+  * @author  LuckkMaker
+  * @brief   Header for secure_crypto.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SECURE_CRYPTO_H
+#define SECURE_CRYPTO_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "sw_crypto.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SECURE_CRYPTO_BACKEND_HW    0   /*!< CRYP fed by DMA2, APM32F417 only */
+#define SECURE_CRYPTO_BACKEND_SW    1   /*!< sw_crypto.c on the CPU */
+
+/*!< the CRYP peripheral only exists on APM32F417xx */
+#ifndef SECURE_CRYPTO_BACKEND
+#if defined(CRYP)
+#define SECURE_CRYPTO_BACKEND       SECURE_CRYPTO_BACKEND_HW
+#else
+#define SECURE_CRYPTO_BACKEND       SECURE_CRYPTO_BACKEND_SW
+#endif
+#endif
+
+#if (SECURE_CRYPTO_BACKEND == SECURE_CRYPTO_BACKEND_HW) && !defined(CRYP)
+#error "SECURE_CRYPTO_BACKEND_HW needs the CRYP peripheral (APM32F417xx)"
+#endif
+
+/*!< CRYP_IN is DMA2 stream 6 channel 2, CRYP_OUT is DMA2 stream 5 channel 2 */
+#define SECURE_CRYPTO_DMA_IN_IRQn   DMA2_Stream6_IRQn
+#define SECURE_CRYPTO_DMA_OUT_IRQn  DMA2_Stream5_IRQn
+
+int secure_crypto_init(const uint8_t key[SW_AES128_KEY_SIZE]);
+void secure_crypto_start(const uint8_t iv[SW_AES_BLOCK_SIZE]);
+int secure_crypto_run(uint8_t *buf, uint32_t len);
+bool secure_crypto_busy(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SECURE_CRYPTO_H */
@@ -0,0 +1,90 @@
+/**
+  * @file    secure_frame.h
+  * @author  LuckkMaker
+  * @brief   Frame format of the secure configuration upload
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SECURE_FRAME_H
+#define SECURE_FRAME_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< One upload on the bulk OUT pipe, encrypt-then-MAC:
+ *
+ *     header     32 bytes, see SECURE_FRAME_OFS_*
+ *     payload    length bytes, AES-128-CTR, the counter starts at the nonce
+ *     tag        32 bytes, HMAC-SHA256 over header and encrypted payload
+ *
+ *   The host ends the transfer with a short packet (a zero length packet when
+ *   the frame is a multiple of wMaxPacketSize). The device answers on bulk IN
+ *   with 8 bytes: status and payload length, both little-endian.
+ *
+ *   Shared with tools/secure_pack.c, no target headers here. */
+
+#define SECURE_FRAME_MAGIC          0x47464353U /*!< "SCFG" */
+#define SECURE_FRAME_VERSION        1U
+
+#define SECURE_FRAME_HDR_SIZE       32U
+#define SECURE_FRAME_TAG_SIZE       32U
+#define SECURE_FRAME_NONCE_SIZE     16U
+#define SECURE_FRAME_KEY_SIZE       16U
+#define SECURE_FRAME_STATUS_SIZE    8U
+
+#define SECURE_FRAME_OFS_MAGIC      0U  /*!< u32 */
+#define SECURE_FRAME_OFS_VERSION    4U  /*!< u16 */
+#define SECURE_FRAME_OFS_FLAGS      6U  /*!< u16, 0 */
+#define SECURE_FRAME_OFS_LENGTH     8U  /*!< u32, payload bytes */
+#define SECURE_FRAME_OFS_RESERVED   12U /*!< u32, 0 */
+#define SECURE_FRAME_OFS_NONCE      16U /*!< 16 bytes, never reuse with the same key */
+
+#define SECURE_STATUS_OK            0U
+#define SECURE_STATUS_BAD_HEADER    1U
+#define SECURE_STATUS_TOO_LONG      2U
+#define SECURE_STATUS_BAD_TAG       3U
+#define SECURE_STATUS_CRYPTO_ERROR  4U
+#define SECURE_STATUS_TRUNCATED     5U
+
+/*!< demo keys, replace them (and keep them out of the image) for real use */
+#define SECURE_FRAME_DEMO_ENC_KEY   { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, \
+                                      0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C }
+#define SECURE_FRAME_DEMO_MAC_KEY   { 0x43, 0x68, 0x65, 0x72, 0x72, 0x79, 0x55, 0x53, \
+                                      0x42, 0x2D, 0x53, 0x43, 0x46, 0x47, 0x2D, 0x31 }
+
+static inline uint32_t secure_frame_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void secure_frame_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SECURE_FRAME_H */
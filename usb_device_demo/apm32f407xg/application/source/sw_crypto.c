@@ -0,0 +1,346 @@
+/**
+  * @file    sw_crypto.c
+  * @author  LuckkMaker
+  * @brief   Portable AES-128-CTR, SHA-256 and HMAC-SHA256
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Reference implementation of the secure upload channel. The device uses it
+  * when the CRYP peripheral is missing, tools/secure_pack.c uses it on the host,
+  * so both ends run the same code. Byte oriented AES, no tables besides the
+  * S-box, no data dependent branches in the cipher.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sw_crypto.h"
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define SW_AES128_ROUNDS    10U
+
+/* Private macro -------------------------------------------------------------*/
+#define ROTR32(x, n)        (((x) >> (n)) | ((x) << (32U - (n))))
+#define XTIME(x)            ((uint8_t)(((x) << 1) ^ ((((x) >> 7) & 1U) * 0x1BU)))
+
+/* Private variables ---------------------------------------------------------*/
+static const uint8_t aes_sbox[256] = {
+    0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+    0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+    0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+    0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+    0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+    0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+    0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+    0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+    0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+    0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+    0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+    0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+    0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+    0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+    0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+    0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428A2F98U, 0x71374491U, 0xB5C0FBCFU, 0xE9B5DBA5U, 0x3956C25BU, 0x59F111F1U, 0x923F82A4U, 0xAB1C5ED5U,
+    0xD807AA98U, 0x12835B01U, 0x243185BEU, 0x550C7DC3U, 0x72BE5D74U, 0x80DEB1FEU, 0x9BDC06A7U, 0xC19BF174U,
+    0xE49B69C1U, 0xEFBE4786U, 0x0FC19DC6U, 0x240CA1CCU, 0x2DE92C6FU, 0x4A7484AAU, 0x5CB0A9DCU, 0x76F988DAU,
+    0x983E5152U, 0xA831C66DU, 0xB00327C8U, 0xBF597FC7U, 0xC6E00BF3U, 0xD5A79147U, 0x06CA6351U, 0x14292967U,
+    0x27B70A85U, 0x2E1B2138U, 0x4D2C6DFCU, 0x53380D13U, 0x650A7354U, 0x766A0ABBU, 0x81C2C92EU, 0x92722C85U,
+    0xA2BFE8A1U, 0xA81A664BU, 0xC24B8B70U, 0xC76C51A3U, 0xD192E819U, 0xD6990624U, 0xF40E3585U, 0x106AA070U,
+    0x19A4C116U, 0x1E376C08U, 0x2748774CU, 0x34B0BCB5U, 0x391C0CB3U, 0x4ED8AA4AU, 0x5B9CCA4FU, 0x682E6FF3U,
+    0x748F82EEU, 0x78A5636FU, 0x84C87814U, 0x8CC70208U, 0x90BEFFFAU, 0xA4506CEBU, 0xBEF9A3F7U, 0xC67178F2U
+};
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/********************** AES-128-CTR **************************/
+
+static void sw_aes128_expand(uint8_t rk[176], const uint8_t key[SW_AES128_KEY_SIZE]) {
+    uint8_t rcon = 0x01;
+    uint8_t t[4];
+    uint32_t i;
+
+    memcpy(rk, key, SW_AES128_KEY_SIZE);
+
+    for (i = 16; i < 176; i += 4) {
+        memcpy(t, &rk[i - 4], 4);
+        if ((i % 16) == 0) {
+            uint8_t u = t[0];
+
+            t[0] = (uint8_t)(aes_sbox[t[1]] ^ rcon);
+            t[1] = aes_sbox[t[2]];
+            t[2] = aes_sbox[t[3]];
+            t[3] = aes_sbox[u];
+            rcon = XTIME(rcon);
+        }
+        rk[i + 0] = rk[i - 16] ^ t[0];
+        rk[i + 1] = rk[i - 15] ^ t[1];
+        rk[i + 2] = rk[i - 14] ^ t[2];
+        rk[i + 3] = rk[i - 13] ^ t[3];
+    }
+}
+
+static void sw_aes128_encrypt(const uint8_t rk[176], const uint8_t in[16], uint8_t out[16]) {
+    uint8_t s[16];
+    uint8_t t[16];
+    uint32_t r;
+    uint32_t c;
+    uint32_t i;
+
+    for (i = 0; i < 16; i++) {
+        s[i] = in[i] ^ rk[i];
+    }
+
+    for (r = 1; r <= SW_AES128_ROUNDS; r++) {
+        /* SubBytes and ShiftRows, state is column major */
+        for (i = 0; i < 16; i++) {
+            t[i] = aes_sbox[s[(i + 4U * (i % 4U)) % 16U]];
+        }
+
+        /* MixColumns, skipped in the last round */
+        if (r != SW_AES128_ROUNDS) {
+            for (c = 0; c < 16; c += 4) {
+                uint8_t a0 = t[c], a1 = t[c + 1], a2 = t[c + 2], a3 = t[c + 3];
+                uint8_t x = a0 ^ a1 ^ a2 ^ a3;
+
+                t[c + 0] = a0 ^ x ^ XTIME(a0 ^ a1);
+                t[c + 1] = a1 ^ x ^ XTIME(a1 ^ a2);
+                t[c + 2] = a2 ^ x ^ XTIME(a2 ^ a3);
+                t[c + 3] = a3 ^ x ^ XTIME(a3 ^ a0);
+            }
+        }
+
+        for (i = 0; i < 16; i++) {
+            s[i] = t[i] ^ rk[16U * r + i];
+        }
+    }
+
+    memcpy(out, s, 16);
+}
+
+void sw_aes128_ctr_init(struct sw_aes128_ctr *ctx, const uint8_t key[SW_AES128_KEY_SIZE],
+                        const uint8_t iv[SW_AES_BLOCK_SIZE]) {
+    sw_aes128_expand(ctx->rk, key);
+    memcpy(ctx->ctr, iv, SW_AES_BLOCK_SIZE);
+    ctx->ks_used = SW_AES_BLOCK_SIZE;
+}
+
+/**
+ * @brief   Encrypt or decrypt, consecutive calls continue the keystream
+ *
+ * @param   ctx  cipher context
+ *
+ * @param   in   input bytes
+ *
+ * @param   out  output bytes, may be equal to in
+ *
+ * @param   len  byte count, any length
+ *
+ * @retval  None
+ */
+void sw_aes128_ctr_crypt(struct sw_aes128_ctr *ctx, const uint8_t *in, uint8_t *out, size_t len) {
+    int i;
+
+    while (len--) {
+        if (ctx->ks_used == SW_AES_BLOCK_SIZE) {
+            sw_aes128_encrypt(ctx->rk, ctx->ctr, ctx->ks);
+            ctx->ks_used = 0;
+
+            /* 128-bit big-endian increment, same as the CRYP counter */
+            for (i = SW_AES_BLOCK_SIZE - 1; i >= 0; i--) {
+                if (++ctx->ctr[i] != 0) {
+                    break;
+                }
+            }
+        }
+        *out++ = *in++ ^ ctx->ks[ctx->ks_used++];
+    }
+}
+
+/********************** SHA-256 **************************/
+
+static void sw_sha256_block(uint32_t state[8], const uint8_t *p) {
+    uint32_t w[64];
+    uint32_t a, b, c, d, e, f, g, h;
+    uint32_t t1, t2;
+    uint32_t i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+               ((uint32_t)p[4 * i + 2] << 8) | (uint32_t)p[4 * i + 3];
+    }
+    for (i = 16; i < 64; i++) {
+        t1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        t2 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        w[i] = w[i - 16] + t2 + w[i - 7] + t1;
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3];
+    e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+    for (i = 0; i < 64; i++) {
+        t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sw_sha256_init(struct sw_sha256 *ctx) {
+    ctx->state[0] = 0x6A09E667U;
+    ctx->state[1] = 0xBB67AE85U;
+    ctx->state[2] = 0x3C6EF372U;
+    ctx->state[3] = 0xA54FF53AU;
+    ctx->state[4] = 0x510E527FU;
+    ctx->state[5] = 0x9B05688CU;
+    ctx->state[6] = 0x1F83D9ABU;
+    ctx->state[7] = 0x5BE0CD19U;
+    ctx->total = 0;
+    ctx->buf_len = 0;
+}
+
+void sw_sha256_update(struct sw_sha256 *ctx, const uint8_t *data, size_t len) {
+    size_t n;
+
+    ctx->total += len;
+
+    if (ctx->buf_len) {
+        n = SW_SHA256_BLOCK_SIZE - ctx->buf_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&ctx->buf[ctx->buf_len], data, n);
+        ctx->buf_len += (uint32_t)n;
+        data += n;
+        len -= n;
+        if (ctx->buf_len < SW_SHA256_BLOCK_SIZE) {
+            return;
+        }
+        sw_sha256_block(ctx->state, ctx->buf);
+        ctx->buf_len = 0;
+    }
+
+    /* whole blocks straight from the caller's buffer */
+    while (len >= SW_SHA256_BLOCK_SIZE) {
+        sw_sha256_block(ctx->state, data);
+        data += SW_SHA256_BLOCK_SIZE;
+        len -= SW_SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(ctx->buf, data, len);
+    ctx->buf_len = (uint32_t)len;
+}
+
+void sw_sha256_final(struct sw_sha256 *ctx, uint8_t digest[SW_SHA256_DIGEST_SIZE]) {
+    uint64_t bits = ctx->total * 8U;
+    uint32_t i;
+
+    ctx->buf[ctx->buf_len++] = 0x80;
+    if (ctx->buf_len > (SW_SHA256_BLOCK_SIZE - 8U)) {
+        memset(&ctx->buf[ctx->buf_len], 0, SW_SHA256_BLOCK_SIZE - ctx->buf_len);
+        sw_sha256_block(ctx->state, ctx->buf);
+        ctx->buf_len = 0;
+    }
+    memset(&ctx->buf[ctx->buf_len], 0, SW_SHA256_BLOCK_SIZE - 8U - ctx->buf_len);
+    for (i = 0; i < 8; i++) {
+        ctx->buf[SW_SHA256_BLOCK_SIZE - 1U - i] = (uint8_t)(bits >> (8U * i));
+    }
+    sw_sha256_block(ctx->state, ctx->buf);
+
+    for (i = 0; i < 8; i++) {
+        digest[4 * i + 0] = (uint8_t)(ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)(ctx->state[i]);
+    }
+}
+
+/********************** HMAC-SHA256 **************************/
+
+void sw_hmac_sha256_init(struct sw_hmac_sha256 *ctx, const uint8_t *key, size_t key_len) {
+    uint8_t pad[SW_SHA256_BLOCK_SIZE];
+    uint8_t digest[SW_SHA256_DIGEST_SIZE];
+    uint32_t i;
+
+    if (key_len > SW_SHA256_BLOCK_SIZE) {
+        sw_sha256_init(&ctx->inner);
+        sw_sha256_update(&ctx->inner, key, key_len);
+        sw_sha256_final(&ctx->inner, digest);
+        key = digest;
+        key_len = SW_SHA256_DIGEST_SIZE;
+    }
+
+    memset(pad, 0, sizeof(pad));
+    memcpy(pad, key, key_len);
+
+    for (i = 0; i < SW_SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36;
+    }
+    sw_sha256_init(&ctx->inner);
+    sw_sha256_update(&ctx->inner, pad, SW_SHA256_BLOCK_SIZE);
+
+    for (i = 0; i < SW_SHA256_BLOCK_SIZE; i++) {
+        pad[i] ^= 0x36 ^ 0x5C;
+    }
+    sw_sha256_init(&ctx->outer);
+    sw_sha256_update(&ctx->outer, pad, SW_SHA256_BLOCK_SIZE);
+
+    memset(pad, 0, sizeof(pad));
+}
+
+void sw_hmac_sha256_update(struct sw_hmac_sha256 *ctx, const uint8_t *data, size_t len) {
+    sw_sha256_update(&ctx->inner, data, len);
+}
+
+void sw_hmac_sha256_final(struct sw_hmac_sha256 *ctx, uint8_t mac[SW_SHA256_DIGEST_SIZE]) {
+    uint8_t digest[SW_SHA256_DIGEST_SIZE];
+
+    sw_sha256_final(&ctx->inner, digest);
+    sw_sha256_update(&ctx->outer, digest, SW_SHA256_DIGEST_SIZE);
+    sw_sha256_final(&ctx->outer, mac);
+}
+
+/**
+ * @brief   Compare without an early exit, for MAC checks
+ *
+ * @param   a    first buffer
+ *
+ * @param   b    second buffer
+ *
+ * @param   len  byte count
+ *
+ * @retval  0 if equal
+ */
+int sw_crypto_memcmp(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint8_t diff = 0;
+
+    while (len--) {
+        diff |= *a++ ^ *b++;
+    }
+
+    return diff;
+}
@@ -0,0 +1,80 @@
+/**
+  * @file    sw_crypto.h
+  * @author  LuckkMaker
+  * @brief   Header for sw_crypto.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef SW_CRYPTO_H
+#define SW_CRYPTO_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< no target headers here, tools/secure_pack.c builds this file on the host */
+
+#define SW_AES_BLOCK_SIZE       16U
+#define SW_AES128_KEY_SIZE      16U
+#define SW_SHA256_BLOCK_SIZE    64U
+#define SW_SHA256_DIGEST_SIZE   32U
+
+/*!< AES-128 in counter mode, the counter is the big-endian 128-bit IV */
+struct sw_aes128_ctr {
+    uint8_t rk[176];                    /*!< expanded encryption key, 11 round keys */
+    uint8_t ctr[SW_AES_BLOCK_SIZE];     /*!< next counter block */
+    uint8_t ks[SW_AES_BLOCK_SIZE];      /*!< keystream of the previous counter block */
+    uint32_t ks_used;                   /*!< keystream bytes consumed, 16 when empty */
+};
+
+struct sw_sha256 {
+    uint32_t state[8];
+    uint64_t total;
+    uint8_t buf[SW_SHA256_BLOCK_SIZE];
+    uint32_t buf_len;
+};
+
+struct sw_hmac_sha256 {
+    struct sw_sha256 inner;
+    struct sw_sha256 outer;
+};
+
+void sw_aes128_ctr_init(struct sw_aes128_ctr *ctx, const uint8_t key[SW_AES128_KEY_SIZE],
+                        const uint8_t iv[SW_AES_BLOCK_SIZE]);
+void sw_aes128_ctr_crypt(struct sw_aes128_ctr *ctx, const uint8_t *in, uint8_t *out, size_t len);
+
+void sw_sha256_init(struct sw_sha256 *ctx);
+void sw_sha256_update(struct sw_sha256 *ctx, const uint8_t *data, size_t len);
+void sw_sha256_final(struct sw_sha256 *ctx, uint8_t digest[SW_SHA256_DIGEST_SIZE]);
+
+void sw_hmac_sha256_init(struct sw_hmac_sha256 *ctx, const uint8_t *key, size_t key_len);
+void sw_hmac_sha256_update(struct sw_hmac_sha256 *ctx, const uint8_t *data, size_t len);
+void sw_hmac_sha256_final(struct sw_hmac_sha256 *ctx, uint8_t mac[SW_SHA256_DIGEST_SIZE]);
+
+int sw_crypto_memcmp(const uint8_t *a, const uint8_t *b, size_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* SW_CRYPTO_H */
@@ -0,0 +1,380 @@
+/**
+  * @file    uart_log.c
+  * @author  LuckkMaker
+  * @brief   Buffered stdout on the USART, drained by DMA
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * _write() copies into a byte ring and returns, the contiguous part of the
+  * ring behind the read side is sent with DAL_UART_Transmit_DMA(). The half
+  * transfer interrupt gives the first half of a transfer back to writers, the
+  * transfer complete interrupt the rest, then starts the next part.
+  *
+  * The ring is only touched with interrupts masked, for the length of a
+  * memcpy, so _write() may be called from any context. Whether printf itself
+  * may is up to the C library, DLOG() is the interrupt safe way to log.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "uart_log.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <stdbool.h>
+#include <string.h>
+#include "dlog.h"
+
+#if UART_LOG_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+#if (UART_LOG_BUF_SIZE & (UART_LOG_BUF_SIZE - 1U)) || (UART_LOG_BUF_SIZE > 0x8000U)
+#error "UART_LOG_BUF_SIZE must be a power of two, up to 32 KB"
+#endif
+
+#define UART_LOG_MASK               (UART_LOG_BUF_SIZE - 1U)
+
+/* Private macro -------------------------------------------------------------*/
+#define UART_LOG_LOCK(m)            do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define UART_LOG_UNLOCK(m)          __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+UART_HandleTypeDef huart_log;
+DMA_HandleTypeDef hdma_uart_log_tx;
+
+static uint8_t log_buf[UART_LOG_BUF_SIZE];
+/*!< free running: tail <= dma_pos <= head, [tail, dma_pos) is with the DMA */
+static volatile uint32_t log_head;
+static volatile uint32_t log_tail;
+static uint32_t log_dma_pos;
+static uint32_t log_dma_len;
+static uint32_t log_dma_released;
+static volatile bool log_busy;
+static bool log_ready;
+static struct uart_log_stats log_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/*!< called with interrupts masked */
+static void uart_log_kick(void) {
+    uint32_t len;
+    uint32_t off;
+
+    if (log_busy || (log_dma_pos == log_head)) {
+        return;
+    }
+
+    off = log_dma_pos & UART_LOG_MASK;
+    len = log_head - log_dma_pos;
+    if (len > (UART_LOG_BUF_SIZE - off)) {
+        len = UART_LOG_BUF_SIZE - off;
+    }
+
+    if (DAL_UART_Transmit_DMA(&huart_log, &log_buf[off], (uint16_t)len) != DAL_OK) {
+        return;
+    }
+
+    log_busy = true;
+    log_dma_len = len;
+    log_dma_released = 0;
+    log_dma_pos += len;
+    log_stats.dma_starts++;
+}
+
+#if (UART_LOG_POLICY == UART_LOG_POLICY_OVERWRITE)
+/*!< called with interrupts masked, the oldest queued bytes make room */
+static void uart_log_overwrite(uint32_t need) {
+    uint32_t keep;
+    uint32_t i;
+
+    keep = log_head - log_dma_pos - need;
+    for (i = 0; i < keep; i++) {
+        log_buf[(log_dma_pos + i) & UART_LOG_MASK] = log_buf[(log_dma_pos + need + i) & UART_LOG_MASK];
+    }
+    log_head -= need;
+    log_stats.overwritten += need;
+}
+#endif /* UART_LOG_POLICY */
+
+static void uart_log_copy(const uint8_t *data, uint32_t len) {
+    uint32_t off = log_head & UART_LOG_MASK;
+    uint32_t first = UART_LOG_BUF_SIZE - off;
+    uint32_t used;
+
+    if (first > len) {
+        first = len;
+    }
+    memcpy(&log_buf[off], data, first);
+    memcpy(&log_buf[0], data + first, len - first);
+
+    log_head += len;
+    log_stats.written += len;
+    used = log_head - log_tail;
+    if (used > log_stats.peak) {
+        log_stats.peak = used;
+    }
+}
+
+void DAL_UART_MspInit(UART_HandleTypeDef *huart) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    if (huart->Instance != UART_LOG_USART) {
+        return;
+    }
+
+    UART_LOG_CLK_ENABLE();
+
+    /* USART TX pin configuration */
+    GPIO_InitStruct.Pin         = UART_LOG_TX_PIN;
+    GPIO_InitStruct.Mode        = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull        = GPIO_PULLUP;
+    GPIO_InitStruct.Speed       = GPIO_SPEED_FREQ_HIGH;
+    GPIO_InitStruct.Alternate   = UART_LOG_TX_AF;
+    DAL_GPIO_Init(UART_LOG_TX_PORT, &GPIO_InitStruct);
+
+    hdma_uart_log_tx.Instance                   = UART_LOG_DMA_STREAM;
+    hdma_uart_log_tx.Init.Channel               = UART_LOG_DMA_CHANNEL;
+    hdma_uart_log_tx.Init.Direction             = DMA_MEMORY_TO_PERIPH;
+    hdma_uart_log_tx.Init.PeriphInc             = DMA_PINC_DISABLE;
+    hdma_uart_log_tx.Init.MemInc                = DMA_MINC_ENABLE;
+    hdma_uart_log_tx.Init.PeriphDataAlignment   = DMA_PDATAALIGN_BYTE;
+    hdma_uart_log_tx.Init.MemDataAlignment      = DMA_MDATAALIGN_BYTE;
+    hdma_uart_log_tx.Init.Mode                  = DMA_NORMAL;
+    hdma_uart_log_tx.Init.Priority              = DMA_PRIORITY_LOW;
+    hdma_uart_log_tx.Init.FIFOMode              = DMA_FIFOMODE_DISABLE;
+    if (DAL_DMA_Init(&hdma_uart_log_tx) != DAL_OK) {
+        DAL_ErrorHandler();
+    }
+    __DAL_LINKDMA(huart, hdmatx, hdma_uart_log_tx);
+
+    /* below USB, the ring lock masks everything anyway */
+    DAL_NVIC_SetPriority(UART_LOG_DMA_IRQn, 2U, 0U);
+    DAL_NVIC_EnableIRQ(UART_LOG_DMA_IRQn);
+    DAL_NVIC_SetPriority(UART_LOG_USART_IRQn, 2U, 0U);
+    DAL_NVIC_EnableIRQ(UART_LOG_USART_IRQn);
+}
+
+/**
+ * @brief   USART and DMA setup, before the first printf
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void uart_log_init(void) {
+    huart_log.Instance          = UART_LOG_USART;
+    huart_log.Init.BaudRate     = UART_LOG_BAUDRATE;
+    huart_log.Init.WordLength   = UART_WORDLENGTH_8B;
+    huart_log.Init.StopBits     = UART_STOPBITS_1;
+    huart_log.Init.Parity       = UART_PARITY_NONE;
+    huart_log.Init.Mode         = UART_MODE_TX;
+    huart_log.Init.HwFlowCtl    = UART_HWCONTROL_NONE;
+    huart_log.Init.OverSampling = UART_OVERSAMPLING_16;
+    if (DAL_UART_Init(&huart_log) != DAL_OK) {
+        DAL_ErrorHandler();
+    }
+
+    log_head = 0;
+    log_tail = 0;
+    log_dma_pos = 0;
+    log_busy = false;
+    memset(&log_stats, 0, sizeof(log_stats));
+    log_ready = true;
+}
+
+/**
+ * @brief   Queue bytes for the USART, applying UART_LOG_POLICY when full
+ *
+ * @param   data   bytes, copied before returning
+ *
+ * @param   len    number of bytes
+ *
+ * @retval  bytes queued
+ */
+uint32_t uart_log_write(const uint8_t *data, uint32_t len) {
+    uint32_t primask;
+    uint32_t room;
+    uint32_t done = 0;
+    uint32_t n;
+
+    if (!log_ready) {
+        return 0;
+    }
+
+    while (done < len) {
+        n = len - done;
+
+        UART_LOG_LOCK(primask);
+        room = UART_LOG_BUF_SIZE - (log_head - log_tail);
+
+#if (UART_LOG_POLICY == UART_LOG_POLICY_OVERWRITE)
+        if (n > room) {
+            /* only bytes not yet with the DMA can go */
+            uint32_t max = UART_LOG_BUF_SIZE - (log_dma_pos - log_tail);
+
+            if (n > max) {
+                log_stats.dropped += n - max;
+                done += n - max;
+                n = max;
+            }
+            if (n > room) {
+                uart_log_overwrite(n - room);
+            }
+            room = n;
+        }
+#elif (UART_LOG_POLICY == UART_LOG_POLICY_BLOCK)
+        if ((n > room) && ((__get_IPSR() != 0U) || (primask != 0U))) {
+            /* nobody would drain the ring while this context waits */
+            log_stats.dropped += n;
+            UART_LOG_UNLOCK(primask);
+            break;
+        }
+#endif /* UART_LOG_POLICY */
+
+        if (n > room) {
+#if (UART_LOG_POLICY == UART_LOG_POLICY_BLOCK)
+            /* whatever fits now, wait for the DMA to free more */
+            n = room;
+#else
+            log_stats.dropped += n;
+            UART_LOG_UNLOCK(primask);
+            break;
+#endif /* UART_LOG_POLICY */
+        }
+
+        uart_log_copy(data + done, n);
+        done += n;
+        uart_log_kick();
+        UART_LOG_UNLOCK(primask);
+    }
+
+    return done;
+}
+
+/**
+ * @brief   Wait until everything queued left the ring, thread mode only
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void uart_log_drain(void) {
+    while (log_busy || (log_tail != log_head)) {
+    }
+}
+
+void uart_log_get_stats(struct uart_log_stats *stats) {
+    uint32_t primask;
+
+    UART_LOG_LOCK(primask);
+    *stats = log_stats;
+    UART_LOG_UNLOCK(primask);
+}
+
+void DAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart) {
+    uint32_t primask;
+    uint32_t half;
+
+    if (huart != &huart_log) {
+        return;
+    }
+
+    UART_LOG_LOCK(primask);
+    half = log_dma_len / 2U;
+    log_tail += half - log_dma_released;
+    log_dma_released = half;
+    UART_LOG_UNLOCK(primask);
+}
+
+void DAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    uint32_t primask;
+
+    if (huart != &huart_log) {
+        return;
+    }
+
+    UART_LOG_LOCK(primask);
+    log_tail = log_dma_pos;
+    log_busy = false;
+    uart_log_kick();
+    UART_LOG_UNLOCK(primask);
+}
+
+void DAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    uint32_t primask;
+
+    if ((huart != &huart_log) || (huart->gState != DAL_UART_STATE_READY)) {
+        return;
+    }
+
+    /* the transfer was stopped, its bytes are given up */
+    UART_LOG_LOCK(primask);
+    if (log_busy) {
+        log_stats.errors++;
+        log_tail = log_dma_pos;
+        log_busy = false;
+    }
+    uart_log_kick();
+    UART_LOG_UNLOCK(primask);
+}
+
+/**
+ * @brief   stdout and stderr, replaces the __io_putchar() loop of syscalls.c
+ *
+ * @param   file   ignored
+ *
+ * @param   ptr    bytes
+ *
+ * @param   len    number of bytes
+ *
+ * @retval  len, bytes the policy drops are not reported to the C library
+ */
+int _write(int file, char *ptr, int len) {
+    (void)file;
+
+    if (len > 0) {
+        uart_log_write((const uint8_t *)ptr, (uint32_t)len);
+    }
+    return len;
+}
+
+/**
+ * @brief   Binary records of dlog.c, interleaved with stdout
+ */
+void dlog_sink(const uint8_t *data, uint32_t len) {
+    uart_log_write(data, len);
+}
+
+#else
+
+void uart_log_init(void) {
+}
+
+uint32_t uart_log_write(const uint8_t *data, uint32_t len) {
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+void uart_log_drain(void) {
+}
+
+void uart_log_get_stats(struct uart_log_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* UART_LOG_ENABLE */
@@ -0,0 +1,94 @@
+/**
+  * @file    uart_log.h
+  * @author  LuckkMaker
+  * @brief   Header for uart_log.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef UART_LOG_H
+#define UART_LOG_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< stdout and the binary dlog sink go to the UART, 0 keeps syscalls.c */
+#ifndef UART_LOG_ENABLE
+#define UART_LOG_ENABLE             1
+#endif
+
+#define UART_LOG_POLICY_DROP        0   /*!< a write that does not fit is dropped whole */
+#define UART_LOG_POLICY_BLOCK       1   /*!< wait for room, drops instead from an interrupt */
+#define UART_LOG_POLICY_OVERWRITE   2   /*!< the oldest bytes not yet handed to the DMA make room */
+
+#ifndef UART_LOG_POLICY
+#define UART_LOG_POLICY             UART_LOG_POLICY_DROP
+#endif
+
+/*!< ring size in bytes, a power of two */
+#ifndef UART_LOG_BUF_SIZE
+#define UART_LOG_BUF_SIZE           2048U
+#endif
+
+#ifndef UART_LOG_BAUDRATE
+#define UART_LOG_BAUDRATE           115200U
+#endif
+
+/*!< USART1 TX on PA9, the debug header of the board, on DMA2 stream 7 channel 4 */
+#ifndef UART_LOG_USART
+#define UART_LOG_USART              USART1
+#define UART_LOG_USART_IRQn         USART1_IRQn
+#define UART_LOG_TX_PORT            GPIOA
+#define UART_LOG_TX_PIN             GPIO_PIN_9
+#define UART_LOG_TX_AF              GPIO_AF7_USART1
+#define UART_LOG_DMA_STREAM         DMA2_Stream7
+#define UART_LOG_DMA_CHANNEL        DMA_CHANNEL_4
+#define UART_LOG_DMA_IRQn           DMA2_Stream7_IRQn
+#define UART_LOG_CLK_ENABLE()       do { __DAL_RCM_GPIOA_CLK_ENABLE(); \
+                                         __DAL_RCM_USART1_CLK_ENABLE(); \
+                                         __DAL_RCM_DMA2_CLK_ENABLE(); } while (0)
+#endif
+
+struct uart_log_stats {
+    uint32_t written;           /*!< bytes queued */
+    uint32_t dropped;           /*!< bytes refused */
+    uint32_t overwritten;       /*!< queued bytes discarded by UART_LOG_POLICY_OVERWRITE */
+    uint32_t dma_starts;        /*!< transfers started */
+    uint32_t errors;            /*!< transfers that failed, their bytes are lost */
+    uint32_t peak;              /*!< highest ring fill in bytes */
+};
+
+#if UART_LOG_ENABLE
+extern UART_HandleTypeDef huart_log;
+extern DMA_HandleTypeDef hdma_uart_log_tx;
+#endif
+
+void uart_log_init(void);
+uint32_t uart_log_write(const uint8_t *data, uint32_t len);
+void uart_log_drain(void);
+void uart_log_get_stats(struct uart_log_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* UART_LOG_H */
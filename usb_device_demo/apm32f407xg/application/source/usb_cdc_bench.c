@@ -0,0 +1,499 @@
+/**
+  * @file    usb_cdc_bench.c
+  * @author  LuckkMaker
+  * @brief   CDC ACM bulk throughput benchmark
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Protocol in cdc_bench_frame.h, host side in tools/cdc_bench.c. Everything
+  * runs in the USB interrupt:
+  *   - IN: two buffers, the next one is filled with the pattern while the
+  *     other one is on the bus,
+  *   - OUT: the next read is armed on the other buffer before the received
+  *     one is checked,
+  *   - LOOP: one buffer, checked then echoed, the next read is armed once
+  *     the echo is out.
+  * A break from the host (tcsendbreak) abandons the run, the device is then
+  * idle again and waits for a command.
+  *
+  * With CDC_BENCH_HP_STREAM the IN endpoint is handed to usbd_fsdev_hp.c
+  * once configured, the completions still arrive in the USB (LP) interrupt.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_cdc_bench.h"
+
+#if (DEMO_SELECT == DEMO_CDC_BENCH)
+
+/* Private includes ----------------------------------------------------------*/
+#include "usbd_cdc.h"
+#include "usbd_ep_static.h"
+#if CDC_BENCH_HP_STREAM
+#include "usbd_fsdev_hp.h"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+enum usb_cdc_bench_state {
+    CDC_BENCH_IDLE = 0,         /*!< waiting for a command */
+    CDC_BENCH_RUN,              /*!< pattern on the bus */
+    CDC_BENCH_RESULT            /*!< result on the bus */
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USBD_VID           0x314B
+#define USBD_PID           0xF005
+#define USBD_MAX_POWER     100
+#define USBD_LANGID_STRING 1033
+
+/*!< endpoint address */
+#if CDC_BENCH_HP_STREAM
+/*!< an endpoint register of its own, double buffering takes both halves */
+#define CDC_IN_EP          0x82
+#else
+#define CDC_IN_EP          0x81
+#endif
+#define CDC_OUT_EP         0x01
+#define CDC_INT_EP         0x83
+
+#ifdef CONFIG_USB_HS
+#define CDC_MAX_MPS        512
+#else
+#define CDC_MAX_MPS        64
+#endif
+
+/*!< registered endpoints, described by CDC_ACM_DESCRIPTOR_INIT */
+#define CDC_BENCH_EP_LIST(EP) \
+    EP(CDC_OUT_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usb_cdc_bench_bulk_out) \
+    EP(CDC_IN_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usb_cdc_bench_bulk_in)
+
+/*!< config descriptor size */
+#define USB_CONFIG_SIZE    (9 + CDC_ACM_DESCRIPTOR_LEN)
+
+#if (CDC_BENCH_BUF_SIZE < CDC_MAX_MPS) || (CDC_BENCH_BUF_SIZE > 0xFFFFU)
+#error "CDC_BENCH_BUF_SIZE must hold a packet and fit the command"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/*!< global descriptor */
+static const uint8_t usb_cdc_bench_descriptor[] = {
+    USB_DEVICE_DESCRIPTOR_INIT(USB_2_0, 0xEF, 0x02, 0x01, USBD_VID, USBD_PID, 0x0100, 0x01),
+    USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, 0x02, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
+    CDC_ACM_DESCRIPTOR_INIT(0x00, CDC_INT_EP, CDC_OUT_EP, CDC_IN_EP, CDC_MAX_MPS, 0x02),
+    ///////////////////////////////////////
+    /// string0 descriptor
+    ///////////////////////////////////////
+    USB_LANGID_INIT(USBD_LANGID_STRING),
+    ///////////////////////////////////////
+    /// string1 descriptor
+    ///////////////////////////////////////
+    0x14,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ///////////////////////////////////////
+    /// string2 descriptor
+    ///////////////////////////////////////
+    0x20,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ' ', 0x00,                  /* wcChar9 */
+    'B', 0x00,                  /* wcChar10 */
+    'E', 0x00,                  /* wcChar11 */
+    'N', 0x00,                  /* wcChar12 */
+    'C', 0x00,                  /* wcChar13 */
+    'H', 0x00,                  /* wcChar14 */
+    ///////////////////////////////////////
+    /// string3 descriptor
+    ///////////////////////////////////////
+    0x16,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '2', 0x00,                  /* wcChar0 */
+    '0', 0x00,                  /* wcChar1 */
+    '2', 0x00,                  /* wcChar2 */
+    '4', 0x00,                  /* wcChar3 */
+    '1', 0x00,                  /* wcChar4 */
+    '2', 0x00,                  /* wcChar5 */
+    '3', 0x00,                  /* wcChar6 */
+    '4', 0x00,                  /* wcChar7 */
+    '5', 0x00,                  /* wcChar8 */
+    '8', 0x00,                  /* wcChar9 */
+#ifdef CONFIG_USB_HS
+    ///////////////////////////////////////
+    /// device qualifier descriptor
+    ///////////////////////////////////////
+    0x0a,
+    USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER,
+    0x00,
+    0x02,
+    0x02,
+    0x02,
+    0x01,
+    0x40,
+    0x01,
+    0x00,
+#endif
+    0x00
+};
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t bench_buf[2][CDC_BENCH_BUF_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t bench_res[CDC_BENCH_RES_SIZE];
+
+static struct cdc_line_coding bench_line_coding = {
+    .dwDTERate = 115200,
+    .bCharFormat = 0,
+    .bParityType = 0,
+    .bDataBits = 8
+};
+
+static uint8_t bench_busid;
+#if CDC_BENCH_HP_STREAM
+static uint32_t bench_reg_base;
+#endif
+static enum usb_cdc_bench_state bench_state;
+static uint8_t bench_mode;
+static uint32_t bench_xfer;             /*!< IN transfer size */
+static uint32_t bench_read;             /*!< OUT transfer size, whole packets */
+static uint32_t bench_mps;
+static uint32_t bench_length;
+static uint32_t bench_left;             /*!< pattern bytes not yet sent or checked */
+static uint32_t bench_errors;
+static uint32_t bench_first;
+static struct cdc_bench_pattern bench_pat;
+
+static uint32_t out_cur;                /*!< buffer of the armed or last read */
+static bool out_armed;
+static bool in_busy;
+static bool in_zlp;
+static uint32_t in_cur;                 /*!< buffer on the bus */
+static uint32_t in_next;                /*!< bytes ready in the other buffer */
+
+static struct usb_cdc_bench_stats bench_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void usb_cdc_bench_arm(uint32_t buf, uint32_t len) {
+    out_cur = buf;
+    out_armed = true;
+    usbd_ep_start_read(bench_busid, CDC_OUT_EP, bench_buf[buf], len);
+}
+
+static void usb_cdc_bench_write(uint8_t *buf, uint32_t len) {
+#if CDC_BENCH_HP_STREAM
+    usbd_fsdev_hp_in_write(buf, len);
+#else
+    usbd_ep_start_write(bench_busid, CDC_IN_EP, buf, len);
+#endif
+}
+
+static void usb_cdc_bench_send(uint8_t *buf, uint32_t len) {
+    in_busy = true;
+    usb_cdc_bench_write(buf, len);
+}
+
+/*!< the host sends no ZLP, a read must not wait for more than is left */
+static uint32_t usb_cdc_bench_read_len(uint32_t left) {
+    uint32_t len = ((left + bench_mps - 1U) / bench_mps) * bench_mps;
+
+    return (len < bench_read) ? len : bench_read;
+}
+
+static uint32_t usb_cdc_bench_fill(uint32_t buf) {
+    uint32_t n = (bench_left > bench_xfer) ? bench_xfer : bench_left;
+
+    cdc_bench_pattern_fill(&bench_pat, bench_buf[buf], n);
+    bench_left -= n;
+    return n;
+}
+
+static void usb_cdc_bench_check(const uint8_t *buf, uint32_t len) {
+    uint32_t first = 0;
+    uint32_t errors;
+
+    if (len > bench_left) {
+        len = bench_left;
+    }
+
+    errors = cdc_bench_pattern_check(&bench_pat, buf, len, &first);
+    if (errors && (bench_errors == 0)) {
+        bench_first = bench_length - bench_left + first;
+    }
+    bench_errors += errors;
+    bench_left -= len;
+}
+
+static void usb_cdc_bench_result(void) {
+    uint32_t done = bench_length - bench_left;
+
+    cdc_bench_put32(&bench_res[CDC_BENCH_RES_OFS_MAGIC], CDC_BENCH_RES_MAGIC);
+    cdc_bench_put32(&bench_res[CDC_BENCH_RES_OFS_MODE], bench_mode);
+    cdc_bench_put32(&bench_res[CDC_BENCH_RES_OFS_BYTES], done);
+    cdc_bench_put32(&bench_res[CDC_BENCH_RES_OFS_ERRORS], bench_errors);
+    cdc_bench_put32(&bench_res[CDC_BENCH_RES_OFS_FIRST], bench_first);
+
+    if (bench_mode == CDC_BENCH_MODE_IN) {
+        bench_stats.bytes_in += done;
+    } else {
+        bench_stats.bytes_out += done;
+        if (bench_mode == CDC_BENCH_MODE_LOOP) {
+            bench_stats.bytes_in += done;
+        }
+    }
+    bench_stats.errors += bench_errors;
+    bench_stats.runs++;
+
+    bench_state = CDC_BENCH_RESULT;
+    usb_cdc_bench_send(bench_res, CDC_BENCH_RES_SIZE);
+}
+
+static void usb_cdc_bench_idle(void) {
+    bench_state = CDC_BENCH_IDLE;
+    if (!out_armed && !in_busy) {
+        usb_cdc_bench_arm(0, CDC_BENCH_BUF_SIZE);
+    }
+}
+
+static void usb_cdc_bench_start(const uint8_t *cmd, uint32_t len) {
+    if ((len != CDC_BENCH_CMD_SIZE) ||
+        (cdc_bench_get32(&cmd[CDC_BENCH_CMD_OFS_MAGIC]) != CDC_BENCH_CMD_MAGIC) ||
+        (cmd[CDC_BENCH_CMD_OFS_MODE] < CDC_BENCH_MODE_IN) ||
+        (cmd[CDC_BENCH_CMD_OFS_MODE] > CDC_BENCH_MODE_LOOP) ||
+        (cdc_bench_get32(&cmd[CDC_BENCH_CMD_OFS_LENGTH]) == 0)) {
+        bench_stats.bad_commands++;
+        usb_cdc_bench_arm(out_cur, CDC_BENCH_BUF_SIZE);
+        return;
+    }
+
+    bench_mode = cmd[CDC_BENCH_CMD_OFS_MODE];
+    bench_xfer = (uint32_t)cmd[CDC_BENCH_CMD_OFS_XFER] | ((uint32_t)cmd[CDC_BENCH_CMD_OFS_XFER + 1] << 8);
+    if ((bench_xfer == 0) || (bench_xfer > CDC_BENCH_BUF_SIZE)) {
+        bench_xfer = CDC_BENCH_BUF_SIZE;
+    }
+    bench_mps = usbd_get_ep_mps(bench_busid, CDC_OUT_EP);
+    bench_read = (bench_xfer < bench_mps) ? bench_mps : (bench_xfer - (bench_xfer % bench_mps));
+    bench_length = cdc_bench_get32(&cmd[CDC_BENCH_CMD_OFS_LENGTH]);
+    bench_left = bench_length;
+    bench_errors = 0;
+    bench_first = CDC_BENCH_NO_ERROR;
+    cdc_bench_pattern_init(&bench_pat, cdc_bench_get32(&cmd[CDC_BENCH_CMD_OFS_SEED]));
+    bench_state = CDC_BENCH_RUN;
+
+    if (bench_mode == CDC_BENCH_MODE_IN) {
+        in_cur = 0;
+        usb_cdc_bench_send(bench_buf[0], usb_cdc_bench_fill(0));
+        in_next = bench_left ? usb_cdc_bench_fill(1) : 0;
+    } else {
+        usb_cdc_bench_arm(0, usb_cdc_bench_read_len(bench_left));
+    }
+}
+
+/********************** USB side **************************/
+
+#if CDC_BENCH_HP_STREAM
+static void usb_cdc_bench_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes);
+
+static void usb_cdc_bench_hp_in(uint32_t nbytes) {
+    usb_cdc_bench_bulk_in(bench_busid, CDC_IN_EP, nbytes);
+}
+#endif
+
+static void usb_cdc_bench_event_handler(uint8_t busid, uint8_t event) {
+    switch (event) {
+        case USBD_EVENT_RESET:
+        case USBD_EVENT_DISCONNECTED:
+#if CDC_BENCH_HP_STREAM
+            usbd_fsdev_hp_in_close();
+#endif
+            bench_state = CDC_BENCH_IDLE;
+            out_armed = false;
+            in_busy = false;
+            break;
+        case USBD_EVENT_CONFIGURED:
+#if CDC_BENCH_HP_STREAM
+            usbd_fsdev_hp_in_open((USBD_T *)bench_reg_base, CDC_IN_EP,
+                                  usbd_get_ep_mps(busid, CDC_IN_EP), usb_cdc_bench_hp_in);
+#endif
+            in_zlp = false;
+            usb_cdc_bench_idle();
+            break;
+        default:
+            break;
+    }
+}
+
+static int usb_cdc_bench_class_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len) {
+    ARG_UNUSED(busid);
+
+    switch (setup->bRequest) {
+        case CDC_REQUEST_SET_LINE_CODING:
+            /* accepted and ignored, the pipe runs at bus speed */
+            memcpy(&bench_line_coding, *data, MIN(*len, sizeof(bench_line_coding)));
+            *len = 0;
+            return 0;
+        case CDC_REQUEST_GET_LINE_CODING:
+            *data = (uint8_t *)&bench_line_coding;
+            *len = sizeof(bench_line_coding);
+            return 0;
+        case CDC_REQUEST_SET_CONTROL_LINE_STATE:
+            *len = 0;
+            return 0;
+        case CDC_REQUEST_SEND_BREAK:
+            if (bench_state == CDC_BENCH_RUN) {
+                bench_stats.aborts++;
+                usb_cdc_bench_idle();
+            }
+            *len = 0;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static void usb_cdc_bench_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    uint32_t buf = out_cur;
+
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+
+    out_armed = false;
+
+    switch (bench_state) {
+        case CDC_BENCH_IDLE:
+            usb_cdc_bench_start(bench_buf[buf], nbytes);
+            break;
+
+        case CDC_BENCH_RUN:
+            if (bench_mode == CDC_BENCH_MODE_OUT) {
+                if (nbytes < bench_left) {
+                    usb_cdc_bench_arm(buf ^ 1U, usb_cdc_bench_read_len(bench_left - nbytes));
+                }
+                usb_cdc_bench_check(bench_buf[buf], nbytes);
+                if (bench_left == 0) {
+                    usb_cdc_bench_result();
+                }
+            } else {
+                usb_cdc_bench_check(bench_buf[buf], nbytes);
+                usb_cdc_bench_send(bench_buf[buf], nbytes);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void usb_cdc_bench_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    ARG_UNUSED(ep);
+
+    if ((bench_state == CDC_BENCH_RUN) && (bench_mode == CDC_BENCH_MODE_LOOP) &&
+        !in_zlp && nbytes && ((nbytes % usbd_get_ep_mps(busid, CDC_IN_EP)) == 0)) {
+        /* the echo ends with a short packet, the host read may be larger */
+        in_zlp = true;
+        usb_cdc_bench_write(NULL, 0);
+        return;
+    }
+
+    in_zlp = false;
+    in_busy = false;
+
+    switch (bench_state) {
+        case CDC_BENCH_RUN:
+            if (bench_mode == CDC_BENCH_MODE_IN) {
+                if (in_next == 0) {
+                    usb_cdc_bench_result();
+                    break;
+                }
+                in_cur ^= 1U;
+                usb_cdc_bench_send(bench_buf[in_cur], in_next);
+                in_next = bench_left ? usb_cdc_bench_fill(in_cur ^ 1U) : 0;
+            } else if (bench_left == 0) {
+                usb_cdc_bench_result();
+            } else {
+                usb_cdc_bench_arm(0, usb_cdc_bench_read_len(bench_left));
+            }
+            break;
+
+        case CDC_BENCH_RESULT:
+        case CDC_BENCH_IDLE:
+            /* result out, or the tail of an abandoned run */
+            usb_cdc_bench_idle();
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*!< endpoint call back */
+USBD_EP_STATIC_TABLE(cdc_bench_eps, CDC_BENCH_EP_LIST);
+
+static struct usbd_interface cdc_bench_intf0 = {
+    .class_interface_handler = usb_cdc_bench_class_handler
+};
+
+static struct usbd_interface cdc_bench_intf1;
+
+/**
+ * @brief   Register the benchmark device and start the stack
+ *
+ * @param   busid     USB bus
+ *
+ * @param   reg_base  USB peripheral base address
+ *
+ * @retval  usbd_initialize() result
+ */
+int usb_cdc_bench_init(uint8_t busid, uint32_t reg_base) {
+    bench_busid = busid;
+#if CDC_BENCH_HP_STREAM
+    bench_reg_base = reg_base;
+#endif
+    bench_state = CDC_BENCH_IDLE;
+    memset(&bench_stats, 0, sizeof(bench_stats));
+
+    usbd_desc_register(busid, usb_cdc_bench_descriptor);
+    usbd_add_interface(busid, &cdc_bench_intf0);
+    usbd_add_interface(busid, &cdc_bench_intf1);
+    usbd_ep_static_register(busid, cdc_bench_eps, USBD_EP_STATIC_COUNT(cdc_bench_eps));
+
+    return usbd_initialize(busid, reg_base, usb_cdc_bench_event_handler);
+}
+
+void usb_cdc_bench_get_stats(struct usb_cdc_bench_stats *stats) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = bench_stats;
+    __set_PRIMASK(primask);
+}
+
+#endif /* DEMO_SELECT == DEMO_CDC_BENCH */
@@ -0,0 +1,69 @@
+/**
+  * @file    usb_cdc_bench.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_cdc_bench.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_CDC_BENCH_H
+#define USB_CDC_BENCH_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+#include "cdc_bench_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< largest device transfer, two buffers of it */
+#ifndef CDC_BENCH_BUF_SIZE
+#define CDC_BENCH_BUF_SIZE          2048U
+#endif
+
+/*!< fsdev boards (F103): IN goes through the double buffered endpoint of
+ *   usbd_fsdev_hp.c, refilled from the USB HP vector, 0 runs it through
+ *   CherryUSB from the LP vector, to compare the two with tools/cdc_bench */
+#ifndef CDC_BENCH_HP_STREAM
+#define CDC_BENCH_HP_STREAM         0
+#endif
+
+#if CDC_BENCH_HP_STREAM
+#error "CDC_BENCH_HP_STREAM requires the fsdev DCD"
+#endif
+
+/*!< totals since power up */
+struct usb_cdc_bench_stats {
+    uint32_t runs;              /*!< results sent */
+    uint32_t aborts;            /*!< runs stopped by a break from the host */
+    uint32_t bad_commands;      /*!< OUT transfers received while idle that were no command */
+    uint32_t bytes_in;          /*!< pattern bytes sent */
+    uint32_t bytes_out;         /*!< pattern bytes checked */
+    uint32_t errors;            /*!< pattern bytes that did not match */
+};
+
+int usb_cdc_bench_init(uint8_t busid, uint32_t reg_base);
+void usb_cdc_bench_get_stats(struct usb_cdc_bench_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_CDC_BENCH_H */
@@ -0,0 +1,618 @@
+/**
+  * @file    usb_dfu.c
+  * @author  LuckkMaker
+  * @brief   DFU 1.1 device with double-buffered download
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * A DNLOAD block is copied into one of two block buffers and queued, the
+  * following GETSTATUS answers dfuDNLOAD-IDLE straight away as long as the other
+  * buffer is free. usb_dfu_poll() programs the queued block from the main loop
+  * while the host is already sending the next one. dfuDNBUSY is only reported
+  * when both buffers are taken, with bwPollTimeout set to the time left on the
+  * block being programmed.
+  *
+  * Sectors are erased ahead of the write pointer: the first block that reaches
+  * into a sector erases all of it, the following blocks of that sector only
+  * program.
+  *
+  * Each block is also pushed through the CRC unit by DMA while it is being
+  * programmed, the image CRC is known as soon as the last block is written.
+  *
+  * Block buffers go from FREE to QUEUED in the USB interrupt and from QUEUED to
+  * BUSY to FREE in usb_dfu_poll(), each transition has one writer.
+  *
+  * Usage: dfu-util -a 0 -D image.bin
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_dfu.h"
+
+#if (DEMO_SELECT == DEMO_DFU)
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define USBD_VID           0x314B
+#define USBD_PID           0xF003
+#define USBD_MAX_POWER     100
+#define USBD_LANGID_STRING 1033
+
+/*!< config descriptor size */
+#define USB_CONFIG_SIZE (9 + 9 + 9)
+
+/*!< DFU class requests */
+#define DFU_REQUEST_DETACH      0x00
+#define DFU_REQUEST_DNLOAD      0x01
+#define DFU_REQUEST_UPLOAD      0x02
+#define DFU_REQUEST_GETSTATUS   0x03
+#define DFU_REQUEST_CLRSTATUS   0x04
+#define DFU_REQUEST_GETSTATE    0x05
+#define DFU_REQUEST_ABORT       0x06
+
+/*!< DFU states */
+#define DFU_STATE_APP_IDLE              0x00
+#define DFU_STATE_APP_DETACH            0x01
+#define DFU_STATE_DFU_IDLE              0x02
+#define DFU_STATE_DFU_DNLOAD_SYNC       0x03
+#define DFU_STATE_DFU_DNBUSY            0x04
+#define DFU_STATE_DFU_DNLOAD_IDLE       0x05
+#define DFU_STATE_DFU_MANIFEST_SYNC     0x06
+#define DFU_STATE_DFU_MANIFEST          0x07
+#define DFU_STATE_DFU_MANIFEST_WAIT_RST 0x08
+#define DFU_STATE_DFU_UPLOAD_IDLE       0x09
+#define DFU_STATE_DFU_ERROR             0x0A
+
+/*!< DFU status */
+#define DFU_STATUS_OK               0x00
+#define DFU_STATUS_ERR_TARGET       0x01
+#define DFU_STATUS_ERR_WRITE        0x03
+#define DFU_STATUS_ERR_ERASE        0x04
+#define DFU_STATUS_ERR_PROG         0x06
+#define DFU_STATUS_ERR_VERIFY       0x07
+#define DFU_STATUS_ERR_ADDRESS      0x08
+#define DFU_STATUS_ERR_NOTDONE      0x09
+#define DFU_STATUS_ERR_STALLEDPKT   0x0F
+
+/*!< bmAttributes: bitCanDnload | bitCanUpload | bitManifestationTolerant */
+#define DFU_ATTRIBUTES              0x07
+
+/*!< block buffer states */
+#define DFU_BLOCK_FREE              0U
+#define DFU_BLOCK_QUEUED            1U
+#define DFU_BLOCK_BUSY              2U
+
+#if (USB_DFU_TRANSFER_SIZE > CONFIG_USBDEV_REQUEST_BUFFER_LEN)
+#error "USB_DFU_TRANSFER_SIZE must fit CONFIG_USBDEV_REQUEST_BUFFER_LEN"
+#endif
+
+#if ((USB_DFU_TRANSFER_SIZE % DFU_FLASH_PROGRAM_ALIGN) != 0)
+#error "USB_DFU_TRANSFER_SIZE must be a multiple of DFU_FLASH_PROGRAM_ALIGN"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define DFU_CYCLES_TO_MS(c)     ((uint32_t)((c) / (SystemCoreClock / 1000U)))
+
+/* Private variables ---------------------------------------------------------*/
+/*!< global descriptor */
+static const uint8_t usb_dfu_descriptor[] = {
+    USB_DEVICE_DESCRIPTOR_INIT(USB_2_0, 0x00, 0x00, 0x00, USBD_VID, USBD_PID, 0x0200, 0x01),
+    USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, 0x01, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
+    /************** Descriptor of DFU interface *****************/
+    0x09,                          /* bLength: Interface Descriptor size */
+    USB_DESCRIPTOR_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+    0x00,                          /* bInterfaceNumber: Number of Interface */
+    0x00,                          /* bAlternateSetting: Alternate setting */
+    0x00,                          /* bNumEndpoints */
+    0xFE,                          /* bInterfaceClass: Application Specific */
+    0x01,                          /* bInterfaceSubClass: Device Firmware Upgrade */
+    0x02,                          /* nInterfaceProtocol: DFU mode */
+    0x00,                          /* iInterface */
+    /******************** Descriptor of DFU functional ********************/
+    0x09,                          /* bLength */
+    0x21,                          /* bDescriptorType: DFU FUNCTIONAL */
+    DFU_ATTRIBUTES,                /* bmAttributes */
+    WBVAL(0x00FF),                 /* wDetachTimeOut */
+    WBVAL(USB_DFU_TRANSFER_SIZE),  /* wTransferSize */
+    WBVAL(0x0110),                 /* bcdDFUVersion */
+    ///////////////////////////////////////
+    /// string0 descriptor
+    ///////////////////////////////////////
+    USB_LANGID_INIT(USBD_LANGID_STRING),
+    ///////////////////////////////////////
+    /// string1 descriptor
+    ///////////////////////////////////////
+    0x14,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ///////////////////////////////////////
+    /// string2 descriptor
+    ///////////////////////////////////////
+    0x1C,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ' ', 0x00,                  /* wcChar9 */
+    'D', 0x00,                  /* wcChar10 */
+    'F', 0x00,                  /* wcChar11 */
+    'U', 0x00,                  /* wcChar12 */
+    ///////////////////////////////////////
+    /// string3 descriptor
+    ///////////////////////////////////////
+    0x16,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '2', 0x00,                  /* wcChar0 */
+    '0', 0x00,                  /* wcChar1 */
+    '2', 0x00,                  /* wcChar2 */
+    '4', 0x00,                  /* wcChar3 */
+    '1', 0x00,                  /* wcChar4 */
+    '2', 0x00,                  /* wcChar5 */
+    '3', 0x00,                  /* wcChar6 */
+    '4', 0x00,                  /* wcChar7 */
+    '5', 0x00,                  /* wcChar8 */
+    '8', 0x00,                  /* wcChar9 */
+#ifdef CONFIG_USB_HS
+    ///////////////////////////////////////
+    /// device qualifier descriptor
+    ///////////////////////////////////////
+    0x0a,
+    USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER,
+    0x00,
+    0x02,
+    0x00,
+    0x00,
+    0x00,
+    0x40,
+    0x01,
+    0x00,
+#endif
+    0x00
+};
+
+/*!< block buffers, one is received while the other is programmed */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t dfu_block_buf[2][USB_DFU_TRANSFER_SIZE];
+static volatile uint8_t dfu_block_state[2];
+static uint32_t dfu_block_addr[2];
+static uint32_t dfu_block_len[2];
+static uint16_t dfu_block_num[2];
+static uint32_t dfu_block_words[2];
+static uint8_t dfu_block_next;
+static uint8_t dfu_block_work;
+
+/*!< protocol state, owned by the USB interrupt */
+static uint8_t dfu_state = DFU_STATE_DFU_IDLE;
+static uint8_t dfu_status = DFU_STATUS_OK;
+
+/*!< requests from the USB interrupt to usb_dfu_poll */
+static volatile uint8_t dfu_error = DFU_STATUS_OK;
+static volatile bool dfu_manifest_req;
+static volatile bool dfu_manifest_done;
+static volatile bool dfu_abort_req;
+static volatile uint32_t dfu_dnload_start;
+static volatile uint32_t dfu_busy_polls;
+
+/*!< programming progress, owned by usb_dfu_poll */
+static volatile uint32_t dfu_busy_start;
+static volatile uint32_t dfu_busy_ms;
+static uint32_t dfu_erase_end;
+static bool dfu_session_active;
+static uint32_t dfu_session_last;
+static uint64_t dfu_session_cycles;
+static uint64_t dfu_erase_cycles;
+static uint64_t dfu_program_cycles;
+
+static struct usb_dfu_stats dfu_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static uint32_t usb_dfu_busy_remaining(void) {
+    uint32_t elapsed = DFU_CYCLES_TO_MS(DWT->CYCCNT - dfu_busy_start);
+
+    return (elapsed < dfu_busy_ms) ? (dfu_busy_ms - elapsed) : 1U;
+}
+
+static void usb_dfu_set_error(uint8_t status) {
+    dfu_status = status;
+    dfu_state = DFU_STATE_DFU_ERROR;
+}
+
+static void usb_dfu_reset(void) {
+    uint8_t i;
+
+    /* blocks queued before an abort or a bus reset never reach the flash */
+    for (i = 0; i < 2; i++) {
+        if (dfu_block_state[i] == DFU_BLOCK_QUEUED) {
+            dfu_block_state[i] = DFU_BLOCK_FREE;
+        }
+    }
+    /* the next block follows the one still being programmed, if any */
+    dfu_block_next = (dfu_block_state[dfu_block_work] == DFU_BLOCK_BUSY) ? (dfu_block_work ^ 1U) : dfu_block_work;
+
+    dfu_state = DFU_STATE_DFU_IDLE;
+    dfu_status = DFU_STATUS_OK;
+    dfu_error = DFU_STATUS_OK;
+    dfu_manifest_req = false;
+    dfu_manifest_done = false;
+    dfu_abort_req = true;
+}
+
+static int usb_dfu_dnload(struct usb_setup_packet *setup, uint8_t *data, uint32_t len) {
+    uint8_t i = dfu_block_next;
+    uint32_t addr;
+
+    if ((dfu_state != DFU_STATE_DFU_IDLE) && (dfu_state != DFU_STATE_DFU_DNLOAD_IDLE)) {
+        usb_dfu_set_error(DFU_STATUS_ERR_STALLEDPKT);
+        return -1;
+    }
+
+    if (setup->wLength == 0) {
+        if (dfu_state == DFU_STATE_DFU_IDLE) {
+            usb_dfu_set_error(DFU_STATUS_ERR_STALLEDPKT);
+            return -1;
+        }
+
+        /* end of image, manifestation is flushing the last block */
+        dfu_manifest_done = false;
+        dfu_manifest_req = true;
+        dfu_state = DFU_STATE_DFU_MANIFEST_SYNC;
+        return 0;
+    }
+
+    addr = DFU_FLASH_BASE + (uint32_t)setup->wValue * USB_DFU_TRANSFER_SIZE;
+    if ((len > USB_DFU_TRANSFER_SIZE) || ((addr + len) > (DFU_FLASH_BASE + DFU_FLASH_SIZE))) {
+        usb_dfu_set_error(DFU_STATUS_ERR_ADDRESS);
+        return -1;
+    }
+
+    if (dfu_block_state[i] != DFU_BLOCK_FREE) {
+        /* host ignored dfuDNBUSY */
+        usb_dfu_set_error(DFU_STATUS_ERR_STALLEDPKT);
+        return -1;
+    }
+
+    if (setup->wValue == 0) {
+        dfu_dnload_start = DWT->CYCCNT;
+        dfu_busy_polls = 0;
+    }
+
+    memcpy(dfu_block_buf[i], data, len);
+    dfu_block_words[i] = len / 4U;
+    while (len % DFU_FLASH_PROGRAM_ALIGN) {
+        dfu_block_buf[i][len++] = 0xFF;
+    }
+
+    dfu_block_addr[i] = addr;
+    dfu_block_len[i] = len;
+    dfu_block_num[i] = setup->wValue;
+    dfu_block_state[i] = DFU_BLOCK_QUEUED;
+    dfu_block_next ^= 1U;
+
+    dfu_state = DFU_STATE_DFU_DNLOAD_SYNC;
+
+    return 0;
+}
+
+static int usb_dfu_upload(struct usb_setup_packet *setup, uint8_t *data, uint32_t *len) {
+    uint32_t offset = (uint32_t)setup->wValue * setup->wLength;
+    uint32_t n = setup->wLength;
+
+    if ((dfu_state != DFU_STATE_DFU_IDLE) && (dfu_state != DFU_STATE_DFU_UPLOAD_IDLE)) {
+        usb_dfu_set_error(DFU_STATUS_ERR_STALLEDPKT);
+        return -1;
+    }
+
+    if (offset >= DFU_FLASH_SIZE) {
+        n = 0;
+    } else if (n > (DFU_FLASH_SIZE - offset)) {
+        n = DFU_FLASH_SIZE - offset;
+    }
+
+    memcpy(data, (const uint8_t *)(DFU_FLASH_BASE + offset), n);
+    *len = n;
+
+    /* a short block ends the upload */
+    dfu_state = (n < setup->wLength) ? DFU_STATE_DFU_IDLE : DFU_STATE_DFU_UPLOAD_IDLE;
+
+    return 0;
+}
+
+static void usb_dfu_get_status(uint8_t *data, uint32_t *len) {
+    uint32_t timeout = 0;
+    uint8_t state;
+
+    if ((dfu_error != DFU_STATUS_OK) && (dfu_state != DFU_STATE_DFU_ERROR)) {
+        usb_dfu_set_error(dfu_error);
+    }
+
+    state = dfu_state;
+
+    switch (dfu_state) {
+        case DFU_STATE_DFU_DNLOAD_SYNC:
+            if (dfu_block_state[dfu_block_next] == DFU_BLOCK_FREE) {
+                /* the block just received is programmed while the next one comes in */
+                dfu_state = DFU_STATE_DFU_DNLOAD_IDLE;
+                state = dfu_state;
+            } else {
+                state = DFU_STATE_DFU_DNBUSY;
+                timeout = usb_dfu_busy_remaining();
+                dfu_busy_polls++;
+            }
+            break;
+        case DFU_STATE_DFU_MANIFEST_SYNC:
+            if (dfu_manifest_done) {
+                dfu_manifest_done = false;
+                dfu_state = DFU_STATE_DFU_IDLE;
+                state = dfu_state;
+            } else {
+                state = DFU_STATE_DFU_MANIFEST;
+                timeout = usb_dfu_busy_remaining();
+            }
+            break;
+        default:
+            break;
+    }
+
+    data[0] = dfu_status;
+    data[1] = (uint8_t)(timeout);
+    data[2] = (uint8_t)(timeout >> 8);
+    data[3] = (uint8_t)(timeout >> 16);
+    data[4] = state;
+    data[5] = 0;
+    *len = 6;
+}
+
+static int usb_dfu_class_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len) {
+    ARG_UNUSED(busid);
+
+    switch (setup->bRequest) {
+        case DFU_REQUEST_DETACH:
+            /* already in DFU mode */
+            *len = 0;
+            return 0;
+        case DFU_REQUEST_DNLOAD:
+            return usb_dfu_dnload(setup, *data, *len);
+        case DFU_REQUEST_UPLOAD:
+            return usb_dfu_upload(setup, *data, len);
+        case DFU_REQUEST_GETSTATUS:
+            usb_dfu_get_status(*data, len);
+            return 0;
+        case DFU_REQUEST_CLRSTATUS:
+        case DFU_REQUEST_ABORT:
+            usb_dfu_reset();
+            *len = 0;
+            return 0;
+        case DFU_REQUEST_GETSTATE:
+            (*data)[0] = dfu_state;
+            *len = 1;
+            return 0;
+        default:
+            USB_LOG_WRN("Unhandled DFU Class bRequest 0x%02x\r\n", setup->bRequest);
+            return -1;
+    }
+}
+
+static void usb_dfu_event_handler(uint8_t busid, uint8_t event) {
+    ARG_UNUSED(busid);
+
+    switch (event) {
+        case USBD_EVENT_RESET:
+            usb_dfu_reset();
+            break;
+        default:
+            break;
+    }
+}
+
+static struct usbd_interface dfu_intf = {
+    .class_interface_handler = usb_dfu_class_handler
+};
+
+static void usb_dfu_session_start(void) {
+    memset(&dfu_stats, 0, sizeof(dfu_stats));
+    dfu_erase_end = DFU_FLASH_BASE;
+    dfu_session_last = dfu_dnload_start;
+    dfu_session_cycles = 0;
+    dfu_erase_cycles = 0;
+    dfu_program_cycles = 0;
+    dfu_session_active = true;
+    dfu_abort_req = false;
+    dfu_flash_unlock();
+}
+
+static void usb_dfu_session_end(void) {
+    dfu_flash_lock();
+    dfu_session_active = false;
+
+    dfu_stats.total_ms = DFU_CYCLES_TO_MS(dfu_session_cycles);
+    dfu_stats.erase_ms = DFU_CYCLES_TO_MS(dfu_erase_cycles);
+    dfu_stats.program_ms = DFU_CYCLES_TO_MS(dfu_program_cycles);
+    dfu_stats.busy_polls = dfu_busy_polls;
+
+    while (crc32_stream_busy()) {
+    }
+    dfu_stats.image_crc = crc32_stream_value();
+
+    USB_LOG_RAW("DFU: %u bytes in %u ms (erase %u ms, program %u ms, %u busy polls), crc 0x%08x\r\n",
+                (unsigned int)dfu_stats.image_size, (unsigned int)dfu_stats.total_ms,
+                (unsigned int)dfu_stats.erase_ms, (unsigned int)dfu_stats.program_ms,
+                (unsigned int)dfu_stats.busy_polls, (unsigned int)dfu_stats.image_crc);
+
+#if USB_DFU_CHECK_CRC
+    if (dfu_stats.image_crc != 0) {
+        USB_LOG_ERR("DFU: image CRC check failed\r\n");
+        dfu_error = DFU_STATUS_ERR_VERIFY;
+    }
+#endif
+}
+
+static void usb_dfu_program_block(uint8_t i) {
+    uint32_t addr = dfu_block_addr[i];
+    uint32_t len = dfu_block_len[i];
+    uint32_t estimate = dfu_flash_program_time(len);
+    uint32_t end;
+    uint32_t t0;
+    uint8_t status = DFU_STATUS_OK;
+
+    if (dfu_block_num[i] == 0) {
+        usb_dfu_session_start();
+    }
+
+    if (!dfu_session_active || (dfu_error != DFU_STATUS_OK)) {
+        /* remains of an aborted or failed download */
+        return;
+    }
+
+    for (end = dfu_erase_end; end < (addr + len); end += dfu_flash_sector_size(end)) {
+        estimate += dfu_flash_erase_time(end);
+    }
+    dfu_busy_ms = estimate;
+    dfu_busy_start = DWT->CYCCNT;
+
+    /* the CRC unit reads the buffer by DMA while the flash is busy */
+    if (dfu_block_words[i] != 0) {
+        crc32_stream_feed((const uint32_t *)dfu_block_buf[i], dfu_block_words[i], dfu_block_num[i] == 0, NULL, NULL);
+    }
+
+    /* erase ahead of the write pointer, whole sectors at a time */
+    t0 = DWT->CYCCNT;
+    while (dfu_erase_end < (addr + len)) {
+        if (dfu_flash_erase(dfu_erase_end) != 0) {
+            status = DFU_STATUS_ERR_ERASE;
+            break;
+        }
+        dfu_erase_end += dfu_flash_sector_size(dfu_erase_end);
+    }
+    dfu_erase_cycles += DWT->CYCCNT - t0;
+
+    t0 = DWT->CYCCNT;
+    if (status == DFU_STATUS_OK) {
+        if (dfu_flash_program(addr, dfu_block_buf[i], len) != 0) {
+            status = DFU_STATUS_ERR_PROG;
+        } else if (memcmp((const void *)addr, dfu_block_buf[i], len) != 0) {
+            status = DFU_STATUS_ERR_VERIFY;
+        }
+    }
+    dfu_program_cycles += DWT->CYCCNT - t0;
+
+    dfu_stats.image_size += len;
+    dfu_stats.blocks++;
+
+    /* buffer goes back to the USB side */
+    while (crc32_stream_busy()) {
+    }
+
+    if (status != DFU_STATUS_OK) {
+        USB_LOG_ERR("DFU: block %u at 0x%08x failed, status %u\r\n",
+                    (unsigned int)dfu_block_num[i], (unsigned int)addr, (unsigned int)status);
+        dfu_error = status;
+    }
+}
+
+int usb_dfu_init(uint8_t busid, uint32_t reg_base) {
+    /* cycle counter keeps running while the flash stalls SysTick */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    crc32_stream_init();
+
+    usbd_desc_register(busid, usb_dfu_descriptor);
+    usbd_add_interface(busid, &dfu_intf);
+
+    return usbd_initialize(busid, reg_base, usb_dfu_event_handler);
+}
+
+/**
+ * @brief   Program queued DNLOAD blocks, call from the main loop
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_dfu_poll(void) {
+    uint8_t i = dfu_block_work;
+    uint32_t now = DWT->CYCCNT;
+    uint32_t primask;
+    bool queued;
+
+    if (dfu_session_active) {
+        dfu_session_cycles += now - dfu_session_last;
+        dfu_session_last = now;
+    }
+
+    /* usb_dfu_reset drops queued blocks from the USB interrupt */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    queued = (dfu_block_state[i] == DFU_BLOCK_QUEUED);
+    if (queued) {
+        dfu_block_state[i] = DFU_BLOCK_BUSY;
+    }
+    __set_PRIMASK(primask);
+
+    if (queued) {
+        usb_dfu_program_block(i);
+
+        primask = __get_PRIMASK();
+        __disable_irq();
+        dfu_block_state[i] = DFU_BLOCK_FREE;
+        dfu_block_work ^= 1U;
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    if (dfu_block_state[i ^ 1U] != DFU_BLOCK_FREE) {
+        return;
+    }
+
+    if (dfu_manifest_req) {
+        dfu_manifest_req = false;
+        if (dfu_session_active) {
+            usb_dfu_session_end();
+        }
+        dfu_manifest_done = true;
+    } else if (dfu_abort_req) {
+        dfu_abort_req = false;
+        if (dfu_session_active) {
+            dfu_flash_lock();
+            dfu_session_active = false;
+        }
+    }
+}
+
+void usb_dfu_get_stats(struct usb_dfu_stats *stats) {
+    memcpy(stats, &dfu_stats, sizeof(dfu_stats));
+}
+
+#endif /* DEMO_SELECT == DEMO_DFU */
@@ -0,0 +1,782 @@
+/**
+  * @file    usb_eth_bridge.c
+  * @author  LuckkMaker
+  * @brief   CDC ECM device bridged to the ETH MAC without copying frames
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Data path:
+  *   ETH -> USB: RX descriptors are filled from rx_pool by DAL_ETH_RxAllocateCallback,
+  *               the received buffer is submitted to the bulk IN endpoint as it is and
+  *               goes back to the pool on IN completion.
+  *   USB -> ETH: bulk OUT reads land in out_pool, the buffer is attached to a TX
+  *               descriptor by DAL_ETH_Transmit_IT and goes back to the pool from
+  *               DAL_ETH_TxFreeCallback, which also re-arms a throttled OUT endpoint.
+  *
+  * ETH_IRQn and OTG_FS_IRQn run at the same priority, so the bridge state is only
+  * touched from one preemption level and needs no locking.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_eth_bridge.h"
+
+#if (DEMO_SELECT == DEMO_USB_ETH_BRIDGE)
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct usb_eth_bridge_frame {
+    uint8_t *buf;
+    uint16_t len;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USBD_VID           0x314B
+#define USBD_PID           0xF002
+#define USBD_MAX_POWER     100
+#define USBD_LANGID_STRING 1033
+
+/*!< endpoint address */
+#define ECM_IN_EP          0x81
+#define ECM_OUT_EP         0x01
+#define ECM_INT_EP         0x83
+
+#ifdef CONFIG_USB_HS
+#define ECM_MAX_MPS        512
+#else
+#define ECM_MAX_MPS        64
+#endif
+
+/*!< ethernet frame without FCS */
+#define ECM_MAX_SEGMENT_SIZE    1514U
+
+/*!< OUT buffer, multiple of MPS so a full sized frame ends with a short packet */
+#define ECM_OUT_BUF_SIZE        1536U
+
+/*!< ETH_UpdateDescriptor re-arms RX descriptors with a 1000 byte buffer size */
+#define ECM_RX_SEGMENT_SIZE     1000U
+
+#define ECM_RX_BUF_NUM          (ETH_RX_DESC_CNT + USB_ETH_BRIDGE_IN_QUEUE_DEPTH)
+
+/*!< config descriptor size */
+#define USB_CONFIG_SIZE (9 + 9 + 5 + 5 + 13 + 7 + 9 + 9 + 7 + 7)
+
+/*!< CDC class specific requests and notifications */
+#define CDC_REQUEST_SET_ETHERNET_PACKET_FILTER  0x43
+#define CDC_NOTIFY_NETWORK_CONNECTION           0x00
+#define CDC_NOTIFY_CONNECTION_SPEED_CHANGE      0x2A
+
+/*!< generic IEEE 802.3 PHY registers */
+#define PHY_REG_BMCR            0x00U
+#define PHY_REG_BMSR            0x01U
+#define PHY_REG_ANLPAR          0x05U
+#define PHY_BMCR_ANEN           0x1000U
+#define PHY_BMCR_ANRESTART      0x0200U
+#define PHY_BMSR_LINK           0x0004U
+#define PHY_BMSR_ANDONE         0x0020U
+#define PHY_ANLPAR_100FD        0x0100U
+#define PHY_ANLPAR_100HD        0x0080U
+#define PHY_ANLPAR_10FD         0x0040U
+
+#define PHY_POLL_INTERVAL_MS    500U
+
+#if ((ETH_TX_DESC_CNT & (ETH_TX_DESC_CNT - 1U)) != 0U)
+#error "ETH_TX_DESC_CNT must be a power of 2"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/*!< global descriptor */
+static const uint8_t usb_eth_bridge_descriptor[] = {
+    USB_DEVICE_DESCRIPTOR_INIT(USB_2_0, 0x02, 0x00, 0x00, USBD_VID, USBD_PID, 0x0100, 0x01),
+    USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, 0x02, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
+    /************** Descriptor of CDC ECM communication interface *****************/
+    0x09,                          /* bLength: Interface Descriptor size */
+    USB_DESCRIPTOR_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+    0x00,                          /* bInterfaceNumber: Number of Interface */
+    0x00,                          /* bAlternateSetting: Alternate setting */
+    0x01,                          /* bNumEndpoints */
+    0x02,                          /* bInterfaceClass: CDC */
+    0x06,                          /* bInterfaceSubClass: Ethernet Networking Control Model */
+    0x00,                          /* nInterfaceProtocol */
+    0x00,                          /* iInterface */
+    0x05,                          /* bFunctionLength */
+    0x24,                          /* bDescriptorType: CS_INTERFACE */
+    0x00,                          /* bDescriptorSubtype: Header */
+    WBVAL(0x0110),                 /* bcdCDC */
+    0x05,                          /* bFunctionLength */
+    0x24,                          /* bDescriptorType: CS_INTERFACE */
+    0x06,                          /* bDescriptorSubtype: Union */
+    0x00,                          /* bControlInterface */
+    0x01,                          /* bSubordinateInterface0 */
+    0x0D,                          /* bFunctionLength */
+    0x24,                          /* bDescriptorType: CS_INTERFACE */
+    0x0F,                          /* bDescriptorSubtype: Ethernet Networking */
+    0x04,                          /* iMACAddress */
+    DBVAL(0),                      /* bmEthernetStatistics */
+    WBVAL(ECM_MAX_SEGMENT_SIZE),   /* wMaxSegmentSize */
+    WBVAL(0),                      /* wNumberMCFilters */
+    0x00,                          /* bNumberPowerFilters */
+    0x07,                          /* bLength: Endpoint Descriptor size */
+    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
+    ECM_INT_EP,                    /* bEndpointAddress: Endpoint Address (IN) */
+    0x03,                          /* bmAttributes: Interrupt endpoint */
+    WBVAL(16),                     /* wMaxPacketSize: 16 Byte max */
+    0x10,                          /* bInterval: Polling Interval */
+    /************** Descriptor of CDC data interface, no endpoints *****************/
+    0x09,                          /* bLength: Interface Descriptor size */
+    USB_DESCRIPTOR_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+    0x01,                          /* bInterfaceNumber: Number of Interface */
+    0x00,                          /* bAlternateSetting: Alternate setting */
+    0x00,                          /* bNumEndpoints */
+    0x0A,                          /* bInterfaceClass: CDC data */
+    0x00,                          /* bInterfaceSubClass */
+    0x00,                          /* nInterfaceProtocol */
+    0x00,                          /* iInterface */
+    /************** Descriptor of CDC data interface, active *****************/
+    0x09,                          /* bLength: Interface Descriptor size */
+    USB_DESCRIPTOR_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+    0x01,                          /* bInterfaceNumber: Number of Interface */
+    0x01,                          /* bAlternateSetting: Alternate setting */
+    0x02,                          /* bNumEndpoints */
+    0x0A,                          /* bInterfaceClass: CDC data */
+    0x00,                          /* bInterfaceSubClass */
+    0x00,                          /* nInterfaceProtocol */
+    0x00,                          /* iInterface */
+    0x07,                          /* bLength: Endpoint Descriptor size */
+    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
+    ECM_OUT_EP,                    /* bEndpointAddress: Endpoint Address (OUT) */
+    0x02,                          /* bmAttributes: Bulk endpoint */
+    WBVAL(ECM_MAX_MPS),            /* wMaxPacketSize */
+    0x00,                          /* bInterval */
+    0x07,                          /* bLength: Endpoint Descriptor size */
+    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
+    ECM_IN_EP,                     /* bEndpointAddress: Endpoint Address (IN) */
+    0x02,                          /* bmAttributes: Bulk endpoint */
+    WBVAL(ECM_MAX_MPS),            /* wMaxPacketSize */
+    0x00,                          /* bInterval */
+    ///////////////////////////////////////
+    /// string0 descriptor
+    ///////////////////////////////////////
+    USB_LANGID_INIT(USBD_LANGID_STRING),
+    ///////////////////////////////////////
+    /// string1 descriptor
+    ///////////////////////////////////////
+    0x14,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ///////////////////////////////////////
+    /// string2 descriptor
+    ///////////////////////////////////////
+    0x22,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ' ', 0x00,                  /* wcChar9 */
+    'B', 0x00,                  /* wcChar10 */
+    'R', 0x00,                  /* wcChar11 */
+    'I', 0x00,                  /* wcChar12 */
+    'D', 0x00,                  /* wcChar13 */
+    'G', 0x00,                  /* wcChar14 */
+    'E', 0x00,                  /* wcChar15 */
+    ///////////////////////////////////////
+    /// string3 descriptor
+    ///////////////////////////////////////
+    0x16,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '2', 0x00,                  /* wcChar0 */
+    '0', 0x00,                  /* wcChar1 */
+    '2', 0x00,                  /* wcChar2 */
+    '4', 0x00,                  /* wcChar3 */
+    '1', 0x00,                  /* wcChar4 */
+    '2', 0x00,                  /* wcChar5 */
+    '3', 0x00,                  /* wcChar6 */
+    '4', 0x00,                  /* wcChar7 */
+    '5', 0x00,                  /* wcChar8 */
+    '7', 0x00,                  /* wcChar9 */
+    ///////////////////////////////////////
+    /// string4 descriptor, host side MAC address
+    ///////////////////////////////////////
+    0x1A,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '0', 0x00,                  /* wcChar0 */
+    '2', 0x00,                  /* wcChar1 */
+    '0', 0x00,                  /* wcChar2 */
+    '0', 0x00,                  /* wcChar3 */
+    '0', 0x00,                  /* wcChar4 */
+    '0', 0x00,                  /* wcChar5 */
+    '0', 0x00,                  /* wcChar6 */
+    '0', 0x00,                  /* wcChar7 */
+    '0', 0x00,                  /* wcChar8 */
+    '0', 0x00,                  /* wcChar9 */
+    '0', 0x00,                  /* wcChar10 */
+    '1', 0x00,                  /* wcChar11 */
+#ifdef CONFIG_USB_HS
+    ///////////////////////////////////////
+    /// device qualifier descriptor
+    ///////////////////////////////////////
+    0x0a,
+    USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER,
+    0x00,
+    0x02,
+    0x02,
+    0x00,
+    0x00,
+    0x40,
+    0x01,
+    0x00,
+#endif
+    0x00
+};
+
+/*!< ETH DMA descriptors and handle */
+static ETH_DMADescTypeDef eth_rx_desc[ETH_RX_DESC_CNT];
+static ETH_DMADescTypeDef eth_tx_desc[ETH_TX_DESC_CNT];
+static uint8_t eth_mac_addr[6] = { ETH_MAC_ADDR_0, ETH_MAC_ADDR_1, ETH_MAC_ADDR_2,
+                                   ETH_MAC_ADDR_3, ETH_MAC_ADDR_4, ETH_MAC_ADDR_5 };
+ETH_HandleTypeDef heth;
+
+/*!< frame buffers, used by the ETH DMA and the USB core in place */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t rx_pool[ECM_RX_BUF_NUM][ETH_BUFFER_SIZE_RX];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t out_pool[USB_ETH_BRIDGE_OUT_BUF_NUM][ECM_OUT_BUF_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t notify_buffer[16];
+
+static uint8_t *rx_free[ECM_RX_BUF_NUM];
+static uint32_t rx_free_cnt;
+static uint8_t *out_free[USB_ETH_BRIDGE_OUT_BUF_NUM];
+static uint32_t out_free_cnt;
+
+/*!< ETH -> USB IN queue */
+static struct usb_eth_bridge_frame in_queue[ECM_RX_BUF_NUM];
+static uint32_t in_head;
+static uint32_t in_tail;
+static uint32_t in_cnt;
+static volatile bool in_busy;
+static bool in_zlp;
+
+/*!< USB OUT -> ETH TX queue, frames waiting for a free TX descriptor */
+static struct usb_eth_bridge_frame tx_queue[USB_ETH_BRIDGE_OUT_BUF_NUM];
+static uint32_t tx_head;
+static uint32_t tx_tail;
+static uint32_t tx_cnt;
+static ETH_TxPacketConfig tx_config;
+static ETH_BufferTypeDef tx_buffer;
+
+/*!< OUT buffer currently owned by the USB core */
+static uint8_t *out_cur;
+
+/*!< frame spanning two RX descriptors */
+static uint8_t *rx_tail_seg;
+static uint16_t rx_last_len;
+
+static uint8_t bridge_busid;
+static volatile bool data_active;
+static volatile bool link_up;
+static bool link_notify;
+static uint32_t link_speed;
+static uint32_t phy_poll_tick;
+
+static struct usb_eth_bridge_stats bridge_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+static void usb_eth_bridge_rx_drain(void);
+
+/* External functions --------------------------------------------------------*/
+
+static void usb_eth_bridge_out_arm(void) {
+    if ((out_cur != NULL) || !data_active) {
+        return;
+    }
+
+    if (out_free_cnt == 0) {
+        /* leave the endpoint NAKing until a TX descriptor releases a buffer */
+        bridge_stats.out_throttled++;
+        return;
+    }
+
+    out_cur = out_free[--out_free_cnt];
+    usbd_ep_start_read(bridge_busid, ECM_OUT_EP, out_cur, ECM_OUT_BUF_SIZE);
+}
+
+static void usb_eth_bridge_in_kick(void) {
+    if (in_busy || (in_cnt == 0) || !data_active) {
+        return;
+    }
+
+    in_busy = true;
+    usbd_ep_start_write(bridge_busid, ECM_IN_EP, in_queue[in_tail].buf, in_queue[in_tail].len);
+}
+
+static void usb_eth_bridge_tx_flush(void) {
+    while (tx_cnt) {
+        if (heth.gState != DAL_ETH_STATE_STARTED) {
+            /* no link, nothing will ever release the descriptor */
+            bridge_stats.tx_dropped++;
+            out_free[out_free_cnt++] = tx_queue[tx_tail].buf;
+        } else {
+            tx_buffer.buffer = tx_queue[tx_tail].buf;
+            tx_buffer.len = tx_queue[tx_tail].len;
+            tx_buffer.next = NULL;
+            tx_config.Length = tx_queue[tx_tail].len;
+            tx_config.TxBuffer = &tx_buffer;
+            tx_config.pData = tx_queue[tx_tail].buf;
+
+            if (DAL_ETH_Transmit_IT(&heth, &tx_config) != DAL_OK) {
+                bridge_stats.tx_ring_full++;
+                break;
+            }
+            bridge_stats.tx_frames++;
+        }
+
+        tx_tail = (tx_tail + 1) % USB_ETH_BRIDGE_OUT_BUF_NUM;
+        tx_cnt--;
+    }
+
+    usb_eth_bridge_out_arm();
+}
+
+static void usb_eth_bridge_send_notify(void) {
+    uint32_t speed = link_up ? link_speed : 0;
+
+    if (!data_active) {
+        return;
+    }
+
+    if (link_notify) {
+        /* NETWORK_CONNECTION, followed by CONNECTION_SPEED_CHANGE from the IN callback */
+        notify_buffer[0] = 0xA1;
+        notify_buffer[1] = CDC_NOTIFY_NETWORK_CONNECTION;
+        notify_buffer[2] = link_up ? 1 : 0;
+        notify_buffer[3] = 0;
+        notify_buffer[4] = 0;
+        notify_buffer[5] = 0;
+        notify_buffer[6] = 0;
+        notify_buffer[7] = 0;
+        link_notify = false;
+        usbd_ep_start_write(bridge_busid, ECM_INT_EP, notify_buffer, 8);
+    } else if (notify_buffer[1] == CDC_NOTIFY_NETWORK_CONNECTION) {
+        notify_buffer[1] = CDC_NOTIFY_CONNECTION_SPEED_CHANGE;
+        notify_buffer[2] = 0;
+        notify_buffer[6] = 8;
+        memcpy(&notify_buffer[8], &speed, 4);
+        memcpy(&notify_buffer[12], &speed, 4);
+        usbd_ep_start_write(bridge_busid, ECM_INT_EP, notify_buffer, 16);
+    }
+}
+
+/********************** USB side **************************/
+
+static void usb_eth_bridge_event_handler(uint8_t busid, uint8_t event) {
+    switch (event) {
+        case USBD_EVENT_RESET:
+        case USBD_EVENT_DISCONNECTED:
+            data_active = false;
+            break;
+        case USBD_EVENT_CONFIGURED:
+            /* bulk endpoints are opened by SET_INTERFACE alternate setting 1 */
+            break;
+        default:
+            break;
+    }
+}
+
+static int usb_eth_bridge_class_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(data);
+
+    switch (setup->bRequest) {
+        case CDC_REQUEST_SET_ETHERNET_PACKET_FILTER:
+            /* the MAC runs promiscuous, the host does the filtering */
+            *len = 0;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static void usb_eth_bridge_data_notify(uint8_t busid, uint8_t event, void *arg) {
+    struct usb_interface_descriptor *intf_desc = (struct usb_interface_descriptor *)arg;
+
+    if ((event != USBD_EVENT_SET_INTERFACE) || (intf_desc == NULL)) {
+        return;
+    }
+
+    if (intf_desc->bAlternateSetting == 1) {
+        data_active = true;
+        in_busy = false;
+        in_zlp = false;
+        link_notify = true;
+        usb_eth_bridge_out_arm();
+        usb_eth_bridge_in_kick();
+        usb_eth_bridge_send_notify();
+    } else {
+        data_active = false;
+    }
+}
+
+static void usb_eth_bridge_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    if (!in_zlp && nbytes && ((nbytes % usbd_get_ep_mps(busid, ep)) == 0)) {
+        /* frame boundary is a short packet */
+        in_zlp = true;
+        usbd_ep_start_write(busid, ECM_IN_EP, NULL, 0);
+        return;
+    }
+
+    in_zlp = false;
+    rx_free[rx_free_cnt++] = in_queue[in_tail].buf;
+    in_tail = (in_tail + 1) % ECM_RX_BUF_NUM;
+    in_cnt--;
+    in_busy = false;
+    bridge_stats.rx_frames++;
+
+    /* a buffer is back, give it to a descriptor waiting for one */
+    usb_eth_bridge_rx_drain();
+    usb_eth_bridge_in_kick();
+}
+
+static void usb_eth_bridge_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    uint8_t *buf = out_cur;
+
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+
+    out_cur = NULL;
+
+    if ((nbytes == 0) || (nbytes > ECM_MAX_SEGMENT_SIZE)) {
+        bridge_stats.tx_dropped++;
+        out_free[out_free_cnt++] = buf;
+    } else {
+        tx_queue[tx_head].buf = buf;
+        tx_queue[tx_head].len = (uint16_t)nbytes;
+        tx_head = (tx_head + 1) % USB_ETH_BRIDGE_OUT_BUF_NUM;
+        tx_cnt++;
+    }
+
+    usb_eth_bridge_tx_flush();
+}
+
+static void usb_eth_bridge_int_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+    ARG_UNUSED(nbytes);
+
+    usb_eth_bridge_send_notify();
+}
+
+/*!< endpoint call back */
+static struct usbd_endpoint ecm_out_ep = {
+    .ep_addr = ECM_OUT_EP,
+    .ep_cb = usb_eth_bridge_bulk_out
+};
+
+static struct usbd_endpoint ecm_in_ep = {
+    .ep_addr = ECM_IN_EP,
+    .ep_cb = usb_eth_bridge_bulk_in
+};
+
+static struct usbd_endpoint ecm_int_ep = {
+    .ep_addr = ECM_INT_EP,
+    .ep_cb = usb_eth_bridge_int_in
+};
+
+static struct usbd_interface ecm_intf0 = {
+    .class_interface_handler = usb_eth_bridge_class_handler
+};
+
+static struct usbd_interface ecm_intf1 = {
+    .notify_handler = usb_eth_bridge_data_notify
+};
+
+/********************** ETH side **************************/
+
+void DAL_ETH_MspInit(ETH_HandleTypeDef *heth) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    ARG_UNUSED(heth);
+
+    __DAL_RCM_ETHMAC_CLK_ENABLE();
+    __DAL_RCM_ETHMACTX_CLK_ENABLE();
+    __DAL_RCM_ETHMACRX_CLK_ENABLE();
+    __DAL_RCM_GPIOA_CLK_ENABLE();
+    __DAL_RCM_GPIOC_CLK_ENABLE();
+    __DAL_RCM_GPIOG_CLK_ENABLE();
+
+    /* RMII: PA1 REF_CLK, PA2 MDIO, PA7 CRS_DV, PC1 MDC, PC4 RXD0, PC5 RXD1,
+     * PG11 TX_EN, PG13 TXD0, PG14 TXD1 */
+    GPIO_InitStruct.Mode        = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull        = GPIO_NOPULL;
+    GPIO_InitStruct.Speed       = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate   = GPIO_AF11_ETH;
+
+    GPIO_InitStruct.Pin         = GPIO_PIN_1 | GPIO_PIN_2 | GPIO_PIN_7;
+    DAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+
+    GPIO_InitStruct.Pin         = GPIO_PIN_1 | GPIO_PIN_4 | GPIO_PIN_5;
+    DAL_GPIO_Init(GPIOC, &GPIO_InitStruct);
+
+    GPIO_InitStruct.Pin         = GPIO_PIN_11 | GPIO_PIN_13 | GPIO_PIN_14;
+    DAL_GPIO_Init(GPIOG, &GPIO_InitStruct);
+
+    /* same priority as OTG_FS, see file header */
+    DAL_NVIC_SetPriority(ETH_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(ETH_IRQn);
+}
+
+void DAL_ETH_RxAllocateCallback(uint8_t **buff) {
+    if (rx_free_cnt == 0) {
+        bridge_stats.rx_alloc_fail++;
+        *buff = NULL;
+        return;
+    }
+
+    *buff = rx_free[--rx_free_cnt];
+}
+
+void DAL_ETH_RxLinkCallback(void **pStart, void **pEnd, uint8_t *buff, uint16_t Length) {
+    if (*pStart == NULL) {
+        *pStart = buff;
+        rx_tail_seg = NULL;
+    } else {
+        /* second descriptor of a frame longer than ECM_RX_SEGMENT_SIZE */
+        rx_tail_seg = buff;
+    }
+
+    /* the last call carries the whole frame length */
+    rx_last_len = Length;
+    *pEnd = buff;
+}
+
+void DAL_ETH_TxFreeCallback(uint32_t *buff) {
+    out_free[out_free_cnt++] = (uint8_t *)buff;
+}
+
+void DAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth) {
+    ARG_UNUSED(heth);
+
+    usb_eth_bridge_rx_drain();
+    usb_eth_bridge_in_kick();
+}
+
+void DAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth) {
+    DAL_ETH_ReleaseTxPacket(heth);
+    usb_eth_bridge_tx_flush();
+}
+
+void DAL_ETH_ErrorCallback(ETH_HandleTypeDef *heth) {
+    ARG_UNUSED(heth);
+
+    bridge_stats.eth_errors++;
+}
+
+static void usb_eth_bridge_rx_drain(void) {
+    void *frame;
+    uint8_t *buf;
+
+    /* DAL_ETH_ReadData also hands free buffers to the descriptors awaiting one */
+    while (DAL_ETH_ReadData(&heth, &frame) == DAL_OK) {
+        buf = (uint8_t *)frame;
+
+        if (rx_tail_seg != NULL) {
+            memcpy(&buf[ECM_RX_SEGMENT_SIZE], rx_tail_seg, rx_last_len - ECM_RX_SEGMENT_SIZE);
+            rx_free[rx_free_cnt++] = rx_tail_seg;
+            rx_tail_seg = NULL;
+            bridge_stats.rx_split_frames++;
+        }
+
+        if (!data_active || (in_cnt == ECM_RX_BUF_NUM)) {
+            bridge_stats.rx_dropped++;
+            rx_free[rx_free_cnt++] = buf;
+            continue;
+        }
+
+        in_queue[in_head].buf = buf;
+        in_queue[in_head].len = rx_last_len;
+        in_head = (in_head + 1) % ECM_RX_BUF_NUM;
+        in_cnt++;
+    }
+}
+
+static int usb_eth_bridge_eth_init(void) {
+    ETH_MACFilterConfigTypeDef filter;
+    uint32_t i;
+
+    for (i = 0; i < ECM_RX_BUF_NUM; i++) {
+        rx_free[i] = rx_pool[i];
+    }
+    rx_free_cnt = ECM_RX_BUF_NUM;
+
+    for (i = 0; i < USB_ETH_BRIDGE_OUT_BUF_NUM; i++) {
+        out_free[i] = out_pool[i];
+    }
+    out_free_cnt = USB_ETH_BRIDGE_OUT_BUF_NUM;
+
+    heth.Instance = ETH;
+    heth.Init.MACAddr = eth_mac_addr;
+    heth.Init.MediaInterface = DAL_ETH_RMII_MODE;
+    heth.Init.TxDesc = eth_tx_desc;
+    heth.Init.RxDesc = eth_rx_desc;
+    heth.Init.RxBuffLen = ECM_RX_SEGMENT_SIZE;
+
+    if (DAL_ETH_Init(&heth) != DAL_OK) {
+        return -1;
+    }
+
+    /* forward every frame, the bridge is transparent */
+    DAL_ETH_GetMACFilterConfig(&heth, &filter);
+    filter.PromiscuousMode = ENABLE;
+    DAL_ETH_SetMACFilterConfig(&heth, &filter);
+
+    memset(&tx_config, 0, sizeof(tx_config));
+    tx_config.Attributes = ETH_TX_PACKETS_FEATURES_CRCPAD;
+    tx_config.CRCPadCtrl = ETH_CRC_PAD_INSERT;
+
+    /* restart auto negotiation, link is picked up by usb_eth_bridge_poll */
+    DAL_ETH_WritePHYRegister(&heth, USB_ETH_BRIDGE_PHY_ADDR, PHY_REG_BMCR, PHY_BMCR_ANEN | PHY_BMCR_ANRESTART);
+
+    return 0;
+}
+
+static void usb_eth_bridge_tx_reclaim(void) {
+    ETH_TxDescListTypeDef *list = &heth.TxDescList;
+    uint32_t i;
+
+    DAL_ETH_ReleaseTxPacket(&heth);
+
+    /* the stopped DMA never completes what it still owns, take the buffers back */
+    for (i = 0; i < ETH_TX_DESC_CNT; i++) {
+        CLEAR_BIT(heth.Init.TxDesc[i].DESC0, ETH_DMATXDESC_OWN);
+        if (list->PacketAddress[i] != NULL) {
+            DAL_ETH_TxFreeCallback(list->PacketAddress[i]);
+            list->PacketAddress[i] = NULL;
+            bridge_stats.tx_dropped++;
+        }
+    }
+
+    /* rewind the ring, the DMA starts from the list address on the next link up */
+    list->BuffersInUse = 0;
+    list->releaseIndex = 0;
+    list->CurTxDesc = 0;
+    WRITE_REG(heth.Instance->DMATXDLADDR, (uint32_t)heth.Init.TxDesc);
+}
+
+static void usb_eth_bridge_link_update(bool up) {
+    ETH_MACConfigTypeDef mac;
+    uint32_t anlpar = 0;
+
+    if (up) {
+        DAL_ETH_ReadPHYRegister(&heth, USB_ETH_BRIDGE_PHY_ADDR, PHY_REG_ANLPAR, &anlpar);
+
+        DAL_ETH_GetMACConfig(&heth, &mac);
+        if (anlpar & (PHY_ANLPAR_100FD | PHY_ANLPAR_100HD)) {
+            mac.Speed = ETH_SPEED_100M;
+            link_speed = 100000000U;
+        } else {
+            mac.Speed = ETH_SPEED_10M;
+            link_speed = 10000000U;
+        }
+        mac.DuplexMode = (anlpar & (PHY_ANLPAR_100FD | PHY_ANLPAR_10FD)) ? ETH_FULLDUPLEX_MODE : ETH_HALFDUPLEX_MODE;
+        DAL_ETH_SetMACConfig(&heth, &mac);
+    }
+
+    /* Start/Stop take RX buffers from rx_free and change gState, both used by the interrupts */
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    DAL_NVIC_DisableIRQ(ETH_IRQn);
+    if (up) {
+        DAL_ETH_Start_IT(&heth);
+    } else {
+        DAL_ETH_Stop_IT(&heth);
+        usb_eth_bridge_tx_reclaim();
+        /* drops what is still queued and re-arms a throttled OUT endpoint */
+        usb_eth_bridge_tx_flush();
+    }
+    link_up = up;
+    link_notify = true;
+    usb_eth_bridge_send_notify();
+    DAL_NVIC_EnableIRQ(ETH_IRQn);
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+}
+
+int usb_eth_bridge_init(uint8_t busid, uint32_t reg_base) {
+    bridge_busid = busid;
+
+    if (usb_eth_bridge_eth_init() != 0) {
+        return -1;
+    }
+
+    usbd_desc_register(busid, usb_eth_bridge_descriptor);
+    usbd_add_interface(busid, &ecm_intf0);
+    usbd_add_interface(busid, &ecm_intf1);
+    usbd_add_endpoint(busid, &ecm_int_ep);
+    usbd_add_endpoint(busid, &ecm_out_ep);
+    usbd_add_endpoint(busid, &ecm_in_ep);
+
+    return usbd_initialize(busid, reg_base, usb_eth_bridge_event_handler);
+}
+
+/**
+ * @brief   Poll the PHY link state, call from the main loop
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_eth_bridge_poll(void) {
+    uint32_t bmsr = 0;
+    bool up;
+
+    if ((DAL_GetTick() - phy_poll_tick) < PHY_POLL_INTERVAL_MS) {
+        return;
+    }
+    phy_poll_tick = DAL_GetTick();
+
+    if (DAL_ETH_ReadPHYRegister(&heth, USB_ETH_BRIDGE_PHY_ADDR, PHY_REG_BMSR, &bmsr) != DAL_OK) {
+        return;
+    }
+
+    up = ((bmsr & (PHY_BMSR_LINK | PHY_BMSR_ANDONE)) == (PHY_BMSR_LINK | PHY_BMSR_ANDONE));
+    if (up != link_up) {
+        usb_eth_bridge_link_update(up);
+    }
+
+    /* missed frame counter is clear on read */
+    bridge_stats.rx_missed += (heth.Instance->DMAMFABOCNT & ETH_DMAMFABOCNT_MISFCNT);
+}
+
+void usb_eth_bridge_get_stats(struct usb_eth_bridge_stats *stats) {
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    DAL_NVIC_DisableIRQ(ETH_IRQn);
+    memcpy(stats, &bridge_stats, sizeof(bridge_stats));
+    DAL_NVIC_EnableIRQ(ETH_IRQn);
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+}
+
+#endif /* DEMO_SELECT == DEMO_USB_ETH_BRIDGE */
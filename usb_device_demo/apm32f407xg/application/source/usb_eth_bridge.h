@@ -0,0 +1,75 @@
+/**
+  * @file    usb_eth_bridge.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_eth_bridge.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_ETH_BRIDGE_H
+#define USB_ETH_BRIDGE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< RX descriptor ring depth is ETH_RX_DESC_CNT (ETH_BUFFER_NUMBER_RX in apm32f4xx_dal_cfg.h),
+ *   TX descriptor ring depth is ETH_TX_DESC_CNT (ETH_BUFFER_NUMBER_TX in apm32f4xx_dal_cfg.h) */
+
+/*!< received frames that may wait for the USB IN endpoint on top of the RX ring */
+#ifndef USB_ETH_BRIDGE_IN_QUEUE_DEPTH
+#define USB_ETH_BRIDGE_IN_QUEUE_DEPTH   4U
+#endif
+
+/*!< USB OUT frame buffers, each one is handed to a TX descriptor as it is */
+#ifndef USB_ETH_BRIDGE_OUT_BUF_NUM
+#define USB_ETH_BRIDGE_OUT_BUF_NUM      (ETH_TX_DESC_CNT + 1U)
+#endif
+
+/*!< PHY address on the MDIO bus */
+#ifndef USB_ETH_BRIDGE_PHY_ADDR
+#define USB_ETH_BRIDGE_PHY_ADDR         0x00U
+#endif
+
+/*!< bridge counters, every backpressure point has its own counter */
+struct usb_eth_bridge_stats {
+    uint32_t rx_frames;         /*!< ETH frames forwarded to USB IN */
+    uint32_t rx_split_frames;   /*!< frames received in two descriptors, tail copied */
+    uint32_t rx_dropped;        /*!< frames dropped because the USB data interface is down */
+    uint32_t rx_alloc_fail;     /*!< RX descriptor left without buffer, MAC drops on ring full */
+    uint32_t rx_missed;         /*!< frames missed by the MAC (DMAMFABOCNT) */
+    uint32_t tx_frames;         /*!< USB OUT frames queued on TX descriptors */
+    uint32_t tx_dropped;        /*!< USB OUT frames dropped (link down or bad length) */
+    uint32_t tx_ring_full;      /*!< DAL_ETH_Transmit_IT found no free TX descriptor */
+    uint32_t out_throttled;     /*!< USB OUT left NAKing because no buffer was free */
+    uint32_t eth_errors;        /*!< ETH DMA/MAC error interrupts */
+};
+
+int usb_eth_bridge_init(uint8_t busid, uint32_t reg_base);
+void usb_eth_bridge_poll(void);
+void usb_eth_bridge_get_stats(struct usb_eth_bridge_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_ETH_BRIDGE_H */
@@ -0,0 +1,687 @@
+/**
+  * @file    usb_host_bridge.c
+  * @author  LuckkMaker
+  * @brief   CDC ACM device on OTG_FS bridged to a CDC ACM device behind the OTG_HS host
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The two cores run two independent stacks: the device stack on OTG_FS
+  * (OTG_FS_IRQHandler, device bus 0) and the host stack on OTG_HS with its
+  * embedded full speed PHY (OTG_HS1_IRQHandler, host bus 0). Each stack has
+  * its own bus context, only this file knows about both.
+  *
+  * Data path, each direction is a ring of USB_HOST_BRIDGE_BUF_NUM buffers:
+  *   PC -> downstream: device OUT reads land in down_pool, the received buffer
+  *                     is the transfer buffer of the host bulk OUT URB and goes
+  *                     back to the ring on URB completion, which also re-arms
+  *                     a throttled OUT endpoint.
+  *   downstream -> PC: host bulk IN URBs land in up_pool, the received buffer
+  *                     is written to the device IN endpoint as it is and goes
+  *                     back to the ring on IN completion.
+  *
+  * OTG_FS_IRQn and OTG_HS_IRQn run at the same priority, so the rings are only
+  * touched from one preemption level and need no locking. Threads (the host
+  * PSC thread and the bridge thread) mask both interrupts around their
+  * changes, as usb_eth_bridge.c does for the link state. Control requests
+  * from the PC are control transfers on the downstream bus, which block, so
+  * the OTG_FS interrupt only posts them to the bridge thread.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_host_bridge.h"
+
+#if (DEMO_SELECT == DEMO_USB_HOST_BRIDGE)
+
+/* Private includes ----------------------------------------------------------*/
+#include "usbd_cdc.h"
+#include "usbd_ep_static.h"
+#include "usbh_core.h"
+#include "usbh_cdc_acm.h"
+#include "usb_osal.h"
+#include "usb_errno.h"
+
+#if !CONFIG_USB_OSAL
+#error "DEMO_USB_HOST_BRIDGE runs the host stack, it needs CONFIG_USB_OSAL"
+#endif
+
+#if (CONFIG_USBDEV_MAX_BUS > 1)
+#error "OTG_HS is the host of DEMO_USB_HOST_BRIDGE, it cannot be device bus 1"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+enum usb_host_bridge_event {
+    BRIDGE_EVT_RUN = 1,         /*!< downstream device bound, configure it */
+    BRIDGE_EVT_LINE_CODING,     /*!< SET_LINE_CODING from the PC */
+    BRIDGE_EVT_LINE_STATE       /*!< SET_CONTROL_LINE_STATE from the PC */
+};
+
+/*!< one direction, buffers are filled and forwarded in ring order */
+struct usb_host_bridge_pipe {
+    uint8_t (*pool)[USB_HOST_BRIDGE_BUF_SIZE];
+    uint32_t len[USB_HOST_BRIDGE_BUF_NUM];
+    uint8_t rx;                 /*!< buffer the producer fills next */
+    uint8_t tx;                 /*!< oldest filled buffer, on the bus while tx_busy */
+    uint8_t filled;             /*!< buffers received and not forwarded yet */
+    bool rx_armed;
+    bool tx_busy;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USBD_VID           0x314B
+#define USBD_PID           0xF006
+#define USBD_MAX_POWER     100
+#define USBD_LANGID_STRING 1033
+
+/*!< endpoint address */
+#define CDC_IN_EP          0x81
+#define CDC_OUT_EP         0x01
+#define CDC_INT_EP         0x83
+
+#define CDC_MAX_MPS        64
+
+/*!< registered endpoints, described by CDC_ACM_DESCRIPTOR_INIT */
+#define HOST_BRIDGE_EP_LIST(EP) \
+    EP(CDC_OUT_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usb_host_bridge_bulk_out) \
+    EP(CDC_IN_EP, USB_ENDPOINT_TYPE_BULK, CDC_MAX_MPS, 0x00, usb_host_bridge_bulk_in)
+
+/*!< config descriptor size */
+#define USB_CONFIG_SIZE    (9 + CDC_ACM_DESCRIPTOR_LEN)
+
+/*!< events waiting for the bridge thread */
+#define BRIDGE_MQ_DEPTH    8U
+
+#define CDC_LINE_STATE_DTR 0x01U
+#define CDC_LINE_STATE_RTS 0x02U
+
+#if ((USB_HOST_BRIDGE_BUF_SIZE % 512U) != 0U)
+#error "USB_HOST_BRIDGE_BUF_SIZE must be a multiple of the largest bulk MPS"
+#endif
+
+#if (USB_HOST_BRIDGE_BUF_NUM < 2U) || (USB_HOST_BRIDGE_BUF_NUM > 255U)
+#error "USB_HOST_BRIDGE_BUF_NUM out of range"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/*!< global descriptor */
+static const uint8_t usb_host_bridge_descriptor[] = {
+    USB_DEVICE_DESCRIPTOR_INIT(USB_2_0, 0xEF, 0x02, 0x01, USBD_VID, USBD_PID, 0x0100, 0x01),
+    USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, 0x02, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
+    CDC_ACM_DESCRIPTOR_INIT(0x00, CDC_INT_EP, CDC_OUT_EP, CDC_IN_EP, CDC_MAX_MPS, 0x02),
+    ///////////////////////////////////////
+    /// string0 descriptor
+    ///////////////////////////////////////
+    USB_LANGID_INIT(USBD_LANGID_STRING),
+    ///////////////////////////////////////
+    /// string1 descriptor
+    ///////////////////////////////////////
+    0x14,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ///////////////////////////////////////
+    /// string2 descriptor
+    ///////////////////////////////////////
+    0x22,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ' ', 0x00,                  /* wcChar9 */
+    'B', 0x00,                  /* wcChar10 */
+    'R', 0x00,                  /* wcChar11 */
+    'I', 0x00,                  /* wcChar12 */
+    'D', 0x00,                  /* wcChar13 */
+    'G', 0x00,                  /* wcChar14 */
+    'E', 0x00,                  /* wcChar15 */
+    ///////////////////////////////////////
+    /// string3 descriptor
+    ///////////////////////////////////////
+    0x16,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '2', 0x00,                  /* wcChar0 */
+    '0', 0x00,                  /* wcChar1 */
+    '2', 0x00,                  /* wcChar2 */
+    '4', 0x00,                  /* wcChar3 */
+    '1', 0x00,                  /* wcChar4 */
+    '2', 0x00,                  /* wcChar5 */
+    '3', 0x00,                  /* wcChar6 */
+    '4', 0x00,                  /* wcChar7 */
+    '5', 0x00,                  /* wcChar8 */
+    '9', 0x00,                  /* wcChar9 */
+    0x00
+};
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t down_pool[USB_HOST_BRIDGE_BUF_NUM][USB_HOST_BRIDGE_BUF_SIZE];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t up_pool[USB_HOST_BRIDGE_BUF_NUM][USB_HOST_BRIDGE_BUF_SIZE];
+/*!< copy handed to the downstream control transfer */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static struct cdc_line_coding host_line_coding;
+
+static struct cdc_line_coding dev_line_coding = {
+    .dwDTERate = 115200,
+    .bCharFormat = 0,
+    .bParityType = 0,
+    .bDataBits = 8
+};
+static uint8_t dev_line_state;
+
+static uint8_t bridge_busid;
+static bool dev_ready;                  /*!< PC side configured */
+static bool dev_in_zlp;
+
+/*!< downstream class the rings forward to, NULL while not bound */
+static struct usbh_cdc_acm *host_cdc;
+/*!< downstream class bound by usbh_cdc_acm_run(), owned by the bridge thread */
+static struct usbh_cdc_acm *bridge_cdc;
+static bool host_in_halted;
+
+static struct usb_host_bridge_pipe down_pipe = { .pool = down_pool };
+static struct usb_host_bridge_pipe up_pipe = { .pool = up_pool };
+
+static usb_osal_mq_t bridge_mq;
+static usb_osal_mutex_t bridge_mutex;
+
+/*!< both stacks sleep in their init, the bridge thread starts them */
+static uint32_t bridge_dev_reg_base;
+static uint8_t bridge_host_busid;
+static uint32_t bridge_host_reg_base;
+
+static struct usb_host_bridge_stats bridge_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void usb_host_bridge_lock(void) {
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    DAL_NVIC_DisableIRQ(OTG_HS_IRQn);
+}
+
+static void usb_host_bridge_unlock(void) {
+    DAL_NVIC_EnableIRQ(OTG_HS_IRQn);
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+}
+
+/********************** buffer rings **************************/
+
+static uint8_t *usb_host_bridge_rx_buf(struct usb_host_bridge_pipe *pipe) {
+    return pipe->pool[pipe->rx];
+}
+
+static uint8_t *usb_host_bridge_tx_buf(struct usb_host_bridge_pipe *pipe) {
+    return pipe->pool[pipe->tx];
+}
+
+static void usb_host_bridge_rx_done(struct usb_host_bridge_pipe *pipe, uint32_t nbytes) {
+    pipe->len[pipe->rx] = nbytes;
+    pipe->rx = (uint8_t)((pipe->rx + 1U) % USB_HOST_BRIDGE_BUF_NUM);
+    pipe->filled++;
+}
+
+static void usb_host_bridge_tx_done(struct usb_host_bridge_pipe *pipe) {
+    pipe->tx = (uint8_t)((pipe->tx + 1U) % USB_HOST_BRIDGE_BUF_NUM);
+    pipe->filled--;
+}
+
+/*!< drops what the consumer has not taken, a read still armed stays armed */
+static uint32_t usb_host_bridge_flush(struct usb_host_bridge_pipe *pipe) {
+    uint32_t dropped = pipe->filled;
+
+    pipe->tx = pipe->rx;
+    pipe->filled = 0;
+    pipe->tx_busy = false;
+    return dropped;
+}
+
+/********************** forwarding **************************/
+
+static void usb_host_bridge_host_in_complete(void *arg, int nbytes);
+static void usb_host_bridge_host_out_complete(void *arg, int nbytes);
+
+static void usb_host_bridge_dev_out_arm(void) {
+    if (!dev_ready || down_pipe.rx_armed) {
+        return;
+    }
+
+    if (down_pipe.filled >= USB_HOST_BRIDGE_BUF_NUM) {
+        /* re-armed from usb_host_bridge_host_out_complete() */
+        bridge_stats.down_throttled++;
+        return;
+    }
+
+    down_pipe.rx_armed = true;
+    usbd_ep_start_read(bridge_busid, CDC_OUT_EP, usb_host_bridge_rx_buf(&down_pipe), USB_HOST_BRIDGE_BUF_SIZE);
+}
+
+static void usb_host_bridge_dev_in_kick(void) {
+    if (!dev_ready || up_pipe.tx_busy || (up_pipe.filled == 0U)) {
+        return;
+    }
+
+    up_pipe.tx_busy = true;
+    usbd_ep_start_write(bridge_busid, CDC_IN_EP, usb_host_bridge_tx_buf(&up_pipe), up_pipe.len[up_pipe.tx]);
+}
+
+static void usb_host_bridge_host_in_arm(void) {
+    struct usbh_urb *urb;
+
+    if ((host_cdc == NULL) || host_in_halted || up_pipe.rx_armed) {
+        return;
+    }
+
+    if (up_pipe.filled >= USB_HOST_BRIDGE_BUF_NUM) {
+        /* re-armed from usb_host_bridge_bulk_in() */
+        bridge_stats.up_throttled++;
+        return;
+    }
+
+    urb = &host_cdc->bulkin_urb;
+    usbh_bulk_urb_fill(urb, host_cdc->hport, host_cdc->bulkin, usb_host_bridge_rx_buf(&up_pipe),
+                       USB_HOST_BRIDGE_BUF_SIZE, 0, usb_host_bridge_host_in_complete, NULL);
+    if (usbh_submit_urb(urb) < 0) {
+        bridge_stats.host_errors++;
+        host_in_halted = true;
+        return;
+    }
+    up_pipe.rx_armed = true;
+}
+
+static void usb_host_bridge_host_out_kick(void) {
+    struct usbh_urb *urb;
+
+    while ((host_cdc != NULL) && !down_pipe.tx_busy && (down_pipe.filled != 0U)) {
+        urb = &host_cdc->bulkout_urb;
+        usbh_bulk_urb_fill(urb, host_cdc->hport, host_cdc->bulkout, usb_host_bridge_tx_buf(&down_pipe),
+                           down_pipe.len[down_pipe.tx], 0, usb_host_bridge_host_out_complete, NULL);
+        if (usbh_submit_urb(urb) == 0) {
+            down_pipe.tx_busy = true;
+            break;
+        }
+
+        /* drop it, the next one may still go out */
+        bridge_stats.host_errors++;
+        usb_host_bridge_tx_done(&down_pipe);
+    }
+}
+
+/********************** host side, OTG_HS interrupt **************************/
+
+static void usb_host_bridge_host_in_complete(void *arg, int nbytes) {
+    ARG_UNUSED(arg);
+
+    /* killed by the disconnect, usbh_cdc_acm_stop() takes the buffer back */
+    if ((nbytes == -USB_ERR_SHUTDOWN) || (host_cdc == NULL)) {
+        return;
+    }
+
+    up_pipe.rx_armed = false;
+
+    if (nbytes < 0) {
+        /* left unarmed until the device is bound again */
+        bridge_stats.host_errors++;
+        host_in_halted = true;
+        return;
+    }
+
+    if (nbytes > 0) {
+        if (dev_ready) {
+            usb_host_bridge_rx_done(&up_pipe, (uint32_t)nbytes);
+            bridge_stats.up_bytes += (uint32_t)nbytes;
+            usb_host_bridge_dev_in_kick();
+        } else {
+            bridge_stats.up_dropped++;
+        }
+    }
+
+    usb_host_bridge_host_in_arm();
+}
+
+static void usb_host_bridge_host_out_complete(void *arg, int nbytes) {
+    ARG_UNUSED(arg);
+
+    if ((nbytes == -USB_ERR_SHUTDOWN) || (host_cdc == NULL)) {
+        return;
+    }
+
+    if (nbytes < 0) {
+        bridge_stats.host_errors++;
+    }
+
+    down_pipe.tx_busy = false;
+    usb_host_bridge_tx_done(&down_pipe);
+    usb_host_bridge_host_out_kick();
+    usb_host_bridge_dev_out_arm();
+}
+
+/********************** device side, OTG_FS interrupt **************************/
+
+static void usb_host_bridge_event_handler(uint8_t busid, uint8_t event) {
+    ARG_UNUSED(busid);
+
+    switch (event) {
+        case USBD_EVENT_RESET:
+        case USBD_EVENT_DISCONNECTED:
+            /* aborted transfers do not complete, their buffers go back as they are */
+            dev_ready = false;
+            dev_in_zlp = false;
+            down_pipe.rx_armed = false;
+            bridge_stats.up_dropped += usb_host_bridge_flush(&up_pipe);
+            usb_host_bridge_host_in_arm();
+            break;
+        case USBD_EVENT_CONFIGURED:
+            dev_ready = true;
+            usb_host_bridge_dev_out_arm();
+            usb_host_bridge_host_in_arm();
+            break;
+        default:
+            break;
+    }
+}
+
+static int usb_host_bridge_class_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len) {
+    ARG_UNUSED(busid);
+
+    switch (setup->bRequest) {
+        case CDC_REQUEST_SET_LINE_CODING:
+            memcpy(&dev_line_coding, *data, MIN(*len, sizeof(dev_line_coding)));
+            usb_osal_mq_send(bridge_mq, BRIDGE_EVT_LINE_CODING);
+            *len = 0;
+            return 0;
+        case CDC_REQUEST_GET_LINE_CODING:
+            *data = (uint8_t *)&dev_line_coding;
+            *len = sizeof(dev_line_coding);
+            return 0;
+        case CDC_REQUEST_SET_CONTROL_LINE_STATE:
+            dev_line_state = (uint8_t)(setup->wValue & (CDC_LINE_STATE_DTR | CDC_LINE_STATE_RTS));
+            usb_osal_mq_send(bridge_mq, BRIDGE_EVT_LINE_STATE);
+            *len = 0;
+            return 0;
+        case CDC_REQUEST_SEND_BREAK:
+            *len = 0;
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static void usb_host_bridge_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+
+    down_pipe.rx_armed = false;
+
+    if (nbytes != 0U) {
+        if (host_cdc != NULL) {
+            usb_host_bridge_rx_done(&down_pipe, nbytes);
+            bridge_stats.down_bytes += nbytes;
+            usb_host_bridge_host_out_kick();
+        } else {
+            bridge_stats.down_dropped++;
+        }
+    }
+
+    usb_host_bridge_dev_out_arm();
+}
+
+static void usb_host_bridge_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    if (!dev_in_zlp && nbytes && ((nbytes % usbd_get_ep_mps(busid, ep)) == 0)) {
+        /* the transfer ends with a short packet, the PC read may be larger */
+        dev_in_zlp = true;
+        usbd_ep_start_write(busid, ep, NULL, 0);
+        return;
+    }
+
+    dev_in_zlp = false;
+    up_pipe.tx_busy = false;
+    usb_host_bridge_tx_done(&up_pipe);
+    usb_host_bridge_dev_in_kick();
+    usb_host_bridge_host_in_arm();
+}
+
+/*!< endpoint call back */
+USBD_EP_STATIC_TABLE(host_bridge_eps, HOST_BRIDGE_EP_LIST);
+
+static struct usbd_interface host_bridge_intf0 = {
+    .class_interface_handler = usb_host_bridge_class_handler
+};
+
+static struct usbd_interface host_bridge_intf1;
+
+/********************** bridge thread **************************/
+
+static void usb_host_bridge_set_line_coding(struct usbh_cdc_acm *cdc) {
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    memcpy(&host_line_coding, &dev_line_coding, sizeof(host_line_coding));
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+
+    if (usbh_cdc_acm_set_line_coding(cdc, &host_line_coding) < 0) {
+        USB_LOG_WRN("bridge: set line coding failed\r\n");
+    }
+}
+
+static void usb_host_bridge_set_line_state(struct usbh_cdc_acm *cdc) {
+    uint8_t state = dev_line_state;
+
+    if (usbh_cdc_acm_set_line_state(cdc, (state & CDC_LINE_STATE_DTR) != 0U, (state & CDC_LINE_STATE_RTS) != 0U) < 0) {
+        USB_LOG_WRN("bridge: set line state failed\r\n");
+    }
+}
+
+static void usb_host_bridge_start(void) {
+    if (usbd_initialize(bridge_busid, bridge_dev_reg_base, usb_host_bridge_event_handler) < 0) {
+        USB_LOG_ERR("bridge: device stack failed to start\r\n");
+    }
+    if (usbh_initialize(bridge_host_busid, bridge_host_reg_base) < 0) {
+        USB_LOG_ERR("bridge: host stack failed to start\r\n");
+    }
+}
+
+static void usb_host_bridge_thread(void *arg) {
+    uintptr_t event;
+
+    ARG_UNUSED(arg);
+
+    /* the kernel runs by now, the stacks may sleep */
+    usb_host_bridge_start();
+
+    while (1) {
+        if (usb_osal_mq_recv(bridge_mq, &event, USB_OSAL_WAITING_FOREVER) < 0) {
+            continue;
+        }
+
+        usb_osal_mutex_take(bridge_mutex);
+        if (bridge_cdc != NULL) {
+            switch (event) {
+                case BRIDGE_EVT_RUN:
+                    usb_host_bridge_set_line_coding(bridge_cdc);
+                    usb_host_bridge_set_line_state(bridge_cdc);
+
+                    usb_host_bridge_lock();
+                    if (host_cdc == NULL) {
+                        host_cdc = bridge_cdc;
+                        host_in_halted = false;
+                        usb_host_bridge_host_in_arm();
+                        usb_host_bridge_host_out_kick();
+                    }
+                    usb_host_bridge_unlock();
+                    break;
+                case BRIDGE_EVT_LINE_CODING:
+                    usb_host_bridge_set_line_coding(bridge_cdc);
+                    break;
+                case BRIDGE_EVT_LINE_STATE:
+                    usb_host_bridge_set_line_state(bridge_cdc);
+                    break;
+                default:
+                    break;
+            }
+        }
+        usb_osal_mutex_give(bridge_mutex);
+    }
+}
+
+/********************** host class hooks, PSC thread **************************/
+
+void usbh_cdc_acm_run(struct usbh_cdc_acm *cdc_acm_class) {
+    usb_osal_mutex_take(bridge_mutex);
+    if (bridge_cdc != NULL) {
+        /* the first CDC ACM interface is the bridged one */
+        usb_osal_mutex_give(bridge_mutex);
+        return;
+    }
+    bridge_cdc = cdc_acm_class;
+    usb_osal_mutex_give(bridge_mutex);
+
+    bridge_stats.connects++;
+    USB_LOG_INFO("bridge: downstream CDC ACM bound\r\n");
+    usb_osal_mq_send(bridge_mq, BRIDGE_EVT_RUN);
+}
+
+void usbh_cdc_acm_stop(struct usbh_cdc_acm *cdc_acm_class) {
+    usb_osal_mutex_take(bridge_mutex);
+    if (cdc_acm_class != bridge_cdc) {
+        usb_osal_mutex_give(bridge_mutex);
+        return;
+    }
+
+    /* the class killed both URBs, their buffers come back here */
+    usb_host_bridge_lock();
+    host_cdc = NULL;
+    host_in_halted = false;
+    up_pipe.rx_armed = false;
+    bridge_stats.down_dropped += usb_host_bridge_flush(&down_pipe);
+    usb_host_bridge_dev_out_arm();
+    usb_host_bridge_unlock();
+
+    bridge_cdc = NULL;
+    usb_osal_mutex_give(bridge_mutex);
+    USB_LOG_INFO("bridge: downstream CDC ACM gone\r\n");
+}
+
+/**
+ * @brief   Register the device and create the bridge thread, which starts
+ *          both stacks once the kernel runs
+ *
+ * @param   dev_busid       device bus, facing the PC
+ *
+ * @param   dev_reg_base    device core base address, USB_OTG_FS_PERIPH_BASE
+ *
+ * @param   host_busid      host bus, facing the downstream device
+ *
+ * @param   host_reg_base   host core base address, USB_OTG_HS_PERIPH_BASE
+ *
+ * @retval  0 on success, negative when an OSAL object failed
+ */
+int usb_host_bridge_init(uint8_t dev_busid, uint32_t dev_reg_base, uint8_t host_busid, uint32_t host_reg_base) {
+    bridge_busid = dev_busid;
+    bridge_dev_reg_base = dev_reg_base;
+    bridge_host_busid = host_busid;
+    bridge_host_reg_base = host_reg_base;
+    memset(&bridge_stats, 0, sizeof(bridge_stats));
+
+    bridge_mq = usb_osal_mq_create(BRIDGE_MQ_DEPTH);
+    bridge_mutex = usb_osal_mutex_create();
+    if ((bridge_mq == NULL) || (bridge_mutex == NULL) ||
+        (usb_osal_thread_create("bridge", USB_HOST_BRIDGE_STACKSIZE, USB_HOST_BRIDGE_PRIO,
+                                usb_host_bridge_thread, NULL) == NULL)) {
+        return -1;
+    }
+
+    usbd_desc_register(dev_busid, usb_host_bridge_descriptor);
+    usbd_add_interface(dev_busid, &host_bridge_intf0);
+    usbd_add_interface(dev_busid, &host_bridge_intf1);
+    usbd_ep_static_register(dev_busid, host_bridge_eps, USBD_EP_STATIC_COUNT(host_bridge_eps));
+
+    return 0;
+}
+
+void usb_host_bridge_get_stats(struct usb_host_bridge_stats *stats) {
+    usb_host_bridge_lock();
+    memcpy(stats, &bridge_stats, sizeof(bridge_stats));
+    usb_host_bridge_unlock();
+}
+
+/**
+ * @brief   OTG_HS core in host mode on its embedded full speed PHY
+ *
+ * @param   bus     host bus
+ *
+ * @retval  None
+ */
+void usb_hc_low_level_init(struct usbh_bus *bus) {
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    ARG_UNUSED(bus);
+
+    /* Configure USB OTG GPIO */
+    __DAL_RCM_GPIOB_CLK_ENABLE();
+
+    /* USB DM, DP pin configuration */
+    GPIO_InitStruct.Pin         = GPIO_PIN_14 | GPIO_PIN_15;
+    GPIO_InitStruct.Mode        = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull        = GPIO_NOPULL;
+    GPIO_InitStruct.Speed       = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate   = GPIO_AF12_OTG_HS_FS;
+    DAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+#if defined(USB_HOST_BRIDGE_VBUS_PORT) && defined(USB_HOST_BRIDGE_VBUS_PIN)
+    GPIO_InitStruct.Pin         = USB_HOST_BRIDGE_VBUS_PIN;
+    GPIO_InitStruct.Mode        = GPIO_MODE_OUTPUT_PP;
+    GPIO_InitStruct.Speed       = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate   = 0U;
+    DAL_GPIO_Init(USB_HOST_BRIDGE_VBUS_PORT, &GPIO_InitStruct);
+    DAL_GPIO_WritePin(USB_HOST_BRIDGE_VBUS_PORT, USB_HOST_BRIDGE_VBUS_PIN, GPIO_PIN_SET);
+#endif
+
+    /* Configure USB OTG, no ULPI PHY behind it */
+    __DAL_RCM_USB_OTG_HS_CLK_ENABLE();
+    __DAL_RCM_USB_OTG_HS_ULPI_CLK_SLEEP_DISABLE();
+
+    /* Configure interrupt, same level as OTG_FS_IRQn */
+    DAL_NVIC_SetPriority(OTG_HS_IRQn, 1U, 0U);
+    DAL_NVIC_EnableIRQ(OTG_HS_IRQn);
+}
+
+void usb_hc_low_level_deinit(struct usbh_bus *bus) {
+    ARG_UNUSED(bus);
+
+#if defined(USB_HOST_BRIDGE_VBUS_PORT) && defined(USB_HOST_BRIDGE_VBUS_PIN)
+    DAL_GPIO_WritePin(USB_HOST_BRIDGE_VBUS_PORT, USB_HOST_BRIDGE_VBUS_PIN, GPIO_PIN_RESET);
+#endif
+
+    /* Disable peripheral clock */
+    __DAL_RCM_USB_OTG_HS_CLK_DISABLE();
+
+    /* USB DM, DP pin configuration */
+    DAL_GPIO_DeInit(GPIOB, GPIO_PIN_14 | GPIO_PIN_15);
+
+    /* Disable peripheral interrupt */
+    DAL_NVIC_DisableIRQ(OTG_HS_IRQn);
+}
+
+#endif /* DEMO_SELECT == DEMO_USB_HOST_BRIDGE */
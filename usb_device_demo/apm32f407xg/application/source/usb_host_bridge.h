@@ -0,0 +1,76 @@
+/**
+  * @file    usb_host_bridge.h
+  * @author  LuckkMaker
+  * @brief   CDC ACM device on OTG_FS bridged to a CDC ACM device behind the OTG_HS host
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_HOST_BRIDGE_H
+#define USB_HOST_BRIDGE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< buffer size, a multiple of the bulk MPS on both buses */
+#ifndef USB_HOST_BRIDGE_BUF_SIZE
+#define USB_HOST_BRIDGE_BUF_SIZE        512U
+#endif
+
+/*!< buffers per direction, a full direction leaves its producer NAKing */
+#ifndef USB_HOST_BRIDGE_BUF_NUM
+#define USB_HOST_BRIDGE_BUF_NUM         4U
+#endif
+
+/*!< thread forwarding the line coding and line state downstream */
+#ifndef USB_HOST_BRIDGE_STACKSIZE
+#define USB_HOST_BRIDGE_STACKSIZE       1024U
+#endif
+
+#ifndef USB_HOST_BRIDGE_PRIO
+#define USB_HOST_BRIDGE_PRIO            4U
+#endif
+
+/*!< define USB_HOST_BRIDGE_VBUS_PORT and USB_HOST_BRIDGE_VBUS_PIN to switch
+ *   the downstream VBUS from an active high GPIO */
+
+/*!< bridge counters, every backpressure point has its own counter */
+struct usb_host_bridge_stats {
+    uint32_t connects;          /*!< downstream CDC ACM devices bound */
+    uint32_t down_bytes;        /*!< bytes received from the PC for the downstream device */
+    uint32_t down_dropped;      /*!< OUT transfers dropped, no downstream device */
+    uint32_t down_throttled;    /*!< device OUT left NAKing because no buffer was free */
+    uint32_t up_bytes;          /*!< bytes received from the downstream device for the PC */
+    uint32_t up_dropped;        /*!< IN transfers dropped, the PC side is not configured */
+    uint32_t up_throttled;      /*!< host IN left unarmed because no buffer was free */
+    uint32_t host_errors;       /*!< failed host URBs */
+};
+
+int usb_host_bridge_init(uint8_t dev_busid, uint32_t dev_reg_base, uint8_t host_busid, uint32_t host_reg_base);
+void usb_host_bridge_get_stats(struct usb_host_bridge_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_HOST_BRIDGE_H */
@@ -0,0 +1,504 @@
+/**
+  * @file    usb_osal_freertos.c
+  * @author  LuckkMaker
+  * @brief   CherryUSB OSAL on FreeRTOS with statically allocated objects
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Built with CONFIG_USB_OSAL=1, which the CMake FREERTOS_DIR option sets.
+  * The stack then runs MSC SCSI commands in its own thread
+  * (CONFIG_USBDEV_MSC_THREAD) and the host hub and port status work in the
+  * PSC thread; the bulk and hub interrupts only give a semaphore or post a
+  * message. Semaphore give, message send and timer start/stop take the
+  * FromISR path when called from an exception, found from IPSR.
+  *
+  * Objects come from the static pools of usb_osal_port.h, there is no
+  * kernel heap. A thread's stack is stack_size bytes of the shared stack
+  * pool; a deleted thread's TCB and stack go back to the pool only once
+  * portCLEAN_UP_TCB() reports the kernel released them, for a thread that
+  * deleted itself that is in the idle task. A deleted timer's slot is
+  * released by a call the timer task runs after the delete command.
+  *
+  * CherryUSB priorities count down from 0, the most urgent, FreeRTOS ones
+  * up, they are mapped as configMAX_PRIORITIES - 1 - prio.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_config.h"
+
+#if CONFIG_USB_OSAL
+#include "usb_osal.h"
+#include "usb_errno.h"
+#include "usb_osal_port.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include "main.h"
+#include <stdlib.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+
+/* Private typedef -----------------------------------------------------------*/
+struct usb_osal_thread_slot {
+    StaticTask_t tcb;
+    StackType_t *stack;         /*!< kept for the next thread once released */
+    uint32_t depth;             /*!< stack words */
+    bool used;
+};
+
+struct usb_osal_mq_slot {
+    StaticQueue_t queue;
+    uintptr_t *storage;         /*!< kept for the next queue once deleted */
+    uint32_t depth;             /*!< messages */
+    bool used;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USB_OSAL_STACK_WORDS        (USB_OSAL_STACK_POOL_SIZE / sizeof(StackType_t))
+
+/* Private macro -------------------------------------------------------------*/
+#define USB_OSAL_IN_ISR()           (__get_IPSR() != 0U)
+
+/* Private variables ---------------------------------------------------------*/
+static struct usb_osal_thread_slot usb_osal_threads[USB_OSAL_THREAD_MAX];
+static StackType_t usb_osal_stack_pool[USB_OSAL_STACK_WORDS] __attribute__((aligned(8)));
+static uint32_t usb_osal_stack_used;
+
+static StaticSemaphore_t usb_osal_sems[USB_OSAL_SEM_MAX];
+static bool usb_osal_sem_used[USB_OSAL_SEM_MAX];
+
+static StaticSemaphore_t usb_osal_mutexes[USB_OSAL_MUTEX_MAX];
+static bool usb_osal_mutex_used[USB_OSAL_MUTEX_MAX];
+
+static struct usb_osal_mq_slot usb_osal_mqs[USB_OSAL_MQ_MAX];
+static uintptr_t usb_osal_mq_pool[USB_OSAL_MQ_POOL_SIZE];
+static uint32_t usb_osal_mq_pool_used;
+
+static struct usb_osal_timer usb_osal_timers[USB_OSAL_TIMER_MAX];
+static StaticTimer_t usb_osal_timer_bufs[USB_OSAL_TIMER_MAX];
+static bool usb_osal_timer_used[USB_OSAL_TIMER_MAX];
+
+static StaticTask_t usb_osal_idle_tcb;
+static StackType_t usb_osal_idle_stack[configMINIMAL_STACK_SIZE];
+static StaticTask_t usb_osal_timer_tcb;
+static StackType_t usb_osal_timer_stack[configTIMER_TASK_STACK_DEPTH];
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static int usb_osal_claim(bool *used, uint32_t num) {
+    uint32_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < num; i++) {
+        if (!used[i]) {
+            used[i] = true;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return (i < num) ? (int)i : -1;
+}
+
+static void usb_osal_yield_from_isr(BaseType_t woken) {
+    portYIELD_FROM_ISR(woken);
+}
+
+/**
+ * @brief   Create a thread on a stack from the pool
+ *
+ * @param   name         thread name
+ *
+ * @param   stack_size   stack bytes
+ *
+ * @param   prio         CherryUSB priority, 0 is the most urgent
+ *
+ * @param   entry        thread function
+ *
+ * @param   args         passed to entry
+ *
+ * @retval  thread handle, NULL if no slot or stack was left
+ */
+usb_osal_thread_t usb_osal_thread_create(const char *name, uint32_t stack_size, uint32_t prio, usb_thread_entry_t entry, void *args) {
+    struct usb_osal_thread_slot *slot = NULL;
+    uint32_t depth = (stack_size + sizeof(StackType_t) - 1U) / sizeof(StackType_t);
+    UBaseType_t rtos_prio;
+    uint32_t i;
+
+    if (prio >= (configMAX_PRIORITIES - 1U)) {
+        prio = configMAX_PRIORITIES - 2U;
+    }
+    rtos_prio = configMAX_PRIORITIES - 1U - prio;
+
+    taskENTER_CRITICAL();
+    /* A released stack that fits first, then a new one */
+    for (i = 0; i < USB_OSAL_THREAD_MAX; i++) {
+        if (!usb_osal_threads[i].used && (usb_osal_threads[i].depth >= depth)) {
+            slot = &usb_osal_threads[i];
+            break;
+        }
+    }
+    if ((slot == NULL) && ((USB_OSAL_STACK_WORDS - usb_osal_stack_used) >= depth)) {
+        for (i = 0; i < USB_OSAL_THREAD_MAX; i++) {
+            if (!usb_osal_threads[i].used && (usb_osal_threads[i].stack == NULL)) {
+                slot = &usb_osal_threads[i];
+                slot->stack = &usb_osal_stack_pool[usb_osal_stack_used];
+                slot->depth = depth;
+                usb_osal_stack_used += depth;
+                break;
+            }
+        }
+    }
+    if (slot != NULL) {
+        slot->used = true;
+    }
+    taskEXIT_CRITICAL();
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    return (usb_osal_thread_t)xTaskCreateStatic(entry, name, slot->depth, args, rtos_prio, slot->stack, &slot->tcb);
+}
+
+/**
+ * @brief   Delete a thread, NULL for the calling one
+ *
+ * @param   thread   thread handle
+ *
+ * @retval  None
+ */
+void usb_osal_thread_delete(usb_osal_thread_t thread) {
+    vTaskDelete((TaskHandle_t)thread);
+}
+
+/**
+ * @brief   Release the slot of a deleted thread, portCLEAN_UP_TCB() hook
+ *
+ * @param   tcb   TCB the kernel is done with
+ *
+ * @retval  None
+ */
+void usb_osal_thread_cleanup(void *tcb) {
+    uint32_t i;
+
+    for (i = 0; i < USB_OSAL_THREAD_MAX; i++) {
+        if (tcb == &usb_osal_threads[i].tcb) {
+            usb_osal_threads[i].used = false;
+            break;
+        }
+    }
+}
+
+usb_osal_sem_t usb_osal_sem_create(uint32_t initial_count) {
+    int i = usb_osal_claim(usb_osal_sem_used, USB_OSAL_SEM_MAX);
+
+    if (i < 0) {
+        return NULL;
+    }
+
+    return (usb_osal_sem_t)xSemaphoreCreateCountingStatic(USB_OSAL_SEM_COUNT_MAX, initial_count, &usb_osal_sems[i]);
+}
+
+void usb_osal_sem_delete(usb_osal_sem_t sem) {
+    StaticSemaphore_t *buf = (StaticSemaphore_t *)sem;
+
+    vSemaphoreDelete((SemaphoreHandle_t)sem);
+    usb_osal_sem_used[buf - usb_osal_sems] = false;
+}
+
+/**
+ * @brief   Take a semaphore, from a thread
+ *
+ * @param   sem       semaphore
+ *
+ * @param   timeout   ms, USB_OSAL_WAITING_FOREVER to block
+ *
+ * @retval  0 on success, -USB_ERR_TIMEOUT
+ */
+int usb_osal_sem_take(usb_osal_sem_t sem, uint32_t timeout) {
+    TickType_t ticks = (timeout == USB_OSAL_WAITING_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+
+    return (xSemaphoreTake((SemaphoreHandle_t)sem, ticks) == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+/**
+ * @brief   Give a semaphore, from a thread or an interrupt
+ *
+ * @param   sem   semaphore
+ *
+ * @retval  0 on success, -USB_ERR_TIMEOUT if its count is at the maximum
+ */
+int usb_osal_sem_give(usb_osal_sem_t sem) {
+    BaseType_t woken = pdFALSE;
+    BaseType_t ret;
+
+    if (USB_OSAL_IN_ISR()) {
+        ret = xSemaphoreGiveFromISR((SemaphoreHandle_t)sem, &woken);
+        usb_osal_yield_from_isr(woken);
+    } else {
+        ret = xSemaphoreGive((SemaphoreHandle_t)sem);
+    }
+
+    return (ret == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+void usb_osal_sem_reset(usb_osal_sem_t sem) {
+    xQueueReset((QueueHandle_t)sem);
+}
+
+usb_osal_mutex_t usb_osal_mutex_create(void) {
+    int i = usb_osal_claim(usb_osal_mutex_used, USB_OSAL_MUTEX_MAX);
+
+    if (i < 0) {
+        return NULL;
+    }
+
+    return (usb_osal_mutex_t)xSemaphoreCreateMutexStatic(&usb_osal_mutexes[i]);
+}
+
+void usb_osal_mutex_delete(usb_osal_mutex_t mutex) {
+    StaticSemaphore_t *buf = (StaticSemaphore_t *)mutex;
+
+    vSemaphoreDelete((SemaphoreHandle_t)mutex);
+    usb_osal_mutex_used[buf - usb_osal_mutexes] = false;
+}
+
+int usb_osal_mutex_take(usb_osal_mutex_t mutex) {
+    return (xSemaphoreTake((SemaphoreHandle_t)mutex, portMAX_DELAY) == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+int usb_osal_mutex_give(usb_osal_mutex_t mutex) {
+    return (xSemaphoreGive((SemaphoreHandle_t)mutex) == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+/**
+ * @brief   Create a queue of pointer sized messages, storage from the pool
+ *
+ * @param   max_msgs   queue depth
+ *
+ * @retval  queue handle, NULL if no slot or storage was left
+ */
+usb_osal_mq_t usb_osal_mq_create(uint32_t max_msgs) {
+    struct usb_osal_mq_slot *slot = NULL;
+    uint32_t i;
+
+    taskENTER_CRITICAL();
+    for (i = 0; i < USB_OSAL_MQ_MAX; i++) {
+        if (!usb_osal_mqs[i].used && (usb_osal_mqs[i].depth >= max_msgs)) {
+            slot = &usb_osal_mqs[i];
+            break;
+        }
+    }
+    if ((slot == NULL) && ((USB_OSAL_MQ_POOL_SIZE - usb_osal_mq_pool_used) >= max_msgs)) {
+        for (i = 0; i < USB_OSAL_MQ_MAX; i++) {
+            if (!usb_osal_mqs[i].used && (usb_osal_mqs[i].storage == NULL)) {
+                slot = &usb_osal_mqs[i];
+                slot->storage = &usb_osal_mq_pool[usb_osal_mq_pool_used];
+                slot->depth = max_msgs;
+                usb_osal_mq_pool_used += max_msgs;
+                break;
+            }
+        }
+    }
+    if (slot != NULL) {
+        slot->used = true;
+    }
+    taskEXIT_CRITICAL();
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    return (usb_osal_mq_t)xQueueCreateStatic(max_msgs, sizeof(uintptr_t), (uint8_t *)slot->storage, &slot->queue);
+}
+
+void usb_osal_mq_delete(usb_osal_mq_t mq) {
+    struct usb_osal_mq_slot *slot = (struct usb_osal_mq_slot *)mq;
+
+    vQueueDelete((QueueHandle_t)mq);
+    slot->used = false;
+}
+
+/**
+ * @brief   Post a message, from a thread or an interrupt, never blocks
+ *
+ * @param   mq     queue
+ *
+ * @param   addr   message
+ *
+ * @retval  0 on success, -USB_ERR_TIMEOUT if the queue is full
+ */
+int usb_osal_mq_send(usb_osal_mq_t mq, uintptr_t addr) {
+    BaseType_t woken = pdFALSE;
+    BaseType_t ret;
+
+    if (USB_OSAL_IN_ISR()) {
+        ret = xQueueSendFromISR((QueueHandle_t)mq, &addr, &woken);
+        usb_osal_yield_from_isr(woken);
+    } else {
+        ret = xQueueSend((QueueHandle_t)mq, &addr, 0);
+    }
+
+    return (ret == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+int usb_osal_mq_recv(usb_osal_mq_t mq, uintptr_t *addr, uint32_t timeout) {
+    TickType_t ticks = (timeout == USB_OSAL_WAITING_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+
+    return (xQueueReceive((QueueHandle_t)mq, addr, ticks) == pdTRUE) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+static void usb_osal_timer_cb(TimerHandle_t handle) {
+    struct usb_osal_timer *timer = (struct usb_osal_timer *)pvTimerGetTimerID(handle);
+
+    timer->handler(timer->argument);
+}
+
+struct usb_osal_timer *usb_osal_timer_create(const char *name, uint32_t timeout_ms, usb_timer_handler_t handler, void *argument, bool is_period) {
+    struct usb_osal_timer *timer;
+    int i = usb_osal_claim(usb_osal_timer_used, USB_OSAL_TIMER_MAX);
+
+    if (i < 0) {
+        return NULL;
+    }
+
+    timer = &usb_osal_timers[i];
+    timer->handler = handler;
+    timer->argument = argument;
+    timer->is_period = is_period;
+    timer->timeout_ms = timeout_ms;
+    timer->timer = (void *)xTimerCreateStatic(name, pdMS_TO_TICKS(timeout_ms), is_period ? pdTRUE : pdFALSE,
+                                              timer, usb_osal_timer_cb, &usb_osal_timer_bufs[i]);
+
+    return timer;
+}
+
+static void usb_osal_timer_release(void *unused, uint32_t i) {
+    (void)unused;
+
+    usb_osal_timer_used[i] = false;
+}
+
+void usb_osal_timer_delete(struct usb_osal_timer *timer) {
+    uint32_t i = (uint32_t)(timer - usb_osal_timers);
+
+    xTimerStop((TimerHandle_t)timer->timer, portMAX_DELAY);
+    xTimerDelete((TimerHandle_t)timer->timer, portMAX_DELAY);
+    /* the delete is only queued, the timer task owns the StaticTimer_t until it has run it */
+    xTimerPendFunctionCall(usb_osal_timer_release, NULL, i, portMAX_DELAY);
+}
+
+void usb_osal_timer_start(struct usb_osal_timer *timer) {
+    BaseType_t woken = pdFALSE;
+
+    if (USB_OSAL_IN_ISR()) {
+        xTimerStartFromISR((TimerHandle_t)timer->timer, &woken);
+        usb_osal_yield_from_isr(woken);
+    } else {
+        xTimerStart((TimerHandle_t)timer->timer, portMAX_DELAY);
+    }
+}
+
+void usb_osal_timer_stop(struct usb_osal_timer *timer) {
+    BaseType_t woken = pdFALSE;
+
+    if (USB_OSAL_IN_ISR()) {
+        xTimerStopFromISR((TimerHandle_t)timer->timer, &woken);
+        usb_osal_yield_from_isr(woken);
+    } else {
+        xTimerStop((TimerHandle_t)timer->timer, portMAX_DELAY);
+    }
+}
+
+/**
+ * @brief   Mask the kernel aware interrupts, OTG_FS_IRQn among them
+ *
+ * @param   None
+ *
+ * @retval  state for usb_osal_leave_critical_section()
+ */
+size_t usb_osal_enter_critical_section(void) {
+    size_t flag;
+
+    if (USB_OSAL_IN_ISR()) {
+        flag = taskENTER_CRITICAL_FROM_ISR();
+    } else {
+        taskENTER_CRITICAL();
+        flag = 1;
+    }
+
+    return flag;
+}
+
+void usb_osal_leave_critical_section(size_t flag) {
+    if (USB_OSAL_IN_ISR()) {
+        taskEXIT_CRITICAL_FROM_ISR(flag);
+    } else {
+        taskEXIT_CRITICAL();
+    }
+}
+
+void usb_osal_msleep(uint32_t delay) {
+    vTaskDelay(pdMS_TO_TICKS(delay));
+}
+
+void *usb_osal_malloc(size_t size) {
+    return usb_malloc(size);
+}
+
+void usb_osal_free(void *ptr) {
+    usb_free(ptr);
+}
+
+/**
+ * @brief   Kernel tick, from SysTick_Handler once the scheduler runs
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_osal_tick_handler(void) {
+    extern void xPortSysTickHandler(void);
+
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED) {
+        xPortSysTickHandler();
+    }
+}
+
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *depth) {
+    *tcb = &usb_osal_idle_tcb;
+    *stack = usb_osal_idle_stack;
+    *depth = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **stack, uint32_t *depth) {
+    *tcb = &usb_osal_timer_tcb;
+    *stack = usb_osal_timer_stack;
+    *depth = configTIMER_TASK_STACK_DEPTH;
+}
+
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name) {
+    (void)task;
+    (void)name;
+
+    DAL_ErrorHandler();
+}
+#endif /* CONFIG_USB_OSAL */
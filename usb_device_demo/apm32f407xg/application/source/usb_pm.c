@@ -0,0 +1,358 @@
+/**
+  * @file    usb_pm.c
+  * @author  LuckkMaker
+  * @brief   USB suspend and resume power management
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The demo's event handler passes every event to usb_pm_event_handler(),
+  * the main loop calls usb_pm_poll(), or a task does once the notify
+  * callback reported a suspend or a remote wakeup request. Once the host suspended the bus the
+  * poll stops the PHY clock, gates the core's HCLK and enters STOP with the
+  * low power regulator, interrupts masked so that a resume arriving in
+  * between just makes the WFI fall through. STOP halts every USB core, so
+  * usb_pm is left out of builds with more than one device bus.
+  *
+  * A host that suspends for a short idle spell gets it back in a few
+  * microseconds: for the first USB_PM_STOP_DELAY_MS of a suspend the poll
+  * only gates the PHY and sleeps with WFI, clocks running. This stands in
+  * for LPM L1, which the OTG_FS core of the APM32F407 does not implement
+  * (no GLPMCFG, no LPM token handshake), so the descriptors keep bcdUSB
+  * 2.00 and no host sends it LPM transactions.
+  *
+  * Resume signaling raises OTG_FS_WKUP_IRQn on EINT line 18, which works
+  * with the PHY gated and the clocks stopped. The core wakes on HSI,
+  * DAL_SysClkResume() brings HSE and the PLL back, then the interrupts are
+  * unmasked: the wakeup handler ungates the PHY and the core reports the
+  * resume to the DCD as usual. Any other interrupt leaves the poll in STOP.
+  *
+  * If the host enabled it, usb_pm_request_remote_wakeup(), e.g. from the
+  * key interrupt, makes the poll drive resume signaling for USB_PM_RWKUP_MS.
+  * The core raises no interrupt for its own signaling, so the resume event
+  * is posted to the core from here.
+  *
+  * With CYCLE_PROF_ENABLE=1 the stop_exit probe times the clock restore,
+  * resume_xfer and resume_xfer_slp the wakeup interrupt to the first
+  * endpoint interrupt, after STOP and after the light sleep.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_pm.h"
+
+#if USB_PM_ENABLE
+
+/* Private includes ----------------------------------------------------------*/
+#include "apm32f4xx_device_cfg.h"
+
+/* Private typedef -----------------------------------------------------------*/
+struct usb_pm {
+    uint32_t reg_base;
+    uint8_t busid;
+    volatile bool suspended;
+    volatile bool woken;            /*!< resume signaling seen on the wakeup line */
+    volatile bool rwkup_request;
+    volatile bool rwkup_enabled;    /*!< DEVICE_REMOTE_WAKEUP feature set by the host */
+    volatile bool stopped;          /*!< the last sleep was STOP */
+    void (*notify)(void);
+    uint32_t suspend_tick;
+#if CYCLE_PROF_ENABLE
+    volatile bool xfer_pending;     /*!< no transfer since the last wakeup */
+    enum cycle_prof_id xfer_probe;
+    uint32_t wake_t;
+#endif
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USB_PM_GLOBAL               ((USB_OTG_GlobalTypeDef *)usb_pm.reg_base)
+#define USB_PM_DEVICE               ((USB_OTG_DeviceTypeDef *)(usb_pm.reg_base + USB_OTG_DEVICE_BASE))
+#define USB_PM_PCGCCTL              (*(__IO uint32_t *)(usb_pm.reg_base + USB_OTG_PCGCCTL_BASE))
+
+/* Private macro -------------------------------------------------------------*/
+#define USB_PM_LOCK(m)              do { (m) = __get_PRIMASK(); __disable_irq(); } while (0)
+#define USB_PM_UNLOCK(m)            __set_PRIMASK(m)
+
+/* Private variables ---------------------------------------------------------*/
+static struct usb_pm usb_pm;
+static struct usb_pm_stats usb_pm_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void usb_pm_gate(void) {
+    USB_PM_PCGCCTL |= USB_OTG_PCGCCTL_STOPCLK | USB_OTG_PCGCCTL_GATECLK;
+}
+
+static void usb_pm_ungate(void) {
+    USB_PM_PCGCCTL &= ~(USB_OTG_PCGCCTL_STOPCLK | USB_OTG_PCGCCTL_GATECLK);
+}
+
+static void usb_pm_mark_wake(void) {
+#if CYCLE_PROF_ENABLE
+    usb_pm.wake_t = cycle_prof_now();
+    usb_pm.xfer_probe = usb_pm.stopped ? CYCLE_PROF_RESUME_XFER : CYCLE_PROF_RESUME_XFER_SLP;
+    usb_pm.xfer_pending = true;
+#endif
+}
+
+static void usb_pm_remote_wakeup(void) {
+    usb_pm.rwkup_request = false;
+    if (!usb_pm.suspended || !usb_pm.rwkup_enabled) {
+        return;
+    }
+
+    usb_pm_ungate();
+    usb_pm.stopped = false;
+
+    USB_PM_DEVICE->DCTRL |= USB_OTG_DCTRL_RWKUPS;
+    DAL_Delay(USB_PM_RWKUP_MS);
+    USB_PM_DEVICE->DCTRL &= ~USB_OTG_DCTRL_RWKUPS;
+    usb_pm_stats.remote_wakeups++;
+    usb_pm_mark_wake();
+
+    /* the wakeup line saw our own K state */
+    EINT->IPEND = USB_PM_WKUP_EINT_LINE;
+    DAL_NVIC_ClearPendingIRQ(OTG_FS_WKUP_IRQn);
+    usb_pm.woken = false;
+
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    usbd_event_resume_handler(usb_pm.busid);
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+}
+
+/**
+ * @brief   Set up the wakeup line and the optional wakeup key
+ *
+ * @param   busid      USB bus id
+ *
+ * @param   reg_base   OTG_FS core base address
+ *
+ * @retval  0
+ */
+int usb_pm_init(uint8_t busid, uint32_t reg_base) {
+    usb_pm.busid = busid;
+    usb_pm.reg_base = reg_base;
+    usb_pm.suspended = false;
+    usb_pm.woken = false;
+    usb_pm.rwkup_request = false;
+    usb_pm.rwkup_enabled = false;
+
+    __DAL_RCM_PMU_CLK_ENABLE();
+
+    /* resume signaling is a rising edge on the internal wakeup line */
+    EINT->FTEN &= ~USB_PM_WKUP_EINT_LINE;
+    EINT->RTEN |= USB_PM_WKUP_EINT_LINE;
+    EINT->IPEND = USB_PM_WKUP_EINT_LINE;
+    EINT->IMASK |= USB_PM_WKUP_EINT_LINE;
+
+    DAL_NVIC_SetPriority(OTG_FS_WKUP_IRQn, USB_PM_WKUP_PRIO, 0U);
+    DAL_NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+
+#if USB_PM_KEY_ENABLE
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    GPIO_InitStruct.Pin         = USB_PM_KEY_PIN;
+    GPIO_InitStruct.Mode        = GPIO_MODE_IT_RISING;
+    GPIO_InitStruct.Pull        = GPIO_PULLDOWN;
+    DAL_GPIO_Init(USB_PM_KEY_PORT, &GPIO_InitStruct);
+
+    DAL_NVIC_SetPriority(USB_PM_KEY_IRQn, USB_PM_KEY_PRIO, 0U);
+    DAL_NVIC_EnableIRQ(USB_PM_KEY_IRQn);
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief   Track the bus state, called from the demo's USB event handler
+ *
+ * @param   busid   USB bus id
+ *
+ * @param   event   USBD_EVENT_*
+ *
+ * @retval  None
+ */
+void usb_pm_event_handler(uint8_t busid, uint8_t event) {
+    /* the other buses are not suspended by usb_pm */
+    if (busid != usb_pm.busid) {
+        return;
+    }
+
+    switch (event) {
+        case USBD_EVENT_SUSPEND:
+            if (!usb_pm.suspended) {
+                usb_pm_stats.suspends++;
+                usb_pm.suspend_tick = DAL_GetTick();
+            }
+            usb_pm.suspended = true;
+            if (usb_pm.notify != NULL) {
+                usb_pm.notify();
+            }
+            break;
+        case USBD_EVENT_RESUME:
+            usb_pm.suspended = false;
+            break;
+        case USBD_EVENT_RESET:
+        case USBD_EVENT_DISCONNECTED:
+            usb_pm_ungate();
+            usb_pm.suspended = false;
+            usb_pm.rwkup_enabled = false;
+            break;
+        case USBD_EVENT_SET_REMOTE_WAKEUP:
+            usb_pm.rwkup_enabled = true;
+            break;
+        case USBD_EVENT_CLR_REMOTE_WAKEUP:
+            usb_pm.rwkup_enabled = false;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief   Sleep while the bus is suspended, called from the main loop
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_pm_poll(void) {
+    uint32_t primask;
+
+    if (usb_pm.rwkup_request) {
+        usb_pm_remote_wakeup();
+    }
+
+    if (!usb_pm.suspended) {
+        return;
+    }
+
+    USB_PM_LOCK(primask);
+    while (usb_pm.suspended && !usb_pm.woken && !usb_pm.rwkup_request) {
+        usb_pm_gate();
+        usb_pm_stats.sleeps++;
+        usb_pm.stopped = USB_PM_STOP_ENABLE &&
+                         ((DAL_GetTick() - usb_pm.suspend_tick) >= USB_PM_STOP_DELAY_MS);
+        if (usb_pm.stopped) {
+            usb_pm_stats.stops++;
+            DAL_PMU_EnterSTOPMode(PMU_LOWPOWERREGULATOR_ON, PMU_STOPENTRY_WFI);
+            CYCLE_PROF_BEGIN(STOP_EXIT);
+            DAL_SysClkResume();
+            CYCLE_PROF_END(STOP_EXIT);
+        } else {
+            /* SysTick keeps waking it, the loop checks the delay again */
+            __WFI();
+        }
+        /* let the pending interrupt run, it may be the wakeup line */
+        __enable_irq();
+        __ISB();
+        __disable_irq();
+    }
+    usb_pm.woken = false;
+    USB_PM_UNLOCK(primask);
+
+    if (usb_pm.rwkup_request) {
+        usb_pm_remote_wakeup();
+    }
+}
+
+bool usb_pm_suspended(void) {
+    return usb_pm.suspended;
+}
+
+/**
+ * @brief   Ask for a remote wakeup, safe from any interrupt
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_pm_request_remote_wakeup(void) {
+    usb_pm.rwkup_request = true;
+    if (usb_pm.notify != NULL) {
+        usb_pm.notify();
+    }
+}
+
+/**
+ * @brief   Called when usb_pm_poll() has work, from interrupt context
+ *
+ * @param   notify   e.g. signals the task calling usb_pm_poll(), NULL for none
+ *
+ * @retval  None
+ */
+void usb_pm_set_notify(void (*notify)(void)) {
+    usb_pm.notify = notify;
+}
+
+/**
+ * @brief   Resume signaling on the wakeup line, from OTG_FS_WKUP_IRQHandler
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_pm_wakeup_irq_handler(void) {
+    EINT->IPEND = USB_PM_WKUP_EINT_LINE;
+
+    if (!usb_pm.suspended) {
+        return;
+    }
+
+    usb_pm_ungate();
+    usb_pm_mark_wake();
+    usb_pm.woken = true;
+    usb_pm_stats.resumes++;
+}
+
+/**
+ * @brief   Wakeup key edge, from the EINT handler of USB_PM_KEY_PIN
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_pm_key_irq_handler(void) {
+#if USB_PM_KEY_ENABLE
+    if (EINT->IPEND & USB_PM_KEY_PIN) {
+        EINT->IPEND = USB_PM_KEY_PIN;
+        usb_pm_request_remote_wakeup();
+    }
+#endif
+}
+
+#if CYCLE_PROF_ENABLE
+void usb_pm_usb_irq_entry(void) {
+    USB_OTG_GlobalTypeDef *global = USB_PM_GLOBAL;
+
+    if (usb_pm.xfer_pending &&
+        (global->GCINT & global->GINTMASK & (USB_OTG_GCINT_INEP | USB_OTG_GCINT_ONEP))) {
+        usb_pm.xfer_pending = false;
+        cycle_prof_record(usb_pm.xfer_probe, cycle_prof_now() - usb_pm.wake_t);
+    }
+}
+#endif /* CYCLE_PROF_ENABLE */
+
+void usb_pm_get_stats(struct usb_pm_stats *stats) {
+    uint32_t primask;
+
+    USB_PM_LOCK(primask);
+    *stats = usb_pm_stats;
+    USB_PM_UNLOCK(primask);
+}
+
+#endif /* USB_PM_ENABLE */
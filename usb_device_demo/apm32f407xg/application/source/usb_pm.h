@@ -0,0 +1,114 @@
+/**
+  * @file    usb_pm.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_pm.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_PM_H
+#define USB_PM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+#include "cycle_prof.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< suspend handling, STOP freezes every core so it is only built for a single device bus */
+#ifndef USB_PM_ENABLE
+#define USB_PM_ENABLE               (CONFIG_USBDEV_MAX_BUS == 1)
+#endif
+
+#if USB_PM_ENABLE && (CONFIG_USBDEV_MAX_BUS > 1)
+#error "USB_PM_ENABLE enters STOP on a bus 0 suspend, which stops the other buses too"
+#endif
+
+/*!< STOP mode while suspended, 0 sleeps with WFI and only gates the PHY clock */
+#ifndef USB_PM_STOP_ENABLE
+#define USB_PM_STOP_ENABLE          1
+#endif
+
+/*!< suspend time spent in the light sleep before STOP, a resume within it
+ *   costs microseconds instead of the HSE and PLL restart */
+#ifndef USB_PM_STOP_DELAY_MS
+#define USB_PM_STOP_DELAY_MS        10U
+#endif
+
+/*!< remote wakeup signaling, 1 to 15 ms by USB 2.0 7.1.7.7 */
+#ifndef USB_PM_RWKUP_MS
+#define USB_PM_RWKUP_MS             5U
+#endif
+
+/*!< wakeup key, its rising edge requests a remote wakeup */
+#ifndef USB_PM_KEY_ENABLE
+#define USB_PM_KEY_ENABLE           0
+#endif
+
+#ifndef USB_PM_KEY_PORT
+#define USB_PM_KEY_PORT             GPIOA
+#define USB_PM_KEY_PIN              GPIO_PIN_0
+#define USB_PM_KEY_IRQn             EINT0_IRQn
+#endif
+
+#define USB_PM_WKUP_PRIO            1U      /*!< same as OTG_FS_IRQn */
+#define USB_PM_KEY_PRIO             2U
+
+/*!< EINT line of OTG_FS_WKUP_IRQn */
+#define USB_PM_WKUP_EINT_LINE       (1UL << 18)
+
+struct usb_pm_stats {
+    uint32_t suspends;          /*!< suspends signaled by the host */
+    uint32_t sleeps;            /*!< STOP or sleep entries, other interrupts wake the core too */
+    uint32_t stops;             /*!< those of them in STOP */
+    uint32_t resumes;           /*!< resume signaling seen on the wakeup line */
+    uint32_t remote_wakeups;    /*!< remote wakeup signals sent */
+};
+
+#if USB_PM_ENABLE && CYCLE_PROF_ENABLE
+/*!< first thing in OTG_FS_IRQHandler, times the first transfer after a resume */
+#define USB_PM_USB_IRQ_ENTRY()      usb_pm_usb_irq_entry()
+
+void usb_pm_usb_irq_entry(void);
+#else
+#define USB_PM_USB_IRQ_ENTRY()
+#endif
+
+#if USB_PM_ENABLE
+
+int usb_pm_init(uint8_t busid, uint32_t reg_base);
+void usb_pm_event_handler(uint8_t busid, uint8_t event);
+void usb_pm_poll(void);
+bool usb_pm_suspended(void);
+void usb_pm_request_remote_wakeup(void);
+void usb_pm_set_notify(void (*notify)(void));
+void usb_pm_wakeup_irq_handler(void);
+void usb_pm_key_irq_handler(void);
+void usb_pm_get_stats(struct usb_pm_stats *stats);
+
+#endif /* USB_PM_ENABLE */
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_PM_H */
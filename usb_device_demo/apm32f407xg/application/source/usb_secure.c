@@ -0,0 +1,538 @@
+/**
+  * @file    usb_secure.c
+  * @author  LuckkMaker
+  * @brief   Vendor bulk channel for encrypted and authenticated uploads
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Frame format in secure_frame.h. Three things run at once:
+  *   - the bulk OUT endpoint fills one of two chunk buffers,
+  *   - the CRYP decrypts the payload received so far by DMA (secure_crypto.c),
+  *   - usb_secure_poll() copies the other chunk into the payload buffer and
+  *     feeds it to HMAC-SHA256 on the CPU.
+  * The HASH peripheral of the APM32F417 has no SHA-256, so the MAC is always
+  * computed in software. Without CRYP the payload is decrypted on the CPU too.
+  *
+  * The payload is only handed to usb_secure_commit() once the tag matched.
+  *
+  * Chunk buffers go from FREE to FULL in the USB interrupt and from FULL to
+  * FREE in usb_secure_poll(), each transition has one writer.
+  *
+  * Usage: tools/secure_pack.c pack config.bin frame.bin, then write frame.bin to
+  * bulk OUT 0x01 and read 8 bytes of status from bulk IN 0x81.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_secure.h"
+
+#if (DEMO_SELECT == DEMO_SECURE_UPLOAD)
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define USBD_VID           0x314B
+#define USBD_PID           0xF004
+#define USBD_MAX_POWER     100
+#define USBD_LANGID_STRING 1033
+
+/*!< endpoint address */
+#define SECURE_OUT_EP      0x01
+#define SECURE_IN_EP       0x81
+
+#ifdef CONFIG_USB_HS
+#define SECURE_MAX_MPS     512
+#else
+#define SECURE_MAX_MPS     64
+#endif
+
+/*!< config descriptor size */
+#define USB_CONFIG_SIZE (9 + 9 + 7 + 7)
+
+/*!< chunk buffer states */
+#define SECURE_CHUNK_FREE  0U
+#define SECURE_CHUNK_FULL  1U
+
+#if ((USB_SECURE_CHUNK_SIZE % SECURE_MAX_MPS) != 0) || ((USB_SECURE_CHUNK_SIZE % SW_AES_BLOCK_SIZE) != 0)
+#error "USB_SECURE_CHUNK_SIZE must be a multiple of the MPS and of the AES block"
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define SECURE_CYCLES_TO_MS(c)  ((uint32_t)((c) / (SystemCoreClock / 1000U)))
+
+/* Private variables ---------------------------------------------------------*/
+/*!< global descriptor */
+static const uint8_t usb_secure_descriptor[] = {
+    USB_DEVICE_DESCRIPTOR_INIT(USB_2_0, 0x00, 0x00, 0x00, USBD_VID, USBD_PID, 0x0100, 0x01),
+    USB_CONFIG_DESCRIPTOR_INIT(USB_CONFIG_SIZE, 0x01, 0x01, USB_CONFIG_BUS_POWERED, USBD_MAX_POWER),
+    /************** Descriptor of vendor interface *****************/
+    0x09,                          /* bLength: Interface Descriptor size */
+    USB_DESCRIPTOR_TYPE_INTERFACE, /* bDescriptorType: Interface descriptor type */
+    0x00,                          /* bInterfaceNumber: Number of Interface */
+    0x00,                          /* bAlternateSetting: Alternate setting */
+    0x02,                          /* bNumEndpoints */
+    0xFF,                          /* bInterfaceClass: Vendor Specific */
+    0x00,                          /* bInterfaceSubClass */
+    0x00,                          /* nInterfaceProtocol */
+    0x00,                          /* iInterface */
+    0x07,                          /* bLength: Endpoint Descriptor size */
+    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
+    SECURE_OUT_EP,                 /* bEndpointAddress: Endpoint Address (OUT) */
+    0x02,                          /* bmAttributes: Bulk endpoint */
+    WBVAL(SECURE_MAX_MPS),         /* wMaxPacketSize */
+    0x00,                          /* bInterval */
+    0x07,                          /* bLength: Endpoint Descriptor size */
+    USB_DESCRIPTOR_TYPE_ENDPOINT,  /* bDescriptorType: */
+    SECURE_IN_EP,                  /* bEndpointAddress: Endpoint Address (IN) */
+    0x02,                          /* bmAttributes: Bulk endpoint */
+    WBVAL(SECURE_MAX_MPS),         /* wMaxPacketSize */
+    0x00,                          /* bInterval */
+    ///////////////////////////////////////
+    /// string0 descriptor
+    ///////////////////////////////////////
+    USB_LANGID_INIT(USBD_LANGID_STRING),
+    ///////////////////////////////////////
+    /// string1 descriptor
+    ///////////////////////////////////////
+    0x14,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ///////////////////////////////////////
+    /// string2 descriptor
+    ///////////////////////////////////////
+    0x1E,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    'C', 0x00,                  /* wcChar0 */
+    'h', 0x00,                  /* wcChar1 */
+    'e', 0x00,                  /* wcChar2 */
+    'r', 0x00,                  /* wcChar3 */
+    'r', 0x00,                  /* wcChar4 */
+    'y', 0x00,                  /* wcChar5 */
+    'U', 0x00,                  /* wcChar6 */
+    'S', 0x00,                  /* wcChar7 */
+    'B', 0x00,                  /* wcChar8 */
+    ' ', 0x00,                  /* wcChar9 */
+    'S', 0x00,                  /* wcChar10 */
+    'C', 0x00,                  /* wcChar11 */
+    'F', 0x00,                  /* wcChar12 */
+    'G', 0x00,                  /* wcChar13 */
+    ///////////////////////////////////////
+    /// string3 descriptor
+    ///////////////////////////////////////
+    0x16,                       /* bLength */
+    USB_DESCRIPTOR_TYPE_STRING, /* bDescriptorType */
+    '2', 0x00,                  /* wcChar0 */
+    '0', 0x00,                  /* wcChar1 */
+    '2', 0x00,                  /* wcChar2 */
+    '4', 0x00,                  /* wcChar3 */
+    '1', 0x00,                  /* wcChar4 */
+    '2', 0x00,                  /* wcChar5 */
+    '3', 0x00,                  /* wcChar6 */
+    '4', 0x00,                  /* wcChar7 */
+    '5', 0x00,                  /* wcChar8 */
+    '9', 0x00,                  /* wcChar9 */
+#ifdef CONFIG_USB_HS
+    ///////////////////////////////////////
+    /// device qualifier descriptor
+    ///////////////////////////////////////
+    0x0a,
+    USB_DESCRIPTOR_TYPE_DEVICE_QUALIFIER,
+    0x00,
+    0x02,
+    0x00,
+    0x00,
+    0x00,
+    0x40,
+    0x01,
+    0x00,
+#endif
+    0x00
+};
+
+static const uint8_t secure_enc_key[SECURE_FRAME_KEY_SIZE] = SECURE_FRAME_DEMO_ENC_KEY;
+static const uint8_t secure_mac_key[SECURE_FRAME_KEY_SIZE] = SECURE_FRAME_DEMO_MAC_KEY;
+
+/*!< chunk buffers, one is received while the other is processed */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t chunk_buf[2][USB_SECURE_CHUNK_SIZE];
+static volatile uint8_t chunk_state[2];
+static volatile uint32_t chunk_len[2];
+static uint8_t chunk_next;
+static uint8_t chunk_work;
+static volatile bool out_armed;
+
+/*!< decrypted in place, room for the CRYP rounding up the last block */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t payload_buf[USB_SECURE_MAX_PAYLOAD + SW_AES_BLOCK_SIZE];
+
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX static uint8_t status_buf[SECURE_FRAME_STATUS_SIZE];
+/*!< status_buf is on the wire until the IN completion, the next status waits here */
+static volatile bool status_busy;
+static volatile bool status_pending;
+static uint32_t status_word[2];
+
+static uint8_t secure_busid;
+static volatile bool secure_configured;
+static volatile bool secure_abort_req;
+
+/*!< frame parser, owned by usb_secure_poll */
+static uint8_t frame_hdr[SECURE_FRAME_HDR_SIZE];
+static uint8_t frame_tag[SECURE_FRAME_TAG_SIZE];
+static uint32_t frame_hdr_len;
+static uint32_t frame_tag_len;
+static uint32_t frame_payload_len;
+static uint32_t frame_rx_len;
+static uint32_t frame_dec_len;
+static uint32_t frame_status;
+static uint32_t frame_start;
+static struct sw_hmac_sha256 frame_hmac;
+
+static struct usb_secure_stats secure_stats;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/**
+ * @brief   Authenticated payload, override to apply it
+ *
+ * @param   data decrypted payload
+ *
+ * @param   len  byte count
+ *
+ * @retval  None
+ */
+__WEAK void usb_secure_commit(const uint8_t *data, uint32_t len) {
+    (void)data;
+
+    USB_LOG_RAW("SCFG: %u byte configuration accepted\r\n", (unsigned int)len);
+}
+
+static void usb_secure_out_arm(void) {
+    if (out_armed || !secure_configured) {
+        return;
+    }
+
+    if (chunk_state[chunk_next] != SECURE_CHUNK_FREE) {
+        /* leave the endpoint NAKing until usb_secure_poll() frees a chunk */
+        secure_stats.out_stalls++;
+        return;
+    }
+
+    out_armed = true;
+    usbd_ep_start_read(secure_busid, SECURE_OUT_EP, chunk_buf[chunk_next], USB_SECURE_CHUNK_SIZE);
+}
+
+/* called from the USB interrupt or with OTG_FS masked */
+static void usb_secure_status_send(void) {
+    if (status_busy || !status_pending || !secure_configured) {
+        return;
+    }
+
+    status_pending = false;
+    status_busy = true;
+    secure_frame_put32(&status_buf[0], status_word[0]);
+    secure_frame_put32(&status_buf[4], status_word[1]);
+    usbd_ep_start_write(secure_busid, SECURE_IN_EP, status_buf, SECURE_FRAME_STATUS_SIZE);
+}
+
+static void usb_secure_event_handler(uint8_t busid, uint8_t event) {
+    ARG_UNUSED(busid);
+
+    switch (event) {
+        case USBD_EVENT_RESET:
+        case USBD_EVENT_DISCONNECTED:
+            secure_configured = false;
+            out_armed = false;
+            status_busy = false;
+            status_pending = false;
+            secure_abort_req = true;
+            break;
+        case USBD_EVENT_CONFIGURED:
+            secure_configured = true;
+            usb_secure_out_arm();
+            break;
+        default:
+            break;
+    }
+}
+
+static void usb_secure_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    uint8_t i = chunk_next;
+
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+
+    chunk_len[i] = nbytes;
+    chunk_state[i] = SECURE_CHUNK_FULL;
+    chunk_next ^= 1U;
+    out_armed = false;
+
+    usb_secure_out_arm();
+}
+
+static void usb_secure_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(ep);
+    ARG_UNUSED(nbytes);
+
+    status_busy = false;
+    usb_secure_status_send();
+}
+
+/*!< endpoint call back */
+static struct usbd_endpoint secure_out_ep = {
+    .ep_addr = SECURE_OUT_EP,
+    .ep_cb = usb_secure_bulk_out
+};
+
+static struct usbd_endpoint secure_in_ep = {
+    .ep_addr = SECURE_IN_EP,
+    .ep_cb = usb_secure_bulk_in
+};
+
+static struct usbd_interface secure_intf;
+
+/********************** frame processing **************************/
+
+static void usb_secure_frame_reset(void) {
+    frame_hdr_len = 0;
+    frame_tag_len = 0;
+    frame_payload_len = 0;
+    frame_rx_len = 0;
+    frame_dec_len = 0;
+    frame_status = SECURE_STATUS_OK;
+}
+
+static void usb_secure_frame_begin(void) {
+    frame_start = DWT->CYCCNT;
+    frame_payload_len = secure_frame_get32(&frame_hdr[SECURE_FRAME_OFS_LENGTH]);
+
+    if ((secure_frame_get32(&frame_hdr[SECURE_FRAME_OFS_MAGIC]) != SECURE_FRAME_MAGIC) ||
+        ((secure_frame_get32(&frame_hdr[SECURE_FRAME_OFS_VERSION]) & 0xFFFFU) != SECURE_FRAME_VERSION)) {
+        frame_status = SECURE_STATUS_BAD_HEADER;
+        return;
+    }
+
+    if (frame_payload_len > USB_SECURE_MAX_PAYLOAD) {
+        frame_status = SECURE_STATUS_TOO_LONG;
+        return;
+    }
+
+    sw_hmac_sha256_init(&frame_hmac, secure_mac_key, sizeof(secure_mac_key));
+    sw_hmac_sha256_update(&frame_hmac, frame_hdr, SECURE_FRAME_HDR_SIZE);
+    secure_crypto_start(&frame_hdr[SECURE_FRAME_OFS_NONCE]);
+}
+
+/* start the CRYP on whole blocks received so far, on everything at the end */
+static void usb_secure_decrypt_kick(bool last) {
+    uint32_t n;
+
+    if ((frame_status != SECURE_STATUS_OK) || secure_crypto_busy()) {
+        return;
+    }
+
+    n = frame_rx_len - frame_dec_len;
+    if (!last) {
+        n &= ~(SW_AES_BLOCK_SIZE - 1U);
+    }
+    if (n == 0) {
+        return;
+    }
+
+    if (secure_crypto_run(&payload_buf[frame_dec_len], n) != 0) {
+        frame_status = SECURE_STATUS_CRYPTO_ERROR;
+        return;
+    }
+    frame_dec_len += n;
+}
+
+static void usb_secure_frame_end(uint32_t status) {
+    uint8_t mac[SW_SHA256_DIGEST_SIZE];
+    uint32_t ms;
+
+    if (status == SECURE_STATUS_OK) {
+        while ((frame_dec_len < frame_payload_len) && (frame_status == SECURE_STATUS_OK)) {
+            usb_secure_decrypt_kick(true);
+        }
+        while (secure_crypto_busy()) {
+        }
+        status = frame_status;
+    }
+
+    if (status == SECURE_STATUS_OK) {
+        sw_hmac_sha256_final(&frame_hmac, mac);
+        if (sw_crypto_memcmp(mac, frame_tag, SECURE_FRAME_TAG_SIZE) != 0) {
+            status = SECURE_STATUS_BAD_TAG;
+        }
+    }
+
+    ms = SECURE_CYCLES_TO_MS(DWT->CYCCNT - frame_start);
+
+    if (status == SECURE_STATUS_OK) {
+        usb_secure_commit(payload_buf, frame_payload_len);
+        secure_stats.frames_ok++;
+        secure_stats.bytes += frame_payload_len;
+        secure_stats.last_kbps = ms ? (frame_payload_len / ms) : frame_payload_len;
+    } else {
+        USB_LOG_ERR("SCFG: frame rejected, status %u\r\n", (unsigned int)status);
+        secure_stats.frames_rejected++;
+    }
+    secure_stats.last_status = status;
+
+    /* the plaintext does not outlive the frame */
+    memset(payload_buf, 0, frame_rx_len);
+
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    if (status_pending) {
+        /* the host has not read the last two statuses, keep the newest */
+        secure_stats.status_overruns++;
+    }
+    status_word[0] = status;
+    status_word[1] = frame_rx_len;
+    status_pending = true;
+    usb_secure_status_send();
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+
+    usb_secure_frame_reset();
+}
+
+static void usb_secure_consume(const uint8_t *p, uint32_t n, bool short_xfer) {
+    uint32_t take;
+
+    while (n) {
+        if (frame_hdr_len < SECURE_FRAME_HDR_SIZE) {
+            take = SECURE_FRAME_HDR_SIZE - frame_hdr_len;
+            take = (take > n) ? n : take;
+            memcpy(&frame_hdr[frame_hdr_len], p, take);
+            frame_hdr_len += take;
+            if (frame_hdr_len == SECURE_FRAME_HDR_SIZE) {
+                usb_secure_frame_begin();
+            }
+        } else if (frame_status != SECURE_STATUS_OK) {
+            /* no way to resync, drop the rest of the transfer */
+            take = n;
+        } else if (frame_rx_len < frame_payload_len) {
+            take = frame_payload_len - frame_rx_len;
+            take = (take > n) ? n : take;
+            memcpy(&payload_buf[frame_rx_len], p, take);
+            frame_rx_len += take;
+
+            /* CRYP works on the payload buffer while the CPU hashes the chunk */
+            usb_secure_decrypt_kick(false);
+            sw_hmac_sha256_update(&frame_hmac, p, take);
+        } else {
+            take = SECURE_FRAME_TAG_SIZE - frame_tag_len;
+            take = (take > n) ? n : take;
+            memcpy(&frame_tag[frame_tag_len], p, take);
+            frame_tag_len += take;
+            if (frame_tag_len == SECURE_FRAME_TAG_SIZE) {
+                usb_secure_frame_end(SECURE_STATUS_OK);
+            }
+        }
+
+        p += take;
+        n -= take;
+    }
+
+    if (short_xfer && (frame_hdr_len != 0)) {
+        /* transfer ended inside a frame */
+        usb_secure_frame_end((frame_status != SECURE_STATUS_OK) ? frame_status : SECURE_STATUS_TRUNCATED);
+    }
+}
+
+int usb_secure_init(uint8_t busid, uint32_t reg_base) {
+    secure_busid = busid;
+
+    /* cycle counter for the throughput figures */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (secure_crypto_init(secure_enc_key) != 0) {
+        return -1;
+    }
+
+    usb_secure_frame_reset();
+
+    usbd_desc_register(busid, usb_secure_descriptor);
+    usbd_add_interface(busid, &secure_intf);
+    usbd_add_endpoint(busid, &secure_out_ep);
+    usbd_add_endpoint(busid, &secure_in_ep);
+
+    return usbd_initialize(busid, reg_base, usb_secure_event_handler);
+}
+
+/**
+ * @brief   Process received chunks, call from the main loop
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void usb_secure_poll(void) {
+    uint8_t i = chunk_work;
+
+    if (secure_abort_req) {
+        secure_abort_req = false;
+        while (secure_crypto_busy()) {
+        }
+        memset(payload_buf, 0, frame_rx_len);
+        usb_secure_frame_reset();
+
+        /* chunks of the aborted transfer are not the start of the next frame */
+        DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+        chunk_state[0] = SECURE_CHUNK_FREE;
+        chunk_state[1] = SECURE_CHUNK_FREE;
+        if (!out_armed) {
+            chunk_next = 0;
+        }
+        /* a read armed since the reset lands in chunk_next, consumed first */
+        chunk_work = chunk_next;
+        usb_secure_out_arm();
+        DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+        return;
+    }
+
+    if (chunk_state[i] != SECURE_CHUNK_FULL) {
+        /* keep the CRYP busy while the host is sending */
+        usb_secure_decrypt_kick(false);
+        return;
+    }
+
+    usb_secure_consume(chunk_buf[i], chunk_len[i], chunk_len[i] < USB_SECURE_CHUNK_SIZE);
+
+    /* chunk goes back to the USB side */
+    DAL_NVIC_DisableIRQ(OTG_FS_IRQn);
+    chunk_state[i] = SECURE_CHUNK_FREE;
+    usb_secure_out_arm();
+    DAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+
+    chunk_work ^= 1U;
+}
+
+void usb_secure_get_stats(struct usb_secure_stats *stats) {
+    memcpy(stats, &secure_stats, sizeof(secure_stats));
+}
+
+#endif /* DEMO_SELECT == DEMO_SECURE_UPLOAD */
@@ -0,0 +1,67 @@
+/**
+  * @file    usb_secure.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_secure.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_SECURE_H
+#define USB_SECURE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "usbd_core.h"
+#include "secure_frame.h"
+#include "secure_crypto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< bulk OUT read size, multiple of the MPS and of the AES block */
+#ifndef USB_SECURE_CHUNK_SIZE
+#define USB_SECURE_CHUNK_SIZE       512U
+#endif
+
+/*!< largest payload, it is staged in RAM until the tag is checked */
+#ifndef USB_SECURE_MAX_PAYLOAD
+#define USB_SECURE_MAX_PAYLOAD      16384U
+#endif
+
+/*!< figures of the uploads so far, times measured with the DWT cycle counter */
+struct usb_secure_stats {
+    uint32_t frames_ok;         /*!< frames with a valid tag, handed to usb_secure_commit() */
+    uint32_t frames_rejected;   /*!< frames answered with an error status */
+    uint32_t bytes;             /*!< payload bytes of accepted frames */
+    uint32_t last_status;       /*!< SECURE_STATUS_* of the last frame */
+    uint32_t last_kbps;         /*!< KB/s of the last frame, header to status */
+    uint32_t out_stalls;        /*!< bulk OUT left NAKing because both buffers were taken */
+    uint32_t status_overruns;   /*!< statuses replaced while the previous one was still queued */
+};
+
+int usb_secure_init(uint8_t busid, uint32_t reg_base);
+void usb_secure_poll(void);
+void usb_secure_get_stats(struct usb_secure_stats *stats);
+void usb_secure_commit(const uint8_t *data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_SECURE_H */
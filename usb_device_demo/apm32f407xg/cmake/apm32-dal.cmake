@@ -1,19 +1,56 @@
+# APM32 DAL module selection, one option per module of apm32f4xx_dal_cfg.h.
+# An enabled module adds its sources and DAL_<module>_MODULE_ENABLED, the
+# list in apm32f4xx_dal_cfg.h only applies to builds without this file.
+# The defaults are the modules the demos use.
+set(APM32_DAL_DIR "driver/APM32F4xx_DAL_Driver/Source")
+
+macro(apm32_dal_module name default)
+    option(APM32_DAL_${name} "DAL ${name} module" ${default})
+    if(APM32_DAL_${name})
+        foreach(src ${ARGN})
+            list(APPEND APM32_DAL_CORE_SOURCES "${APM32_DAL_DIR}/apm32f4xx_${src}.c")
+        endforeach()
+        list(APPEND APM32_DAL_CORE_DEFINES "DAL_${name}_MODULE_ENABLED")
+    endif()
+endmacro()
+
 # APM32 DAL core sources
-file(GLOB_RECURSE APM32_DAL_CORE_SOURCES
-    "application/*.*"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal.c"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal_cortex.c"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal_dma.c"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal_gpio.c"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal_rcm.c"
-    "driver/APM32F4xx_DAL_Driver/Source/apm32f4xx_dal_pmu.c"
+set(APM32_DAL_CORE_SOURCES
+    "application/config/Source/apm32f4xx_device_cfg.c"
+    "application/config/Source/apm32f4xx_gpio_cfg.c"
+    "application/config/Source/apm32f4xx_nvic_cfg.c"
+    "application/config/Source/apm32f4xx_rcm_cfg.c"
+    "application/source/apm32f4xx_int.c"
+    "application/source/cdc_acm_hid.c"
+    "application/source/crc32_stream.c"
+    "application/source/cycle_prof.c"
+    "application/source/dfu_flash.c"
+    "application/source/dlog.c"
+    "application/source/hid_report_queue.c"
+    "application/source/irq_lat.c"
+    "application/source/main.c"
+    "application/source/sched.c"
+    "application/source/secure_crypto.c"
+    "application/source/sw_crypto.c"
+    "application/source/syscalls.c"
+    "application/source/sysmem.c"
+    "application/source/system_apm32f4xx.c"
+    "application/source/uart_log.c"
+    "application/source/usb_cdc_bench.c"
+    "application/source/usb_dfu.c"
+    "application/source/usb_eth_bridge.c"
+    "application/source/usb_host_bridge.c"
+    "application/source/usb_osal_freertos.c"
+    "application/source/usb_pm.c"
+    "application/source/usb_secure.c"
+    "${APM32_DAL_DIR}/apm32f4xx_dal.c"
     "driver/Device/Geehy/APM32F4xx/Source/gcc/startup_apm32f407xx.S"
 )
 
 # APM32 DAL core includes
 set(APM32_DAL_CORE_INCLUDES
     "application/include"
-    "application/config/include"
+    "application/config/Include"
     "driver/APM32F4xx_DAL_Driver/Include"
     "driver/Device/Geehy/APM32F4xx/Include"
     "driver/CMSIS/Include"
@@ -23,4 +60,47 @@ set(APM32_DAL_CORE_INCLUDES
 set(APM32_DAL_CORE_DEFINES
     "APM32F407xx"
     "USE_DAL_DRIVER"
-)
\ No newline at end of file
+    "DAL_MODULE_SELECT_EXTERNAL"
+)
+
+# APM32 DAL modules, name, default, sources without the apm32f4xx_ prefix
+apm32_dal_module(ADC        OFF dal_adc dal_adc_ex)
+apm32_dal_module(CAN        OFF dal_can)
+apm32_dal_module(CRC        ON  dal_crc)
+apm32_dal_module(CRYP       ON  dal_cryp dal_cryp_ex)
+apm32_dal_module(DAC        OFF dal_dac dal_dac_ex)
+apm32_dal_module(DCI        OFF dal_dci dal_dci_ex)
+apm32_dal_module(DMA        ON  dal_dma dal_dma_ex)
+apm32_dal_module(ETH        ON  dal_eth)
+apm32_dal_module(FLASH      ON  dal_flash dal_flash_ex dal_flash_ramfunc)
+apm32_dal_module(NAND       OFF dal_nand ddl_smc)
+apm32_dal_module(NOR        OFF dal_nor ddl_smc)
+apm32_dal_module(PCCARD     OFF dal_pccard ddl_smc)
+apm32_dal_module(SRAM       OFF dal_sram ddl_smc)
+apm32_dal_module(SDRAM      OFF dal_sdram ddl_dmc)
+apm32_dal_module(HASH       OFF dal_hash dal_hash_ex)
+apm32_dal_module(GPIO       ON  dal_gpio)
+apm32_dal_module(EINT       OFF dal_eint)
+apm32_dal_module(I2C        OFF dal_i2c dal_i2c_ex)
+apm32_dal_module(SMBUS      OFF dal_smbus)
+apm32_dal_module(I2S        OFF dal_i2s dal_i2s_ex)
+apm32_dal_module(IWDT       OFF dal_iwdt)
+apm32_dal_module(PMU        ON  dal_pmu dal_pmu_ex)
+apm32_dal_module(RCM        ON  dal_rcm dal_rcm_ex)
+apm32_dal_module(RNG        OFF dal_rng)
+apm32_dal_module(RTC        OFF dal_rtc dal_rtc_ex)
+apm32_dal_module(SD         OFF dal_sd ddl_sdmmc)
+apm32_dal_module(SPI        OFF dal_spi)
+apm32_dal_module(TMR        OFF dal_tmr dal_tmr_ex)
+apm32_dal_module(UART       ON  dal_uart)
+apm32_dal_module(USART      OFF dal_usart)
+apm32_dal_module(IRDA       OFF dal_irda)
+apm32_dal_module(SMARTCARD  OFF dal_smartcard)
+apm32_dal_module(WWDT       OFF dal_wwdt)
+apm32_dal_module(CORTEX     ON  dal_cortex)
+apm32_dal_module(PCD        OFF dal_pcd dal_pcd_ex ddl_usb)
+apm32_dal_module(HCD        OFF dal_hcd ddl_usb)
+apm32_dal_module(MMC        OFF dal_mmc ddl_sdmmc)
+
+# Modules sharing a low layer driver list it once
+list(REMOVE_DUPLICATES APM32_DAL_CORE_SOURCES)
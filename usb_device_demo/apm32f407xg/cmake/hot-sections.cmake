@@ -0,0 +1,34 @@
+# USB hot path placed first in flash, contiguous for the flash prefetch and
+# cache. HOT_FUNCTIONS_LIST holds one function name per line in placement
+# order, # starts a comment, names the image does not have match nothing.
+# The output is a linker script passed with -T ahead of the board linker
+# script, INSERT adds .text.usb_hot in front of .text without editing it.
+set(HOT_FUNCTIONS_LIST  ${CMAKE_SOURCE_DIR}/cmake/usb-hot-functions.txt)
+set(HOT_SECTIONS_LD     ${CMAKE_BINARY_DIR}/usb_hot_sections.ld)
+
+file(STRINGS ${HOT_FUNCTIONS_LIST} HOT_FUNCTIONS_LINES)
+set(HOT_SECTIONS_INPUTS "")
+foreach(line IN LISTS HOT_FUNCTIONS_LINES)
+    string(REGEX REPLACE "#.*" "" name "${line}")
+    string(STRIP "${name}" name)
+    if(name)
+        # clones and LTO private copies keep the name as prefix
+        string(APPEND HOT_SECTIONS_INPUTS "    *(.text.${name} .text.${name}.*)\n")
+    endif()
+endforeach()
+
+# Rewritten only when it changes, the image relinks only then
+file(CONFIGURE OUTPUT ${HOT_SECTIONS_LD} CONTENT
+"/* Generated from cmake/usb-hot-functions.txt, do not edit */
+SECTIONS
+{
+  .text.usb_hot :
+  {
+    . = ALIGN(16);
+${HOT_SECTIONS_INPUTS}    . = ALIGN(4);
+  }
+}
+INSERT BEFORE .text;
+")
+
+set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${HOT_FUNCTIONS_LIST})
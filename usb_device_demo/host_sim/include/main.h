@@ -0,0 +1,52 @@
+/**
+  * @file    main.h
+  * @author  LuckkMaker
+  * @brief   Host build replacement for the board main.h
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef MAIN_H
+#define MAIN_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< the simulated controller raises its events from the caller's thread, so
+ *   there is no interrupt to mask */
+static inline uint32_t __get_PRIMASK(void) {
+    return 0;
+}
+
+static inline void __disable_irq(void) {
+}
+
+static inline void __set_PRIMASK(uint32_t primask) {
+    (void)primask;
+}
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MAIN_H */
@@ -0,0 +1,565 @@
+/**
+  * @file    dwc2_bench.c
+  * @author  LuckkMaker
+  * @brief   Register access profile of apm32f4xx_ddl_usb.c on the DWC2 model
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The driver runs unmodified against dwc2_model.c, the interrupt side is
+  * done here the way apm32f4xx_dal_pcd.c and apm32f4xx_dal_hcd.c do it
+  * (TX FIFO fill on DITXFSTS, RX FIFO drain on GRXSTSP). Per operation:
+  *   dev_init     USB_CoreInit + USB_SetCurrentMode + USB_DevInit
+  *   ep0_setup    USB_EP0_OutStart, SETUP packet drained from the RX FIFO
+  *   in_512       USB_EPStartXfer + FIFO fill of a 512 byte bulk IN transfer
+  *   out_512      USB_EPStartXfer + RX FIFO drain of a 512 byte bulk OUT transfer
+  *   flush_tx     USB_FlushTxFifo of all the FIFOs
+  *   host_out_256 USB_HC_StartXfer of a bulk OUT transfer up to the halt
+  *   host_in_256  USB_HC_StartXfer of a bulk IN transfer up to the halt
+  * then one run per injected fault, each must be seen by the driver or by
+  * the model counters.
+  *
+  *   dwc2_bench [iterations]
+  *
+  * Cycles are bus cycles from the model cost table, not host time. Exits
+  * non-zero on a data error or an undetected fault.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dwc2_model.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define DWC2_BENCH_EP               1U
+#define DWC2_BENCH_MPS              64U
+#define DWC2_BENCH_LEN              512U
+#define DWC2_BENCH_HOST_LEN         256U
+#define DWC2_BENCH_HC_OUT           0U
+#define DWC2_BENCH_HC_IN            1U
+#define DWC2_BENCH_DEV_ADDR         1U
+
+/*!< FIFO RAM split in words, RX 512 B, EP0 TX 64 B, EP1 TX 512 B */
+#define DWC2_BENCH_RX_WORDS         128U
+#define DWC2_BENCH_TX0_WORDS        16U
+#define DWC2_BENCH_TX1_WORDS        128U
+
+/*!< host mode frames before a transfer is declared stuck */
+#define DWC2_BENCH_FRAMES           64U
+
+/* Private macro -------------------------------------------------------------*/
+#define USBx_BASE                   ((uint32_t)(uintptr_t)usbx)
+
+/* Private variables ---------------------------------------------------------*/
+static USB_OTG_GlobalTypeDef *usbx;
+static uint8_t bench_tx[DWC2_BENCH_LEN];
+static uint8_t bench_rx[DWC2_BENCH_LEN];
+static uint8_t peer_buf[DWC2_BENCH_LEN];
+static uint32_t peer_len;
+static uint8_t peer_seq;
+static int bench_errors;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void dwc2_bench_fail(const char *what) {
+    printf("FAIL %s\n", what);
+    bench_errors++;
+}
+
+static void dwc2_bench_pattern(uint8_t *buf, uint32_t len, uint8_t seed) {
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7U);
+    }
+}
+
+static void dwc2_bench_print(const char *name, uint32_t calls) {
+    struct dwc2_model_stats st;
+
+    dwc2_model_get_stats(&st);
+    printf("%-13s %7.1f reg_rd %7.1f reg_wr %7.1f fifo_rd %7.1f fifo_wr %9.1f cycles/call\n",
+           name,
+           (double)st.reg_rd / calls,
+           (double)st.reg_wr / calls,
+           (double)st.fifo_rd / calls,
+           (double)st.fifo_wr / calls,
+           (double)st.cycles / calls);
+}
+
+static USB_OTG_CfgTypeDef dwc2_bench_cfg(uint32_t speed) {
+    USB_OTG_CfgTypeDef cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.dev_endpoints = 4;
+    cfg.Host_channels = 8;
+    cfg.speed = speed;
+    cfg.ep0_mps = DWC2_BENCH_MPS;
+    cfg.phy_itface = USB_OTG_EMBEDDED_PHY;
+
+    return cfg;
+}
+
+/*************************** device mode *************************************/
+
+static int dwc2_bench_dev_init(void) {
+    USB_OTG_CfgTypeDef cfg = dwc2_bench_cfg(USBD_FS_SPEED);
+
+    if ((USB_CoreInit(usbx, cfg) != DAL_OK) ||
+        (USB_SetCurrentMode(usbx, USB_DEVICE_MODE) != DAL_OK) ||
+        (USB_DevInit(usbx, cfg) != DAL_OK)) {
+        return -1;
+    }
+
+    /* DAL_PCDEx_SetRxFiFo / SetTxFiFo */
+    usbx->GRXFIFO = DWC2_BENCH_RX_WORDS;
+    usbx->GTXFCFG = (DWC2_BENCH_TX0_WORDS << 16) | DWC2_BENCH_RX_WORDS;
+    usbx->DTXFIFO[0] = (DWC2_BENCH_TX1_WORDS << 16) | (DWC2_BENCH_RX_WORDS + DWC2_BENCH_TX0_WORDS);
+
+    return 0;
+}
+
+static void dwc2_bench_ep(USB_OTG_EPTypeDef *ep, uint8_t is_in) {
+    memset(ep, 0, sizeof(*ep));
+    ep->num = DWC2_BENCH_EP;
+    ep->is_in = is_in;
+    ep->type = EP_TYPE_BULK;
+    ep->maxpacket = DWC2_BENCH_MPS;
+    ep->tx_fifo_num = is_in ? DWC2_BENCH_EP : 0U;
+}
+
+/* PCD_WriteEmptyTxFifo() */
+static void dwc2_bench_fill_tx(USB_OTG_EPTypeDef *ep) {
+    uint32_t len;
+
+    len = ep->xfer_len - ep->xfer_count;
+    if (len > ep->maxpacket) {
+        len = ep->maxpacket;
+    }
+
+    while (((USBx_INEP(ep->num)->DITXFSTS & USB_OTG_DITXFSTS_INEPTXFSA) >= ((len + 3U) / 4U)) &&
+           (ep->xfer_count < ep->xfer_len)) {
+        len = ep->xfer_len - ep->xfer_count;
+        if (len > ep->maxpacket) {
+            len = ep->maxpacket;
+        }
+
+        USB_WritePacket(usbx, ep->xfer_buff, ep->num, (uint16_t)len, 0);
+        ep->xfer_buff += len;
+        ep->xfer_count += len;
+    }
+
+    if (ep->xfer_len <= ep->xfer_count) {
+        USBx_DEVICE->DIEIMASK &= ~(1UL << ep->num);
+    }
+}
+
+/* RXFLVL branch of the PCD / HCD interrupt handler, returns the bytes read */
+static uint32_t dwc2_bench_drain_rx(uint8_t *buf, uint32_t size) {
+    uint32_t total = 0;
+    uint32_t sts;
+    uint32_t bcnt;
+
+    while (usbx->GCINT & USB_OTG_GCINT_RXFNONE) {
+        sts = usbx->GRXSTSP;
+        bcnt = (sts & USB_OTG_GRXSTSP_BCNT) >> 4;
+
+        switch ((sts & USB_OTG_GRXSTSP_PSTS) >> 17) {
+            case STS_DATA_UPDT:
+            case STS_SETUP_UPDT:
+                if ((total + bcnt) <= size) {
+                    USB_ReadPacket(usbx, &buf[total], (uint16_t)bcnt);
+                    total += bcnt;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return total;
+}
+
+static void dwc2_bench_setup(uint32_t iterations) {
+    static const uint8_t setup[8] = { 0x80, 0x06, 0x00, 0x01, 0x00, 0x00, 0x12, 0x00 };
+    uint8_t got[8];
+    uint32_t i;
+
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        USB_EP0_OutStart(usbx, 0, got);
+        dwc2_model_setup(setup);
+
+        memset(got, 0, sizeof(got));
+        if ((dwc2_bench_drain_rx(got, sizeof(got)) != 8U) || memcmp(got, setup, 8)) {
+            dwc2_bench_fail("ep0_setup data");
+            return;
+        }
+        if (!(USB_ReadDevOutEPInterrupt(usbx, 0) & USB_OTG_DOEPINT_SETPCMP)) {
+            dwc2_bench_fail("ep0_setup SETPCMP");
+            return;
+        }
+        USBx_OUTEP(0)->DOEPINT = USB_OTG_DOEPINT_SETPCMP;
+    }
+
+    dwc2_bench_print("ep0_setup", iterations);
+}
+
+static int dwc2_bench_in_once(USB_OTG_EPTypeDef *ep, uint8_t seed) {
+    uint32_t got = 0;
+    int len;
+
+    dwc2_bench_pattern(bench_tx, DWC2_BENCH_LEN, seed);
+    ep->xfer_buff = bench_tx;
+    ep->xfer_len = DWC2_BENCH_LEN;
+    ep->xfer_count = 0;
+
+    USB_EPStartXfer(usbx, ep, 0);
+    dwc2_bench_fill_tx(ep);
+
+    while (got < DWC2_BENCH_LEN) {
+        len = dwc2_model_in(DWC2_BENCH_EP, &bench_rx[got], DWC2_BENCH_LEN - got);
+        if (len <= 0) {
+            break;
+        }
+        got += (uint32_t)len;
+    }
+
+    if (!(USB_ReadDevInEPInterrupt(usbx, DWC2_BENCH_EP) & USB_OTG_DIEPINT_TSFCMP)) {
+        return -1;
+    }
+    USBx_INEP(DWC2_BENCH_EP)->DIEPINT = USB_OTG_DIEPINT_TSFCMP;
+
+    return ((got == DWC2_BENCH_LEN) && !memcmp(bench_tx, bench_rx, DWC2_BENCH_LEN)) ? 0 : -1;
+}
+
+static void dwc2_bench_in(uint32_t iterations) {
+    USB_OTG_EPTypeDef ep;
+    uint32_t i;
+
+    dwc2_bench_ep(&ep, 1);
+    USB_ActivateEndpoint(usbx, &ep);
+
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        if (dwc2_bench_in_once(&ep, (uint8_t)i) != 0) {
+            dwc2_bench_fail("in_512 data");
+            return;
+        }
+    }
+
+    dwc2_bench_print("in_512", iterations);
+}
+
+static int dwc2_bench_out_once(USB_OTG_EPTypeDef *ep, uint8_t seed) {
+    uint32_t got = 0;
+    uint32_t sent;
+
+    dwc2_bench_pattern(bench_tx, DWC2_BENCH_LEN, seed);
+    ep->xfer_buff = bench_rx;
+    ep->xfer_len = DWC2_BENCH_LEN;
+    ep->xfer_count = 0;
+
+    USB_EPStartXfer(usbx, ep, 0);
+
+    for (sent = 0; sent < DWC2_BENCH_LEN; sent += DWC2_BENCH_MPS) {
+        if (dwc2_model_out(DWC2_BENCH_EP, &bench_tx[sent], DWC2_BENCH_MPS) != (int)DWC2_BENCH_MPS) {
+            return -1;
+        }
+        got += dwc2_bench_drain_rx(&bench_rx[got], DWC2_BENCH_LEN - got);
+    }
+
+    if (!(USB_ReadDevOutEPInterrupt(usbx, DWC2_BENCH_EP) & USB_OTG_DOEPINT_TSFCMP)) {
+        return -1;
+    }
+    USBx_OUTEP(DWC2_BENCH_EP)->DOEPINT = USB_OTG_DOEPINT_TSFCMP;
+
+    return ((got == DWC2_BENCH_LEN) && !memcmp(bench_tx, bench_rx, DWC2_BENCH_LEN)) ? 0 : -1;
+}
+
+static void dwc2_bench_out(uint32_t iterations) {
+    USB_OTG_EPTypeDef ep;
+    uint32_t i;
+
+    dwc2_bench_ep(&ep, 0);
+    USB_ActivateEndpoint(usbx, &ep);
+
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        if (dwc2_bench_out_once(&ep, (uint8_t)i) != 0) {
+            dwc2_bench_fail("out_512 data");
+            return;
+        }
+    }
+
+    dwc2_bench_print("out_512", iterations);
+}
+
+static void dwc2_bench_flush(uint32_t iterations) {
+    uint32_t i;
+
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        if (USB_FlushTxFifo(usbx, 0x10U) != DAL_OK) {
+            dwc2_bench_fail("flush_tx");
+            return;
+        }
+    }
+
+    dwc2_bench_print("flush_tx", iterations);
+}
+
+static void dwc2_bench_device(uint32_t iterations) {
+    usbx = dwc2_model_init(DWC2_MODEL_CID_FS);
+    if ((usbx == NULL) || (dwc2_bench_dev_init() != 0)) {
+        dwc2_bench_fail("dev_init");
+        return;
+    }
+
+    /* once more for the profile, the model is already configured */
+    dwc2_model_clear_stats();
+    dwc2_bench_dev_init();
+    dwc2_bench_print("dev_init", 1);
+
+    /* USBRST branch of the PCD interrupt handler */
+    dwc2_model_bus_reset();
+    USB_ClearInterrupts(usbx, USB_OTG_GCINT_USBRST | USB_OTG_GCINT_ENUMD);
+    USBx_DEVICE->DAEPIMASK |= 0x10001U | (0x10001U << DWC2_BENCH_EP);
+    USBx_DEVICE->DOUTIMASK |= USB_OTG_DOUTIMASK_SETPCMPM | USB_OTG_DOUTIMASK_TSFCMPM | USB_OTG_DOUTIMASK_EPDISM;
+    USBx_DEVICE->DINIMASK |= USB_OTG_DINIMASK_TSFCMPM | USB_OTG_DINIMASK_EPDISM;
+
+    dwc2_bench_setup(iterations);
+    dwc2_bench_in(iterations);
+    dwc2_bench_out(iterations);
+    dwc2_bench_flush(iterations);
+
+    dwc2_model_deinit();
+}
+
+/*************************** host mode ***************************************/
+
+static int dwc2_bench_peer_out(void *arg, uint8_t ep, const uint8_t *data, uint32_t len) {
+    (void)arg;
+    (void)ep;
+
+    if ((peer_len + len) > sizeof(peer_buf)) {
+        return DWC2_MODEL_STALL;
+    }
+    memcpy(&peer_buf[peer_len], data, len);
+    peer_len += len;
+    return (int)len;
+}
+
+static int dwc2_bench_peer_in(void *arg, uint8_t ep, uint8_t *data, uint32_t mps) {
+    (void)arg;
+    (void)ep;
+
+    dwc2_bench_pattern(data, mps, peer_seq);
+    peer_seq = (uint8_t)(peer_seq + mps * 7U);
+    return (int)mps;
+}
+
+static int dwc2_bench_hc_wait(uint8_t ch, uint32_t flag) {
+    uint32_t i;
+
+    for (i = 0; i < DWC2_BENCH_FRAMES; i++) {
+        if (USBx_HC(ch)->HCHINT & flag) {
+            USBx_HC(ch)->HCHINT = flag;
+            return 0;
+        }
+        dwc2_model_frame();
+    }
+
+    return -1;
+}
+
+static int dwc2_bench_hc_xfer(USB_OTG_HCTypeDef *hc) {
+    if (dwc2_bench_hc_wait(hc->ch_num, USB_OTG_HCHINT_TSFCMPN) != 0) {
+        return -1;
+    }
+
+    USB_HC_Halt(usbx, hc->ch_num);
+    return dwc2_bench_hc_wait(hc->ch_num, USB_OTG_HCHINT_TSFCMPAN);
+}
+
+static void dwc2_bench_hc(USB_OTG_HCTypeDef *hc, uint8_t ch, uint8_t ep) {
+    memset(hc, 0, sizeof(*hc));
+    hc->dev_addr = DWC2_BENCH_DEV_ADDR;
+    hc->ch_num = ch;
+    hc->ep_num = ep & 0x7FU;
+    hc->ep_is_in = (ep & 0x80U) ? 1U : 0U;
+    hc->speed = HPRT0_PRTSPD_FULL_SPEED;
+    hc->ep_type = EP_TYPE_BULK;
+    hc->max_packet = DWC2_BENCH_MPS;
+
+    USB_HC_Init(usbx, ch, ep, DWC2_BENCH_DEV_ADDR, HPRT0_PRTSPD_FULL_SPEED, EP_TYPE_BULK, DWC2_BENCH_MPS);
+}
+
+static void dwc2_bench_host(uint32_t iterations) {
+    static const struct dwc2_model_peer peer = { dwc2_bench_peer_out, dwc2_bench_peer_in, NULL };
+    USB_OTG_CfgTypeDef cfg = dwc2_bench_cfg(USBH_FSLS_SPEED);
+    USB_OTG_HCTypeDef hc_out;
+    USB_OTG_HCTypeDef hc_in;
+    uint8_t expect[DWC2_BENCH_HOST_LEN];
+    uint32_t got;
+    uint32_t i;
+
+    usbx = dwc2_model_init(DWC2_MODEL_CID_FS);
+    if ((usbx == NULL) ||
+        (USB_CoreInit(usbx, cfg) != DAL_OK) ||
+        (USB_SetCurrentMode(usbx, USB_HOST_MODE) != DAL_OK) ||
+        (USB_HostInit(usbx, cfg) != DAL_OK)) {
+        dwc2_bench_fail("host_init");
+        return;
+    }
+
+    USB_InitFSLSPClkSel(usbx, HCFG_48_MHZ);
+    USB_DriveVbus(usbx, 1);
+    dwc2_model_attach(&peer);
+    USB_ResetPort(usbx);
+    if (!(USBx_HPRT0 & USB_OTG_HPORTCSTS_PEN) || (USB_GetHostSpeed(usbx) != HPRT0_PRTSPD_FULL_SPEED)) {
+        dwc2_bench_fail("host port enable");
+        dwc2_model_deinit();
+        return;
+    }
+
+    dwc2_bench_hc(&hc_out, DWC2_BENCH_HC_OUT, DWC2_BENCH_EP);
+    dwc2_bench_hc(&hc_in, DWC2_BENCH_HC_IN, 0x80U | DWC2_BENCH_EP);
+
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        dwc2_bench_pattern(bench_tx, DWC2_BENCH_HOST_LEN, (uint8_t)i);
+        peer_len = 0;
+        hc_out.xfer_buff = bench_tx;
+        hc_out.xfer_len = DWC2_BENCH_HOST_LEN;
+        USB_HC_StartXfer(usbx, &hc_out, 0);
+
+        if ((dwc2_bench_hc_xfer(&hc_out) != 0) || (peer_len != DWC2_BENCH_HOST_LEN) ||
+            memcmp(peer_buf, bench_tx, DWC2_BENCH_HOST_LEN)) {
+            dwc2_bench_fail("host_out_256");
+            dwc2_model_deinit();
+            return;
+        }
+    }
+
+    dwc2_bench_print("host_out_256", iterations);
+    dwc2_model_clear_stats();
+
+    for (i = 0; i < iterations; i++) {
+        dwc2_bench_pattern(expect, DWC2_BENCH_HOST_LEN, peer_seq);
+        hc_in.xfer_buff = bench_rx;
+        hc_in.xfer_len = DWC2_BENCH_HOST_LEN;
+        USB_HC_StartXfer(usbx, &hc_in, 0);
+
+        got = 0;
+        while (got < DWC2_BENCH_HOST_LEN) {
+            dwc2_model_frame();
+            got += dwc2_bench_drain_rx(&bench_rx[got], DWC2_BENCH_HOST_LEN - got);
+            if (USBx_HC(DWC2_BENCH_HC_IN)->HCHINT & USB_OTG_HCHINT_TSFCMPN) {
+                break;
+            }
+        }
+
+        if ((dwc2_bench_hc_xfer(&hc_in) != 0) || (got != DWC2_BENCH_HOST_LEN) ||
+            memcmp(bench_rx, expect, DWC2_BENCH_HOST_LEN)) {
+            dwc2_bench_fail("host_in_256");
+            dwc2_model_deinit();
+            return;
+        }
+    }
+
+    dwc2_bench_print("host_in_256", iterations);
+    dwc2_model_deinit();
+}
+
+/*************************** faults ******************************************/
+
+static void dwc2_bench_fault_report(const char *name, bool detected, const char *how) {
+    printf("fault %-13s %s (%s)\n", name, detected ? "detected" : "MISSED", how);
+    if (!detected) {
+        bench_errors++;
+    }
+}
+
+static void dwc2_bench_faults(void) {
+    struct dwc2_model_stats st;
+    USB_OTG_EPTypeDef ep;
+    DAL_StatusTypeDef ret;
+
+    /* CSRST never clears, USB_CoreReset() must give up */
+    usbx = dwc2_model_init(DWC2_MODEL_CID_FS);
+    if (usbx == NULL) {
+        dwc2_bench_fail("model init");
+        return;
+    }
+    dwc2_model_set_faults(DWC2_MODEL_FAULT_RESET_STUCK);
+    ret = USB_CoreInit(usbx, dwc2_bench_cfg(USBD_FS_SPEED));
+    dwc2_bench_fault_report("reset_stuck", ret != DAL_OK, "USB_CoreInit status");
+    dwc2_model_deinit();
+
+    /* DITXFSTS always reports room, the FIFO fill loop overruns the TX FIFO */
+    usbx = dwc2_model_init(DWC2_MODEL_CID_FS);
+    dwc2_bench_dev_init();
+    dwc2_bench_ep(&ep, 1);
+    USB_ActivateEndpoint(usbx, &ep);
+    dwc2_model_set_faults(DWC2_MODEL_FAULT_TXFSTS_LIE);
+    usbx->DTXFIFO[0] = (DWC2_BENCH_TX0_WORDS << 16) | (DWC2_BENCH_RX_WORDS + DWC2_BENCH_TX0_WORDS);
+    dwc2_model_clear_stats();
+    dwc2_bench_in_once(&ep, 0);
+    dwc2_model_get_stats(&st);
+    dwc2_bench_fault_report("txfsts_lie", st.tx_overflow != 0, "model tx_overflow");
+    dwc2_model_deinit();
+
+    /* RX status byte count one word long, the driver reads past the packet */
+    usbx = dwc2_model_init(DWC2_MODEL_CID_FS);
+    dwc2_bench_dev_init();
+    dwc2_bench_ep(&ep, 0);
+    USB_ActivateEndpoint(usbx, &ep);
+    dwc2_model_set_faults(DWC2_MODEL_FAULT_RX_BCNT_LONG);
+    dwc2_model_clear_stats();
+    dwc2_bench_out_once(&ep, 0);
+    dwc2_model_get_stats(&st);
+    dwc2_bench_fault_report("rx_bcnt_long", (st.rx_underrun + st.rx_desync) != 0, "model rx_underrun");
+    dwc2_model_deinit();
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 1000;
+
+    if (argc > 1) {
+        iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    dwc2_bench_device(iterations);
+    dwc2_bench_host(iterations);
+    dwc2_bench_faults();
+
+    return (bench_errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,914 @@
+/**
+  * @file    dwc2_model.c
+  * @author  LuckkMaker
+  * @brief   Register level model of the OTG core for running apm32f4xx_ddl_usb.c on Linux
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The driver keeps casting USBx to uint32_t (USBx_BASE), so the register
+  * window is mapped below 4 GB and handed to the driver as USBx, no source
+  * change needed. mmio_trap.c routes every access here: dwc2_read() carries
+  * the side effects (W1C flags, self clearing reset bits, GRXSTSP and FIFO
+  * pops), dwc2_peek() is the plain value a write merges into.
+  *
+  * Page 0 holds the registers, page 1 + n is DFIFO(n). Device mode: writes to
+  * DFIFO(n) fill TX FIFO n, reads from any DFIFO pop the RX FIFO. Host mode:
+  * writes go to the non-periodic or periodic TX FIFO by channel type.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dwc2_model.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include "mmio_trap.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+struct dwc2_fifo {
+    uint32_t word[1024];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t count;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define DWC2_REG_SIZE               0x1000U
+#define DWC2_MMIO_SIZE              (USB_OTG_FIFO_BASE + 16U * USB_OTG_FIFO_SIZE)
+#define DWC2_EP_NUM                 16U
+#define DWC2_CH_NUM                 16U
+#define DWC2_FIFO_WORDS             1024U
+#define DWC2_PTX                    16U     /*!< host periodic TX FIFO */
+
+/*!< reads of GRSTCTRL before CSRST / flush bits clear */
+#define DWC2_RESET_READS            2U
+
+/*!< placeholder bus costs, calibrate against the board */
+#define DWC2_COST_REG_RD            5U
+#define DWC2_COST_REG_WR            2U
+#define DWC2_COST_FIFO_RD           5U
+#define DWC2_COST_FIFO_WR           2U
+
+/*!< Synopsys ID register next to GCID, read by USB_EP0_OutStart() */
+#define DWC2_SNPSID                 0x4F54281AU
+
+/* Private macro -------------------------------------------------------------*/
+#define R_G(r)                      offsetof(USB_OTG_GlobalTypeDef, r)
+#define R_D(r)                      (USB_OTG_DEVICE_BASE + offsetof(USB_OTG_DeviceTypeDef, r))
+#define R_H(r)                      (USB_OTG_HOST_BASE + offsetof(USB_OTG_HostTypeDef, r))
+#define R_IEP(n, r)                 (USB_OTG_IN_ENDPOINT_BASE + (n) * USB_OTG_EP_REG_SIZE + \
+                                     offsetof(USB_OTG_INEndpointTypeDef, r))
+#define R_OEP(n, r)                 (USB_OTG_OUT_ENDPOINT_BASE + (n) * USB_OTG_EP_REG_SIZE + \
+                                     offsetof(USB_OTG_OUTEndpointTypeDef, r))
+#define R_HC(n, r)                  (USB_OTG_HOST_CHANNEL_BASE + (n) * USB_OTG_HOST_CHANNEL_SIZE + \
+                                     offsetof(USB_OTG_HostChannelTypeDef, r))
+#define R_HPRT                      USB_OTG_HOST_PORT_BASE
+
+#define REG(off)                    dwc2_reg[(off) >> 2]
+
+#define DWC2_RXSTS(ep, bcnt, sts)   ((uint32_t)(ep) | ((uint32_t)(bcnt) << 4) | ((uint32_t)(sts) << 17))
+#define DWC2_RXSTS_EP(w)            ((w) & 0xFU)
+#define DWC2_RXSTS_BCNT(w)          (((w) >> 4) & 0x7FFU)
+#define DWC2_RXSTS_STS(w)           (((w) >> 17) & 0xFU)
+
+#define HPRT_W1C                    (USB_OTG_HPORTCSTS_PCINTFLG | USB_OTG_HPORTCSTS_PENCHG | \
+                                     USB_OTG_HPORTCSTS_POVCCHG)
+
+/*!< GCINT bits computed from the rest of the core, never latched */
+#define GCINT_LIVE                  (USB_OTG_GCINT_CURMOSEL | USB_OTG_GCINT_RXFNONE | \
+                                     USB_OTG_GCINT_NPTXFEM | USB_OTG_GCINT_PTXFE | \
+                                     USB_OTG_GCINT_INEP | USB_OTG_GCINT_ONEP | \
+                                     USB_OTG_GCINT_HPORT | USB_OTG_GCINT_HCHAN)
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t *dwc2_mmio;
+static uint32_t dwc2_reg[DWC2_REG_SIZE / 4U];
+static struct dwc2_fifo dwc2_tx[DWC2_PTX + 1U];
+static struct dwc2_fifo dwc2_rx;
+static uint32_t dwc2_rx_left;                   /*!< data words of the popped status still unread */
+static uint32_t dwc2_grst_busy;
+static uint32_t dwc2_faults;
+static uint32_t dwc2_frame;
+static bool dwc2_hc_done[DWC2_CH_NUM];
+static struct dwc2_model_peer dwc2_peer;
+static struct dwc2_model_stats dwc2_stats;
+static struct dwc2_model_cost dwc2_cost = {
+    DWC2_COST_REG_RD, DWC2_COST_REG_WR, DWC2_COST_FIFO_RD, DWC2_COST_FIFO_WR
+};
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/* the driver's only dependency on the DAL, time is accounted, not spent */
+void DAL_Delay(uint32_t Delay) {
+    dwc2_stats.delay_ms += Delay;
+}
+
+/*************************** FIFOs *******************************************/
+
+static void dwc2_fifo_flush(struct dwc2_fifo *f) {
+    f->head = 0;
+    f->tail = 0;
+    f->count = 0;
+}
+
+static bool dwc2_fifo_push(struct dwc2_fifo *f, uint32_t depth, uint32_t w) {
+    if ((f->count >= depth) || (f->count >= DWC2_FIFO_WORDS)) {
+        return false;
+    }
+
+    f->word[f->head] = w;
+    f->head = (f->head + 1U) % DWC2_FIFO_WORDS;
+    f->count++;
+    return true;
+}
+
+static uint32_t dwc2_fifo_pop(struct dwc2_fifo *f) {
+    uint32_t w;
+
+    if (f->count == 0) {
+        return 0;
+    }
+
+    w = f->word[f->tail];
+    f->tail = (f->tail + 1U) % DWC2_FIFO_WORDS;
+    f->count--;
+    return w;
+}
+
+static bool dwc2_is_host(void) {
+    return (REG(R_G(GUSBCFG)) & USB_OTG_GUSBCFG_FHMODE) != 0U;
+}
+
+static uint32_t dwc2_rx_depth(void) {
+    return REG(R_G(GRXFIFO)) & 0xFFFFU;
+}
+
+static uint32_t dwc2_tx_depth(uint32_t n) {
+    if (n == DWC2_PTX) {
+        return REG(R_G(GHPTXFSIZE)) >> 16;
+    }
+    if (n == 0) {
+        return REG(R_G(GTXFCFG)) >> 16;
+    }
+    return REG(R_G(DTXFIFO) + 4U * (n - 1U)) >> 16;
+}
+
+static uint32_t dwc2_tx_free(uint32_t n) {
+    uint32_t depth = dwc2_tx_depth(n);
+
+    if (dwc2_faults & DWC2_MODEL_FAULT_TXFSTS_LIE) {
+        return depth;
+    }
+    return (dwc2_tx[n].count < depth) ? (depth - dwc2_tx[n].count) : 0;
+}
+
+static bool dwc2_rx_room(uint32_t words) {
+    return (dwc2_rx.count + words) <= dwc2_rx_depth();
+}
+
+static void dwc2_rx_push_packet(uint32_t sts, const uint8_t *data, uint32_t len) {
+    uint32_t w;
+    uint32_t i;
+
+    dwc2_fifo_push(&dwc2_rx, dwc2_rx_depth(), sts);
+    for (i = 0; i < len; i += 4U) {
+        w = 0;
+        memcpy(&w, &data[i], ((len - i) < 4U) ? (len - i) : 4U);
+        dwc2_fifo_push(&dwc2_rx, dwc2_rx_depth(), w);
+    }
+}
+
+static uint32_t dwc2_tx_index(uint32_t n) {
+    uint32_t type;
+
+    if (!dwc2_is_host()) {
+        return n;
+    }
+
+    /* host mode, one FIFO per transfer kind whatever the channel */
+    type = (REG(R_HC(n, HCH)) & USB_OTG_HCH_EDPTYP) >> 18;
+    return ((type == EP_TYPE_INTR) || (type == EP_TYPE_ISOC)) ? DWC2_PTX : 0U;
+}
+
+/*************************** register file ***********************************/
+
+static uint32_t dwc2_ep0_mps(uint32_t ctrl) {
+    static const uint16_t mps[4] = { 64, 32, 16, 8 };
+
+    return mps[ctrl & 0x3U];
+}
+
+static uint32_t dwc2_ep_mps(uint32_t n, uint32_t ctrl) {
+    return (n == 0) ? dwc2_ep0_mps(ctrl) : (ctrl & USB_OTG_DIEPCTRL_MAXPS);
+}
+
+static uint32_t dwc2_daepint(void) {
+    uint32_t daint = 0;
+    uint32_t msk;
+    uint32_t n;
+
+    for (n = 0; n < DWC2_EP_NUM; n++) {
+        msk = REG(R_D(DINIMASK));
+        if (REG(R_D(DIEIMASK)) & (1UL << n)) {
+            msk |= USB_OTG_DIEPINT_TXFE;
+        }
+        if ((REG(R_IEP(n, DIEPINT)) | ((dwc2_tx[n].count == 0) ? USB_OTG_DIEPINT_TXFE : 0U)) & msk) {
+            daint |= 1UL << n;
+        }
+        if (REG(R_OEP(n, DOEPINT)) & REG(R_D(DOUTIMASK))) {
+            daint |= 1UL << (16U + n);
+        }
+    }
+
+    return daint;
+}
+
+static uint32_t dwc2_hachint(void) {
+    uint32_t haint = 0;
+    uint32_t n;
+
+    for (n = 0; n < DWC2_CH_NUM; n++) {
+        if (REG(R_HC(n, HCHINT)) & REG(R_HC(n, HCHIMASK))) {
+            haint |= 1UL << n;
+        }
+    }
+
+    return haint;
+}
+
+static uint32_t dwc2_gcint(void) {
+    uint32_t v = REG(R_G(GCINT)) & ~GCINT_LIVE;
+    uint32_t daint;
+
+    if (dwc2_is_host()) {
+        v |= USB_OTG_GCINT_CURMOSEL;
+        if (dwc2_tx[0].count == 0) {
+            v |= USB_OTG_GCINT_NPTXFEM;
+        }
+        if (dwc2_tx[DWC2_PTX].count == 0) {
+            v |= USB_OTG_GCINT_PTXFE;
+        }
+        if (REG(R_HPRT) & HPRT_W1C) {
+            v |= USB_OTG_GCINT_HPORT;
+        }
+        if (dwc2_hachint() & REG(R_H(HACHIMASK))) {
+            v |= USB_OTG_GCINT_HCHAN;
+        }
+    } else {
+        daint = dwc2_daepint() & REG(R_D(DAEPIMASK));
+        if (daint & 0xFFFFU) {
+            v |= USB_OTG_GCINT_INEP;
+        }
+        if (daint >> 16) {
+            v |= USB_OTG_GCINT_ONEP;
+        }
+    }
+
+    if (dwc2_rx.count) {
+        v |= USB_OTG_GCINT_RXFNONE;
+    }
+
+    return v;
+}
+
+/* value of a register without side effects */
+static uint32_t dwc2_peek(uint32_t off) {
+    uint32_t n;
+
+    if (off >= USB_OTG_FIFO_BASE) {
+        return 0;
+    }
+
+    if ((off >= USB_OTG_IN_ENDPOINT_BASE) && (off < USB_OTG_OUT_ENDPOINT_BASE)) {
+        n = (off - USB_OTG_IN_ENDPOINT_BASE) / USB_OTG_EP_REG_SIZE;
+        if (off == R_IEP(n, DIEPINT)) {
+            return REG(off) | ((dwc2_tx[n].count == 0) ? USB_OTG_DIEPINT_TXFE : 0U);
+        }
+        if (off == R_IEP(n, DITXFSTS)) {
+            return dwc2_tx_free(n);
+        }
+        return REG(off);
+    }
+
+    switch (off) {
+        case R_G(GRSTCTRL):
+            return REG(off) | USB_OTG_GRSTCTRL_AHBMIDL;
+        case R_G(GCINT):
+            return dwc2_gcint();
+        case R_G(GRXSTS):
+        case R_G(GRXSTSP):
+            return ((dwc2_rx.count != 0) && (dwc2_rx_left == 0)) ? dwc2_rx.word[dwc2_rx.tail] : 0U;
+        case R_G(GNPTXFQSTS):
+            return (8UL << 16) | dwc2_tx_free(0);
+        case R_H(HPTXSTS):
+            return (8UL << 16) | dwc2_tx_free(DWC2_PTX);
+        case R_H(HFIFM):
+            return dwc2_frame & USB_OTG_HFIFM_FNUM;
+        case R_H(HACHINT):
+            return dwc2_hachint();
+        case R_D(DAEPINT):
+            return dwc2_daepint();
+        default:
+            return REG(off);
+    }
+}
+
+static uint32_t dwc2_rx_pop_status(void) {
+    uint32_t w;
+    uint32_t n;
+
+    if (dwc2_rx_left) {
+        /* the driver skipped data, on hardware this misaligns the FIFO */
+        dwc2_stats.rx_desync++;
+        while (dwc2_rx_left) {
+            dwc2_fifo_pop(&dwc2_rx);
+            dwc2_rx_left--;
+        }
+    }
+
+    if (dwc2_rx.count == 0) {
+        dwc2_stats.rx_underrun++;
+        return 0;
+    }
+
+    w = dwc2_fifo_pop(&dwc2_rx);
+    dwc2_rx_left = (DWC2_RXSTS_BCNT(w) + 3U) / 4U;
+    n = DWC2_RXSTS_EP(w);
+
+    if (!dwc2_is_host()) {
+        switch (DWC2_RXSTS_STS(w)) {
+            case STS_XFER_COMP:
+                REG(R_OEP(n, DOEPCTRL)) &= ~USB_OTG_DOEPCTRL_EPEN;
+                REG(R_OEP(n, DOEPINT)) |= USB_OTG_DOEPINT_TSFCMP;
+                break;
+            case STS_SETUP_COMP:
+                REG(R_OEP(n, DOEPINT)) |= USB_OTG_DOEPINT_SETPCMP;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if ((dwc2_faults & DWC2_MODEL_FAULT_RX_BCNT_LONG) && DWC2_RXSTS_BCNT(w)) {
+        w += 4U << 4;
+    }
+
+    return w;
+}
+
+static uint32_t dwc2_read(uint32_t off) {
+    uint32_t v;
+
+    if (off >= USB_OTG_FIFO_BASE) {
+        dwc2_stats.fifo_rd++;
+        dwc2_stats.cycles += dwc2_cost.fifo_rd;
+
+        if (dwc2_rx_left == 0) {
+            dwc2_stats.rx_underrun++;
+            return 0;
+        }
+        dwc2_rx_left--;
+        return dwc2_fifo_pop(&dwc2_rx);
+    }
+
+    dwc2_stats.reg_rd++;
+    dwc2_stats.cycles += dwc2_cost.reg_rd;
+
+    if (off == R_G(GRXSTSP)) {
+        return dwc2_rx_pop_status();
+    }
+
+    v = dwc2_peek(off);
+
+    if ((off == R_G(GRSTCTRL)) && dwc2_grst_busy && !(dwc2_faults & DWC2_MODEL_FAULT_RESET_STUCK)) {
+        if (--dwc2_grst_busy == 0) {
+            REG(off) &= ~(USB_OTG_GRSTCTRL_CSRST | USB_OTG_GRSTCTRL_RXFFLU | USB_OTG_GRSTCTRL_TXFFLU);
+        }
+    }
+
+    return v;
+}
+
+static void dwc2_write_grstctrl(uint32_t v) {
+    uint32_t num;
+    uint32_t n;
+
+    if (v & USB_OTG_GRSTCTRL_CSRST) {
+        /* soft reset keeps the CSRs, state machines and FIFOs start over */
+        for (n = 0; n <= DWC2_PTX; n++) {
+            dwc2_fifo_flush(&dwc2_tx[n]);
+        }
+        dwc2_fifo_flush(&dwc2_rx);
+        dwc2_rx_left = 0;
+    }
+    if (v & USB_OTG_GRSTCTRL_RXFFLU) {
+        dwc2_fifo_flush(&dwc2_rx);
+        dwc2_rx_left = 0;
+    }
+    if (v & USB_OTG_GRSTCTRL_TXFFLU) {
+        num = (v & USB_OTG_GRSTCTRL_TXFNUM) >> 6;
+        for (n = 0; n <= DWC2_PTX; n++) {
+            if ((num == 0x10U) || (num == n)) {
+                dwc2_fifo_flush(&dwc2_tx[n]);
+            }
+        }
+    }
+
+    REG(R_G(GRSTCTRL)) = v & ~USB_OTG_GRSTCTRL_AHBMIDL;
+    dwc2_grst_busy = DWC2_RESET_READS;
+}
+
+/* DIEPCTRL and DOEPCTRL share the bit layout */
+static void dwc2_write_epctrl(uint32_t off, uint32_t v) {
+    uint32_t old = REG(off);
+    uint32_t nak = old & USB_OTG_DIEPCTRL_NAKSTS;
+
+    if (v & USB_OTG_DIEPCTRL_NAKSET) {
+        nak = USB_OTG_DIEPCTRL_NAKSTS;
+    }
+    if (v & USB_OTG_DIEPCTRL_NAKCLR) {
+        nak = 0;
+    }
+
+    v &= ~(USB_OTG_DIEPCTRL_NAKCLR | USB_OTG_DIEPCTRL_NAKSET | USB_OTG_DIEPCTRL_DPIDSET |
+           USB_OTG_DIEPCTRL_OFSET | USB_OTG_DIEPCTRL_EPDIS | USB_OTG_DIEPCTRL_NAKSTS);
+
+    /* EPEN is set by software and cleared by the core only */
+    REG(off) = v | nak | (old & USB_OTG_DIEPCTRL_EPEN);
+}
+
+static void dwc2_write(uint32_t off, uint32_t v) {
+    uint32_t n;
+    uint32_t idx;
+    uint32_t old;
+
+    if (off >= USB_OTG_FIFO_BASE) {
+        dwc2_stats.fifo_wr++;
+        dwc2_stats.cycles += dwc2_cost.fifo_wr;
+
+        n = (off - USB_OTG_FIFO_BASE) / USB_OTG_FIFO_SIZE;
+        idx = dwc2_tx_index(n);
+        if (!dwc2_fifo_push(&dwc2_tx[idx], dwc2_tx_depth(idx), v)) {
+            dwc2_stats.tx_overflow++;
+        }
+        return;
+    }
+
+    dwc2_stats.reg_wr++;
+    dwc2_stats.cycles += dwc2_cost.reg_wr;
+
+    /* device endpoints */
+    if ((off >= USB_OTG_IN_ENDPOINT_BASE) && (off < USB_OTG_PCGCCTL_BASE)) {
+        if (off < USB_OTG_OUT_ENDPOINT_BASE) {
+            n = (off - USB_OTG_IN_ENDPOINT_BASE) / USB_OTG_EP_REG_SIZE;
+            if (off == R_IEP(n, DIEPCTRL)) {
+                old = REG(off);
+                dwc2_write_epctrl(off, v);
+                if ((v & USB_OTG_DIEPCTRL_EPDIS) && (old & USB_OTG_DIEPCTRL_EPEN)) {
+                    REG(off) &= ~USB_OTG_DIEPCTRL_EPEN;
+                    REG(R_IEP(n, DIEPINT)) |= USB_OTG_DIEPINT_EPDIS;
+                }
+            } else if (off == R_IEP(n, DIEPINT)) {
+                REG(off) &= ~v;
+            } else if (off != R_IEP(n, DITXFSTS)) {
+                REG(off) = v;
+            }
+        } else {
+            n = (off - USB_OTG_OUT_ENDPOINT_BASE) / USB_OTG_EP_REG_SIZE;
+            if (off == R_OEP(n, DOEPCTRL)) {
+                old = REG(off);
+                dwc2_write_epctrl(off, v);
+                if ((v & USB_OTG_DOEPCTRL_EPDIS) && (old & USB_OTG_DOEPCTRL_EPEN)) {
+                    REG(off) &= ~USB_OTG_DOEPCTRL_EPEN;
+                    REG(R_OEP(n, DOEPINT)) |= USB_OTG_DOEPINT_EPDIS;
+                }
+            } else if (off == R_OEP(n, DOEPINT)) {
+                REG(off) &= ~v;
+            } else {
+                REG(off) = v;
+            }
+        }
+        return;
+    }
+
+    /* host channels */
+    if ((off >= USB_OTG_HOST_CHANNEL_BASE) && (off < USB_OTG_DEVICE_BASE)) {
+        n = (off - USB_OTG_HOST_CHANNEL_BASE) / USB_OTG_HOST_CHANNEL_SIZE;
+        if (off == R_HC(n, HCH)) {
+            if ((v & USB_OTG_HCH_CHEN) && !(REG(off) & USB_OTG_HCH_CHEN)) {
+                dwc2_hc_done[n] = false;
+            }
+            /* CHEN with CHINT is a halt request, the next frame completes it */
+            REG(off) = v;
+        } else if (off == R_HC(n, HCHINT)) {
+            REG(off) &= ~v;
+        } else {
+            REG(off) = v;
+        }
+        return;
+    }
+
+    switch (off) {
+        case R_G(GRSTCTRL):
+            dwc2_write_grstctrl(v);
+            break;
+        case R_G(GCINT):
+            REG(off) &= ~(v & ~GCINT_LIVE);
+            break;
+        case R_G(GRXSTS):
+        case R_G(GRXSTSP):
+        case R_G(GNPTXFQSTS):
+        case R_G(GCID):
+        case R_G(GCID) + 4U:
+        case R_H(HFIFM):
+        case R_H(HPTXSTS):
+        case R_H(HACHINT):
+        case R_D(DSTS):
+        case R_D(DAEPINT):
+            /* read only */
+            break;
+        case R_HPRT:
+            old = REG(off);
+            REG(off) = (old & (USB_OTG_HPORTCSTS_PCNNTFLG | USB_OTG_HPORTCSTS_PEN | USB_OTG_HPORTCSTS_PSPDSEL)) |
+                       (old & HPRT_W1C & ~v) |
+                       (v & (USB_OTG_HPORTCSTS_PRST | USB_OTG_HPORTCSTS_PP | USB_OTG_HPORTCSTS_PSUS |
+                             USB_OTG_HPORTCSTS_PRS | USB_OTG_HPORTCSTS_PTSEL));
+            if (v & USB_OTG_HPORTCSTS_PEN) {
+                /* write 1 disables the port */
+                REG(off) &= ~USB_OTG_HPORTCSTS_PEN;
+            }
+            if ((old & USB_OTG_HPORTCSTS_PRST) && !(v & USB_OTG_HPORTCSTS_PRST) &&
+                (old & USB_OTG_HPORTCSTS_PCNNTFLG)) {
+                /* end of port reset, the device is enabled */
+                REG(off) |= USB_OTG_HPORTCSTS_PEN | USB_OTG_HPORTCSTS_PENCHG;
+            }
+            break;
+        default:
+            REG(off) = v;
+            break;
+    }
+}
+
+static const struct mmio_trap_ops dwc2_ops = {
+    dwc2_read, dwc2_peek, dwc2_write
+};
+
+/*************************** model API ***************************************/
+
+/**
+ * @brief   Map the register window, accesses are routed to the model
+ *
+ * @param   cid    GCID value, DWC2_MODEL_CID_FS or DWC2_MODEL_CID_HS
+ *
+ * @retval  USBx for the driver, NULL on failure
+ */
+USB_OTG_GlobalTypeDef *dwc2_model_init(uint32_t cid) {
+    dwc2_mmio = mmio_trap_map(0, DWC2_MMIO_SIZE, &dwc2_ops);
+    if (dwc2_mmio == NULL) {
+        return NULL;
+    }
+
+    memset(dwc2_reg, 0, sizeof(dwc2_reg));
+    memset(dwc2_tx, 0, sizeof(dwc2_tx));
+    memset(&dwc2_rx, 0, sizeof(dwc2_rx));
+    memset(&dwc2_stats, 0, sizeof(dwc2_stats));
+    memset(dwc2_hc_done, 0, sizeof(dwc2_hc_done));
+    memset(&dwc2_peer, 0, sizeof(dwc2_peer));
+    dwc2_rx_left = 0;
+    dwc2_grst_busy = 0;
+    dwc2_faults = 0;
+    dwc2_frame = 0;
+
+    REG(R_G(GCID)) = cid;
+    REG(R_G(GCID) + 4U) = DWC2_SNPSID;
+
+    return (USB_OTG_GlobalTypeDef *)dwc2_mmio;
+}
+
+void dwc2_model_deinit(void) {
+    if (dwc2_mmio == NULL) {
+        return;
+    }
+
+    mmio_trap_unmap(dwc2_mmio);
+    dwc2_mmio = NULL;
+}
+
+void dwc2_model_set_cost(const struct dwc2_model_cost *cost) {
+    dwc2_cost = *cost;
+}
+
+void dwc2_model_set_faults(uint32_t faults) {
+    dwc2_faults = faults;
+}
+
+void dwc2_model_get_stats(struct dwc2_model_stats *stats) {
+    *stats = dwc2_stats;
+}
+
+void dwc2_model_clear_stats(void) {
+    memset(&dwc2_stats, 0, sizeof(dwc2_stats));
+}
+
+/**
+ * @brief   Interrupt line of the core
+ *
+ * @param   None
+ *
+ * @retval  pending and unmasked GCINT bits, 0 while GAHBCFG masks the core
+ */
+uint32_t dwc2_model_irq_pending(void) {
+    if ((REG(R_G(GAHBCFG)) & USB_OTG_GAHBCFG_GINTMASK) == 0U) {
+        return 0;
+    }
+    return dwc2_gcint() & REG(R_G(GINTMASK));
+}
+
+/*************************** device mode *************************************/
+
+void dwc2_model_bus_reset(void) {
+    REG(R_G(GCINT)) |= USB_OTG_GCINT_USBRST | USB_OTG_GCINT_ENUMD;
+    REG(R_D(DSTS)) = (REG(R_D(DSTS)) & ~USB_OTG_DSTS_ENUMSPD) | DSTS_ENUMSPD_FS_PHY_48MHZ;
+    REG(R_D(DCFG)) &= ~USB_OTG_DCFG_DADDR;
+}
+
+/**
+ * @brief   SETUP token on EP0, accepted whatever the endpoint state
+ *
+ * @param   setup  8 byte setup packet
+ *
+ * @retval  8, or DWC2_MODEL_NAK if the RX FIFO is full
+ */
+int dwc2_model_setup(const uint8_t *setup) {
+    if (!dwc2_rx_room(1U + 2U + 1U)) {
+        dwc2_stats.rx_full++;
+        return DWC2_MODEL_NAK;
+    }
+
+    dwc2_rx_push_packet(DWC2_RXSTS(0, 8, STS_SETUP_UPDT), setup, 8);
+    dwc2_fifo_push(&dwc2_rx, dwc2_rx_depth(), DWC2_RXSTS(0, 0, STS_SETUP_COMP));
+
+    REG(R_IEP(0, DIEPCTRL)) &= ~USB_OTG_DIEPCTRL_STALLH;
+    REG(R_OEP(0, DOEPCTRL)) &= ~USB_OTG_DOEPCTRL_STALLH;
+
+    return 8;
+}
+
+/**
+ * @brief   IN token
+ *
+ * @param   ep     endpoint number
+ *
+ * @param   buf    receives the packet
+ *
+ * @param   size   room in buf
+ *
+ * @retval  packet length, or DWC2_MODEL_NAK, DWC2_MODEL_STALL, DWC2_MODEL_BABBLE
+ */
+int dwc2_model_in(uint8_t ep, uint8_t *buf, uint32_t size) {
+    uint32_t n = ep & 0xFU;
+    uint32_t ctrl = REG(R_IEP(n, DIEPCTRL));
+    uint32_t tsiz = REG(R_IEP(n, DIEPTRS));
+    uint32_t xfer = tsiz & USB_OTG_DIEPTRS_EPTRS;
+    uint32_t pkt = (tsiz & USB_OTG_DIEPTRS_EPPCNT) >> 19;
+    uint32_t len;
+    uint32_t w;
+    uint32_t i;
+
+    if (ctrl & USB_OTG_DIEPCTRL_STALLH) {
+        return DWC2_MODEL_STALL;
+    }
+    if (!(ctrl & USB_OTG_DIEPCTRL_EPEN) || (ctrl & USB_OTG_DIEPCTRL_NAKSTS) || (pkt == 0)) {
+        return DWC2_MODEL_NAK;
+    }
+
+    len = dwc2_ep_mps(n, ctrl);
+    if (len > xfer) {
+        len = xfer;
+    }
+    if (len > size) {
+        return DWC2_MODEL_BABBLE;
+    }
+    if (dwc2_tx[n].count < ((len + 3U) / 4U)) {
+        dwc2_stats.in_underrun++;
+        return DWC2_MODEL_NAK;
+    }
+
+    for (i = 0; i < len; i += 4U) {
+        w = dwc2_fifo_pop(&dwc2_tx[n]);
+        memcpy(&buf[i], &w, ((len - i) < 4U) ? (len - i) : 4U);
+    }
+
+    xfer -= len;
+    pkt--;
+    REG(R_IEP(n, DIEPTRS)) = (tsiz & ~(USB_OTG_DIEPTRS_EPTRS | USB_OTG_DIEPTRS_EPPCNT)) | xfer | (pkt << 19);
+
+    if (pkt == 0) {
+        REG(R_IEP(n, DIEPCTRL)) &= ~USB_OTG_DIEPCTRL_EPEN;
+        REG(R_IEP(n, DIEPINT)) |= USB_OTG_DIEPINT_TSFCMP;
+    }
+
+    return (int)len;
+}
+
+/**
+ * @brief   OUT token with its data packet
+ *
+ * @param   ep     endpoint number
+ *
+ * @param   data   packet
+ *
+ * @param   len    packet length, 0 for a ZLP
+ *
+ * @retval  len, or DWC2_MODEL_NAK, DWC2_MODEL_STALL, DWC2_MODEL_BABBLE
+ */
+int dwc2_model_out(uint8_t ep, const uint8_t *data, uint32_t len) {
+    uint32_t n = ep & 0xFU;
+    uint32_t ctrl = REG(R_OEP(n, DOEPCTRL));
+    uint32_t tsiz = REG(R_OEP(n, DOEPTRS));
+    uint32_t xfer = tsiz & USB_OTG_DOEPTRS_EPTRS;
+    uint32_t pkt = (tsiz & USB_OTG_DOEPTRS_EPPCNT) >> 19;
+    uint32_t mps = dwc2_ep_mps(n, ctrl);
+
+    if (ctrl & USB_OTG_DOEPCTRL_STALLH) {
+        return DWC2_MODEL_STALL;
+    }
+    if (!(ctrl & USB_OTG_DOEPCTRL_EPEN) || (ctrl & USB_OTG_DOEPCTRL_NAKSTS) || (pkt == 0)) {
+        return DWC2_MODEL_NAK;
+    }
+    if (len > mps) {
+        return DWC2_MODEL_BABBLE;
+    }
+    if (!dwc2_rx_room(1U + ((len + 3U) / 4U) + 1U)) {
+        dwc2_stats.rx_full++;
+        return DWC2_MODEL_NAK;
+    }
+
+    dwc2_rx_push_packet(DWC2_RXSTS(n, len, STS_DATA_UPDT), data, len);
+
+    xfer -= (len < xfer) ? len : xfer;
+    pkt--;
+    REG(R_OEP(n, DOEPTRS)) = (tsiz & ~(USB_OTG_DOEPTRS_EPTRS | USB_OTG_DOEPTRS_EPPCNT)) | xfer | (pkt << 19);
+
+    if ((len < mps) || (pkt == 0)) {
+        /* EPEN drops when the driver pops this entry */
+        dwc2_fifo_push(&dwc2_rx, dwc2_rx_depth(), DWC2_RXSTS(n, 0, STS_XFER_COMP));
+        REG(R_OEP(n, DOEPCTRL)) |= USB_OTG_DOEPCTRL_NAKSTS;
+    }
+
+    return (int)len;
+}
+
+/*************************** host mode ***************************************/
+
+/**
+ * @brief   Plug a full speed device into the root port
+ *
+ * @param   peer   the device, NULL ACKs every OUT and NAKs every IN
+ *
+ * @retval  None
+ */
+void dwc2_model_attach(const struct dwc2_model_peer *peer) {
+    if (peer != NULL) {
+        dwc2_peer = *peer;
+    } else {
+        memset(&dwc2_peer, 0, sizeof(dwc2_peer));
+    }
+
+    REG(R_HPRT) |= USB_OTG_HPORTCSTS_PCNNTFLG | USB_OTG_HPORTCSTS_PCINTFLG |
+                   (HPRT0_PRTSPD_FULL_SPEED << 17);
+}
+
+static void dwc2_hc_out(uint32_t ch, uint32_t ep, uint32_t mps) {
+    uint32_t tsiz = REG(R_HC(ch, HCHTSIZE));
+    uint32_t xfer = tsiz & USB_OTG_HCHTSIZE_TSFSIZE;
+    uint32_t pkt = (tsiz & USB_OTG_HCHTSIZE_PCKTCNT) >> 19;
+    uint32_t idx = dwc2_tx_index(ch);
+    uint8_t data[1024];
+    uint32_t len = (xfer < mps) ? xfer : mps;
+    uint32_t w;
+    uint32_t i;
+    int ret;
+
+    if (dwc2_tx[idx].count < ((len + 3U) / 4U)) {
+        /* the core waits for the whole packet */
+        return;
+    }
+
+    for (i = 0; i < len; i += 4U) {
+        w = dwc2_fifo_pop(&dwc2_tx[idx]);
+        memcpy(&data[i], &w, ((len - i) < 4U) ? (len - i) : 4U);
+    }
+
+    ret = (dwc2_peer.out != NULL) ? dwc2_peer.out(dwc2_peer.arg, (uint8_t)ep, data, len) : (int)len;
+
+    if (ret == DWC2_MODEL_NAK) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXNAK;
+        return;
+    }
+    if (ret == DWC2_MODEL_STALL) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXSTALL;
+        return;
+    }
+
+    xfer -= len;
+    pkt = pkt ? (pkt - 1U) : 0U;
+    REG(R_HC(ch, HCHTSIZE)) = (tsiz & ~(USB_OTG_HCHTSIZE_TSFSIZE | USB_OTG_HCHTSIZE_PCKTCNT)) | xfer | (pkt << 19);
+    REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXTXACK;
+
+    if (pkt == 0) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_TSFCMPN;
+        dwc2_hc_done[ch] = true;
+    }
+}
+
+static void dwc2_hc_in(uint32_t ch, uint32_t ep, uint32_t mps) {
+    uint32_t tsiz = REG(R_HC(ch, HCHTSIZE));
+    uint32_t xfer = tsiz & USB_OTG_HCHTSIZE_TSFSIZE;
+    uint32_t pkt = (tsiz & USB_OTG_HCHTSIZE_PCKTCNT) >> 19;
+    uint8_t data[1024];
+    int ret;
+
+    if (!dwc2_rx_room(1U + ((mps + 3U) / 4U) + 1U)) {
+        dwc2_stats.rx_full++;
+        return;
+    }
+
+    ret = (dwc2_peer.in != NULL) ? dwc2_peer.in(dwc2_peer.arg, (uint8_t)(ep | 0x80U), data, mps) : DWC2_MODEL_NAK;
+
+    if (ret == DWC2_MODEL_NAK) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXNAK;
+        return;
+    }
+    if (ret < 0) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXSTALL;
+        return;
+    }
+    if ((uint32_t)ret > mps) {
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_BABBLE;
+        return;
+    }
+
+    dwc2_rx_push_packet(DWC2_RXSTS(ch, ret, STS_DATA_UPDT), data, (uint32_t)ret);
+
+    xfer -= ((uint32_t)ret < xfer) ? (uint32_t)ret : xfer;
+    pkt = pkt ? (pkt - 1U) : 0U;
+    REG(R_HC(ch, HCHTSIZE)) = (tsiz & ~(USB_OTG_HCHTSIZE_TSFSIZE | USB_OTG_HCHTSIZE_PCKTCNT)) | xfer | (pkt << 19);
+    REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_RXTXACK;
+
+    if (((uint32_t)ret < mps) || (pkt == 0)) {
+        dwc2_fifo_push(&dwc2_rx, dwc2_rx_depth(), DWC2_RXSTS(ch, 0, STS_XFER_COMP));
+        REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_TSFCMPN;
+        dwc2_hc_done[ch] = true;
+    }
+}
+
+/**
+ * @brief   One scheduling pass, every enabled channel gets one transaction
+ *
+ * @param   None
+ *
+ * @retval  None
+ */
+void dwc2_model_frame(void) {
+    uint32_t hch;
+    uint32_t ch;
+
+    dwc2_frame++;
+
+    for (ch = 0; ch < DWC2_CH_NUM; ch++) {
+        hch = REG(R_HC(ch, HCH));
+        if (!(hch & USB_OTG_HCH_CHEN)) {
+            continue;
+        }
+        if (hch & USB_OTG_HCH_CHINT) {
+            REG(R_HC(ch, HCH)) = hch & ~(USB_OTG_HCH_CHEN | USB_OTG_HCH_CHINT);
+            REG(R_HC(ch, HCHINT)) |= USB_OTG_HCHINT_TSFCMPAN;
+            continue;
+        }
+        if (dwc2_hc_done[ch] || !(REG(R_HPRT) & USB_OTG_HPORTCSTS_PEN)) {
+            continue;
+        }
+
+        if (hch & USB_OTG_HCH_EDPDRT) {
+            dwc2_hc_in(ch, (hch & USB_OTG_HCH_EDPNUM) >> 11, hch & USB_OTG_HCH_MAXPSIZE);
+        } else {
+            dwc2_hc_out(ch, (hch & USB_OTG_HCH_EDPNUM) >> 11, hch & USB_OTG_HCH_MAXPSIZE);
+        }
+    }
+}
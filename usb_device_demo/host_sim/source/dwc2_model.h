@@ -0,0 +1,100 @@
+/**
+  * @file    dwc2_model.h
+  * @author  LuckkMaker
+  * @brief   Header for dwc2_model.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef DWC2_MODEL_H
+#define DWC2_MODEL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "apm32f4xx_dal.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< GCID of the modelled core, bit 8 clear selects the full speed core */
+#define DWC2_MODEL_CID_FS           0x00001200U
+#define DWC2_MODEL_CID_HS           0x00001300U
+
+/*!< handshake of a token, byte counts are returned as >= 0 */
+#define DWC2_MODEL_NAK              (-1)
+#define DWC2_MODEL_STALL            (-2)
+#define DWC2_MODEL_BABBLE           (-3)
+
+/*!< fault injection */
+#define DWC2_MODEL_FAULT_RESET_STUCK    (1U << 0)   /*!< CSRST and the FIFO flush bits never clear */
+#define DWC2_MODEL_FAULT_TXFSTS_LIE     (1U << 1)   /*!< TX FIFO status always reports an empty FIFO */
+#define DWC2_MODEL_FAULT_RX_BCNT_LONG   (1U << 2)   /*!< RX status byte count one word longer than the data */
+
+/*!< bus cost in AHB cycles, charged per driver access */
+struct dwc2_model_cost {
+    uint32_t reg_rd;
+    uint32_t reg_wr;
+    uint32_t fifo_rd;
+    uint32_t fifo_wr;
+};
+
+struct dwc2_model_stats {
+    uint32_t reg_rd;
+    uint32_t reg_wr;
+    uint32_t fifo_rd;           /*!< words popped from the RX FIFO */
+    uint32_t fifo_wr;           /*!< words pushed to a TX FIFO */
+    uint64_t cycles;            /*!< estimated bus cycles of the accesses above */
+    uint32_t delay_ms;          /*!< DAL_Delay() time requested by the driver */
+    uint32_t tx_overflow;       /*!< words written to a full TX FIFO, dropped */
+    uint32_t rx_underrun;       /*!< words read past the packet, or from an empty RX FIFO */
+    uint32_t rx_desync;         /*!< status popped with data of the previous packet unread */
+    uint32_t in_underrun;       /*!< IN tokens NAKed because the FIFO did not hold the packet */
+    uint32_t rx_full;           /*!< OUT tokens NAKed because the RX FIFO was full */
+};
+
+/*!< far end of the cable in host mode, called from dwc2_model_frame() */
+struct dwc2_model_peer {
+    int (*out)(void *arg, uint8_t ep, const uint8_t *data, uint32_t len);   /*!< len, NAK or STALL */
+    int (*in)(void *arg, uint8_t ep, uint8_t *data, uint32_t mps);          /*!< length, NAK or STALL */
+    void *arg;
+};
+
+USB_OTG_GlobalTypeDef *dwc2_model_init(uint32_t cid);
+void dwc2_model_deinit(void);
+void dwc2_model_set_cost(const struct dwc2_model_cost *cost);
+void dwc2_model_set_faults(uint32_t faults);
+void dwc2_model_get_stats(struct dwc2_model_stats *stats);
+void dwc2_model_clear_stats(void);
+uint32_t dwc2_model_irq_pending(void);
+
+/* device mode, the model plays the host */
+void dwc2_model_bus_reset(void);
+int dwc2_model_setup(const uint8_t *setup);
+int dwc2_model_in(uint8_t ep, uint8_t *buf, uint32_t size);
+int dwc2_model_out(uint8_t ep, const uint8_t *data, uint32_t len);
+
+/* host mode, the model plays the device through the peer */
+void dwc2_model_attach(const struct dwc2_model_peer *peer);
+void dwc2_model_frame(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* DWC2_MODEL_H */
@@ -0,0 +1,701 @@
+/**
+  * @file    fsdev_bench.c
+  * @author  LuckkMaker
+  * @brief   Register and PMA access profile of apm32f10x_usb_device.c on the USBD model
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The SPD device driver runs unmodified against fsdev_model.c, the
+  * USBD_*Callback() hooks are implemented here the way the device core
+  * uses them (EP0 data and status stages, endpoint open on reset). Per
+  * operation:
+  *   reset        bus reset interrupt, EP0 opened from USBD_EnumDoneCallback
+  *   get_desc_100 control read of 100 bytes, 4 packets and the status stage
+  *   set_address  no data control, the address must be live after status
+  *   ctl_out_64   control write of 64 bytes
+  *   in_512       bulk IN of 512 bytes, single buffer
+  *   out_512      bulk OUT of 512 bytes, single buffer
+  *   db_in_512    bulk IN of 512 bytes, double buffer
+  *   db_out_512   bulk OUT of 512 bytes, double buffer
+  * then one run per injected fault, then the fuzz run: random control and
+  * bulk transfers, lengths, max packet sizes, PMA placement and interrupt
+  * latency from a seeded generator, every byte checked.
+  *
+  *   fsdev_bench [iterations] [seed]
+  *
+  * Cycles are bus cycles from the model cost table, not host time. Driver
+  * defects the model exposes are listed in fsdev_bench_known[]: they are
+  * reported, do not fail the run, and are flagged if they start passing.
+  * Exits non-zero on any other data error, an undetected fault or a fuzz
+  * failure.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fsdev_model.h"
+#include "apm32f10x_usb_device.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct fsdev_bench_known {
+    const char *test;
+    const char *reason;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define FSDEV_BENCH_EP0_MPS         32U
+#define FSDEV_BENCH_MPS             64U
+#define FSDEV_BENCH_LEN             512U
+#define FSDEV_BENCH_DESC_LEN        100U
+#define FSDEV_BENCH_CTL_OUT_LEN     64U
+#define FSDEV_BENCH_DEV_ADDR        5U
+
+#define FSDEV_BENCH_EP_SB           1U      /*!< single buffer bulk IN and OUT */
+#define FSDEV_BENCH_EP_DB_IN        2U
+#define FSDEV_BENCH_EP_DB_OUT       3U
+
+/*!< PMA layout in bytes, descriptors of EP0..3 at 0 */
+#define FSDEV_BENCH_PMA_EP0_OUT     0x020U
+#define FSDEV_BENCH_PMA_EP0_IN      0x040U
+#define FSDEV_BENCH_PMA_SB_OUT      0x060U
+#define FSDEV_BENCH_PMA_SB_IN       0x0A0U
+#define FSDEV_BENCH_PMA_DB_IN       0x0E0U
+#define FSDEV_BENCH_PMA_DB_OUT      0x160U
+#define FSDEV_BENCH_PMA_END         0x200U
+
+/*!< tokens before a transfer is declared stuck */
+#define FSDEV_BENCH_TRIES           64U
+
+/*!< longest fuzzed transfers */
+#define FSDEV_BENCH_FUZZ_CTL        255U
+#define FSDEV_BENCH_FUZZ_BULK       1024U
+
+/* Private macro -------------------------------------------------------------*/
+#define FSDEV_BENCH_PMA2(a0, a1)    ((uint32_t)(a0) | ((uint32_t)(a1) << 16))
+
+/* Private variables ---------------------------------------------------------*/
+static USBD_HANDLE_T usbdh;
+static uint8_t bench_tx[FSDEV_BENCH_FUZZ_BULK];
+static uint8_t bench_rx[FSDEV_BENCH_FUZZ_BULK];
+static uint8_t bench_expect[FSDEV_BENCH_FUZZ_BULK];
+static int bench_errors;
+
+/* EP0 state of the device side, what the device core keeps */
+static uint8_t ctl_setup[8];
+static uint8_t ctl_buf[FSDEV_BENCH_FUZZ_CTL];
+static uint32_t ctl_len;
+static uint32_t ctl_done;
+static uint32_t ep0_mps = FSDEV_BENCH_EP0_MPS;
+
+/* completions reported by the driver */
+static uint32_t in_done[8];
+static uint32_t out_done[8];
+
+/* fuzz: interrupt latency */
+static uint32_t bench_rng = 1;
+static uint32_t bench_lazy;
+
+static const struct fsdev_bench_known fsdev_bench_known[] = {
+    { "db_in_512",  "USBD_ConfigEP / USBD_EP_XferStart leave DTOG_TX == SW_BUF, "
+                    "both buffers are filled but never released to the core" },
+    { "db_out_512", "USBD_ConfigEP leaves DTOG_RX == SW_BUF, USBD_EP_XferStart only "
+                    "toggles SW_BUF when bufCount != 0, which USBD_EP_Receive clears" },
+};
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static uint32_t fsdev_bench_rand(void) {
+    /* xorshift32, the seed picks the run */
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return bench_rng;
+}
+
+static void fsdev_bench_fail(const char *what) {
+    printf("FAIL %s\n", what);
+    bench_errors++;
+}
+
+static const struct fsdev_bench_known *fsdev_bench_find_known(const char *test) {
+    uint32_t i;
+
+    for (i = 0; i < (sizeof(fsdev_bench_known) / sizeof(fsdev_bench_known[0])); i++) {
+        if (strcmp(fsdev_bench_known[i].test, test) == 0) {
+            return &fsdev_bench_known[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* a failing test that is a known driver defect is reported, not counted */
+static void fsdev_bench_result(const char *test, bool ok) {
+    const struct fsdev_bench_known *known = fsdev_bench_find_known(test);
+
+    if ((known != NULL) && !ok) {
+        printf("%-13s known driver defect: %s\n", test, known->reason);
+    } else if (known != NULL) {
+        printf("%-13s passes, drop it from fsdev_bench_known[]\n", test);
+        bench_errors++;
+    } else if (!ok) {
+        fsdev_bench_fail(test);
+    }
+}
+
+static void fsdev_bench_pattern(uint8_t *buf, uint32_t len, uint8_t seed) {
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(seed + i * 7U);
+    }
+}
+
+static void fsdev_bench_print(const char *name, uint32_t calls) {
+    struct fsdev_model_stats st;
+
+    fsdev_model_get_stats(&st);
+    printf("%-13s %7.1f reg_rd %7.1f reg_wr %7.1f pma_rd %7.1f pma_wr %9.1f cycles/call\n",
+           name,
+           (double)st.reg_rd / calls,
+           (double)st.reg_wr / calls,
+           (double)st.pma_rd / calls,
+           (double)st.pma_wr / calls,
+           (double)st.cycles / calls);
+}
+
+/*************************** device side *************************************/
+
+void USBD_EnumDoneCallback(USBD_HANDLE_T *usbdh) {
+    USBD_ConfigPMA(usbdh, 0x00, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_EP0_OUT);
+    USBD_ConfigPMA(usbdh, 0x80, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_EP0_IN);
+    USBD_EP_Open(usbdh, 0x00, EP_TYPE_CONTROL, ep0_mps);
+    USBD_EP_Open(usbdh, 0x80, EP_TYPE_CONTROL, ep0_mps);
+}
+
+void USBD_SetupStageCallback(USBD_HANDLE_T *usbdh) {
+    uint16_t length;
+
+    memcpy(ctl_setup, usbdh->setup, sizeof(ctl_setup));
+    length = (uint16_t)(ctl_setup[6] | (ctl_setup[7] << 8));
+    ctl_done = 0;
+
+    if (length > sizeof(ctl_buf)) {
+        USBD_EP_Stall(usbdh, 0x80);
+        return;
+    }
+    ctl_len = length;
+
+    if (ctl_setup[0] & 0x80U) {
+        /* control read, the data is the pattern seeded by wValue */
+        fsdev_bench_pattern(ctl_buf, ctl_len, ctl_setup[2]);
+        USBD_EP_Transfer(usbdh, 0x80, ctl_buf, ctl_len);
+    } else if (ctl_len) {
+        USBD_EP_Receive(usbdh, 0x00, ctl_buf, ctl_len);
+    } else {
+        if (ctl_setup[1] == 0x05U) {
+            /* SET_ADDRESS, applied by the driver after the status stage */
+            USBD_SetDevAddress(usbdh, ctl_setup[2]);
+        }
+        USBD_EP_Transfer(usbdh, 0x80, NULL, 0);
+    }
+}
+
+void USBD_DataInStageCallback(USBD_HANDLE_T *usbdh, uint8_t epNum) {
+    USBD_ENDPOINT_INFO_T *ep = &usbdh->epIN[0];
+
+    if (epNum != 0) {
+        in_done[epNum & 7U]++;
+        return;
+    }
+
+    if (!(ctl_setup[0] & 0x80U)) {
+        /* status stage of a control write */
+        return;
+    }
+
+    ctl_done += ep->bufCount;
+    if ((ctl_done < ctl_len) || ((ep->bufCount == ep0_mps) && (ctl_done == ctl_len) &&
+        (ctl_len < (uint32_t)(ctl_setup[6] | (ctl_setup[7] << 8))))) {
+        USBD_EP_Transfer(usbdh, 0x80, &ctl_buf[ctl_done], ctl_len - ctl_done);
+    } else {
+        USBD_EP_Receive(usbdh, 0x00, NULL, 0);
+    }
+}
+
+void USBD_DataOutStageCallback(USBD_HANDLE_T *usbdh, uint8_t epNum) {
+    if (epNum != 0) {
+        out_done[epNum & 7U]++;
+        return;
+    }
+
+    ctl_done += usbdh->epOUT[0].bufCount;
+    if (ctl_done >= ctl_len) {
+        USBD_EP_Transfer(usbdh, 0x80, NULL, 0);
+    }
+}
+
+static void fsdev_bench_isr(void) {
+    uint32_t guard = 0;
+
+    if (bench_lazy && ((fsdev_bench_rand() % bench_lazy) == 0U)) {
+        /* interrupt held off, the next token sees the endpoint NAK */
+        return;
+    }
+
+    while (fsdev_model_irq_pending() && (guard++ < 16U)) {
+        USBD_IsrHandler(&usbdh);
+    }
+}
+
+/* end of a transfer, whatever the latency the interrupt has run by now */
+static void fsdev_bench_settle(void) {
+    uint32_t lazy = bench_lazy;
+
+    bench_lazy = 0;
+    fsdev_bench_isr();
+    bench_lazy = lazy;
+}
+
+/*************************** host side ***************************************/
+
+static int fsdev_bench_in(uint8_t ep, uint8_t *buf, uint32_t size) {
+    uint32_t tries;
+    int ret = FSDEV_MODEL_NAK;
+
+    for (tries = 0; (tries < FSDEV_BENCH_TRIES) && (ret == FSDEV_MODEL_NAK); tries++) {
+        ret = fsdev_model_in(ep, buf, size);
+        fsdev_bench_isr();
+    }
+
+    return ret;
+}
+
+static int fsdev_bench_out(uint8_t ep, const uint8_t *data, uint32_t len) {
+    uint32_t tries;
+    int ret = FSDEV_MODEL_NAK;
+
+    for (tries = 0; (tries < FSDEV_BENCH_TRIES) && (ret == FSDEV_MODEL_NAK); tries++) {
+        ret = fsdev_model_out(ep, data, len);
+        fsdev_bench_isr();
+    }
+
+    return ret;
+}
+
+/* IN data until a short packet or len bytes, -1 on a handshake error */
+static int fsdev_bench_read(uint8_t ep, uint8_t *buf, uint32_t len, uint32_t mps) {
+    uint32_t got = 0;
+    int ret;
+
+    do {
+        ret = fsdev_bench_in(ep, &buf[got], mps);
+        if (ret < 0) {
+            return -1;
+        }
+        got += (uint32_t)ret;
+    } while ((got < len) && ((uint32_t)ret == mps));
+
+    return (int)got;
+}
+
+/* OUT data in mps packets, a zero length packet for len 0 */
+static int fsdev_bench_write(uint8_t ep, const uint8_t *data, uint32_t len, uint32_t mps) {
+    uint32_t sent = 0;
+    uint32_t n;
+
+    do {
+        n = ((len - sent) > mps) ? mps : (len - sent);
+        if (fsdev_bench_out(ep, &data[sent], n) != (int)n) {
+            return -1;
+        }
+        sent += n;
+    } while (sent < len);
+
+    return 0;
+}
+
+/* full control transfer, data points at wLength bytes */
+static int fsdev_bench_control(uint8_t type, uint8_t req, uint16_t value, uint8_t *data, uint16_t length) {
+    uint8_t setup[8] = {
+        type, req, (uint8_t)value, (uint8_t)(value >> 8), 0, 0, (uint8_t)length, (uint8_t)(length >> 8)
+    };
+    int ret;
+
+    if (fsdev_model_setup(setup) != 8) {
+        return -1;
+    }
+    fsdev_bench_isr();
+
+    if (type & 0x80U) {
+        ret = fsdev_bench_read(0, data, length, ep0_mps);
+        if ((ret != (int)length) || (fsdev_bench_out(0, NULL, 0) != 0)) {
+            return -1;
+        }
+    } else {
+        if (length && (fsdev_bench_write(0, data, length, ep0_mps) != 0)) {
+            return -1;
+        }
+        if (fsdev_bench_in(0, bench_rx, ep0_mps) != 0) {
+            return -1;
+        }
+    }
+    fsdev_bench_settle();
+
+    return 0;
+}
+
+/*************************** runs ********************************************/
+
+static int fsdev_bench_init(void) {
+    if (fsdev_model_init() == NULL) {
+        return -1;
+    }
+
+    memset(&usbdh, 0, sizeof(usbdh));
+    memset(in_done, 0, sizeof(in_done));
+    memset(out_done, 0, sizeof(out_done));
+    usbdh.usbGlobal = USBD;
+    usbdh.usbCfg.devEndpointNum = 8;
+
+    USBD_Config(&usbdh);
+    USBD_Start(&usbdh);
+
+    return 0;
+}
+
+static int fsdev_bench_reset(void) {
+    fsdev_model_bus_reset();
+    fsdev_bench_settle();
+    return (fsdev_model_in(0, bench_rx, ep0_mps) == FSDEV_MODEL_NAK) ? 0 : -1;
+}
+
+static void fsdev_bench_open(uint8_t ep_addr, uint16_t status, uint32_t pma, uint16_t mps) {
+    USBD_ConfigPMA(&usbdh, ep_addr, status, pma);
+    USBD_EP_Open(&usbdh, ep_addr, EP_TYPE_BULK, mps);
+}
+
+static bool fsdev_bench_in_once(uint8_t ep, uint32_t len, uint32_t mps, uint8_t seed) {
+    uint32_t done = in_done[ep];
+
+    fsdev_bench_pattern(bench_tx, len, seed);
+    memset(bench_rx, 0, len);
+    USBD_EP_Transfer(&usbdh, 0x80U | ep, bench_tx, len);
+
+    if (fsdev_bench_read(ep, bench_rx, len, mps) != (int)len) {
+        return false;
+    }
+    fsdev_bench_settle();
+
+    return (in_done[ep] == (done + 1U)) && !memcmp(bench_rx, bench_tx, len);
+}
+
+static bool fsdev_bench_out_once(uint8_t ep, uint32_t len, uint32_t mps, uint8_t seed) {
+    uint32_t done = out_done[ep];
+
+    fsdev_bench_pattern(bench_tx, len, seed);
+    memset(bench_rx, 0, len);
+    USBD_EP_Receive(&usbdh, ep, bench_rx, len);
+
+    if (fsdev_bench_write(ep, bench_tx, len, mps) != 0) {
+        return false;
+    }
+    fsdev_bench_settle();
+
+    return (out_done[ep] == (done + 1U)) && (USBD_EP_ReadRxDataLen(&usbdh, ep) == len) &&
+           !memcmp(bench_rx, bench_tx, len);
+}
+
+static void fsdev_bench_device(uint32_t iterations) {
+    uint32_t i;
+    bool ok;
+
+    if (fsdev_bench_init() != 0) {
+        fsdev_bench_fail("model init");
+        return;
+    }
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        if (fsdev_bench_reset() != 0) {
+            fsdev_bench_fail("reset");
+            fsdev_model_deinit();
+            return;
+        }
+    }
+    fsdev_bench_print("reset", iterations);
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        fsdev_bench_pattern(bench_expect, FSDEV_BENCH_DESC_LEN, (uint8_t)i);
+        if ((fsdev_bench_control(0x80, 0x06, (uint16_t)(i & 0xFFU), bench_rx, FSDEV_BENCH_DESC_LEN) != 0) ||
+            memcmp(bench_rx, bench_expect, FSDEV_BENCH_DESC_LEN)) {
+            fsdev_bench_fail("get_desc_100");
+            fsdev_model_deinit();
+            return;
+        }
+    }
+    fsdev_bench_print("get_desc_100", iterations);
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        fsdev_model_set_address(0);
+        if ((fsdev_bench_control(0x00, 0x05, FSDEV_BENCH_DEV_ADDR, NULL, 0) != 0) ||
+            (fsdev_model_in(0, bench_rx, ep0_mps) != FSDEV_MODEL_TIMEOUT)) {
+            fsdev_bench_fail("set_address");
+            fsdev_model_deinit();
+            return;
+        }
+        fsdev_model_set_address(FSDEV_BENCH_DEV_ADDR);
+        if (fsdev_model_in(0, bench_rx, ep0_mps) != FSDEV_MODEL_NAK) {
+            fsdev_bench_fail("set_address");
+            fsdev_model_deinit();
+            return;
+        }
+        USBD_SetDevAddress(&usbdh, 0);
+    }
+    fsdev_bench_print("set_address", iterations);
+    fsdev_model_set_address(0);
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        fsdev_bench_pattern(bench_tx, FSDEV_BENCH_CTL_OUT_LEN, (uint8_t)i);
+        if ((fsdev_bench_control(0x21, 0x09, 0, bench_tx, FSDEV_BENCH_CTL_OUT_LEN) != 0) ||
+            (ctl_done != FSDEV_BENCH_CTL_OUT_LEN) || memcmp(ctl_buf, bench_tx, FSDEV_BENCH_CTL_OUT_LEN)) {
+            fsdev_bench_fail("ctl_out_64");
+            fsdev_model_deinit();
+            return;
+        }
+    }
+    fsdev_bench_print("ctl_out_64", iterations);
+
+    fsdev_bench_open(FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_SB_OUT, FSDEV_BENCH_MPS);
+    fsdev_bench_open(0x80U | FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_SB_IN, FSDEV_BENCH_MPS);
+    fsdev_bench_open(0x80U | FSDEV_BENCH_EP_DB_IN, USBD_EP_BUFFER_DOUBLE,
+                     FSDEV_BENCH_PMA2(FSDEV_BENCH_PMA_DB_IN, FSDEV_BENCH_PMA_DB_IN + FSDEV_BENCH_MPS),
+                     FSDEV_BENCH_MPS);
+    fsdev_bench_open(FSDEV_BENCH_EP_DB_OUT, USBD_EP_BUFFER_DOUBLE,
+                     FSDEV_BENCH_PMA2(FSDEV_BENCH_PMA_DB_OUT, FSDEV_BENCH_PMA_DB_OUT + FSDEV_BENCH_MPS),
+                     FSDEV_BENCH_MPS);
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        if (!fsdev_bench_in_once(FSDEV_BENCH_EP_SB, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, (uint8_t)i)) {
+            fsdev_bench_fail("in_512");
+            fsdev_model_deinit();
+            return;
+        }
+    }
+    fsdev_bench_print("in_512", iterations);
+
+    fsdev_model_clear_stats();
+    for (i = 0; i < iterations; i++) {
+        if (!fsdev_bench_out_once(FSDEV_BENCH_EP_SB, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, (uint8_t)i)) {
+            fsdev_bench_fail("out_512");
+            fsdev_model_deinit();
+            return;
+        }
+    }
+    fsdev_bench_print("out_512", iterations);
+
+    fsdev_model_clear_stats();
+    for (i = 0, ok = true; ok && (i < iterations); i++) {
+        ok = fsdev_bench_in_once(FSDEV_BENCH_EP_DB_IN, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, (uint8_t)i);
+    }
+    if (ok) {
+        fsdev_bench_print("db_in_512", iterations);
+    }
+    fsdev_bench_result("db_in_512", ok);
+
+    fsdev_model_clear_stats();
+    for (i = 0, ok = true; ok && (i < iterations); i++) {
+        ok = fsdev_bench_out_once(FSDEV_BENCH_EP_DB_OUT, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, (uint8_t)i);
+    }
+    if (ok) {
+        fsdev_bench_print("db_out_512", iterations);
+    }
+    fsdev_bench_result("db_out_512", ok);
+
+    fsdev_model_deinit();
+}
+
+/*************************** faults ******************************************/
+
+static void fsdev_bench_fault_report(const char *name, bool detected, const char *how) {
+    printf("fault %-13s %s (%s)\n", name, detected ? "detected" : "MISSED", how);
+    if (!detected) {
+        bench_errors++;
+    }
+}
+
+static void fsdev_bench_faults(void) {
+    struct fsdev_model_stats st;
+    bool ok;
+
+    /* OUT count two bytes long, the received length is off */
+    if ((fsdev_bench_init() != 0) || (fsdev_bench_reset() != 0)) {
+        fsdev_bench_fail("model init");
+        return;
+    }
+    fsdev_bench_open(FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_SB_OUT, FSDEV_BENCH_MPS);
+    fsdev_model_set_faults(FSDEV_MODEL_FAULT_CNT_LONG);
+    ok = fsdev_bench_out_once(FSDEV_BENCH_EP_SB, 40, FSDEV_BENCH_MPS, 1);
+    fsdev_bench_fault_report("cnt_long", !ok, "received length");
+    fsdev_model_deinit();
+
+    /* DTOG frozen, the host sees repeated data PIDs */
+    if ((fsdev_bench_init() != 0) || (fsdev_bench_reset() != 0)) {
+        fsdev_bench_fail("model init");
+        return;
+    }
+    fsdev_bench_open(0x80U | FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_SB_IN, FSDEV_BENCH_MPS);
+    fsdev_model_set_faults(FSDEV_MODEL_FAULT_DTOG_STUCK);
+    fsdev_bench_in_once(FSDEV_BENCH_EP_SB, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, 2);
+    fsdev_model_get_stats(&st);
+    fsdev_bench_fault_report("dtog_stuck", st.toggle_err != 0, "model toggle_err");
+    fsdev_model_deinit();
+
+    /* received halfwords byte swapped */
+    if ((fsdev_bench_init() != 0) || (fsdev_bench_reset() != 0)) {
+        fsdev_bench_fail("model init");
+        return;
+    }
+    fsdev_bench_open(FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, FSDEV_BENCH_PMA_SB_OUT, FSDEV_BENCH_MPS);
+    fsdev_model_set_faults(FSDEV_MODEL_FAULT_PMA_SWAP);
+    ok = fsdev_bench_out_once(FSDEV_BENCH_EP_SB, FSDEV_BENCH_LEN, FSDEV_BENCH_MPS, 3);
+    fsdev_bench_fault_report("pma_swap", !ok, "data compare");
+    fsdev_model_deinit();
+}
+
+/*************************** fuzz ********************************************/
+
+/* EP1 IN and OUT buffers at random, non overlapping, even PMA addresses */
+static void fsdev_bench_fuzz_open(uint16_t mps) {
+    uint32_t room = FSDEV_BENCH_PMA_END - FSDEV_BENCH_PMA_SB_OUT - 2U * mps;
+    uint32_t gap = (fsdev_bench_rand() % (room / 2U + 1U)) * 2U;
+    uint32_t first = FSDEV_BENCH_PMA_SB_OUT + (fsdev_bench_rand() % ((room - gap) / 2U + 1U)) * 2U;
+    uint32_t second = first + mps + gap;
+
+    if (fsdev_bench_rand() & 1U) {
+        fsdev_bench_open(FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, first, mps);
+        fsdev_bench_open(0x80U | FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, second, mps);
+    } else {
+        fsdev_bench_open(0x80U | FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, first, mps);
+        fsdev_bench_open(FSDEV_BENCH_EP_SB, USBD_EP_BUFFER_SINGLE, second, mps);
+    }
+}
+
+static void fsdev_bench_fuzz(uint32_t iterations, uint32_t seed) {
+    static const uint16_t mps_set[] = { 8, 16, 32, 64 };
+    struct fsdev_model_stats st;
+    uint32_t i;
+    uint32_t op = 0;
+    uint32_t len = 0;
+    uint16_t mps = FSDEV_BENCH_MPS;
+    bool ok = true;
+
+    bench_rng = seed ? seed : 1U;
+
+    if (fsdev_bench_init() != 0) {
+        fsdev_bench_fail("fuzz init");
+        return;
+    }
+    fsdev_model_clear_stats();
+    bench_lazy = 3;
+
+    for (i = 0; ok && (i < iterations); i++) {
+        op = fsdev_bench_rand() % 4U;
+
+        if ((i % 16U) == 0U) {
+            /* host side reconfiguration, data toggles start over */
+            mps = mps_set[fsdev_bench_rand() % 4U];
+            if (fsdev_bench_reset() != 0) {
+                ok = false;
+                break;
+            }
+            fsdev_bench_fuzz_open(mps);
+        }
+
+        switch (op) {
+            case 0:
+                len = fsdev_bench_rand() % (FSDEV_BENCH_FUZZ_CTL + 1U);
+                fsdev_bench_pattern(bench_expect, len, (uint8_t)i);
+                ok = (fsdev_bench_control(0x80, 0x06, (uint16_t)(i & 0xFFU), bench_rx, (uint16_t)len) == 0) &&
+                     !memcmp(bench_rx, bench_expect, len);
+                break;
+            case 1:
+                len = 1U + fsdev_bench_rand() % FSDEV_BENCH_FUZZ_CTL;
+                fsdev_bench_pattern(bench_tx, len, (uint8_t)i);
+                ok = (fsdev_bench_control(0x21, 0x09, 0, bench_tx, (uint16_t)len) == 0) &&
+                     (ctl_done == len) && !memcmp(ctl_buf, bench_tx, len);
+                break;
+            case 2:
+                len = fsdev_bench_rand() % (FSDEV_BENCH_FUZZ_BULK + 1U);
+                ok = fsdev_bench_in_once(FSDEV_BENCH_EP_SB, len, mps, (uint8_t)i);
+                break;
+            default:
+                len = fsdev_bench_rand() % (FSDEV_BENCH_FUZZ_BULK + 1U);
+                ok = fsdev_bench_out_once(FSDEV_BENCH_EP_SB, len, mps, (uint8_t)i);
+                break;
+        }
+
+        fsdev_model_get_stats(&st);
+        if (st.toggle_err || st.rx_overrun || st.pma_oob) {
+            ok = false;
+        }
+    }
+
+    bench_lazy = 0;
+    fsdev_model_get_stats(&st);
+
+    if (!ok) {
+        printf("FAIL fuzz seed %u iteration %u op %u len %u mps %u "
+               "(toggle_err %u rx_overrun %u pma_oob %u)\n",
+               seed, i - 1U, op, len, mps, st.toggle_err, st.rx_overrun, st.pma_oob);
+        bench_errors++;
+    } else {
+        printf("fuzz          %u transfers, seed %u, %u NAKs from held off interrupts\n",
+               iterations, seed, st.nak);
+    }
+
+    fsdev_model_deinit();
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 100;
+    uint32_t seed = 1;
+
+    if (argc > 1) {
+        iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        seed = (uint32_t)strtoul(argv[2], NULL, 0);
+    }
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    fsdev_bench_device(iterations);
+    fsdev_bench_faults();
+    fsdev_bench_fuzz(iterations, seed);
+
+    return (bench_errors == 0) ? 0 : 1;
+}
@@ -0,0 +1,594 @@
+/**
+  * @file    fsdev_model.c
+  * @author  LuckkMaker
+  * @brief   Register level model of the USBD core for running apm32f10x_usb.c on Linux
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The SPD driver reaches the packet memory through the fixed USBD and
+  * USBD_PMA_ADDR addresses, so the window is mapped where the chip has it,
+  * 0x40005000 to 0x40006FFF, and mmio_trap.c routes every access here.
+  *
+  * Modelled:
+  *   - EPx: CTFR / CTFT are rc_w0, DTOG and STS bits toggle on writing 1,
+  *     SETUP is read only, TYPE / KIND / ADDR are plain,
+  *   - INTSTS: CTR, EPID and DOT follow the EPx flags, the other flags are
+  *     rc_w0,
+  *   - 512 byte PMA as 256 16-bit words in 32-bit slots (USBD_PMA_ACCESS 2),
+  *     buffer descriptors at BUFFTB, RX size from BLSIZE / NUM_BLOCK,
+  *   - bulk double buffering (KIND set on a bulk endpoint): the core uses
+  *     the buffer DTOG points at, buffer 0 in the TX descriptor fields and
+  *     buffer 1 in the RX ones, SW_BUF is the DTOG bit of the other
+  *     direction, a token is NAKed while DTOG == SW_BUF, STS stays VALID.
+  * Not modelled: isochronous endpoints, suspend / wakeup signalling, the
+  * control STATUS_OUT (KIND) handshake check.
+  *
+  * SETUP is accepted unless the endpoint is disabled, then forces both STS
+  * fields to NAK and both DTOG bits to 1, so the data and status stages run
+  * with DATA1.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "fsdev_model.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include "apm32f10x_usb.h"
+#include "mmio_trap.h"
+#include <stddef.h>
+#include <string.h>
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+#define FSDEV_MMIO_BASE             (USBD_BASE & ~0xFFFU)
+#define FSDEV_MMIO_SIZE             0x2000U
+#define FSDEV_REG_OFF               (USBD_BASE - FSDEV_MMIO_BASE)
+#define FSDEV_PMA_OFF               (USBD_PMA_ADDR - FSDEV_MMIO_BASE)
+#define FSDEV_PMA_BYTES             512U
+#define FSDEV_PMA_WORDS             (FSDEV_PMA_BYTES / 2U)
+#define FSDEV_EP_NUM                8U
+
+/*!< placeholder bus costs, calibrate against the board */
+#define FSDEV_COST_REG_RD           6U
+#define FSDEV_COST_REG_WR           4U
+#define FSDEV_COST_PMA_RD           6U
+#define FSDEV_COST_PMA_WR           4U
+
+/*!< CTRL after a system reset, FORRST and PWRDOWN set */
+#define FSDEV_CTRL_RESET            0x0003U
+
+/*!< buffer descriptor fields, 16-bit words from BUFFTB + ep * 8 */
+#define BT_TX_ADDR                  0U
+#define BT_TX_CNT                   1U
+#define BT_RX_ADDR                  2U
+#define BT_RX_CNT                   3U
+
+#define EP_TOGGLE                   (USBD_EP_BIT_RXDTOG | USBD_EP_BIT_RXSTS | \
+                                     USBD_EP_BIT_TXDTOG | USBD_EP_BIT_TXSTS)
+#define EP_RW                       (USBD_EP_BIT_TYPE | USBD_EP_BIT_KIND | USBD_EP_BIT_ADDR)
+#define EP_RC_W0                    (USBD_EP_BIT_CTFR | USBD_EP_BIT_CTFT)
+
+/*!< INTSTS flags cleared by writing 0, CTR is computed */
+#define INTSTS_RC_W0                (USBD_INT_ALL & ~USBD_INT_CTR)
+
+/* Private macro -------------------------------------------------------------*/
+#define R_USBD(r)                   (FSDEV_REG_OFF + offsetof(USBD_T, r))
+#define EP_TYPE(v)                  (((v) & USBD_EP_BIT_TYPE) >> 9)
+#define EP_TXSTS(v)                 (((v) & USBD_EP_BIT_TXSTS) >> 4)
+#define EP_RXSTS(v)                 (((v) & USBD_EP_BIT_RXSTS) >> 12)
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t *fsdev_mmio;
+static uint16_t fsdev_ep[FSDEV_EP_NUM];
+static uint16_t fsdev_ctrl;
+static uint16_t fsdev_intsts;
+static uint16_t fsdev_frame;
+static uint16_t fsdev_addr;
+static uint16_t fsdev_bufftb;
+static uint32_t fsdev_switch;
+static uint16_t fsdev_pma[FSDEV_PMA_WORDS];
+static uint8_t fsdev_host_addr;
+static uint8_t fsdev_host_in[16];               /*!< data PID the host expects next, per endpoint */
+static uint8_t fsdev_host_out[16];              /*!< data PID the host sends next, per endpoint */
+static uint32_t fsdev_faults;
+static struct fsdev_model_stats fsdev_stats;
+static struct fsdev_model_cost fsdev_cost = {
+    FSDEV_COST_REG_RD, FSDEV_COST_REG_WR, FSDEV_COST_PMA_RD, FSDEV_COST_PMA_WR
+};
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/*************************** packet memory ***********************************/
+
+static uint16_t *fsdev_bt(uint32_t n, uint32_t field) {
+    return &fsdev_pma[((fsdev_bufftb >> 1) + n * 4U + field) % FSDEV_PMA_WORDS];
+}
+
+/* room of an RX buffer from its count field */
+static uint32_t fsdev_rx_size(uint16_t cnt) {
+    uint32_t blocks = (cnt >> 10) & 0x1FU;
+
+    return (cnt & 0x8000U) ? (blocks + 1U) * 32U : blocks * 2U;
+}
+
+static uint32_t fsdev_pma_clip(uint32_t addr, uint32_t len) {
+    if ((addr + len) > FSDEV_PMA_BYTES) {
+        fsdev_stats.pma_oob++;
+        return (addr < FSDEV_PMA_BYTES) ? FSDEV_PMA_BYTES - addr : 0U;
+    }
+    return len;
+}
+
+static void fsdev_pma_put(uint32_t addr, const uint8_t *data, uint32_t len) {
+    uint32_t i;
+    uint16_t w;
+
+    len = fsdev_pma_clip(addr, len);
+
+    for (i = 0; i < len; i += 2U) {
+        w = data[i];
+        if ((i + 1U) < len) {
+            w |= (uint16_t)data[i + 1U] << 8;
+        }
+        if (fsdev_faults & FSDEV_MODEL_FAULT_PMA_SWAP) {
+            w = (uint16_t)((w << 8) | (w >> 8));
+        }
+        fsdev_pma[(addr + i) >> 1] = w;
+    }
+}
+
+static void fsdev_pma_get(uint32_t addr, uint8_t *data, uint32_t len) {
+    uint32_t i;
+    uint16_t w;
+
+    len = fsdev_pma_clip(addr, len);
+
+    for (i = 0; i < len; i += 2U) {
+        w = fsdev_pma[(addr + i) >> 1];
+        data[i] = (uint8_t)w;
+        if ((i + 1U) < len) {
+            data[i + 1U] = (uint8_t)(w >> 8);
+        }
+    }
+}
+
+/*************************** registers ***************************************/
+
+static uint16_t fsdev_intsts_read(void) {
+    uint16_t v = fsdev_intsts & INTSTS_RC_W0;
+    uint32_t n;
+
+    for (n = 0; n < FSDEV_EP_NUM; n++) {
+        if (fsdev_ep[n] & EP_RC_W0) {
+            v |= USBD_INT_CTR | (uint16_t)n;
+            if (fsdev_ep[n] & USBD_EP_BIT_CTFR) {
+                v |= 0x10U;
+            }
+            break;
+        }
+    }
+
+    return v;
+}
+
+/* USB reset, from the bus or from FORRST */
+static void fsdev_reset(void) {
+    memset(fsdev_ep, 0, sizeof(fsdev_ep));
+    fsdev_addr = 0;
+    fsdev_intsts |= USBD_INT_RST;
+}
+
+/* value of a register without side effects */
+static uint32_t fsdev_peek(uint32_t off) {
+    if (off >= FSDEV_PMA_OFF) {
+        off = (off - FSDEV_PMA_OFF) >> 2;
+        return (off < FSDEV_PMA_WORDS) ? fsdev_pma[off] : 0U;
+    }
+
+    if ((off >= R_USBD(EP)) && (off < R_USBD(EP[FSDEV_EP_NUM]))) {
+        return fsdev_ep[(off - R_USBD(EP)) >> 2];
+    }
+
+    switch (off) {
+        case R_USBD(CTRL):
+            return fsdev_ctrl;
+        case R_USBD(INTSTS):
+            return fsdev_intsts_read();
+        case R_USBD(FRANUM):
+            return fsdev_frame & 0x7FFU;
+        case R_USBD(ADDR):
+            return fsdev_addr;
+        case R_USBD(BUFFTB):
+            return fsdev_bufftb;
+        case R_USBD(SWITCH):
+            return fsdev_switch;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t fsdev_read(uint32_t off) {
+    if (off >= FSDEV_PMA_OFF) {
+        fsdev_stats.pma_rd++;
+        fsdev_stats.cycles += fsdev_cost.pma_rd;
+        if (((off - FSDEV_PMA_OFF) >> 2) >= FSDEV_PMA_WORDS) {
+            fsdev_stats.pma_oob++;
+        }
+    } else {
+        fsdev_stats.reg_rd++;
+        fsdev_stats.cycles += fsdev_cost.reg_rd;
+    }
+
+    return fsdev_peek(off);
+}
+
+static void fsdev_write_ep(uint32_t n, uint32_t v) {
+    uint16_t old = fsdev_ep[n];
+    uint16_t reg;
+
+    reg = (old & (uint16_t)~EP_RW) | (v & EP_RW);
+    reg ^= v & EP_TOGGLE;
+    reg &= (v & EP_RC_W0) | (uint16_t)~EP_RC_W0;
+
+    fsdev_ep[n] = reg;
+}
+
+static void fsdev_write(uint32_t off, uint32_t v) {
+    if (off >= FSDEV_PMA_OFF) {
+        fsdev_stats.pma_wr++;
+        fsdev_stats.cycles += fsdev_cost.pma_wr;
+
+        off = (off - FSDEV_PMA_OFF) >> 2;
+        if (off < FSDEV_PMA_WORDS) {
+            fsdev_pma[off] = (uint16_t)v;
+        } else {
+            fsdev_stats.pma_oob++;
+        }
+        return;
+    }
+
+    fsdev_stats.reg_wr++;
+    fsdev_stats.cycles += fsdev_cost.reg_wr;
+
+    if ((off >= R_USBD(EP)) && (off < R_USBD(EP[FSDEV_EP_NUM]))) {
+        fsdev_write_ep((off - R_USBD(EP)) >> 2, v);
+        return;
+    }
+
+    switch (off) {
+        case R_USBD(CTRL):
+            if ((v & ~fsdev_ctrl) & 0x1U) {
+                fsdev_reset();
+            }
+            fsdev_ctrl = (uint16_t)(v & 0xFF1FU);
+            break;
+        case R_USBD(INTSTS):
+            fsdev_intsts &= (uint16_t)v | (uint16_t)~INTSTS_RC_W0;
+            break;
+        case R_USBD(ADDR):
+            fsdev_addr = (uint16_t)(v & 0xFFU);
+            break;
+        case R_USBD(BUFFTB):
+            fsdev_bufftb = (uint16_t)(v & 0xFFF8U);
+            break;
+        case R_USBD(SWITCH):
+            fsdev_switch = v & 0x1U;
+            break;
+        default:
+            break;
+    }
+}
+
+static const struct mmio_trap_ops fsdev_ops = {
+    fsdev_read, fsdev_peek, fsdev_write
+};
+
+/*************************** model API ***************************************/
+
+/**
+ * @brief   Map the USBD and PMA window at their chip addresses
+ *
+ * @param   None
+ *
+ * @retval  USBD for the driver, NULL if the address range is taken
+ */
+USBD_T *fsdev_model_init(void) {
+    fsdev_mmio = mmio_trap_map(FSDEV_MMIO_BASE, FSDEV_MMIO_SIZE, &fsdev_ops);
+    if (fsdev_mmio == NULL) {
+        return NULL;
+    }
+
+    memset(fsdev_ep, 0, sizeof(fsdev_ep));
+    memset(fsdev_pma, 0, sizeof(fsdev_pma));
+    memset(fsdev_host_in, 0, sizeof(fsdev_host_in));
+    memset(fsdev_host_out, 0, sizeof(fsdev_host_out));
+    memset(&fsdev_stats, 0, sizeof(fsdev_stats));
+    fsdev_ctrl = FSDEV_CTRL_RESET;
+    fsdev_intsts = 0;
+    fsdev_frame = 0;
+    fsdev_addr = 0;
+    fsdev_bufftb = 0;
+    fsdev_switch = 0;
+    fsdev_host_addr = 0;
+    fsdev_faults = 0;
+
+    return (USBD_T *)(fsdev_mmio + FSDEV_REG_OFF);
+}
+
+void fsdev_model_deinit(void) {
+    if (fsdev_mmio == NULL) {
+        return;
+    }
+
+    mmio_trap_unmap(fsdev_mmio);
+    fsdev_mmio = NULL;
+}
+
+void fsdev_model_set_cost(const struct fsdev_model_cost *cost) {
+    fsdev_cost = *cost;
+}
+
+void fsdev_model_set_faults(uint32_t faults) {
+    fsdev_faults = faults;
+}
+
+void fsdev_model_get_stats(struct fsdev_model_stats *stats) {
+    *stats = fsdev_stats;
+}
+
+void fsdev_model_clear_stats(void) {
+    memset(&fsdev_stats, 0, sizeof(fsdev_stats));
+}
+
+/**
+ * @brief   Interrupt line of the core
+ *
+ * @param   None
+ *
+ * @retval  pending INTSTS flags enabled in CTRL
+ */
+uint32_t fsdev_model_irq_pending(void) {
+    return fsdev_intsts_read() & fsdev_ctrl & USBD_INT_ALL;
+}
+
+/*************************** host side ***************************************/
+
+void fsdev_model_bus_reset(void) {
+    fsdev_reset();
+    fsdev_host_addr = 0;
+    memset(fsdev_host_in, 0, sizeof(fsdev_host_in));
+    memset(fsdev_host_out, 0, sizeof(fsdev_host_out));
+}
+
+void fsdev_model_sof(void) {
+    fsdev_frame++;
+    fsdev_intsts |= USBD_INT_SOF;
+}
+
+/**
+ * @brief   Address the following tokens go to, after SET_ADDRESS completed
+ *
+ * @param   addr   device address
+ *
+ * @retval  None
+ */
+void fsdev_model_set_address(uint8_t addr) {
+    fsdev_host_addr = addr & 0x7FU;
+}
+
+/* endpoint register answering a token, -1 if the device does not */
+static int fsdev_find(uint8_t ep) {
+    uint32_t n;
+
+    if ((fsdev_ctrl & 0x1U) || !(fsdev_addr & 0x80U) || ((fsdev_addr & 0x7FU) != fsdev_host_addr)) {
+        return -1;
+    }
+
+    for (n = 0; n < FSDEV_EP_NUM; n++) {
+        if ((fsdev_ep[n] & USBD_EP_BIT_ADDR) == ep) {
+            return (int)n;
+        }
+    }
+
+    return -1;
+}
+
+static bool fsdev_is_db(uint16_t reg) {
+    return (EP_TYPE(reg) == USBD_REG_EP_TYPE_BULK) && (reg & USBD_EP_BIT_KIND);
+}
+
+static void fsdev_toggle(uint32_t n, uint16_t bit) {
+    if (!(fsdev_faults & FSDEV_MODEL_FAULT_DTOG_STUCK)) {
+        fsdev_ep[n] ^= bit;
+    }
+}
+
+static void fsdev_set_sts(uint32_t n, uint16_t mask, uint16_t sts) {
+    fsdev_ep[n] = (fsdev_ep[n] & (uint16_t)~mask) | sts;
+}
+
+/**
+ * @brief   SETUP token on a control endpoint, accepted unless disabled
+ *
+ * @param   setup  8 byte setup packet
+ *
+ * @retval  8, or FSDEV_MODEL_STALL on a buffer overrun, FSDEV_MODEL_TIMEOUT
+ */
+int fsdev_model_setup(const uint8_t *setup) {
+    int n = fsdev_find(0);
+    uint16_t *cnt;
+
+    if ((n < 0) || (EP_TYPE(fsdev_ep[n]) != USBD_REG_EP_TYPE_CONTROL) ||
+        (EP_RXSTS(fsdev_ep[n]) == USBD_EP_STATUS_DISABLE)) {
+        return FSDEV_MODEL_TIMEOUT;
+    }
+
+    cnt = fsdev_bt((uint32_t)n, BT_RX_CNT);
+    if (fsdev_rx_size(*cnt) < 8U) {
+        fsdev_stats.rx_overrun++;
+        return FSDEV_MODEL_STALL;
+    }
+
+    fsdev_pma_put(*fsdev_bt((uint32_t)n, BT_RX_ADDR), setup, 8);
+    *cnt = (*cnt & 0xFC00U) | ((fsdev_faults & FSDEV_MODEL_FAULT_CNT_LONG) ? 10U : 8U);
+
+    fsdev_ep[n] |= USBD_EP_BIT_CTFR | USBD_EP_BIT_SETUP | USBD_EP_BIT_RXDTOG | USBD_EP_BIT_TXDTOG;
+    fsdev_set_sts((uint32_t)n, USBD_EP_BIT_RXSTS | USBD_EP_BIT_TXSTS,
+                  (USBD_EP_STATUS_NAK << 12) | (USBD_EP_STATUS_NAK << 4));
+
+    fsdev_host_in[0] = 1;
+    fsdev_host_out[0] = 1;
+
+    return 8;
+}
+
+/**
+ * @brief   IN token
+ *
+ * @param   ep     endpoint number
+ *
+ * @param   buf    receives the packet
+ *
+ * @param   size   room in buf
+ *
+ * @retval  packet length, or FSDEV_MODEL_NAK, _STALL, _TIMEOUT, _BABBLE
+ */
+int fsdev_model_in(uint8_t ep, uint8_t *buf, uint32_t size) {
+    int n = fsdev_find(ep & 0xFU);
+    uint16_t reg;
+    uint32_t field = BT_TX_ADDR;
+    uint32_t len;
+
+    if ((n < 0) || (EP_TYPE(fsdev_ep[n]) == USBD_REG_EP_TYPE_ISO)) {
+        return FSDEV_MODEL_TIMEOUT;
+    }
+
+    reg = fsdev_ep[n];
+    switch (EP_TXSTS(reg)) {
+        case USBD_EP_STATUS_DISABLE:
+            return FSDEV_MODEL_TIMEOUT;
+        case USBD_EP_STATUS_STALL:
+            return FSDEV_MODEL_STALL;
+        case USBD_EP_STATUS_NAK:
+            fsdev_stats.nak++;
+            return FSDEV_MODEL_NAK;
+        default:
+            break;
+    }
+
+    if (fsdev_is_db(reg)) {
+        /* SW_BUF of an IN endpoint is DTOG_RX */
+        if (!(reg & USBD_EP_BIT_TXDTOG) == !(reg & USBD_EP_BIT_RXDTOG)) {
+            fsdev_stats.nak++;
+            return FSDEV_MODEL_NAK;
+        }
+        if (reg & USBD_EP_BIT_TXDTOG) {
+            field = BT_RX_ADDR;
+        }
+    }
+
+    len = *fsdev_bt((uint32_t)n, field + 1U) & 0x3FFU;
+    if (len > size) {
+        return FSDEV_MODEL_BABBLE;
+    }
+
+    if (!(reg & USBD_EP_BIT_TXDTOG) != !fsdev_host_in[ep & 0xFU]) {
+        fsdev_stats.toggle_err++;
+    }
+    fsdev_host_in[ep & 0xFU] ^= 1U;
+
+    fsdev_pma_get(*fsdev_bt((uint32_t)n, field), buf, len);
+
+    fsdev_ep[n] |= USBD_EP_BIT_CTFT;
+    fsdev_toggle((uint32_t)n, USBD_EP_BIT_TXDTOG);
+    if (!fsdev_is_db(reg)) {
+        fsdev_set_sts((uint32_t)n, USBD_EP_BIT_TXSTS, USBD_EP_STATUS_NAK << 4);
+    }
+
+    return (int)len;
+}
+
+/**
+ * @brief   OUT token with its data packet
+ *
+ * @param   ep     endpoint number
+ *
+ * @param   data   packet
+ *
+ * @param   len    packet length
+ *
+ * @retval  len, or FSDEV_MODEL_NAK, _STALL, _TIMEOUT
+ */
+int fsdev_model_out(uint8_t ep, const uint8_t *data, uint32_t len) {
+    int n = fsdev_find(ep & 0xFU);
+    uint16_t reg;
+    uint16_t *cnt;
+    uint32_t field = BT_RX_ADDR;
+    uint32_t count = len;
+
+    if ((n < 0) || (EP_TYPE(fsdev_ep[n]) == USBD_REG_EP_TYPE_ISO)) {
+        return FSDEV_MODEL_TIMEOUT;
+    }
+
+    reg = fsdev_ep[n];
+    switch (EP_RXSTS(reg)) {
+        case USBD_EP_STATUS_DISABLE:
+            return FSDEV_MODEL_TIMEOUT;
+        case USBD_EP_STATUS_STALL:
+            return FSDEV_MODEL_STALL;
+        case USBD_EP_STATUS_NAK:
+            fsdev_stats.nak++;
+            return FSDEV_MODEL_NAK;
+        default:
+            break;
+    }
+
+    if (fsdev_is_db(reg)) {
+        /* SW_BUF of an OUT endpoint is DTOG_TX */
+        if (!(reg & USBD_EP_BIT_RXDTOG) == !(reg & USBD_EP_BIT_TXDTOG)) {
+            fsdev_stats.nak++;
+            return FSDEV_MODEL_NAK;
+        }
+        field = (reg & USBD_EP_BIT_RXDTOG) ? BT_RX_ADDR : BT_TX_ADDR;
+    }
+
+    cnt = fsdev_bt((uint32_t)n, field + 1U);
+    if (len > fsdev_rx_size(*cnt)) {
+        fsdev_stats.rx_overrun++;
+        return FSDEV_MODEL_STALL;
+    }
+
+    if (!(reg & USBD_EP_BIT_RXDTOG) != !fsdev_host_out[ep & 0xFU]) {
+        fsdev_stats.toggle_err++;
+    }
+    fsdev_host_out[ep & 0xFU] ^= 1U;
+
+    fsdev_pma_put(*fsdev_bt((uint32_t)n, field), data, len);
+    if ((fsdev_faults & FSDEV_MODEL_FAULT_CNT_LONG) && len) {
+        count += 2U;
+    }
+    *cnt = (*cnt & 0xFC00U) | (uint16_t)count;
+
+    fsdev_ep[n] = (fsdev_ep[n] | USBD_EP_BIT_CTFR) & (uint16_t)~USBD_EP_BIT_SETUP;
+    fsdev_toggle((uint32_t)n, USBD_EP_BIT_RXDTOG);
+    if (!fsdev_is_db(reg)) {
+        fsdev_set_sts((uint32_t)n, USBD_EP_BIT_RXSTS, USBD_EP_STATUS_NAK << 12);
+    }
+
+    return (int)len;
+}
@@ -0,0 +1,86 @@
+/**
+  * @file    fsdev_model.h
+  * @author  LuckkMaker
+  * @brief   Header for fsdev_model.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef FSDEV_MODEL_H
+#define FSDEV_MODEL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "apm32f10x.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< handshake of a token, byte counts are returned as >= 0 */
+#define FSDEV_MODEL_NAK             (-1)
+#define FSDEV_MODEL_STALL           (-2)
+#define FSDEV_MODEL_TIMEOUT         (-3)    /*!< no handshake: endpoint disabled, wrong address, core off */
+#define FSDEV_MODEL_BABBLE          (-4)
+
+/*!< fault injection */
+#define FSDEV_MODEL_FAULT_CNT_LONG      (1U << 0)   /*!< received count two bytes longer than the data */
+#define FSDEV_MODEL_FAULT_DTOG_STUCK    (1U << 1)   /*!< DTOG bits do not toggle on a transaction */
+#define FSDEV_MODEL_FAULT_PMA_SWAP      (1U << 2)   /*!< received data lands byte swapped in the PMA */
+
+/*!< bus cost in CPU cycles, charged per driver access */
+struct fsdev_model_cost {
+    uint32_t reg_rd;
+    uint32_t reg_wr;
+    uint32_t pma_rd;
+    uint32_t pma_wr;
+};
+
+struct fsdev_model_stats {
+    uint32_t reg_rd;
+    uint32_t reg_wr;
+    uint32_t pma_rd;            /*!< 16-bit PMA reads by the driver, BTABLE included */
+    uint32_t pma_wr;            /*!< 16-bit PMA writes by the driver, BTABLE included */
+    uint64_t cycles;            /*!< estimated bus cycles of the accesses above */
+    uint32_t nak;               /*!< tokens answered NAK */
+    uint32_t toggle_err;        /*!< data PID of a packet differs from the endpoint DTOG */
+    uint32_t rx_overrun;        /*!< OUT or SETUP packet larger than the buffer, stalled */
+    uint32_t pma_oob;           /*!< accesses past the packet memory, by the driver or a descriptor */
+};
+
+USBD_T *fsdev_model_init(void);
+void fsdev_model_deinit(void);
+void fsdev_model_set_cost(const struct fsdev_model_cost *cost);
+void fsdev_model_set_faults(uint32_t faults);
+void fsdev_model_get_stats(struct fsdev_model_stats *stats);
+void fsdev_model_clear_stats(void);
+uint32_t fsdev_model_irq_pending(void);
+
+/* the model plays the host */
+void fsdev_model_bus_reset(void);
+void fsdev_model_sof(void);
+void fsdev_model_set_address(uint8_t addr);
+int fsdev_model_setup(const uint8_t *setup);
+int fsdev_model_in(uint8_t ep, uint8_t *buf, uint32_t size);
+int fsdev_model_out(uint8_t ep, const uint8_t *data, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* FSDEV_MODEL_H */
@@ -0,0 +1,403 @@
+/**
+  * @file    hp_bench.c
+  * @author  LuckkMaker
+  * @brief   Bulk IN streaming of usbd_fsdev_hp.c against the LP serviced single buffer
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * The F103 usbd_fsdev_hp.c runs unmodified against fsdev_model.c, the host
+  * reads one bulk IN endpoint back to back, a NAKed token is retried at
+  * once. Time is simulated, hp_bench_time holds the costs:
+  *   lp_single  single buffer refilled from the LP vector, the way the
+  *              CherryUSB fsdev port does it: the endpoint NAKs from the
+  *              ACK until the vector has run and copied the next packet,
+  *   hp_double  usbd_fsdev_hp.c, the next packet is released by the HP
+  *              vector with one register write, 2 KiB transfers queued from
+  *              the completion in the LP vector.
+  * Each row holds the LP vector off for a window per millisecond, what a
+  * control transfer or an interrupt of the same priority does to it. The
+  * HP vector is never held off. Throughput, NAKs and the largest gap
+  * between two packets (jitter) are reported per row.
+  *
+  * The check run then streams transfers of random length, zero length
+  * ones included, under random LP windows and compares every byte.
+  *
+  *   hp_bench [KiB per row] [seed]
+  *
+  * Exits non-zero on a data or toggle error or a stalled stream.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fsdev_model.h"
+#include "hp_bench.h"
+#include "usbd_fsdev_hp.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+enum hp_bench_mode {
+    HP_BENCH_LP_SINGLE = 0,
+    HP_BENCH_HP_DOUBLE
+};
+
+/*!< simulated costs in ns */
+struct hp_bench_time {
+    uint32_t packet;            /*!< 64 byte bulk IN transaction, token to handshake */
+    uint32_t nak;               /*!< NAKed token */
+    uint32_t hp;                /*!< ACK to SW_BUF toggled, HP entry and the first writes */
+    uint32_t lp;                /*!< ACK to STS VALID, LP entry, dispatch and the PMA copy */
+};
+
+struct hp_bench_load {
+    uint32_t busy;              /*!< LP held off this long ... */
+    uint32_t period;            /*!< ... once per period */
+};
+
+struct hp_bench_result {
+    uint64_t ns;
+    uint32_t bytes;
+    uint32_t packets;
+    uint32_t naks;
+    uint32_t gap_max;
+    uint32_t errors;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define HP_BENCH_EP                 1U
+#define HP_BENCH_MPS                64U
+#define HP_BENCH_PMA_TX             0x080U
+#define HP_BENCH_XFER               2048U
+#define HP_BENCH_MAX_KIB            1024U
+
+#define HP_BENCH_NEVER              UINT64_MAX
+
+/*!< NAKs in a row before the stream is declared stuck */
+#define HP_BENCH_STUCK              100000U
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static const struct hp_bench_time hp_bench_time = {
+    .packet = 51000U,
+    .nak = 4000U,
+    .hp = 1000U,
+    .lp = 6000U,
+};
+
+static const struct hp_bench_load hp_bench_loads[] = {
+    { 0U,      1000000U },
+    { 20000U,  1000000U },
+    { 100000U, 1000000U },
+    { 300000U, 1000000U },
+};
+
+static uint8_t bench_src[HP_BENCH_MAX_KIB * 1024U];
+static USBD_T *bench_usbx;
+static enum hp_bench_mode bench_mode;
+static struct hp_bench_load bench_load;
+static uint32_t bench_total;
+static uint32_t bench_queued;           /*!< bytes handed to the device side */
+static bool bench_random;               /*!< check run: random transfers and windows */
+static uint32_t bench_rng = 1;
+static int bench_errors;
+
+/* device side clock and the vectors due */
+static uint64_t dev_now;
+static uint64_t hp_due;
+static uint64_t lp_due;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static uint32_t hp_bench_rand(void) {
+    /* xorshift32, the seed picks the run */
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return bench_rng;
+}
+
+/* first time from t on the LP vector is not held off */
+static uint64_t hp_bench_lp_free(uint64_t t) {
+    uint64_t ofs;
+
+    if ((bench_load.busy == 0U) || (bench_load.period == 0U)) {
+        return t;
+    }
+
+    ofs = t % bench_load.period;
+    return (ofs < bench_load.busy) ? (t - ofs + bench_load.busy) : t;
+}
+
+/*************************** device side *************************************/
+
+/* USBD_FSDEV_HP_PEND_LP() of the module */
+void hp_bench_pend_lp(void) {
+    uint64_t due = hp_bench_lp_free(dev_now) + hp_bench_time.lp;
+
+    if (due < lp_due) {
+        lp_due = due;
+    }
+}
+
+static void hp_bench_next_transfer(void) {
+    uint32_t len;
+
+    if (bench_queued >= bench_total) {
+        return;
+    }
+
+    len = bench_random ? (hp_bench_rand() % 300U) : HP_BENCH_XFER;
+    if (len > (bench_total - bench_queued)) {
+        len = bench_total - bench_queued;
+    }
+    if (usbd_fsdev_hp_in_write(&bench_src[bench_queued], len) != 0) {
+        printf("FAIL write refused at %u\n", bench_queued);
+        bench_errors++;
+        return;
+    }
+    bench_queued += len;
+}
+
+static void hp_bench_hp_done(uint32_t nbytes) {
+    (void)nbytes;
+    hp_bench_next_transfer();
+}
+
+/* what the LP vector does for a single buffered IN */
+static void hp_bench_sb_load(void) {
+    uint32_t n = bench_total - bench_queued;
+
+    if (n > HP_BENCH_MPS) {
+        n = HP_BENCH_MPS;
+    }
+
+    USBD_EP_WritePacketData(bench_usbx, HP_BENCH_PMA_TX, &bench_src[bench_queued], n);
+    USBD_EP_SetTxCnt(bench_usbx, HP_BENCH_EP, n);
+    USBD_EP_SetTxStatus(bench_usbx, HP_BENCH_EP, USBD_EP_STATUS_VALID);
+    bench_queued += n;
+}
+
+static void hp_bench_sb_isr(void) {
+    if (!(bench_usbx->EP[HP_BENCH_EP].EP & USBD_EP_BIT_CTFT)) {
+        return;
+    }
+
+    USBD_EP_ResetTxFlag(bench_usbx, HP_BENCH_EP);
+    if (bench_queued < bench_total) {
+        hp_bench_sb_load();
+    }
+}
+
+/* run the vectors due by now, in time order */
+static void hp_bench_device(uint64_t now) {
+    while ((hp_due <= now) || (lp_due <= now)) {
+        if (hp_due <= lp_due) {
+            dev_now = hp_due;
+            hp_due = HP_BENCH_NEVER;
+            usbd_fsdev_hp_irq_handler();
+        } else {
+            dev_now = lp_due;
+            lp_due = HP_BENCH_NEVER;
+            if (bench_mode == HP_BENCH_LP_SINGLE) {
+                hp_bench_sb_isr();
+            } else {
+                usbd_fsdev_hp_lp_handler();
+            }
+        }
+    }
+}
+
+/* the endpoint the way the CherryUSB fsdev port opens it */
+static int hp_bench_open(void) {
+    bench_usbx = fsdev_model_init();
+    if (bench_usbx == NULL) {
+        return -1;
+    }
+
+    bench_usbx->CTRL = 0;
+    bench_usbx->BUFFTB = 0;
+    bench_usbx->ADDR = 0x80U;
+
+    USBD_EP_SetAddr(bench_usbx, HP_BENCH_EP, HP_BENCH_EP);
+    USBD_EP_SetType(bench_usbx, HP_BENCH_EP, USBD_REG_EP_TYPE_BULK);
+    USBD_EP_SetTxAddr(bench_usbx, HP_BENCH_EP, HP_BENCH_PMA_TX);
+    USBD_EP_SetTxStatus(bench_usbx, HP_BENCH_EP, USBD_EP_STATUS_NAK);
+
+    return 0;
+}
+
+/*************************** host side ***************************************/
+
+static void hp_bench_stream(struct hp_bench_result *res) {
+    struct fsdev_model_stats st;
+    uint8_t pkt[HP_BENCH_MPS];
+    uint64_t now = 0;
+    uint64_t last = 0;
+    uint32_t naks_in_row = 0;
+    uint32_t got = 0;
+    uint32_t i;
+    int ret;
+
+    memset(res, 0, sizeof(*res));
+    hp_due = HP_BENCH_NEVER;
+    lp_due = HP_BENCH_NEVER;
+    dev_now = 0;
+    bench_queued = 0;
+
+    if (hp_bench_open() != 0) {
+        printf("FAIL model init\n");
+        bench_errors++;
+        return;
+    }
+
+    if (bench_mode == HP_BENCH_LP_SINGLE) {
+        hp_bench_sb_load();
+    } else {
+        usbd_fsdev_hp_in_open(bench_usbx, 0x80U | HP_BENCH_EP, HP_BENCH_MPS, hp_bench_hp_done);
+        hp_bench_next_transfer();
+    }
+
+    while (got < bench_total) {
+        if (bench_random && ((hp_bench_rand() % 64U) == 0U)) {
+            bench_load.busy = hp_bench_rand() % 200000U;
+        }
+
+        hp_bench_device(now);
+        ret = fsdev_model_in(HP_BENCH_EP, pkt, sizeof(pkt));
+
+        if (ret == FSDEV_MODEL_NAK) {
+            res->naks++;
+            now += hp_bench_time.nak;
+            if (++naks_in_row > HP_BENCH_STUCK) {
+                printf("FAIL stream stuck at %u of %u bytes\n", got, bench_total);
+                res->errors++;
+                break;
+            }
+            continue;
+        }
+        if ((ret < 0) || ((uint32_t)ret > (bench_total - got))) {
+            printf("FAIL handshake %d at %u of %u bytes\n", ret, got, bench_total);
+            res->errors++;
+            break;
+        }
+
+        for (i = 0; i < (uint32_t)ret; i++) {
+            if (pkt[i] != bench_src[got + i]) {
+                res->errors++;
+            }
+        }
+        got += (uint32_t)ret;
+        naks_in_row = 0;
+
+        now += hp_bench_time.packet;
+        if ((res->packets != 0U) && ((now - last) > res->gap_max)) {
+            res->gap_max = (uint32_t)(now - last);
+        }
+        last = now;
+        res->packets++;
+
+        if (bench_mode == HP_BENCH_LP_SINGLE) {
+            lp_due = hp_bench_lp_free(now) + hp_bench_time.lp;
+        } else {
+            hp_due = now + hp_bench_time.hp;
+        }
+    }
+
+    /* a ZLP transfer is a packet too, the stream length is in bytes */
+    res->ns = now;
+    res->bytes = got;
+
+    fsdev_model_get_stats(&st);
+    if (st.toggle_err != 0U) {
+        printf("FAIL %u data toggle errors\n", st.toggle_err);
+        res->errors++;
+    }
+
+    if (bench_mode == HP_BENCH_HP_DOUBLE) {
+        usbd_fsdev_hp_in_close();
+    }
+    fsdev_model_deinit();
+}
+
+static void hp_bench_row(enum hp_bench_mode mode, const struct hp_bench_load *load) {
+    static const char *const name[] = { "lp_single", "hp_double" };
+    struct hp_bench_result res;
+
+    bench_mode = mode;
+    bench_load = *load;
+    hp_bench_stream(&res);
+    bench_errors += (res.errors != 0U) ? 1 : 0;
+
+    printf("%-10s %6u us / ms  %7.1f KB/s  %7u NAKs  %5u packets  max gap %6.1f us\n",
+           name[mode], load->busy / 1000U,
+           (res.ns != 0U) ? ((double)res.bytes * 1e6 / (double)res.ns) : 0.0,
+           res.naks, res.packets, res.gap_max / 1000.0);
+}
+
+static void hp_bench_check(uint32_t seed) {
+    struct hp_bench_result res;
+
+    bench_rng = (seed != 0U) ? seed : 1U;
+    bench_random = true;
+    bench_mode = HP_BENCH_HP_DOUBLE;
+    bench_load.busy = 0;
+    bench_load.period = 1000000U;
+
+    hp_bench_stream(&res);
+    bench_random = false;
+
+    if ((res.errors != 0U) || (res.bytes != bench_total)) {
+        printf("FAIL check seed %u: %u errors, %u of %u bytes\n", seed, res.errors, res.bytes, bench_total);
+        bench_errors++;
+    } else {
+        printf("check      random transfers and LP windows, seed %u, %u packets, %u NAKs\n",
+               seed, res.packets, res.naks);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t kib = 64;
+    uint32_t seed = 1;
+    uint32_t i;
+
+    if (argc > 1) {
+        kib = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        seed = (uint32_t)strtoul(argv[2], NULL, 0);
+    }
+    if ((kib == 0U) || (kib > HP_BENCH_MAX_KIB)) {
+        kib = 64;
+    }
+
+    bench_total = kib * 1024U;
+    for (i = 0; i < bench_total; i++) {
+        bench_src[i] = (uint8_t)(i * 7U + (i >> 8));
+    }
+
+    printf("%u KiB per row, LP held off per millisecond\n", kib);
+    for (i = 0; i < (sizeof(hp_bench_loads) / sizeof(hp_bench_loads[0])); i++) {
+        hp_bench_row(HP_BENCH_LP_SINGLE, &hp_bench_loads[i]);
+        hp_bench_row(HP_BENCH_HP_DOUBLE, &hp_bench_loads[i]);
+    }
+    hp_bench_check(seed);
+
+    return (bench_errors == 0) ? 0 : 1;
+}
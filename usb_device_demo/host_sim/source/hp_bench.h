@@ -0,0 +1,45 @@
+/**
+  * @file    hp_bench.h
+  * @author  LuckkMaker
+  * @brief   Host hooks of usbd_fsdev_hp.c for hp_bench.c
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Included ahead of every source of the hp_bench target. There is no NVIC
+  * on the host: the bench runs the vectors one after the other, so the HP
+  * masking is empty, and the LP pend goes to the bench scheduler.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef HP_BENCH_H
+#define HP_BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void hp_bench_pend_lp(void);
+
+#define USBD_FSDEV_HP_MASK()
+#define USBD_FSDEV_HP_UNMASK()
+#define USBD_FSDEV_HP_PEND_LP()     hp_bench_pend_lp()
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* HP_BENCH_H */
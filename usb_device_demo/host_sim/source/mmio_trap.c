@@ -0,0 +1,234 @@
+/**
+  * @file    mmio_trap.c
+  * @author  LuckkMaker
+  * @brief   Trapped register windows for running peripheral drivers on Linux
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Every register access of a peripheral can have a side effect (W1C flags,
+  * FIFO pops, toggle-on-write bits), so a window stays PROT_NONE:
+  *   - SIGSEGV: the page is opened, a read gets the model value stored at
+  *     the address first, a write gets the current value so narrow and
+  *     read-modify-write instructions merge into it, then the trap flag is
+  *     set,
+  *   - SIGTRAP after the single instruction: a write is picked up from the
+  *     page, the page is closed again.
+  * x86-64 only. The handler does not decode instructions, an access is
+  * reported as the aligned 32-bit slot holding the faulting address.
+  *
+  * Windows are either placed anywhere below 4 GB, for drivers that keep the
+  * base in a uint32_t, or at the fixed address the driver was built for.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include "mmio_trap.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error "mmio_trap traps register accesses by single stepping, x86-64 Linux only"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+struct mmio_trap_window {
+    uint8_t *base;
+    uint32_t size;
+    const struct mmio_trap_ops *ops;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define MMIO_TRAP_MAX               4U
+#define MMIO_TRAP_PAGE_SIZE         0x1000U
+
+#define MMIO_TRAP_EFLAGS_TF         0x100U
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE         0x100000
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+#define MMIO_TRAP_PAGE(p)           ((void *)((uintptr_t)(p) & ~(uintptr_t)(MMIO_TRAP_PAGE_SIZE - 1U)))
+
+/* Private variables ---------------------------------------------------------*/
+static struct mmio_trap_window mmio_trap_win[MMIO_TRAP_MAX];
+static uint32_t mmio_trap_count;
+
+static struct mmio_trap_window *mmio_trap_cur;
+static uint32_t mmio_trap_off;
+static bool mmio_trap_write;
+static struct sigaction mmio_trap_old_segv;
+static struct sigaction mmio_trap_old_trap;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static struct mmio_trap_window *mmio_trap_find(const uint8_t *addr) {
+    uint32_t i;
+
+    for (i = 0; i < MMIO_TRAP_MAX; i++) {
+        if ((mmio_trap_win[i].base != NULL) && (addr >= mmio_trap_win[i].base) &&
+            (addr < (mmio_trap_win[i].base + mmio_trap_win[i].size))) {
+            return &mmio_trap_win[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void mmio_trap_segv(int sig, siginfo_t *si, void *ctx) {
+    ucontext_t *uc = (ucontext_t *)ctx;
+    uint8_t *addr = (uint8_t *)si->si_addr;
+    struct mmio_trap_window *win = mmio_trap_find(addr);
+    uint32_t off;
+
+    (void)sig;
+
+    if (win == NULL) {
+        /* not ours, let it crash the usual way */
+        sigaction(SIGSEGV, &mmio_trap_old_segv, NULL);
+        return;
+    }
+
+    off = (uint32_t)(addr - win->base) & ~3U;
+    mprotect(MMIO_TRAP_PAGE(win->base + off), MMIO_TRAP_PAGE_SIZE, PROT_READ | PROT_WRITE);
+
+    mmio_trap_cur = win;
+    mmio_trap_off = off;
+    mmio_trap_write = (uc->uc_mcontext.gregs[REG_ERR] & 0x2) != 0;
+
+    /* a read-modify-write instruction faults as a write and reads first */
+    *(volatile uint32_t *)(win->base + off) = mmio_trap_write ? win->ops->peek(off) : win->ops->read(off);
+
+    uc->uc_mcontext.gregs[REG_EFL] |= MMIO_TRAP_EFLAGS_TF;
+}
+
+static void mmio_trap_step(int sig, siginfo_t *si, void *ctx) {
+    ucontext_t *uc = (ucontext_t *)ctx;
+    struct mmio_trap_window *win = mmio_trap_cur;
+    uint32_t off = mmio_trap_off;
+
+    (void)sig;
+    (void)si;
+
+    if (win == NULL) {
+        sigaction(SIGTRAP, &mmio_trap_old_trap, NULL);
+        return;
+    }
+
+    if (mmio_trap_write) {
+        win->ops->write(off, *(volatile uint32_t *)(win->base + off));
+    }
+
+    mprotect(MMIO_TRAP_PAGE(win->base + off), MMIO_TRAP_PAGE_SIZE, PROT_NONE);
+    mmio_trap_cur = NULL;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~MMIO_TRAP_EFLAGS_TF;
+}
+
+/**
+ * @brief   Map a register window and route its accesses to a model
+ *
+ * @param   addr   fixed address the driver was built for, 0 for anywhere below 4 GB
+ *
+ * @param   size   window size, rounded up to whole pages
+ *
+ * @param   ops    model of the window
+ *
+ * @retval  window base, NULL on failure
+ */
+void *mmio_trap_map(uintptr_t addr, uint32_t size, const struct mmio_trap_ops *ops) {
+    struct mmio_trap_window *win = NULL;
+    struct sigaction sa;
+    uint8_t *base;
+    uint32_t i;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    if ((sysconf(_SC_PAGESIZE) != MMIO_TRAP_PAGE_SIZE) || (addr & (MMIO_TRAP_PAGE_SIZE - 1U))) {
+        return NULL;
+    }
+
+    for (i = 0; i < MMIO_TRAP_MAX; i++) {
+        if (mmio_trap_win[i].base == NULL) {
+            win = &mmio_trap_win[i];
+            break;
+        }
+    }
+    if (win == NULL) {
+        return NULL;
+    }
+
+    size = (size + MMIO_TRAP_PAGE_SIZE - 1U) & ~(MMIO_TRAP_PAGE_SIZE - 1U);
+    flags |= (addr != 0U) ? MAP_FIXED_NOREPLACE : MAP_32BIT;
+
+    base = mmap((void *)addr, size, PROT_NONE, flags, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+    if ((addr != 0U) && (base != (uint8_t *)addr)) {
+        /* kernel without MAP_FIXED_NOREPLACE took it as a hint */
+        munmap(base, size);
+        return NULL;
+    }
+
+    win->base = base;
+    win->size = size;
+    win->ops = ops;
+
+    if (mmio_trap_count++ == 0U) {
+        mmio_trap_cur = NULL;
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_flags = SA_SIGINFO;
+        sigemptyset(&sa.sa_mask);
+        sa.sa_sigaction = mmio_trap_segv;
+        sigaction(SIGSEGV, &sa, &mmio_trap_old_segv);
+        sa.sa_sigaction = mmio_trap_step;
+        sigaction(SIGTRAP, &sa, &mmio_trap_old_trap);
+    }
+
+    return base;
+}
+
+/**
+ * @brief   Unmap a window, the signal handlers go with the last one
+ *
+ * @param   base   value returned by mmio_trap_map()
+ *
+ * @retval  None
+ */
+void mmio_trap_unmap(void *base) {
+    struct mmio_trap_window *win = mmio_trap_find(base);
+
+    if ((win == NULL) || (win->base != base)) {
+        return;
+    }
+
+    munmap(win->base, win->size);
+    memset(win, 0, sizeof(*win));
+
+    if (--mmio_trap_count == 0U) {
+        sigaction(SIGSEGV, &mmio_trap_old_segv, NULL);
+        sigaction(SIGTRAP, &mmio_trap_old_trap, NULL);
+    }
+}
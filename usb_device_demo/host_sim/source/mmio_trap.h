@@ -0,0 +1,48 @@
+/**
+  * @file    mmio_trap.h
+  * @author  LuckkMaker
+  * @brief   Header for mmio_trap.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef MMIO_TRAP_H
+#define MMIO_TRAP_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< register model behind a window, offsets are 32-bit aligned */
+struct mmio_trap_ops {
+    uint32_t (*read)(uint32_t off);                 /*!< read by the driver, side effects allowed */
+    uint32_t (*peek)(uint32_t off);                 /*!< value under a write, narrow and RMW writes merge into it */
+    void (*write)(uint32_t off, uint32_t value);    /*!< write by the driver, the whole 32-bit slot */
+};
+
+void *mmio_trap_map(uintptr_t addr, uint32_t size, const struct mmio_trap_ops *ops);
+void mmio_trap_unmap(void *base);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MMIO_TRAP_H */
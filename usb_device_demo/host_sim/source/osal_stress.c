@@ -0,0 +1,364 @@
+/**
+  * @file    osal_stress.c
+  * @author  LuckkMaker
+  * @brief   Concurrency stress test of the OSAL on the pthread backend
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Runs the patterns the stack relies on once MSC and the host PSC work
+  * are threaded, with an "isr" thread that only gives and posts as the
+  * USB interrupt does:
+  *   sem      isr gives, two workers take; no give may be lost or doubled
+  *   mq       isr posts a sequence, a full queue is retried as the hub
+  *            interrupt would drop and resubmit; order and count checked
+  *   mutex    workers bump a shared counter under the mutex, and inside
+  *            the critical section; the totals must be exact
+  *   timeout  sem_take and mq_recv on empty objects time out, not early
+  *   timer    periodic and one shot timers fire the expected times
+  *   churn    threads created and deleting themselves past the pool size
+  *
+  *   osal_stress [iterations]
+  *
+  * One line per test, exits non-zero on a failure.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include "usb_osal.h"
+#include "usb_errno.h"
+#include "usb_osal_port.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct osal_stress_ctx {
+    usb_osal_sem_t sem;
+    usb_osal_sem_t done;
+    usb_osal_mq_t mq;
+    usb_osal_mutex_t mutex;
+    uint32_t iterations;
+    volatile uint32_t taken;
+    volatile uint32_t retries;
+    volatile uint32_t errors;
+    volatile bool isr_done;
+    uint32_t counter;           /*!< plain, the locks keep it exact */
+    uint32_t inside;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define OSAL_STRESS_STACKSIZE       CONFIG_USBDEV_MSC_STACKSIZE
+#define OSAL_STRESS_PRIO            CONFIG_USBDEV_MSC_PRIO
+#define OSAL_STRESS_WORKERS         2U
+#define OSAL_STRESS_MQ_DEPTH        8U
+#define OSAL_STRESS_TIMEOUT_MS      20U
+#define OSAL_STRESS_TIMER_MS        5U
+#define OSAL_STRESS_TIMER_SPAN_MS   200U
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct osal_stress_ctx ctx;
+static volatile uint32_t timer_periodic;
+static volatile uint32_t timer_oneshot;
+static volatile uint32_t churn_runs;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static uint64_t osal_stress_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+static int osal_stress_result(const char *name, bool ok, const char *fmt, uint32_t a, uint32_t b) {
+    printf("%-8s %s ", name, ok ? "ok  " : "FAIL");
+    printf(fmt, a, b);
+    printf("\n");
+
+    return ok ? 0 : 1;
+}
+
+static void osal_stress_atomic_inc(volatile uint32_t *v) {
+    size_t flag = usb_osal_enter_critical_section();
+
+    (*v)++;
+    usb_osal_leave_critical_section(flag);
+}
+
+/* Interrupt stand in, never blocks */
+static void isr_give_thread(void *arg) {
+    uint32_t i;
+
+    (void)arg;
+
+    for (i = 0; i < ctx.iterations; i++) {
+        if (usb_osal_sem_give(ctx.sem) != 0) {
+            osal_stress_atomic_inc(&ctx.errors);
+        }
+        if ((i & 7U) == 0U) {
+            sched_yield();
+        }
+    }
+    ctx.isr_done = true;
+    usb_osal_sem_give(ctx.done);
+    usb_osal_thread_delete(NULL);
+}
+
+static void sem_worker_thread(void *arg) {
+    (void)arg;
+
+    /* Stops once the isr ended and its gives were all taken */
+    while (1) {
+        if (usb_osal_sem_take(ctx.sem, 10U) == 0) {
+            osal_stress_atomic_inc(&ctx.taken);
+        } else if (ctx.isr_done) {
+            break;
+        }
+    }
+    usb_osal_sem_give(ctx.done);
+}
+
+static int osal_stress_sem(uint32_t iterations) {
+    uint32_t i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.iterations = iterations;
+    ctx.sem = usb_osal_sem_create(0);
+    ctx.done = usb_osal_sem_create(0);
+
+    for (i = 0; i < OSAL_STRESS_WORKERS; i++) {
+        usb_osal_thread_create("sem_w", OSAL_STRESS_STACKSIZE, OSAL_STRESS_PRIO, sem_worker_thread, NULL);
+    }
+    usb_osal_thread_create("isr", OSAL_STRESS_STACKSIZE, 0, isr_give_thread, NULL);
+
+    for (i = 0; i < (OSAL_STRESS_WORKERS + 1U); i++) {
+        usb_osal_sem_take(ctx.done, USB_OSAL_WAITING_FOREVER);
+    }
+    usb_osal_sem_delete(ctx.sem);
+    usb_osal_sem_delete(ctx.done);
+
+    return osal_stress_result("sem", (ctx.taken == iterations) && (ctx.errors == 0U),
+                              "taken %u of %u", ctx.taken, iterations);
+}
+
+static void isr_post_thread(void *arg) {
+    uint32_t i;
+
+    (void)arg;
+
+    for (i = 0; i < ctx.iterations; i++) {
+        while (usb_osal_mq_send(ctx.mq, (uintptr_t)i) != 0) {
+            ctx.retries++;
+            sched_yield();
+        }
+    }
+}
+
+static void mq_worker_thread(void *arg) {
+    uintptr_t msg;
+    uint32_t expect = 0;
+
+    (void)arg;
+
+    while (expect < ctx.iterations) {
+        if (usb_osal_mq_recv(ctx.mq, &msg, 1000U) != 0) {
+            ctx.errors++;
+            break;
+        }
+        if (msg != expect) {
+            ctx.errors++;
+        }
+        expect = (uint32_t)msg + 1U;
+    }
+    ctx.taken = expect;
+    usb_osal_sem_give(ctx.done);
+}
+
+static int osal_stress_mq(uint32_t iterations) {
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.iterations = iterations;
+    ctx.mq = usb_osal_mq_create(OSAL_STRESS_MQ_DEPTH);
+    ctx.done = usb_osal_sem_create(0);
+
+    usb_osal_thread_create("mq_w", OSAL_STRESS_STACKSIZE, OSAL_STRESS_PRIO, mq_worker_thread, NULL);
+    usb_osal_thread_create("isr", OSAL_STRESS_STACKSIZE, 0, isr_post_thread, NULL);
+
+    usb_osal_sem_take(ctx.done, USB_OSAL_WAITING_FOREVER);
+    usb_osal_mq_delete(ctx.mq);
+    usb_osal_sem_delete(ctx.done);
+
+    return osal_stress_result("mq", (ctx.taken == iterations) && (ctx.errors == 0U),
+                              "received %u in order, %u full retries", ctx.taken, ctx.retries);
+}
+
+static void mutex_worker_thread(void *arg) {
+    uint32_t i;
+    size_t flag;
+
+    (void)arg;
+
+    for (i = 0; i < ctx.iterations; i++) {
+        usb_osal_mutex_take(ctx.mutex);
+        if (ctx.inside++ != 0U) {
+            ctx.errors++;
+        }
+        ctx.counter++;
+        ctx.inside--;
+        usb_osal_mutex_give(ctx.mutex);
+
+        flag = usb_osal_enter_critical_section();
+        ctx.taken++;
+        usb_osal_leave_critical_section(flag);
+    }
+    usb_osal_sem_give(ctx.done);
+}
+
+static int osal_stress_mutex(uint32_t iterations) {
+    uint32_t i;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.iterations = iterations;
+    ctx.mutex = usb_osal_mutex_create();
+    ctx.done = usb_osal_sem_create(0);
+
+    for (i = 0; i < (USB_OSAL_THREAD_MAX - 1U); i++) {
+        usb_osal_thread_create("mutex_w", OSAL_STRESS_STACKSIZE, OSAL_STRESS_PRIO, mutex_worker_thread, NULL);
+    }
+    for (i = 0; i < (USB_OSAL_THREAD_MAX - 1U); i++) {
+        usb_osal_sem_take(ctx.done, USB_OSAL_WAITING_FOREVER);
+    }
+    usb_osal_mutex_delete(ctx.mutex);
+    usb_osal_sem_delete(ctx.done);
+
+    i = iterations * (USB_OSAL_THREAD_MAX - 1U);
+
+    return osal_stress_result("mutex", (ctx.counter == i) && (ctx.taken == i) && (ctx.errors == 0U),
+                              "counted %u of %u", ctx.counter, i);
+}
+
+static int osal_stress_timeout(void) {
+    usb_osal_sem_t sem = usb_osal_sem_create(0);
+    usb_osal_mq_t mq = usb_osal_mq_create(1);
+    uintptr_t msg;
+    uint64_t t0;
+    uint32_t sem_ms;
+    uint32_t mq_ms;
+    bool ok = true;
+
+    t0 = osal_stress_now_ms();
+    ok &= (usb_osal_sem_take(sem, OSAL_STRESS_TIMEOUT_MS) == -USB_ERR_TIMEOUT);
+    sem_ms = (uint32_t)(osal_stress_now_ms() - t0);
+
+    t0 = osal_stress_now_ms();
+    ok &= (usb_osal_mq_recv(mq, &msg, OSAL_STRESS_TIMEOUT_MS) == -USB_ERR_TIMEOUT);
+    mq_ms = (uint32_t)(osal_stress_now_ms() - t0);
+
+    /* Never early, late by scheduling only */
+    ok &= (sem_ms >= OSAL_STRESS_TIMEOUT_MS) && (sem_ms < (OSAL_STRESS_TIMEOUT_MS * 10U));
+    ok &= (mq_ms >= OSAL_STRESS_TIMEOUT_MS) && (mq_ms < (OSAL_STRESS_TIMEOUT_MS * 10U));
+
+    /* A full queue and a give past the count fail without blocking */
+    ok &= (usb_osal_mq_send(mq, 1) == 0) && (usb_osal_mq_send(mq, 2) == -USB_ERR_TIMEOUT);
+
+    usb_osal_sem_delete(sem);
+    usb_osal_mq_delete(mq);
+
+    return osal_stress_result("timeout", ok, "sem %u ms, mq %u ms", sem_ms, mq_ms);
+}
+
+static void timer_periodic_cb(void *arg) {
+    (void)arg;
+    timer_periodic++;
+}
+
+static void timer_oneshot_cb(void *arg) {
+    (void)arg;
+    timer_oneshot++;
+}
+
+static int osal_stress_timer(void) {
+    struct usb_osal_timer *periodic;
+    struct usb_osal_timer *oneshot;
+    uint32_t expect = OSAL_STRESS_TIMER_SPAN_MS / OSAL_STRESS_TIMER_MS;
+    bool ok;
+
+    periodic = usb_osal_timer_create("periodic", OSAL_STRESS_TIMER_MS, timer_periodic_cb, NULL, true);
+    oneshot = usb_osal_timer_create("oneshot", OSAL_STRESS_TIMER_MS, timer_oneshot_cb, NULL, false);
+    if ((periodic == NULL) || (oneshot == NULL)) {
+        return osal_stress_result("timer", false, "create failed %u %u", periodic != NULL, oneshot != NULL);
+    }
+
+    usb_osal_timer_start(periodic);
+    usb_osal_timer_start(oneshot);
+    usb_osal_msleep(OSAL_STRESS_TIMER_SPAN_MS);
+    usb_osal_timer_stop(periodic);
+    usb_osal_timer_delete(periodic);
+    usb_osal_timer_delete(oneshot);
+
+    /* The periodic one reloads from its due time, so it does not drift */
+    ok = (timer_oneshot == 1U) && (timer_periodic >= (expect - 2U)) && (timer_periodic <= (expect + 1U));
+
+    return osal_stress_result("timer", ok, "periodic %u of %u", timer_periodic, expect);
+}
+
+static void churn_thread(void *arg) {
+    (void)arg;
+
+    osal_stress_atomic_inc(&churn_runs);
+    /* Returning deletes the thread, as usb_osal_thread_delete(NULL) */
+}
+
+static int osal_stress_churn(uint32_t iterations) {
+    uint32_t created = 0;
+    uint32_t i;
+
+    for (i = 0; i < iterations; i++) {
+        while (usb_osal_thread_create("churn", OSAL_STRESS_STACKSIZE, OSAL_STRESS_PRIO, churn_thread, NULL) == NULL) {
+            /* Pool full until a thread ended */
+            sched_yield();
+        }
+        created++;
+    }
+    while (churn_runs < created) {
+        usb_osal_msleep(1U);
+    }
+
+    return osal_stress_result("churn", churn_runs == iterations, "ran %u of %u", churn_runs, iterations);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = 100000U;
+    int ret = 0;
+
+    if (argc > 1) {
+        iterations = (uint32_t)strtoul(argv[1], NULL, 0);
+    }
+
+    ret |= osal_stress_sem(iterations);
+    ret |= osal_stress_mq(iterations);
+    ret |= osal_stress_mutex(iterations);
+    ret |= osal_stress_timeout();
+    ret |= osal_stress_timer();
+    ret |= osal_stress_churn(iterations / 100U + USB_OSAL_THREAD_MAX * 4U);
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+/**
+  * @file    sim_bench.c
+  * @author  LuckkMaker
+  * @brief   Throughput benchmark of the CDC ACM + HID demo on the simulated DCD
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Enumerates cdc_acm_hid.c as the board firmware does, then keeps each data
+  * path busy for a fixed time:
+  *   cdc_out   host writes on the CDC bulk OUT, data checked in usbd_cdc_get_out_data
+  *   cdc_in    CDC bulk IN writes of SIM_BENCH_CDC_IN_LEN, ZLP included
+  *   hid_echo  bursts of HID output reports until the OUT endpoint NAKs, then
+  *             the echoes are drained and checked
+  *
+  *   sim_bench [seconds per test] [buses]
+  *
+  * With buses > 1 (up to CONFIG_USBDEV_MAX_BUS) every bus runs its own
+  * instance of the demo, as OTG_FS and OTG_HS do on the F407, and each test
+  * serves the buses in turn, so the line is the combined throughput.
+  *
+  * One line per test, callbacks/s counts completed transfers on all the
+  * endpoints of the test. Exits non-zero on a data or enumeration error.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <time.h>
+#include "cdc_acm_hid.h"
+#include "usb_dc_sim.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_bench_result {
+    const char *name;
+    double seconds;
+    uint64_t callbacks;
+    uint64_t bytes;
+    uint64_t naks;
+};
+
+/* Private define ------------------------------------------------------------*/
+/*!< must match cdc_acm_hid.c */
+#define SIM_BENCH_CDC_IN_EP         0x81
+#define SIM_BENCH_CDC_OUT_EP        0x01
+#define SIM_BENCH_HID_IN_EP         0x82
+#define SIM_BENCH_HID_OUT_EP        0x02
+
+#define SIM_BENCH_CDC_IN_LEN        2048
+#define SIM_BENCH_HID_REPORT_SIZE   64
+
+/*!< iterations between two clock reads */
+#define SIM_BENCH_CHUNK             1024
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t bench_buf[SIM_BENCH_CDC_IN_LEN];
+static uint8_t bench_buses = 1;
+static uint64_t cdc_out_bytes;
+static uint8_t cdc_out_expect[CONFIG_USBDEV_MAX_BUS];
+static uint32_t cdc_out_errors;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External variables --------------------------------------------------------*/
+
+/* External functions --------------------------------------------------------*/
+
+/* overrides the weak hook in cdc_acm_hid.c */
+void usbd_cdc_get_out_data(uint8_t busid, uint8_t *data, uint32_t len) {
+    uint32_t i;
+
+    for (i = 0; i < len; i++) {
+        if (data[i] != cdc_out_expect[busid]) {
+            cdc_out_errors++;
+        }
+        cdc_out_expect[busid]++;
+    }
+    cdc_out_bytes += len;
+}
+
+static double sim_bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void sim_bench_collect(struct sim_bench_result *res, const uint8_t *eps, uint32_t count) {
+    struct usb_sim_ep_stats stats;
+    uint32_t i;
+    uint8_t bus;
+
+    for (bus = 0; bus < bench_buses; bus++) {
+        for (i = 0; i < count; i++) {
+            usb_sim_get_stats(bus, eps[i], &stats);
+            res->callbacks += stats.transfers;
+            res->naks += stats.naks;
+        }
+    }
+}
+
+static void sim_bench_clear(void) {
+    uint8_t bus;
+
+    for (bus = 0; bus < bench_buses; bus++) {
+        usb_sim_clear_stats(bus);
+    }
+}
+
+static void sim_bench_print(const struct sim_bench_result *res) {
+    printf("%-9s %10.0f callbacks/s %8.2f MB/s  (%llu callbacks, %llu bytes, %llu naks)\n",
+           res->name,
+           (double)res->callbacks / res->seconds,
+           (double)res->bytes / res->seconds / 1e6,
+           (unsigned long long)res->callbacks,
+           (unsigned long long)res->bytes,
+           (unsigned long long)res->naks);
+}
+
+static int sim_bench_enumerate(uint8_t busid) {
+    struct usb_setup_packet setup;
+    uint8_t desc[256];
+    uint16_t total;
+    int ret;
+
+    usb_sim_bus_reset(busid);
+
+    /* GET_DESCRIPTOR device */
+    setup.bmRequestType = 0x80;
+    setup.bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup.wValue = USB_DESCRIPTOR_TYPE_DEVICE << 8;
+    setup.wIndex = 0;
+    setup.wLength = 18;
+    ret = usb_sim_control(busid, &setup, desc);
+    if ((ret != 18) || (desc[1] != USB_DESCRIPTOR_TYPE_DEVICE)) {
+        printf("bus %u: device descriptor failed (%d)\n", busid, ret);
+        return -1;
+    }
+
+    /* SET_ADDRESS */
+    setup.bmRequestType = 0x00;
+    setup.bRequest = USB_REQUEST_SET_ADDRESS;
+    setup.wValue = 5;
+    setup.wLength = 0;
+    ret = usb_sim_control(busid, &setup, NULL);
+    if ((ret != 0) || (usb_sim_get_address(busid) != 5)) {
+        printf("bus %u: set address failed (%d)\n", busid, ret);
+        return -1;
+    }
+
+    /* GET_DESCRIPTOR configuration, header then all of it */
+    setup.bmRequestType = 0x80;
+    setup.bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup.wValue = USB_DESCRIPTOR_TYPE_CONFIGURATION << 8;
+    setup.wLength = 9;
+    ret = usb_sim_control(busid, &setup, desc);
+    total = (uint16_t)(desc[2] | (desc[3] << 8));
+    if ((ret != 9) || (total > sizeof(desc))) {
+        printf("bus %u: configuration descriptor failed (%d)\n", busid, ret);
+        return -1;
+    }
+    setup.wLength = total;
+    ret = usb_sim_control(busid, &setup, desc);
+    if (ret != total) {
+        printf("bus %u: configuration descriptor failed (%d)\n", busid, ret);
+        return -1;
+    }
+
+    /* SET_CONFIGURATION 1 */
+    setup.bmRequestType = 0x00;
+    setup.bRequest = USB_REQUEST_SET_CONFIGURATION;
+    setup.wValue = 1;
+    setup.wLength = 0;
+    ret = usb_sim_control(busid, &setup, NULL);
+    if ((ret != 0) || !usb_device_is_configured(busid)) {
+        printf("bus %u: set configuration failed (%d)\n", busid, ret);
+        return -1;
+    }
+
+    /* CDC SET_CONTROL_LINE_STATE, DTR on */
+    setup.bmRequestType = 0x21;
+    setup.bRequest = CDC_REQUEST_SET_CONTROL_LINE_STATE;
+    setup.wValue = 0x0001;
+    setup.wIndex = 0;
+    ret = usb_sim_control(busid, &setup, NULL);
+    if (ret != 0) {
+        printf("bus %u: set control line state failed (%d)\n", busid, ret);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sim_bench_cdc_out(double seconds) {
+    static const uint8_t eps[] = { SIM_BENCH_CDC_OUT_EP };
+    struct sim_bench_result res = { .name = "cdc_out" };
+    uint8_t pkt[64];
+    uint8_t seq[CONFIG_USBDEV_MAX_BUS] = { 0 };
+    uint8_t bus;
+    double t0;
+    uint32_t i;
+    uint32_t j;
+
+    cdc_out_bytes = 0;
+    memset(cdc_out_expect, 0, sizeof(cdc_out_expect));
+    cdc_out_errors = 0;
+    sim_bench_clear();
+
+    t0 = sim_bench_now();
+    do {
+        for (i = 0; i < SIM_BENCH_CHUNK; i++) {
+            for (bus = 0; bus < bench_buses; bus++) {
+                for (j = 0; j < sizeof(pkt); j++) {
+                    pkt[j] = seq[bus]++;
+                }
+                if (usb_sim_out(bus, SIM_BENCH_CDC_OUT_EP, pkt, sizeof(pkt)) != sizeof(pkt)) {
+                    printf("cdc_out: packet refused on bus %u\n", bus);
+                    return -1;
+                }
+            }
+        }
+        res.seconds = sim_bench_now() - t0;
+    } while (res.seconds < seconds);
+
+    res.bytes = cdc_out_bytes;
+    sim_bench_collect(&res, eps, sizeof(eps));
+    sim_bench_print(&res);
+
+    if (cdc_out_errors) {
+        printf("cdc_out: %u corrupted bytes\n", cdc_out_errors);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int sim_bench_cdc_in(double seconds) {
+    static const uint8_t eps[] = { SIM_BENCH_CDC_IN_EP };
+    struct sim_bench_result res = { .name = "cdc_in" };
+    uint8_t pkt[64];
+    uint8_t bus;
+    double t0;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < sizeof(bench_buf); i++) {
+        bench_buf[i] = (uint8_t)i;
+    }
+
+    sim_bench_clear();
+
+    t0 = sim_bench_now();
+    do {
+        for (i = 0; i < SIM_BENCH_CHUNK; i++) {
+            for (bus = 0; bus < bench_buses; bus++) {
+                /* refused while the last one is in flight */
+                cdc_acm_data_write(bus, bench_buf, sizeof(bench_buf));
+
+                ret = usb_sim_in(bus, SIM_BENCH_CDC_IN_EP, pkt, sizeof(pkt));
+                if (ret < 0) {
+                    printf("cdc_in: IN token failed on bus %u (%d)\n", bus, ret);
+                    return -1;
+                }
+                res.bytes += (uint32_t)ret;
+            }
+        }
+        res.seconds = sim_bench_now() - t0;
+    } while (res.seconds < seconds);
+
+    sim_bench_collect(&res, eps, sizeof(eps));
+    sim_bench_print(&res);
+
+    return 0;
+}
+
+static int sim_bench_hid_echo(double seconds) {
+    static const uint8_t eps[] = { SIM_BENCH_HID_OUT_EP, SIM_BENCH_HID_IN_EP };
+    struct sim_bench_result res = { .name = "hid_echo" };
+    uint8_t report[SIM_BENCH_HID_REPORT_SIZE];
+    uint32_t tx_seq[CONFIG_USBDEV_MAX_BUS] = { 0 };
+    uint32_t rx_seq[CONFIG_USBDEV_MAX_BUS] = { 0 };
+    uint32_t seq;
+    uint8_t bus;
+    double t0;
+    int ret;
+
+    sim_bench_clear();
+
+    t0 = sim_bench_now();
+    do {
+        for (bus = 0; bus < bench_buses; bus++) {
+            /* fill the device queue, the OUT endpoint NAKs once it is full */
+            do {
+                memset(report, (int)(tx_seq[bus] & 0xff), sizeof(report));
+                report[0] = 0x01;
+                memcpy(&report[1], &tx_seq[bus], sizeof(tx_seq[bus]));
+                ret = usb_sim_out(bus, SIM_BENCH_HID_OUT_EP, report, sizeof(report));
+                if (ret == sizeof(report)) {
+                    tx_seq[bus]++;
+                }
+            } while (ret == sizeof(report));
+
+            if (ret != USB_SIM_NAK) {
+                printf("hid_echo: OUT token failed on bus %u (%d)\n", bus, ret);
+                return -1;
+            }
+        }
+
+        /* drain the echoes in order, each bus has a queue of its own */
+        for (bus = 0; bus < bench_buses; bus++) {
+            while ((ret = usb_sim_in(bus, SIM_BENCH_HID_IN_EP, report, sizeof(report))) >= 0) {
+                memcpy(&seq, &report[1], sizeof(seq));
+                if ((ret != sizeof(report)) || (report[0] != 0x02) || (seq != rx_seq[bus]) ||
+                    (report[sizeof(report) - 1] != (uint8_t)seq)) {
+                    printf("hid_echo: bad echo %u on bus %u, expected %u\n", seq, bus, rx_seq[bus]);
+                    return -1;
+                }
+                rx_seq[bus]++;
+                res.bytes += (uint32_t)ret;
+            }
+
+            if (rx_seq[bus] != tx_seq[bus]) {
+                printf("hid_echo: %u reports sent on bus %u, %u echoed\n", tx_seq[bus], bus, rx_seq[bus]);
+                return -1;
+            }
+        }
+
+        res.seconds = sim_bench_now() - t0;
+    } while (res.seconds < seconds);
+
+    sim_bench_collect(&res, eps, sizeof(eps));
+    sim_bench_print(&res);
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    double seconds = 1.0;
+    uint8_t bus;
+    int ret = 0;
+
+    if (argc > 1) {
+        seconds = atof(argv[1]);
+    }
+
+    if (argc > 2) {
+        bench_buses = (uint8_t)atoi(argv[2]);
+        if ((bench_buses == 0) || (bench_buses > CONFIG_USBDEV_MAX_BUS)) {
+            printf("buses must be 1..%u\n", (unsigned)CONFIG_USBDEV_MAX_BUS);
+            return 1;
+        }
+    }
+
+    for (bus = 0; bus < bench_buses; bus++) {
+        cdc_acm_hid_init(bus, 0);
+
+        if (sim_bench_enumerate(bus) != 0) {
+            return 1;
+        }
+    }
+
+    printf("%u bus(es)\n", bench_buses);
+
+    ret |= sim_bench_cdc_out(seconds);
+    ret |= sim_bench_cdc_in(seconds);
+    ret |= sim_bench_hid_echo(seconds);
+
+    return (ret == 0) ? 0 : 1;
+}
@@ -0,0 +1,414 @@
+/**
+  * @file    usb_dc_sim.c
+  * @author  LuckkMaker
+  * @brief   Simulated device controller for host builds
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Implements the usb_dc.h port API in place of dwc2 or fsdev. The host side
+  * is driven by the usb_sim_* calls, one call per token:
+  *   - an IN token moves one packet of up to MPS bytes from the armed write,
+  *     an OUT token one packet into the armed read, NAK if nothing is armed,
+  *   - a transfer completes on a short packet or once its length is reached,
+  *     a write whose length is a multiple of MPS ends without a ZLP, the class
+  *     code has to queue one itself as it does on hardware,
+  *   - EP0 completes every packet, like the fsdev port, so the core's data
+  *     stage bookkeeping runs as on the board.
+  * Completion callbacks run from within the usb_sim_* call, which plays the
+  * role of the USB interrupt.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_dc_sim.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include "usb_dc.h"
+
+/* Private typedef -----------------------------------------------------------*/
+struct usb_sim_ep {
+    uint16_t mps;
+    uint8_t type;
+    bool open;
+    bool stalled;
+    bool armed;
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t actual;
+};
+
+struct usb_sim_udc {
+    uint8_t addr;
+    struct usb_setup_packet setup;
+    struct usb_sim_ep in_ep[CONFIG_USBDEV_EP_NUM];
+    struct usb_sim_ep out_ep[CONFIG_USBDEV_EP_NUM];
+    struct usb_sim_ep_stats in_stats[CONFIG_USBDEV_EP_NUM];
+    struct usb_sim_ep_stats out_stats[CONFIG_USBDEV_EP_NUM];
+};
+
+/* Private define ------------------------------------------------------------*/
+/*!< NAKs tolerated per control stage before the transfer is given up */
+#define USB_SIM_CTRL_RETRY          16
+
+/* Private macro -------------------------------------------------------------*/
+#define USB_SIM_EP(busid, ep)       (USB_EP_DIR_IS_IN(ep) ? &g_sim_udc[busid].in_ep[USB_EP_GET_IDX(ep)] : \
+                                                            &g_sim_udc[busid].out_ep[USB_EP_GET_IDX(ep)])
+#define USB_SIM_STATS(busid, ep)    (USB_EP_DIR_IS_IN(ep) ? &g_sim_udc[busid].in_stats[USB_EP_GET_IDX(ep)] : \
+                                                            &g_sim_udc[busid].out_stats[USB_EP_GET_IDX(ep)])
+
+/* Private variables ---------------------------------------------------------*/
+static struct usb_sim_udc g_sim_udc[CONFIG_USBDEV_MAX_BUS];
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+/*************************** port API ****************************************/
+
+int usb_dc_init(uint8_t busid) {
+    memset(&g_sim_udc[busid], 0, sizeof(struct usb_sim_udc));
+    return 0;
+}
+
+int usb_dc_deinit(uint8_t busid) {
+    memset(g_sim_udc[busid].in_ep, 0, sizeof(g_sim_udc[busid].in_ep));
+    memset(g_sim_udc[busid].out_ep, 0, sizeof(g_sim_udc[busid].out_ep));
+    return 0;
+}
+
+int usbd_set_address(uint8_t busid, const uint8_t addr) {
+    g_sim_udc[busid].addr = addr;
+    return 0;
+}
+
+int usbd_set_remote_wakeup(uint8_t busid) {
+    ARG_UNUSED(busid);
+    return 0;
+}
+
+uint8_t usbd_get_port_speed(uint8_t busid) {
+    ARG_UNUSED(busid);
+#ifdef CONFIG_USB_HS
+    return USB_SPEED_HIGH;
+#else
+    return USB_SPEED_FULL;
+#endif
+}
+
+int usbd_ep_open(uint8_t busid, const struct usb_endpoint_descriptor *ep) {
+    struct usb_sim_ep *sep;
+
+    if (USB_EP_GET_IDX(ep->bEndpointAddress) >= CONFIG_USBDEV_EP_NUM) {
+        USB_LOG_ERR("Ep addr %02x overflow\r\n", ep->bEndpointAddress);
+        return -1;
+    }
+
+    sep = USB_SIM_EP(busid, ep->bEndpointAddress);
+    memset(sep, 0, sizeof(struct usb_sim_ep));
+    sep->mps = USB_GET_MAXPACKETSIZE(ep->wMaxPacketSize);
+    sep->type = USB_GET_ENDPOINT_TYPE(ep->bmAttributes);
+    sep->open = true;
+
+    return 0;
+}
+
+int usbd_ep_close(uint8_t busid, const uint8_t ep) {
+    if (USB_EP_GET_IDX(ep) >= CONFIG_USBDEV_EP_NUM) {
+        return -1;
+    }
+
+    memset(USB_SIM_EP(busid, ep), 0, sizeof(struct usb_sim_ep));
+    return 0;
+}
+
+int usbd_ep_set_stall(uint8_t busid, const uint8_t ep) {
+    USB_SIM_EP(busid, ep)->stalled = true;
+    return 0;
+}
+
+int usbd_ep_clear_stall(uint8_t busid, const uint8_t ep) {
+    USB_SIM_EP(busid, ep)->stalled = false;
+    return 0;
+}
+
+int usbd_ep_is_stalled(uint8_t busid, const uint8_t ep, uint8_t *stalled) {
+    *stalled = USB_SIM_EP(busid, ep)->stalled;
+    return 0;
+}
+
+int usbd_ep_start_write(uint8_t busid, const uint8_t ep, const uint8_t *data, uint32_t data_len) {
+    struct usb_sim_ep *sep = &g_sim_udc[busid].in_ep[USB_EP_GET_IDX(ep)];
+
+    if (!sep->open) {
+        return -1;
+    }
+
+    /* the packets are taken from the caller's buffer at token time, as the
+     * DMA capable ports do */
+    sep->buf = (uint8_t *)data;
+    sep->len = data_len;
+    sep->actual = 0;
+    sep->armed = true;
+
+    return 0;
+}
+
+int usbd_ep_start_read(uint8_t busid, const uint8_t ep, uint8_t *data, uint32_t data_len) {
+    struct usb_sim_ep *sep = &g_sim_udc[busid].out_ep[USB_EP_GET_IDX(ep)];
+
+    if (!sep->open) {
+        return -1;
+    }
+
+    sep->buf = data;
+    sep->len = data_len;
+    sep->actual = 0;
+    sep->armed = true;
+
+    return 0;
+}
+
+/*************************** host side ***************************************/
+
+/**
+ * @brief   Attach and reset the bus, EP0 is opened by the core
+ *
+ * @param   busid USB bus
+ *
+ * @retval  None
+ */
+void usb_sim_bus_reset(uint8_t busid) {
+    usb_dc_deinit(busid);
+    g_sim_udc[busid].addr = 0;
+    usbd_event_connect_handler(busid);
+    usbd_event_reset_handler(busid);
+}
+
+uint8_t usb_sim_get_address(uint8_t busid) {
+    return g_sim_udc[busid].addr;
+}
+
+/**
+ * @brief   SETUP token, always acknowledged
+ *
+ * @param   busid USB bus
+ *
+ * @param   setup setup packet
+ *
+ * @retval  0, or USB_SIM_NOT_OPEN before the bus reset
+ */
+int usb_sim_setup(uint8_t busid, const struct usb_setup_packet *setup) {
+    struct usb_sim_udc *udc = &g_sim_udc[busid];
+
+    if (!udc->out_ep[0].open) {
+        return USB_SIM_NOT_OPEN;
+    }
+
+    /* a SETUP cancels whatever EP0 had pending and clears its halt */
+    udc->in_ep[0].armed = false;
+    udc->in_ep[0].stalled = false;
+    udc->out_ep[0].armed = false;
+    udc->out_ep[0].stalled = false;
+
+    memcpy(&udc->setup, setup, sizeof(struct usb_setup_packet));
+    usbd_event_ep0_setup_complete_handler(busid, (uint8_t *)&udc->setup);
+
+    return 0;
+}
+
+/**
+ * @brief   IN token
+ *
+ * @param   busid USB bus
+ *
+ * @param   ep    IN endpoint address
+ *
+ * @param   buf   receives the packet
+ *
+ * @param   size  room in buf
+ *
+ * @retval  packet length, or USB_SIM_NAK, USB_SIM_STALL, USB_SIM_BABBLE, USB_SIM_NOT_OPEN
+ */
+int usb_sim_in(uint8_t busid, uint8_t ep, uint8_t *buf, uint32_t size) {
+    struct usb_sim_ep *sep = &g_sim_udc[busid].in_ep[USB_EP_GET_IDX(ep)];
+    struct usb_sim_ep_stats *stats = &g_sim_udc[busid].in_stats[USB_EP_GET_IDX(ep)];
+    uint32_t n;
+
+    if (!sep->open) {
+        return USB_SIM_NOT_OPEN;
+    }
+    if (sep->stalled) {
+        return USB_SIM_STALL;
+    }
+    if (!sep->armed) {
+        stats->naks++;
+        return USB_SIM_NAK;
+    }
+
+    n = sep->len - sep->actual;
+    if (n > sep->mps) {
+        n = sep->mps;
+    }
+    if (n > size) {
+        return USB_SIM_BABBLE;
+    }
+
+    if (n) {
+        memcpy(buf, &sep->buf[sep->actual], n);
+    }
+    sep->actual += n;
+    stats->packets++;
+    stats->bytes += n;
+
+    if ((n < sep->mps) || (sep->actual == sep->len) || (USB_EP_GET_IDX(ep) == 0)) {
+        sep->armed = false;
+        stats->transfers++;
+        usbd_event_ep_in_complete_handler(busid, ep | 0x80, sep->actual);
+    }
+
+    return (int)n;
+}
+
+/**
+ * @brief   OUT token with its data packet
+ *
+ * @param   busid USB bus
+ *
+ * @param   ep    OUT endpoint address
+ *
+ * @param   buf   packet
+ *
+ * @param   len   packet length, 0 for a ZLP
+ *
+ * @retval  len once accepted, or USB_SIM_NAK, USB_SIM_STALL, USB_SIM_BABBLE, USB_SIM_NOT_OPEN
+ */
+int usb_sim_out(uint8_t busid, uint8_t ep, const uint8_t *buf, uint32_t len) {
+    struct usb_sim_ep *sep = &g_sim_udc[busid].out_ep[USB_EP_GET_IDX(ep)];
+    struct usb_sim_ep_stats *stats = &g_sim_udc[busid].out_stats[USB_EP_GET_IDX(ep)];
+
+    if (!sep->open) {
+        return USB_SIM_NOT_OPEN;
+    }
+    if (sep->stalled) {
+        return USB_SIM_STALL;
+    }
+    if (!sep->armed) {
+        stats->naks++;
+        return USB_SIM_NAK;
+    }
+    if ((len > sep->mps) || (len > (sep->len - sep->actual))) {
+        return USB_SIM_BABBLE;
+    }
+
+    if (len) {
+        memcpy(&sep->buf[sep->actual], buf, len);
+    }
+    sep->actual += len;
+    stats->packets++;
+    stats->bytes += len;
+
+    if ((len < sep->mps) || (sep->actual == sep->len) || (USB_EP_GET_IDX(ep) == 0)) {
+        sep->armed = false;
+        stats->transfers++;
+        usbd_event_ep_out_complete_handler(busid, ep & 0x7f, sep->actual);
+    }
+
+    return (int)len;
+}
+
+static int usb_sim_ctrl_in(uint8_t busid, uint8_t *buf, uint32_t size) {
+    int retry = USB_SIM_CTRL_RETRY;
+    int ret;
+
+    do {
+        ret = usb_sim_in(busid, 0x80, buf, size);
+    } while ((ret == USB_SIM_NAK) && --retry);
+
+    return ret;
+}
+
+static int usb_sim_ctrl_out(uint8_t busid, const uint8_t *buf, uint32_t len) {
+    int retry = USB_SIM_CTRL_RETRY;
+    int ret;
+
+    do {
+        ret = usb_sim_out(busid, 0x00, buf, len);
+    } while ((ret == USB_SIM_NAK) && --retry);
+
+    return ret;
+}
+
+/**
+ * @brief   Complete control transfer, SETUP, data and status stages
+ *
+ * @param   busid USB bus
+ *
+ * @param   setup setup packet
+ *
+ * @param   data  wLength bytes, filled for IN requests, sent for OUT requests
+ *
+ * @retval  data stage length, or the handshake that ended the transfer
+ */
+int usb_sim_control(uint8_t busid, const struct usb_setup_packet *setup, uint8_t *data) {
+    uint16_t mps = g_sim_udc[busid].in_ep[0].mps;
+    uint32_t total = 0;
+    uint32_t n;
+    int ret;
+
+    ret = usb_sim_setup(busid, setup);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (setup->bmRequestType & USB_REQUEST_DIR_IN) {
+        while (total < setup->wLength) {
+            ret = usb_sim_ctrl_in(busid, &data[total], setup->wLength - total);
+            if (ret < 0) {
+                return ret;
+            }
+            total += (uint32_t)ret;
+            if ((uint32_t)ret < mps) {
+                break;
+            }
+        }
+
+        ret = usb_sim_ctrl_out(busid, NULL, 0);
+    } else {
+        while (total < setup->wLength) {
+            n = setup->wLength - total;
+            if (n > mps) {
+                n = mps;
+            }
+            ret = usb_sim_ctrl_out(busid, &data[total], n);
+            if (ret < 0) {
+                return ret;
+            }
+            total += n;
+        }
+
+        ret = usb_sim_ctrl_in(busid, NULL, 0);
+    }
+
+    return (ret < 0) ? ret : (int)total;
+}
+
+void usb_sim_get_stats(uint8_t busid, uint8_t ep, struct usb_sim_ep_stats *stats) {
+    memcpy(stats, USB_SIM_STATS(busid, ep), sizeof(struct usb_sim_ep_stats));
+}
+
+void usb_sim_clear_stats(uint8_t busid) {
+    memset(g_sim_udc[busid].in_stats, 0, sizeof(g_sim_udc[busid].in_stats));
+    memset(g_sim_udc[busid].out_stats, 0, sizeof(g_sim_udc[busid].out_stats));
+}
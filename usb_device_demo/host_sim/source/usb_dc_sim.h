@@ -0,0 +1,62 @@
+/**
+  * @file    usb_dc_sim.h
+  * @author  LuckkMaker
+  * @brief   Header for usb_dc_sim.c file
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef USB_DC_SIM_H
+#define USB_DC_SIM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!< handshake of a host token, byte counts are returned as >= 0 */
+#define USB_SIM_NAK                 (-1)
+#define USB_SIM_STALL               (-2)
+#define USB_SIM_BABBLE              (-3)    /*!< packet larger than MPS or than the armed transfer */
+#define USB_SIM_NOT_OPEN            (-4)
+
+struct usb_sim_ep_stats {
+    uint32_t packets;           /*!< data packets moved, ZLPs included */
+    uint32_t transfers;         /*!< completed transfers, one endpoint callback each */
+    uint32_t naks;              /*!< tokens answered with NAK */
+    uint64_t bytes;
+};
+
+void usb_sim_bus_reset(uint8_t busid);
+uint8_t usb_sim_get_address(uint8_t busid);
+
+int usb_sim_setup(uint8_t busid, const struct usb_setup_packet *setup);
+int usb_sim_in(uint8_t busid, uint8_t ep, uint8_t *buf, uint32_t size);
+int usb_sim_out(uint8_t busid, uint8_t ep, const uint8_t *buf, uint32_t len);
+int usb_sim_control(uint8_t busid, const struct usb_setup_packet *setup, uint8_t *data);
+
+void usb_sim_get_stats(uint8_t busid, uint8_t ep, struct usb_sim_ep_stats *stats);
+void usb_sim_clear_stats(uint8_t busid);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* USB_DC_SIM_H */
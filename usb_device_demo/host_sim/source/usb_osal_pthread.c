@@ -0,0 +1,632 @@
+/**
+  * @file    usb_osal_pthread.c
+  * @author  LuckkMaker
+  * @brief   CherryUSB OSAL on POSIX threads for host tests
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Same API and pool limits as the board's usb_osal_freertos.c, so code
+  * written against the OSAL can be stressed on Linux with real preemption.
+  * An "interrupt" is any thread, give and send never block in it just as
+  * the FromISR calls do not.
+  *
+  * Threads run on static stacks set with pthread_attr_setstack(). The
+  * board stack sizes are far below what glibc needs, so every slot is
+  * USB_OSAL_HOST_STACKSIZE and a thread asking for more fails to create.
+  * A deleted thread's slot is joined before it is reused, its stack is
+  * only free once the thread fully ended.
+  *
+  * Semaphores count under a mutex and a CLOCK_MONOTONIC condition, queues
+  * are rings of the shared message pool, timers run from one service
+  * thread like the FreeRTOS timer task, critical sections take one global
+  * recursive mutex. Priorities are not modelled.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usb_osal.h"
+#include "usb_errno.h"
+#include "usb_osal_port.h"
+
+/* Private includes ----------------------------------------------------------*/
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Private typedef -----------------------------------------------------------*/
+struct usb_osal_thread_slot {
+    pthread_t tid;
+    usb_thread_entry_t entry;
+    void *args;
+    bool used;
+    bool joinable;              /*!< started, to be joined before reuse */
+};
+
+struct usb_osal_sem_slot {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t count;
+    bool used;
+};
+
+struct usb_osal_mutex_slot {
+    pthread_mutex_t lock;
+    bool used;
+};
+
+struct usb_osal_mq_slot {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uintptr_t *storage;         /*!< kept for the next queue once deleted */
+    uint32_t size;              /*!< messages the storage holds */
+    uint32_t depth;             /*!< messages of the current queue */
+    uint32_t head;
+    uint32_t num;
+    bool used;
+};
+
+struct usb_osal_timer_slot {
+    struct usb_osal_timer timer;
+    uint64_t due;               /*!< ms, CLOCK_MONOTONIC */
+    bool armed;
+    bool used;
+};
+
+/* Private define ------------------------------------------------------------*/
+#ifndef USB_OSAL_HOST_STACKSIZE
+#define USB_OSAL_HOST_STACKSIZE     (256U * 1024U)
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct usb_osal_thread_slot usb_osal_threads[USB_OSAL_THREAD_MAX];
+static uint8_t usb_osal_stacks[USB_OSAL_THREAD_MAX][USB_OSAL_HOST_STACKSIZE] __attribute__((aligned(64)));
+
+static struct usb_osal_sem_slot usb_osal_sems[USB_OSAL_SEM_MAX];
+static struct usb_osal_mutex_slot usb_osal_mutexes[USB_OSAL_MUTEX_MAX];
+
+static struct usb_osal_mq_slot usb_osal_mqs[USB_OSAL_MQ_MAX];
+static uintptr_t usb_osal_mq_pool[USB_OSAL_MQ_POOL_SIZE];
+static uint32_t usb_osal_mq_pool_used;
+
+static struct usb_osal_timer_slot usb_osal_timers[USB_OSAL_TIMER_MAX];
+static pthread_mutex_t usb_osal_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t usb_osal_timer_cond;
+static pthread_t usb_osal_timer_tid;
+static bool usb_osal_timer_running;
+
+/*!< object pools */
+static pthread_mutex_t usb_osal_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct usb_osal_thread_slot *usb_osal_self;
+
+static pthread_mutex_t usb_osal_critical;
+static pthread_once_t usb_osal_once = PTHREAD_ONCE_INIT;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External functions --------------------------------------------------------*/
+
+static void usb_osal_init(void) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&usb_osal_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void usb_osal_cond_init(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static uint64_t usb_osal_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U;
+}
+
+static void usb_osal_deadline(struct timespec *ts, uint32_t timeout) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += timeout / 1000U;
+    ts->tv_nsec += (long)(timeout % 1000U) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static void usb_osal_unlock(void *lock) {
+    pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+/* Wait on cond until pred holds, the lock is held, 0 or -USB_ERR_TIMEOUT */
+static int usb_osal_wait_locked(pthread_cond_t *cond, pthread_mutex_t *lock, const volatile uint32_t *pred, uint32_t timeout) {
+    struct timespec ts;
+
+    if (timeout == USB_OSAL_WAITING_FOREVER) {
+        while (*pred == 0U) {
+            pthread_cond_wait(cond, lock);
+        }
+        return 0;
+    }
+
+    usb_osal_deadline(&ts, timeout);
+    while (*pred == 0U) {
+        if (pthread_cond_timedwait(cond, lock, &ts) == ETIMEDOUT) {
+            return (*pred != 0U) ? 0 : -USB_ERR_TIMEOUT;
+        }
+    }
+
+    return 0;
+}
+
+/* Same, a thread deleted while it waits gives the lock back on its way out */
+static int usb_osal_wait(pthread_cond_t *cond, pthread_mutex_t *lock, const volatile uint32_t *pred, uint32_t timeout) {
+    int ret;
+
+    pthread_cleanup_push(usb_osal_unlock, lock);
+    ret = usb_osal_wait_locked(cond, lock, pred, timeout);
+    pthread_cleanup_pop(0);
+
+    return ret;
+}
+
+static void *usb_osal_thread_entry(void *arg) {
+    struct usb_osal_thread_slot *slot = (struct usb_osal_thread_slot *)arg;
+
+    usb_osal_self = slot;
+    slot->entry(slot->args);
+    usb_osal_thread_delete(NULL);
+
+    return NULL;
+}
+
+/* Join the threads that ended, their slots are free afterwards */
+static void usb_osal_thread_reap(void) {
+    uint32_t i;
+
+    for (i = 0; i < USB_OSAL_THREAD_MAX; i++) {
+        if (!usb_osal_threads[i].used && usb_osal_threads[i].joinable) {
+            pthread_join(usb_osal_threads[i].tid, NULL);
+            usb_osal_threads[i].joinable = false;
+        }
+    }
+}
+
+usb_osal_thread_t usb_osal_thread_create(const char *name, uint32_t stack_size, uint32_t prio, usb_thread_entry_t entry, void *args) {
+    struct usb_osal_thread_slot *slot = NULL;
+    pthread_attr_t attr;
+    uint32_t i;
+    int ret;
+
+    (void)name;
+    (void)prio;
+
+    if (stack_size > USB_OSAL_HOST_STACKSIZE) {
+        return NULL;
+    }
+
+    pthread_once(&usb_osal_once, usb_osal_init);
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    usb_osal_thread_reap();
+    for (i = 0; i < USB_OSAL_THREAD_MAX; i++) {
+        if (!usb_osal_threads[i].used && !usb_osal_threads[i].joinable) {
+            slot = &usb_osal_threads[i];
+            slot->used = true;
+            slot->joinable = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    slot->entry = entry;
+    slot->args = args;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, usb_osal_stacks[slot - usb_osal_threads], USB_OSAL_HOST_STACKSIZE);
+    ret = pthread_create(&slot->tid, &attr, usb_osal_thread_entry, slot);
+    pthread_attr_destroy(&attr);
+
+    if (ret != 0) {
+        pthread_mutex_lock(&usb_osal_pool_lock);
+        slot->joinable = false;
+        slot->used = false;
+        pthread_mutex_unlock(&usb_osal_pool_lock);
+        return NULL;
+    }
+
+    return (usb_osal_thread_t)slot;
+}
+
+/**
+ * @brief   Delete a thread, NULL for the calling one
+ *
+ * @param   thread   thread handle
+ *
+ * @retval  None
+ */
+void usb_osal_thread_delete(usb_osal_thread_t thread) {
+    struct usb_osal_thread_slot *slot = (struct usb_osal_thread_slot *)thread;
+
+    if ((slot == NULL) || (slot == usb_osal_self)) {
+        /* Still joinable, the next create joins it before reusing the stack */
+        pthread_mutex_lock(&usb_osal_pool_lock);
+        usb_osal_self->used = false;
+        pthread_mutex_unlock(&usb_osal_pool_lock);
+        pthread_exit(NULL);
+    }
+
+    pthread_cancel(slot->tid);
+    pthread_join(slot->tid, NULL);
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    slot->joinable = false;
+    slot->used = false;
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+}
+
+usb_osal_sem_t usb_osal_sem_create(uint32_t initial_count) {
+    struct usb_osal_sem_slot *sem = NULL;
+    uint32_t i;
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    for (i = 0; i < USB_OSAL_SEM_MAX; i++) {
+        if (!usb_osal_sems[i].used) {
+            sem = &usb_osal_sems[i];
+            sem->used = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+
+    if (sem == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&sem->lock, NULL);
+    usb_osal_cond_init(&sem->cond);
+    sem->count = initial_count;
+
+    return (usb_osal_sem_t)sem;
+}
+
+void usb_osal_sem_delete(usb_osal_sem_t sem) {
+    struct usb_osal_sem_slot *s = (struct usb_osal_sem_slot *)sem;
+
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    s->used = false;
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+}
+
+int usb_osal_sem_take(usb_osal_sem_t sem, uint32_t timeout) {
+    struct usb_osal_sem_slot *s = (struct usb_osal_sem_slot *)sem;
+    int ret;
+
+    pthread_mutex_lock(&s->lock);
+    ret = usb_osal_wait(&s->cond, &s->lock, &s->count, timeout);
+    if (ret == 0) {
+        s->count--;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+int usb_osal_sem_give(usb_osal_sem_t sem) {
+    struct usb_osal_sem_slot *s = (struct usb_osal_sem_slot *)sem;
+    int ret = 0;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->count < USB_OSAL_SEM_COUNT_MAX) {
+        s->count++;
+        pthread_cond_signal(&s->cond);
+    } else {
+        ret = -USB_ERR_TIMEOUT;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    return ret;
+}
+
+void usb_osal_sem_reset(usb_osal_sem_t sem) {
+    struct usb_osal_sem_slot *s = (struct usb_osal_sem_slot *)sem;
+
+    pthread_mutex_lock(&s->lock);
+    s->count = 0;
+    pthread_mutex_unlock(&s->lock);
+}
+
+usb_osal_mutex_t usb_osal_mutex_create(void) {
+    struct usb_osal_mutex_slot *mutex = NULL;
+    uint32_t i;
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    for (i = 0; i < USB_OSAL_MUTEX_MAX; i++) {
+        if (!usb_osal_mutexes[i].used) {
+            mutex = &usb_osal_mutexes[i];
+            mutex->used = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+
+    if (mutex == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&mutex->lock, NULL);
+
+    return (usb_osal_mutex_t)mutex;
+}
+
+void usb_osal_mutex_delete(usb_osal_mutex_t mutex) {
+    struct usb_osal_mutex_slot *m = (struct usb_osal_mutex_slot *)mutex;
+
+    pthread_mutex_destroy(&m->lock);
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    m->used = false;
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+}
+
+int usb_osal_mutex_take(usb_osal_mutex_t mutex) {
+    return (pthread_mutex_lock(&((struct usb_osal_mutex_slot *)mutex)->lock) == 0) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+int usb_osal_mutex_give(usb_osal_mutex_t mutex) {
+    return (pthread_mutex_unlock(&((struct usb_osal_mutex_slot *)mutex)->lock) == 0) ? 0 : -USB_ERR_TIMEOUT;
+}
+
+usb_osal_mq_t usb_osal_mq_create(uint32_t max_msgs) {
+    struct usb_osal_mq_slot *mq = NULL;
+    uint32_t i;
+
+    if (max_msgs == 0U) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    for (i = 0; i < USB_OSAL_MQ_MAX; i++) {
+        if (!usb_osal_mqs[i].used && (usb_osal_mqs[i].size >= max_msgs)) {
+            mq = &usb_osal_mqs[i];
+            break;
+        }
+    }
+    if ((mq == NULL) && ((USB_OSAL_MQ_POOL_SIZE - usb_osal_mq_pool_used) >= max_msgs)) {
+        for (i = 0; i < USB_OSAL_MQ_MAX; i++) {
+            if (!usb_osal_mqs[i].used && (usb_osal_mqs[i].storage == NULL)) {
+                mq = &usb_osal_mqs[i];
+                mq->storage = &usb_osal_mq_pool[usb_osal_mq_pool_used];
+                mq->size = max_msgs;
+                usb_osal_mq_pool_used += max_msgs;
+                break;
+            }
+        }
+    }
+    if (mq != NULL) {
+        mq->used = true;
+    }
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+
+    if (mq == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&mq->lock, NULL);
+    usb_osal_cond_init(&mq->cond);
+    mq->head = 0;
+    mq->num = 0;
+    /* A reused ring may be longer, only max_msgs of it are used */
+    mq->depth = max_msgs;
+
+    return (usb_osal_mq_t)mq;
+}
+
+void usb_osal_mq_delete(usb_osal_mq_t mq) {
+    struct usb_osal_mq_slot *q = (struct usb_osal_mq_slot *)mq;
+
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+
+    pthread_mutex_lock(&usb_osal_pool_lock);
+    q->used = false;
+    pthread_mutex_unlock(&usb_osal_pool_lock);
+}
+
+int usb_osal_mq_send(usb_osal_mq_t mq, uintptr_t addr) {
+    struct usb_osal_mq_slot *q = (struct usb_osal_mq_slot *)mq;
+    int ret = 0;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->num < q->depth) {
+        q->storage[(q->head + q->num) % q->depth] = addr;
+        q->num++;
+        pthread_cond_signal(&q->cond);
+    } else {
+        ret = -USB_ERR_TIMEOUT;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+int usb_osal_mq_recv(usb_osal_mq_t mq, uintptr_t *addr, uint32_t timeout) {
+    struct usb_osal_mq_slot *q = (struct usb_osal_mq_slot *)mq;
+    int ret;
+
+    pthread_mutex_lock(&q->lock);
+    ret = usb_osal_wait(&q->cond, &q->lock, &q->num, timeout);
+    if (ret == 0) {
+        *addr = q->storage[q->head];
+        q->head = (q->head + 1U) % q->depth;
+        q->num--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return ret;
+}
+
+static void *usb_osal_timer_thread(void *arg) {
+    struct usb_osal_timer_slot *slot;
+    struct timespec ts;
+    uint64_t now;
+    uint64_t next;
+    uint32_t i;
+
+    (void)arg;
+
+    pthread_mutex_lock(&usb_osal_timer_lock);
+    while (1) {
+        now = usb_osal_now_ms();
+        next = UINT64_MAX;
+
+        for (i = 0; i < USB_OSAL_TIMER_MAX; i++) {
+            slot = &usb_osal_timers[i];
+            if (!slot->used || !slot->armed) {
+                continue;
+            }
+            if (slot->due <= now) {
+                if (slot->timer.is_period) {
+                    slot->due += slot->timer.timeout_ms ? slot->timer.timeout_ms : 1U;
+                } else {
+                    slot->armed = false;
+                }
+                /* The handler may start or stop timers */
+                pthread_mutex_unlock(&usb_osal_timer_lock);
+                slot->timer.handler(slot->timer.argument);
+                pthread_mutex_lock(&usb_osal_timer_lock);
+                now = usb_osal_now_ms();
+            }
+            if (slot->armed && (slot->due < next)) {
+                next = slot->due;
+            }
+        }
+
+        if (next == UINT64_MAX) {
+            pthread_cond_wait(&usb_osal_timer_cond, &usb_osal_timer_lock);
+        } else if (next > now) {
+            usb_osal_deadline(&ts, (uint32_t)(next - now));
+            pthread_cond_timedwait(&usb_osal_timer_cond, &usb_osal_timer_lock, &ts);
+        }
+    }
+
+    return NULL;
+}
+
+struct usb_osal_timer *usb_osal_timer_create(const char *name, uint32_t timeout_ms, usb_timer_handler_t handler, void *argument, bool is_period) {
+    struct usb_osal_timer_slot *slot = NULL;
+    uint32_t i;
+
+    (void)name;
+
+    pthread_mutex_lock(&usb_osal_timer_lock);
+    if (!usb_osal_timer_running) {
+        usb_osal_cond_init(&usb_osal_timer_cond);
+        if (pthread_create(&usb_osal_timer_tid, NULL, usb_osal_timer_thread, NULL) == 0) {
+            pthread_detach(usb_osal_timer_tid);
+            usb_osal_timer_running = true;
+        }
+    }
+    for (i = 0; usb_osal_timer_running && (i < USB_OSAL_TIMER_MAX); i++) {
+        if (!usb_osal_timers[i].used) {
+            slot = &usb_osal_timers[i];
+            slot->used = true;
+            slot->armed = false;
+            slot->timer.handler = handler;
+            slot->timer.argument = argument;
+            slot->timer.is_period = is_period;
+            slot->timer.timeout_ms = timeout_ms;
+            slot->timer.timer = slot;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&usb_osal_timer_lock);
+
+    return (slot != NULL) ? &slot->timer : NULL;
+}
+
+void usb_osal_timer_delete(struct usb_osal_timer *timer) {
+    struct usb_osal_timer_slot *slot = (struct usb_osal_timer_slot *)timer->timer;
+
+    pthread_mutex_lock(&usb_osal_timer_lock);
+    slot->armed = false;
+    slot->used = false;
+    pthread_mutex_unlock(&usb_osal_timer_lock);
+}
+
+void usb_osal_timer_start(struct usb_osal_timer *timer) {
+    struct usb_osal_timer_slot *slot = (struct usb_osal_timer_slot *)timer->timer;
+
+    pthread_mutex_lock(&usb_osal_timer_lock);
+    slot->due = usb_osal_now_ms() + timer->timeout_ms;
+    slot->armed = true;
+    pthread_cond_signal(&usb_osal_timer_cond);
+    pthread_mutex_unlock(&usb_osal_timer_lock);
+}
+
+void usb_osal_timer_stop(struct usb_osal_timer *timer) {
+    struct usb_osal_timer_slot *slot = (struct usb_osal_timer_slot *)timer->timer;
+
+    pthread_mutex_lock(&usb_osal_timer_lock);
+    slot->armed = false;
+    pthread_mutex_unlock(&usb_osal_timer_lock);
+}
+
+size_t usb_osal_enter_critical_section(void) {
+    pthread_once(&usb_osal_once, usb_osal_init);
+    pthread_mutex_lock(&usb_osal_critical);
+
+    return 1;
+}
+
+void usb_osal_leave_critical_section(size_t flag) {
+    (void)flag;
+
+    pthread_mutex_unlock(&usb_osal_critical);
+}
+
+void usb_osal_msleep(uint32_t delay) {
+    struct timespec ts;
+
+    ts.tv_sec = delay / 1000U;
+    ts.tv_nsec = (long)(delay % 1000U) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+void *usb_osal_malloc(size_t size) {
+    return malloc(size);
+}
+
+void usb_osal_free(void *ptr) {
+    free(ptr);
+}
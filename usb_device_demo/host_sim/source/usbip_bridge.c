@@ -0,0 +1,713 @@
+/**
+  * @file    usbip_bridge.c
+  * @author  LuckkMaker
+  * @brief   USB/IP export of the CDC ACM + HID demo on the simulated DCD
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Serves cdc_acm_hid.c as USB/IP device 1-1 on localhost, so vhci_hcd binds
+  * the real cdc_acm and usbhid drivers to it:
+  *
+  *   usbip_bridge [-p port] [-s]
+  *   modprobe vhci-hcd
+  *   usbip attach -r 127.0.0.1 -b 1-1
+  *
+  *   -p  TCP port, 3240 by default
+  *   -s  stream a byte counter on the CDC bulk IN while DTR is set, what the
+  *       board main loop would send, so "cat /dev/ttyACM0" measures IN
+  *       throughput; OUT data is counted and dropped
+  *
+  * One client at a time, single threaded. URBs are turned into usb_sim_*
+  * tokens: control URBs run to completion at once, bulk and interrupt URBs
+  * stay queued while their endpoint NAKs and are retried, in order per
+  * endpoint, after every command from the host. SET_ADDRESS never reaches
+  * the server, vhci_hcd answers it, so the device is reset and addressed on
+  * import. Isochronous URBs are refused, the demo has none.
+  *
+  * Per endpoint totals are printed when the client detaches, rates are
+  * averaged over the whole attach time.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "cdc_acm_hid.h"
+#include "usb_dc_sim.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Private typedef -----------------------------------------------------------*/
+struct usbip_urb {
+    uint32_t seqnum;
+    uint8_t ep;                 /*!< endpoint address, direction bit included */
+    uint32_t flags;
+    uint32_t len;
+    uint32_t actual;
+    uint8_t *buf;
+};
+
+/* Private define ------------------------------------------------------------*/
+#define USBIP_BRIDGE_BUSID          0
+
+#define USBIP_BRIDGE_PORT           3240
+#define USBIP_BRIDGE_BUSNUM         1
+#define USBIP_BRIDGE_DEVNUM         2
+#define USBIP_BRIDGE_BUS_ID         "1-1"
+
+#define USBIP_BRIDGE_STREAM_LEN     2048
+
+#define USBIP_BRIDGE_MAX_URB        128
+#define USBIP_BRIDGE_MAX_XFER       (1U << 20)
+
+/*!< protocol, all fields big endian */
+#define USBIP_VERSION               0x0111
+
+#define USBIP_OP_REQ_DEVLIST        0x8005
+#define USBIP_OP_REP_DEVLIST        0x0005
+#define USBIP_OP_REQ_IMPORT         0x8003
+#define USBIP_OP_REP_IMPORT         0x0003
+
+#define USBIP_CMD_SUBMIT            1
+#define USBIP_CMD_UNLINK            2
+#define USBIP_RET_SUBMIT            3
+#define USBIP_RET_UNLINK            4
+
+#define USBIP_DIR_IN                1
+
+#define USBIP_OP_HDR_SIZE           8
+#define USBIP_BUSID_SIZE            32
+#define USBIP_DEVICE_SIZE           312
+#define USBIP_CMD_SIZE              48
+
+/*!< transfer_flags */
+#define USBIP_URB_SHORT_NOT_OK      0x0001
+#define USBIP_URB_ZERO_PACKET       0x0040
+
+/*!< hub request the stub server turns into a device reset */
+#define USBIP_RT_PORT               0x23
+#define USBIP_PORT_FEAT_RESET       4
+
+/* Private macro -------------------------------------------------------------*/
+#define USBIP_EP_SLOT(ep)           (USB_EP_GET_IDX(ep) + (USB_EP_DIR_IS_IN(ep) ? 16U : 0U))
+
+/* Private variables ---------------------------------------------------------*/
+static struct usbip_urb bridge_urb[USBIP_BRIDGE_MAX_URB];
+static uint32_t bridge_urb_count;
+
+static bool bridge_stream;
+static uint8_t bridge_stream_buf[USBIP_BRIDGE_STREAM_LEN];
+static uint8_t bridge_dev_desc[18];
+static uint8_t bridge_cfg_desc[CONFIG_USBDEV_REQUEST_BUFFER_LEN];
+static uint16_t bridge_cfg_len;
+static double bridge_t0;
+
+/* Private function prototypes -----------------------------------------------*/
+/* External variables --------------------------------------------------------*/
+
+/* External functions --------------------------------------------------------*/
+
+static void usbip_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void usbip_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t usbip_get32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int usbip_recv(int fd, void *buf, uint32_t len) {
+    uint8_t *p = (uint8_t *)buf;
+    ssize_t n;
+
+    while (len) {
+        n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+static int usbip_send(int fd, const void *buf, uint32_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    ssize_t n;
+
+    while (len) {
+        n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+static double usbip_bridge_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*************************** device ******************************************/
+
+/* overrides the weak hook in cdc_acm_hid.c, the data is counted by the DCD */
+void usbd_cdc_get_out_data(uint8_t busid, uint8_t *data, uint32_t len) {
+    ARG_UNUSED(busid);
+    ARG_UNUSED(data);
+    ARG_UNUSED(len);
+}
+
+/**
+ * @brief   Bus reset and SET_ADDRESS, what the root hub port does before
+ *          vhci_hcd takes over, then the descriptors for the device list
+ *
+ * @param   None
+ *
+ * @retval  0 on success
+ */
+static int usbip_bridge_attach(void) {
+    struct usb_setup_packet setup;
+    int ret;
+
+    usb_sim_bus_reset(USBIP_BRIDGE_BUSID);
+
+    setup.bmRequestType = 0x00;
+    setup.bRequest = USB_REQUEST_SET_ADDRESS;
+    setup.wValue = USBIP_BRIDGE_DEVNUM;
+    setup.wIndex = 0;
+    setup.wLength = 0;
+    if (usb_sim_control(USBIP_BRIDGE_BUSID, &setup, NULL) != 0) {
+        return -1;
+    }
+
+    setup.bmRequestType = 0x80;
+    setup.bRequest = USB_REQUEST_GET_DESCRIPTOR;
+    setup.wValue = USB_DESCRIPTOR_TYPE_DEVICE << 8;
+    setup.wLength = sizeof(bridge_dev_desc);
+    if (usb_sim_control(USBIP_BRIDGE_BUSID, &setup, bridge_dev_desc) != sizeof(bridge_dev_desc)) {
+        return -1;
+    }
+
+    setup.wValue = USB_DESCRIPTOR_TYPE_CONFIGURATION << 8;
+    setup.wLength = sizeof(bridge_cfg_desc);
+    ret = usb_sim_control(USBIP_BRIDGE_BUSID, &setup, bridge_cfg_desc);
+    if (ret < 9) {
+        return -1;
+    }
+    bridge_cfg_len = (uint16_t)ret;
+
+    return 0;
+}
+
+/* the board main loop */
+static void usbip_bridge_stream(void) {
+    if (bridge_stream && cdc_acm_dtr(USBIP_BRIDGE_BUSID) && usb_device_is_configured(USBIP_BRIDGE_BUSID)) {
+        /* refused while the last one is in flight */
+        cdc_acm_data_write(USBIP_BRIDGE_BUSID, bridge_stream_buf, sizeof(bridge_stream_buf));
+    }
+}
+
+static void usbip_bridge_print(void) {
+    struct usb_sim_ep_stats stats;
+    double seconds = usbip_bridge_now() - bridge_t0;
+    uint8_t ep;
+    uint8_t i;
+
+    printf("detached after %.1f s\n", seconds);
+
+    /* data endpoints only */
+    for (i = 2; i < (CONFIG_USBDEV_EP_NUM * 2U); i++) {
+        ep = (uint8_t)((i >> 1) | ((i & 1U) ? 0x80 : 0x00));
+        usb_sim_get_stats(USBIP_BRIDGE_BUSID, ep, &stats);
+        if ((stats.packets == 0) && (stats.naks == 0)) {
+            continue;
+        }
+        printf("ep %02x %-3s %12llu bytes %8.2f MB/s  (%u transfers, %u naks)\n",
+               ep, USB_EP_DIR_IS_IN(ep) ? "in" : "out",
+               (unsigned long long)stats.bytes, (double)stats.bytes / seconds / 1e6,
+               stats.transfers, stats.naks);
+    }
+}
+
+/*************************** device list *************************************/
+
+/* struct usbip_usb_device, the interface list follows for OP_REP_DEVLIST */
+static void usbip_bridge_pack_device(uint8_t *p) {
+    memset(p, 0, USBIP_DEVICE_SIZE);
+    snprintf((char *)p, 256, "/sys/devices/platform/usb_dc_sim/usb%u/%s", USBIP_BRIDGE_BUSNUM, USBIP_BRIDGE_BUS_ID);
+    snprintf((char *)&p[256], USBIP_BUSID_SIZE, "%s", USBIP_BRIDGE_BUS_ID);
+    usbip_put32(&p[288], USBIP_BRIDGE_BUSNUM);
+    usbip_put32(&p[292], USBIP_BRIDGE_DEVNUM);
+    /* USB_SPEED_* has the numbering of the Linux enum usb_device_speed */
+    usbip_put32(&p[296], usbd_get_port_speed(USBIP_BRIDGE_BUSID));
+    /* idVendor, idProduct, bcdDevice, little endian in the descriptor */
+    usbip_put16(&p[300], (uint16_t)(bridge_dev_desc[8] | (bridge_dev_desc[9] << 8)));
+    usbip_put16(&p[302], (uint16_t)(bridge_dev_desc[10] | (bridge_dev_desc[11] << 8)));
+    usbip_put16(&p[304], (uint16_t)(bridge_dev_desc[12] | (bridge_dev_desc[13] << 8)));
+    p[306] = bridge_dev_desc[4];                /* bDeviceClass */
+    p[307] = bridge_dev_desc[5];
+    p[308] = bridge_dev_desc[6];
+    p[309] = usb_device_is_configured(USBIP_BRIDGE_BUSID) ? bridge_cfg_desc[5] : 0;
+    p[310] = bridge_dev_desc[17];               /* bNumConfigurations */
+    p[311] = bridge_cfg_desc[4];                /* bNumInterfaces */
+}
+
+static int usbip_bridge_devlist(int fd) {
+    uint8_t rep[USBIP_OP_HDR_SIZE + 4 + USBIP_DEVICE_SIZE + 32 * 4];
+    uint32_t len = USBIP_OP_HDR_SIZE + 4 + USBIP_DEVICE_SIZE;
+    uint16_t i;
+
+    usbip_put16(&rep[0], USBIP_VERSION);
+    usbip_put16(&rep[2], USBIP_OP_REP_DEVLIST);
+    usbip_put32(&rep[4], 0);
+    usbip_put32(&rep[8], 1);
+    usbip_bridge_pack_device(&rep[12]);
+
+    /* class triple of every alternate setting 0 */
+    for (i = 0; (i + 9U) <= bridge_cfg_len; i += bridge_cfg_desc[i]) {
+        if (bridge_cfg_desc[i] == 0) {
+            break;
+        }
+        if ((bridge_cfg_desc[i + 1] == USB_DESCRIPTOR_TYPE_INTERFACE) && (bridge_cfg_desc[i + 3] == 0) &&
+            ((len + 4U) <= sizeof(rep))) {
+            rep[len++] = bridge_cfg_desc[i + 5];
+            rep[len++] = bridge_cfg_desc[i + 6];
+            rep[len++] = bridge_cfg_desc[i + 7];
+            rep[len++] = 0;
+        }
+    }
+
+    return usbip_send(fd, rep, len);
+}
+
+static int usbip_bridge_import(int fd) {
+    uint8_t busid[USBIP_BUSID_SIZE];
+    uint8_t rep[USBIP_OP_HDR_SIZE + USBIP_DEVICE_SIZE];
+    bool match;
+
+    if (usbip_recv(fd, busid, sizeof(busid)) != 0) {
+        return -1;
+    }
+    busid[sizeof(busid) - 1] = 0;
+    match = (strcmp((const char *)busid, USBIP_BRIDGE_BUS_ID) == 0);
+
+    if (match && (usbip_bridge_attach() != 0)) {
+        match = false;
+    }
+
+    usbip_put16(&rep[0], USBIP_VERSION);
+    usbip_put16(&rep[2], USBIP_OP_REP_IMPORT);
+    usbip_put32(&rep[4], match ? 0 : 1);
+    if (!match) {
+        usbip_send(fd, rep, USBIP_OP_HDR_SIZE);
+        return -1;
+    }
+
+    usbip_bridge_pack_device(&rep[USBIP_OP_HDR_SIZE]);
+
+    return usbip_send(fd, rep, sizeof(rep));
+}
+
+/*************************** URBs ********************************************/
+
+static int usbip_bridge_ret_submit(int fd, const struct usbip_urb *urb, int status) {
+    uint8_t hdr[USBIP_CMD_SIZE];
+
+    memset(hdr, 0, sizeof(hdr));
+    usbip_put32(&hdr[0], USBIP_RET_SUBMIT);
+    usbip_put32(&hdr[4], urb->seqnum);
+    usbip_put32(&hdr[20], (uint32_t)status);
+    usbip_put32(&hdr[24], urb->actual);
+
+    if (usbip_send(fd, hdr, sizeof(hdr)) != 0) {
+        return -1;
+    }
+    if (USB_EP_DIR_IS_IN(urb->ep) && urb->actual) {
+        return usbip_send(fd, urb->buf, urb->actual);
+    }
+
+    return 0;
+}
+
+static int usbip_bridge_status(int ret) {
+    switch (ret) {
+        case USB_SIM_STALL:
+            return -EPIPE;
+        case USB_SIM_BABBLE:
+            return -EOVERFLOW;
+        case USB_SIM_NOT_OPEN:
+            return -ENODEV;
+        default:
+            return -EPROTO;
+    }
+}
+
+/**
+ * @brief   Move packets of a bulk or interrupt URB until the endpoint NAKs
+ *
+ * @param   urb    URB at the head of its endpoint
+ *
+ * @param   status set once the URB is complete
+ *
+ * @retval  true once the URB is complete
+ */
+static bool usbip_bridge_xfer(struct usbip_urb *urb, int *status) {
+    uint16_t mps = usbd_get_ep_mps(USBIP_BRIDGE_BUSID, urb->ep);
+    uint32_t n;
+    int ret;
+
+    while (true) {
+        if (USB_EP_DIR_IS_IN(urb->ep)) {
+            ret = usb_sim_in(USBIP_BRIDGE_BUSID, urb->ep, &urb->buf[urb->actual], urb->len - urb->actual);
+            n = (ret > 0) ? (uint32_t)ret : 0U;
+        } else {
+            n = urb->len - urb->actual;
+            if (n > mps) {
+                n = mps;
+            }
+            ret = usb_sim_out(USBIP_BRIDGE_BUSID, urb->ep, &urb->buf[urb->actual], n);
+        }
+
+        if (ret == USB_SIM_NAK) {
+            return false;
+        }
+        if (ret < 0) {
+            *status = usbip_bridge_status(ret);
+            return true;
+        }
+
+        urb->actual += n;
+
+        /* a short packet ends the transfer, an OUT ends with its data unless
+         * it asked for a ZLP after a full last packet */
+        if (n < mps) {
+            *status = (USB_EP_DIR_IS_IN(urb->ep) && (urb->actual < urb->len) &&
+                       (urb->flags & USBIP_URB_SHORT_NOT_OK)) ? -EREMOTEIO : 0;
+            return true;
+        }
+        if ((urb->actual == urb->len) && (USB_EP_DIR_IS_IN(urb->ep) || !(urb->flags & USBIP_URB_ZERO_PACKET))) {
+            *status = 0;
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief   Retry the queued URBs, oldest first and one per endpoint, until
+ *          none of them moves
+ *
+ * @param   fd     client socket
+ *
+ * @retval  0, -1 on a socket error
+ */
+static int usbip_bridge_service(int fd) {
+    struct usbip_urb *urb;
+    uint32_t blocked;
+    uint32_t i;
+    bool progress;
+    int status;
+
+    do {
+        usbip_bridge_stream();
+
+        progress = false;
+        blocked = 0;
+
+        for (i = 0; i < bridge_urb_count;) {
+            urb = &bridge_urb[i];
+
+            if ((blocked & (1UL << USBIP_EP_SLOT(urb->ep))) ||
+                !usbip_bridge_xfer(urb, &status)) {
+                blocked |= 1UL << USBIP_EP_SLOT(urb->ep);
+                i++;
+                continue;
+            }
+
+            progress = true;
+            if (usbip_bridge_ret_submit(fd, urb, status) != 0) {
+                return -1;
+            }
+            free(urb->buf);
+            memmove(urb, urb + 1, (bridge_urb_count - i - 1) * sizeof(struct usbip_urb));
+            bridge_urb_count--;
+        }
+    } while (progress);
+
+    return 0;
+}
+
+static int usbip_bridge_control(struct usbip_urb *urb, const uint8_t *raw) {
+    struct usb_setup_packet setup;
+    int ret;
+
+    memcpy(&setup, raw, sizeof(setup));
+
+    /* what usbip-host does for a hub port reset of the exported device */
+    if ((setup.bmRequestType == USBIP_RT_PORT) && (setup.bRequest == USB_REQUEST_SET_FEATURE) &&
+        (setup.wValue == USBIP_PORT_FEAT_RESET)) {
+        return (usbip_bridge_attach() == 0) ? 0 : -EPROTO;
+    }
+
+    if (setup.wLength > urb->len) {
+        return -EOVERFLOW;
+    }
+
+    ret = usb_sim_control(USBIP_BRIDGE_BUSID, &setup, urb->buf);
+    if (ret < 0) {
+        return usbip_bridge_status(ret);
+    }
+
+    urb->actual = (uint32_t)ret;
+    return 0;
+}
+
+static int usbip_bridge_submit(int fd, const uint8_t *hdr) {
+    struct usbip_urb urb;
+    uint32_t iso = usbip_get32(&hdr[36]);
+    uint8_t desc[16];
+    int status = 0;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.seqnum = usbip_get32(&hdr[4]);
+    urb.ep = (uint8_t)(usbip_get32(&hdr[16]) & 0x0f);
+    if (usbip_get32(&hdr[12]) == USBIP_DIR_IN) {
+        urb.ep |= 0x80;
+    }
+    urb.flags = usbip_get32(&hdr[20]);
+    urb.len = usbip_get32(&hdr[24]);
+
+    if (urb.len > USBIP_BRIDGE_MAX_XFER) {
+        printf("URB %u: %u bytes, protocol error\n", urb.seqnum, urb.len);
+        return -1;
+    }
+
+    urb.buf = malloc(urb.len ? urb.len : 1U);
+    if (urb.buf == NULL) {
+        return -1;
+    }
+    if (USB_EP_DIR_IS_OUT(urb.ep) && (usbip_recv(fd, urb.buf, urb.len) != 0)) {
+        free(urb.buf);
+        return -1;
+    }
+
+    /* isochronous packet descriptors, only drained */
+    if ((iso != 0) && (iso != 0xffffffffU)) {
+        while (iso--) {
+            if (usbip_recv(fd, desc, sizeof(desc)) != 0) {
+                free(urb.buf);
+                return -1;
+            }
+        }
+        status = -EINVAL;
+    } else if (USB_EP_GET_IDX(urb.ep) == 0) {
+        status = usbip_bridge_control(&urb, &hdr[40]);
+    } else if (bridge_urb_count == USBIP_BRIDGE_MAX_URB) {
+        status = -ENOMEM;
+    } else {
+        memcpy(&bridge_urb[bridge_urb_count++], &urb, sizeof(urb));
+        return usbip_bridge_service(fd);
+    }
+
+    /* OUT data is not echoed back */
+    if (USB_EP_DIR_IS_OUT(urb.ep)) {
+        urb.actual = (status == 0) ? urb.len : 0U;
+    }
+    status = usbip_bridge_ret_submit(fd, &urb, status);
+    free(urb.buf);
+
+    return (status == 0) ? usbip_bridge_service(fd) : -1;
+}
+
+static int usbip_bridge_unlink(int fd, const uint8_t *hdr) {
+    uint32_t seqnum = usbip_get32(&hdr[20]);
+    uint8_t rep[USBIP_CMD_SIZE];
+    int status = 0;
+    uint32_t i;
+
+    for (i = 0; i < bridge_urb_count; i++) {
+        if (bridge_urb[i].seqnum == seqnum) {
+            /* whatever moved already is lost, as on the stub server */
+            free(bridge_urb[i].buf);
+            memmove(&bridge_urb[i], &bridge_urb[i + 1], (bridge_urb_count - i - 1) * sizeof(struct usbip_urb));
+            bridge_urb_count--;
+            status = -ECONNRESET;
+            break;
+        }
+    }
+
+    memset(rep, 0, sizeof(rep));
+    usbip_put32(&rep[0], USBIP_RET_UNLINK);
+    usbip_put32(&rep[4], usbip_get32(&hdr[4]));
+    usbip_put32(&rep[20], (uint32_t)status);
+
+    return usbip_send(fd, rep, sizeof(rep));
+}
+
+static void usbip_bridge_session(int fd) {
+    uint8_t hdr[USBIP_CMD_SIZE];
+    int ret = 0;
+
+    bridge_t0 = usbip_bridge_now();
+    usb_sim_clear_stats(USBIP_BRIDGE_BUSID);
+
+    while ((ret == 0) && (usbip_recv(fd, hdr, sizeof(hdr)) == 0)) {
+        switch (usbip_get32(&hdr[0])) {
+            case USBIP_CMD_SUBMIT:
+                ret = usbip_bridge_submit(fd, hdr);
+                break;
+            case USBIP_CMD_UNLINK:
+                ret = usbip_bridge_unlink(fd, hdr);
+                break;
+            default:
+                printf("unknown command %08x\n", usbip_get32(&hdr[0]));
+                ret = -1;
+                break;
+        }
+    }
+
+    while (bridge_urb_count) {
+        free(bridge_urb[--bridge_urb_count].buf);
+    }
+
+    usbip_bridge_print();
+}
+
+static void usbip_bridge_client(int fd) {
+    uint8_t hdr[USBIP_OP_HDR_SIZE];
+    uint16_t code;
+    int one = 1;
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (usbip_recv(fd, hdr, sizeof(hdr)) != 0) {
+        return;
+    }
+    code = (uint16_t)((hdr[2] << 8) | hdr[3]);
+
+    if (code == USBIP_OP_REQ_DEVLIST) {
+        usbip_bridge_devlist(fd);
+    } else if (code == USBIP_OP_REQ_IMPORT) {
+        if (usbip_bridge_import(fd) == 0) {
+            printf("attached as %s\n", USBIP_BRIDGE_BUS_ID);
+            usbip_bridge_session(fd);
+        }
+    } else {
+        printf("unknown operation %04x\n", code);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct sockaddr_in addr;
+    uint16_t port = USBIP_BRIDGE_PORT;
+    uint32_t i;
+    int one = 1;
+    int srv;
+    int fd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:s")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                bridge_stream = true;
+                break;
+            default:
+                printf("usage: %s [-p port] [-s]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    /* a long running server, keep the log readable when redirected */
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    for (i = 0; i < sizeof(bridge_stream_buf); i++) {
+        bridge_stream_buf[i] = (uint8_t)i;
+    }
+
+    cdc_acm_hid_init(USBIP_BRIDGE_BUSID, 0);
+
+    /* the device list is served before any import */
+    if (usbip_bridge_attach() != 0) {
+        printf("enumeration failed\n");
+        return 1;
+    }
+
+    srv = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv < 0) {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(srv, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((bind(srv, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(srv, 1) != 0)) {
+        perror("bind");
+        close(srv);
+        return 1;
+    }
+
+    printf("USB/IP device %s on 127.0.0.1:%u\n", USBIP_BRIDGE_BUS_ID, port);
+
+    while (true) {
+        fd = accept(srv, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("accept");
+            break;
+        }
+        usbip_bridge_client(fd);
+        close(fd);
+    }
+
+    close(srv);
+
+    return 1;
+}
@@ -0,0 +1,495 @@
+/**
+  * @file    cdc_bench.c
+  * @author  LuckkMaker
+  * @brief   Host side of the CDC throughput benchmark demo
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Linux only, talks to the cdc_acm tty, no libusb:
+  *
+  *   S=../apm32f407xg/application/source
+  *   cc -O2 -I$S -o cdc_bench cdc_bench.c
+  *
+  *   ./cdc_bench -m in -n 16M                    device to host
+  *   ./cdc_bench -m out -s 4096 -n 16M -c 5      host to device, 5 runs
+  *   ./cdc_bench -m loop -s 512 -n 1M            round trips of 512 bytes
+  *
+  *   -d tty      device, /dev/ttyACM0
+  *   -m mode     in, out or loop
+  *   -s bytes    host read()/write() size, 4096
+  *   -x bytes    device transfer size, 0 for its largest, loop uses -s
+  *   -n bytes    pattern bytes per run, K and M suffixes, 1M
+  *   -r seed     pattern seed, 1
+  *   -c runs     runs, 1
+  *   -t ms       give up after this long without progress, 2000
+  *
+  * Latency is per read()/write() call, per echoed chunk in loop mode. A run
+  * that stalls is abandoned with a break, the device then waits for the
+  * next command. Exit status 1 on any mismatch or timeout.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "cdc_bench_frame.h"
+
+/* Private typedef -----------------------------------------------------------*/
+struct bench_run {
+    uint8_t mode;
+    uint32_t chunk;
+    uint32_t xfer;
+    uint32_t length;
+    uint32_t seed;
+    int timeout;
+
+    double seconds;
+    uint32_t errors;            /*!< mismatches seen by the host */
+    uint32_t first;
+    uint32_t dev_bytes;
+    uint32_t dev_errors;
+    uint32_t dev_first;
+
+    double *lat;                /*!< microseconds */
+    uint32_t nlat;
+    uint32_t maxlat;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static int tty = -1;
+
+/* External functions --------------------------------------------------------*/
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int tty_open(const char *path) {
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+
+    if (tcgetattr(fd, &tio) != 0) {
+        perror("tcgetattr");
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        perror("tcsetattr");
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+/*!< >0 bytes moved, 0 timed out, <0 error */
+static ssize_t tty_io(int write_dir, uint8_t *buf, size_t len, int timeout) {
+    struct pollfd pfd = { .fd = tty, .events = write_dir ? POLLOUT : POLLIN };
+    ssize_t n;
+
+    for (;;) {
+        n = write_dir ? write(tty, buf, len) : read(tty, buf, len);
+        if (n > 0) {
+            return n;
+        }
+        if ((n < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+            perror(write_dir ? "write" : "read");
+            return -1;
+        }
+
+        n = poll(&pfd, 1, timeout);
+        if (n == 0) {
+            return 0;
+        }
+        if ((n < 0) && (errno != EINTR)) {
+            perror("poll");
+            return -1;
+        }
+    }
+}
+
+static int tty_write_all(const uint8_t *buf, size_t len, int timeout) {
+    ssize_t n;
+
+    while (len) {
+        n = tty_io(1, (uint8_t *)buf, len, timeout);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+
+    return 0;
+}
+
+static void lat_add(struct bench_run *run, double t0) {
+    if (run->nlat < run->maxlat) {
+        run->lat[run->nlat++] = (now() - t0) * 1e6;
+    }
+}
+
+static void check(struct bench_run *run, struct cdc_bench_pattern *pat, const uint8_t *buf, uint32_t len,
+                  uint32_t done) {
+    uint32_t first = 0;
+    uint32_t errors = cdc_bench_pattern_check(pat, buf, len, &first);
+
+    if (errors && (run->errors == 0)) {
+        run->first = done + first;
+    }
+    run->errors += errors;
+}
+
+/*!< pattern bytes in, anything after them starts the result */
+static int bench_in(struct bench_run *run, uint8_t *buf, uint8_t *res, uint32_t *nres) {
+    struct cdc_bench_pattern pat;
+    uint32_t done = 0;
+    uint32_t data;
+    ssize_t n;
+    double t0;
+
+    cdc_bench_pattern_init(&pat, run->seed);
+
+    while (done < run->length) {
+        t0 = now();
+        n = tty_io(0, buf, run->chunk, run->timeout);
+        if (n <= 0) {
+            return -1;
+        }
+        lat_add(run, t0);
+
+        data = (uint32_t)n;
+        if (data > run->length - done) {
+            data = run->length - done;
+            *nres = (uint32_t)n - data;
+            if (*nres > CDC_BENCH_RES_SIZE) {
+                *nres = CDC_BENCH_RES_SIZE;
+            }
+            memcpy(res, &buf[data], *nres);
+        }
+        check(run, &pat, buf, data, done);
+        done += data;
+    }
+
+    return 0;
+}
+
+static int bench_out(struct bench_run *run, uint8_t *buf) {
+    struct cdc_bench_pattern pat;
+    uint32_t done = 0;
+    uint32_t len;
+    uint32_t off;
+    ssize_t n;
+    double t0;
+
+    cdc_bench_pattern_init(&pat, run->seed);
+
+    while (done < run->length) {
+        len = (run->length - done < run->chunk) ? (run->length - done) : run->chunk;
+        cdc_bench_pattern_fill(&pat, buf, len);
+        for (off = 0; off < len; off += (uint32_t)n) {
+            t0 = now();
+            n = tty_io(1, &buf[off], len - off, run->timeout);
+            if (n <= 0) {
+                return -1;
+            }
+            lat_add(run, t0);
+        }
+        done += len;
+    }
+
+    return 0;
+}
+
+static int bench_loop(struct bench_run *run, uint8_t *buf, uint8_t *echo) {
+    struct cdc_bench_pattern tx;
+    struct cdc_bench_pattern rx;
+    uint32_t done = 0;
+    uint32_t len;
+    uint32_t got;
+    ssize_t n;
+    double t0;
+
+    cdc_bench_pattern_init(&tx, run->seed);
+    cdc_bench_pattern_init(&rx, run->seed);
+
+    while (done < run->length) {
+        len = (run->length - done < run->chunk) ? (run->length - done) : run->chunk;
+        cdc_bench_pattern_fill(&tx, buf, len);
+
+        t0 = now();
+        if (tty_write_all(buf, len, run->timeout) != 0) {
+            return -1;
+        }
+        for (got = 0; got < len; got += (uint32_t)n) {
+            n = tty_io(0, &echo[got], len - got, run->timeout);
+            if (n <= 0) {
+                return -1;
+            }
+        }
+        lat_add(run, t0);
+
+        check(run, &rx, echo, len, done);
+        done += len;
+    }
+
+    return 0;
+}
+
+static int bench_result(struct bench_run *run, uint8_t *res, uint32_t nres) {
+    ssize_t n;
+
+    while (nres < CDC_BENCH_RES_SIZE) {
+        n = tty_io(0, &res[nres], CDC_BENCH_RES_SIZE - nres, run->timeout);
+        if (n <= 0) {
+            return -1;
+        }
+        nres += (uint32_t)n;
+    }
+
+    if ((cdc_bench_get32(&res[CDC_BENCH_RES_OFS_MAGIC]) != CDC_BENCH_RES_MAGIC) ||
+        (cdc_bench_get32(&res[CDC_BENCH_RES_OFS_MODE]) != run->mode)) {
+        fprintf(stderr, "bad result frame\n");
+        return -1;
+    }
+
+    run->dev_bytes = cdc_bench_get32(&res[CDC_BENCH_RES_OFS_BYTES]);
+    run->dev_errors = cdc_bench_get32(&res[CDC_BENCH_RES_OFS_ERRORS]);
+    run->dev_first = cdc_bench_get32(&res[CDC_BENCH_RES_OFS_FIRST]);
+
+    return 0;
+}
+
+static int bench_run(struct bench_run *run) {
+    uint8_t cmd[CDC_BENCH_CMD_SIZE] = { 0 };
+    uint8_t res[CDC_BENCH_RES_SIZE];
+    uint32_t nres = 0;
+    uint8_t *buf = malloc(run->chunk);
+    uint8_t *echo = malloc(run->chunk);
+    double t0;
+    int ret = -1;
+
+    if ((buf == NULL) || (echo == NULL)) {
+        goto out;
+    }
+
+    cdc_bench_put32(&cmd[CDC_BENCH_CMD_OFS_MAGIC], CDC_BENCH_CMD_MAGIC);
+    cmd[CDC_BENCH_CMD_OFS_MODE] = run->mode;
+    cmd[CDC_BENCH_CMD_OFS_XFER] = (uint8_t)run->xfer;
+    cmd[CDC_BENCH_CMD_OFS_XFER + 1] = (uint8_t)(run->xfer >> 8);
+    cdc_bench_put32(&cmd[CDC_BENCH_CMD_OFS_LENGTH], run->length);
+    cdc_bench_put32(&cmd[CDC_BENCH_CMD_OFS_SEED], run->seed);
+
+    run->errors = 0;
+    run->first = CDC_BENCH_NO_ERROR;
+    run->nlat = 0;
+
+    /* the command has to be a transfer of its own */
+    if ((tty_write_all(cmd, sizeof(cmd), run->timeout) != 0) || (tcdrain(tty) != 0)) {
+        goto out;
+    }
+
+    t0 = now();
+    switch (run->mode) {
+        case CDC_BENCH_MODE_IN:
+            ret = bench_in(run, buf, res, &nres);
+            break;
+        case CDC_BENCH_MODE_OUT:
+            ret = bench_out(run, buf);
+            break;
+        default:
+            ret = bench_loop(run, buf, echo);
+            break;
+    }
+    if (ret == 0) {
+        ret = bench_result(run, res, nres);
+    }
+    run->seconds = now() - t0;
+
+    if (ret != 0) {
+        fprintf(stderr, "run stalled, sending break\n");
+        tcsendbreak(tty, 0);
+        usleep(100000);
+        tcflush(tty, TCIOFLUSH);
+    }
+
+out:
+    free(buf);
+    free(echo);
+    return ret;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double pct(const struct bench_run *run, unsigned int p) {
+    uint32_t i;
+
+    if (run->nlat == 0) {
+        return 0.0;
+    }
+    i = (uint32_t)(((uint64_t)(run->nlat - 1) * p) / 100U);
+    return run->lat[i];
+}
+
+static void report(unsigned int index, struct bench_run *run) {
+    double bytes = (double)run->length * ((run->mode == CDC_BENCH_MODE_LOOP) ? 2.0 : 1.0);
+
+    qsort(run->lat, run->nlat, sizeof(run->lat[0]), cmp_double);
+
+    printf("run %u: %u bytes in %.3f s, %.3f MB/s%s\n", index, run->length, run->seconds,
+           bytes / run->seconds / 1e6, (run->mode == CDC_BENCH_MODE_LOOP) ? " both ways" : "");
+    printf("  latency us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f  (%u calls)\n",
+           pct(run, 50), pct(run, 90), pct(run, 99), pct(run, 100), run->nlat);
+    if (run->mode != CDC_BENCH_MODE_OUT) {
+        printf("  host:   %u errors", run->errors);
+        if (run->errors) {
+            printf(", first at %u", run->first);
+        }
+        printf("\n");
+    }
+    printf("  device: %u bytes, %u errors", run->dev_bytes, run->dev_errors);
+    if (run->dev_first != CDC_BENCH_NO_ERROR) {
+        printf(", first at %u", run->dev_first);
+    }
+    printf("\n");
+}
+
+static uint32_t parse_size(const char *s) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 0);
+
+    if ((*end == 'k') || (*end == 'K')) {
+        v <<= 10;
+    } else if ((*end == 'm') || (*end == 'M')) {
+        v <<= 20;
+    }
+
+    return (uint32_t)v;
+}
+
+static int usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-d tty] -m in|out|loop [-s chunk] [-x xfer] [-n bytes] [-r seed] [-c runs] "
+                    "[-t ms]\n", prog);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    struct bench_run run = { .chunk = 4096, .length = 1U << 20, .seed = 1, .timeout = 2000 };
+    const char *dev = "/dev/ttyACM0";
+    unsigned int runs = 1;
+    unsigned int i;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:m:s:x:n:r:c:t:")) != -1) {
+        switch (opt) {
+            case 'd':
+                dev = optarg;
+                break;
+            case 'm':
+                if (strcmp(optarg, "in") == 0) {
+                    run.mode = CDC_BENCH_MODE_IN;
+                } else if (strcmp(optarg, "out") == 0) {
+                    run.mode = CDC_BENCH_MODE_OUT;
+                } else if (strcmp(optarg, "loop") == 0) {
+                    run.mode = CDC_BENCH_MODE_LOOP;
+                }
+                break;
+            case 's':
+                run.chunk = parse_size(optarg);
+                break;
+            case 'x':
+                run.xfer = parse_size(optarg);
+                break;
+            case 'n':
+                run.length = parse_size(optarg);
+                break;
+            case 'r':
+                run.seed = (uint32_t)strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                runs = (unsigned int)strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                run.timeout = atoi(optarg);
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+
+    if ((run.mode == 0) || (run.chunk == 0) || (run.length == 0) || (run.xfer > 0xFFFFU)) {
+        return usage(argv[0]);
+    }
+
+    /* an echo has to come back before the next chunk goes out, so the
+     * device must not wait for more than one chunk */
+    if ((run.mode == CDC_BENCH_MODE_LOOP) && ((run.xfer == 0) || (run.xfer > run.chunk))) {
+        run.xfer = (run.chunk > 0xFFFFU) ? 0xFFFFU : run.chunk;
+    }
+
+    run.maxlat = run.length / run.chunk + 2U * (run.length / 64U) + 16U;
+    run.lat = malloc(sizeof(run.lat[0]) * run.maxlat);
+    if (run.lat == NULL) {
+        return 1;
+    }
+
+    tty = tty_open(dev);
+    if (tty < 0) {
+        return 1;
+    }
+
+    for (i = 0; i < runs; i++) {
+        if (bench_run(&run) != 0) {
+            failed = 1;
+            continue;
+        }
+        report(i, &run);
+        if (run.errors || run.dev_errors || (run.dev_bytes != run.length)) {
+            failed = 1;
+        }
+    }
+
+    close(tty);
+    free(run.lat);
+    return failed;
+}
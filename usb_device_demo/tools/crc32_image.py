@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# CRC-32 as computed by the APM32 CRC unit: poly 0x04C11DB7, init 0xFFFFFFFF,
+# little-endian 32-bit words fed MSB first, no reflection, no final XOR.
+#
+#   crc32_image.py append app.bin app_crc.bin   pad to 4 bytes with 0xFF, append the CRC
+#   crc32_image.py check app_crc.bin            residue must be 0
+#   crc32_image.py crc app.bin                  print the CRC
+#
+# An image written by "append" makes the DFU demo report image_crc = 0.
+
+import argparse
+import struct
+import sys
+
+POLY = 0x04C11DB7
+INIT = 0xFFFFFFFF
+
+
+def crc32_words(data, crc=INIT):
+    if len(data) % 4:
+        raise ValueError("length must be a multiple of 4")
+    for (word,) in struct.iter_unpack("<I", data):
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ POLY) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+def pad(data):
+    return data + b"\xff" * (-len(data) % 4)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="APM32 CRC unit image helper")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+    p = sub.add_parser("append")
+    p.add_argument("input")
+    p.add_argument("output")
+    p = sub.add_parser("check")
+    p.add_argument("input")
+    p = sub.add_parser("crc")
+    p.add_argument("input")
+    args = parser.parse_args()
+
+    assert crc32_words(struct.pack("<I", 0x12345678)) == 0xDF8A8A2B
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+
+    if args.cmd == "append":
+        data = pad(data)
+        crc = crc32_words(data)
+        with open(args.output, "wb") as f:
+            f.write(data + struct.pack("<I", crc))
+        print("0x%08X, %d bytes" % (crc, len(data) + 4))
+    elif args.cmd == "check":
+        crc = crc32_words(pad(data))
+        print("ok" if crc == 0 else "bad residue 0x%08X" % crc)
+        return 0 if crc == 0 else 1
+    else:
+        print("0x%08X" % crc32_words(pad(data)))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
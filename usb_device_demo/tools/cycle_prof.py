@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Report of the cycle_prof probes of a demo built with CYCLE_PROF_ENABLE=1.
+# Reads the dump with the CYCLE_PROF_REQ_DUMP vendor request (needs pyusb)
+# or from a file saved earlier.
+#
+#   cycle_prof.py [--vid 0x314b] [--pid 0xf001] [--clear] [--save dump.bin]
+#   cycle_prof.py dump.bin
+#
+# Per probe: count, min/mean/max in cycles and microseconds, then the log2
+# histogram, bin n holding the samples of 2^n to 2^(n+1)-1 cycles.
+#
+# An F407 build with IRQ_LAT_ENABLE=1 adds sof_lat, test_irq_lat and
+# test_preempt, their max is the worst case to tune interrupt priorities on.
+# usb_pm adds stop_exit, counted while the core still runs on the 16 MHz HSI
+# and converted at that rate, and resume_xfer / resume_xfer_slp, wakeup to
+# first transfer out of STOP or out of the light sleep that precedes it.
+
+import argparse
+import struct
+import sys
+
+MAGIC = 0x46525043
+REQ_DUMP = 0x50
+REQ_CLEAR = 0x51
+
+HEADER = struct.Struct("<IHBBII")
+RECORD_HEAD = struct.Struct("<16sIIIQ")
+
+BAR_WIDTH = 40
+
+# probes timed before the system clock is back, cycles at this rate
+PROBE_HZ = {"stop_exit": 16000000}
+
+
+def fetch(vid, pid, clear):
+    try:
+        import usb.core
+    except ImportError:
+        sys.exit("pyusb is needed to read the device, or pass a dump file")
+
+    dev = usb.core.find(idVendor=vid, idProduct=pid)
+    if dev is None:
+        sys.exit("device %04x:%04x not found" % (vid, pid))
+
+    data = bytes(dev.ctrl_transfer(0xC0, REQ_DUMP, 0, 0, 4096))
+    if clear:
+        dev.ctrl_transfer(0x40, REQ_CLEAR, 0, 0, None)
+    return data
+
+
+def parse(data):
+    if len(data) < HEADER.size:
+        sys.exit("dump too short")
+    magic, version, probes, bins, timer_hz, bias = HEADER.unpack_from(data)
+    if magic != MAGIC or version != 1:
+        sys.exit("not a cycle_prof dump (magic %08x version %u)" % (magic, version))
+
+    hist = struct.Struct("<%uI" % bins)
+    size = RECORD_HEAD.size + hist.size
+    if len(data) < HEADER.size + probes * size:
+        sys.exit("dump truncated")
+
+    records = []
+    for i in range(probes):
+        off = HEADER.size + i * size
+        name, count, vmin, vmax, total = RECORD_HEAD.unpack_from(data, off)
+        records.append({
+            "name": name.rstrip(b"\0").decode("ascii", "replace"),
+            "count": count,
+            "min": vmin,
+            "max": vmax,
+            "sum": total,
+            "hist": hist.unpack_from(data, off + RECORD_HEAD.size),
+        })
+    return timer_hz, bias, records
+
+
+def report(timer_hz, bias, records):
+    print("timer %.1f MHz, probe cost %u cycles subtracted" % (timer_hz / 1e6, bias))
+    print()
+    print("%-16s %10s %10s %10s %10s %10s %10s" %
+          ("probe", "count", "min", "mean", "max", "mean us", "max us"))
+    for r in records:
+        if not r["count"]:
+            continue
+        mean = r["sum"] / r["count"]
+        hz = PROBE_HZ.get(r["name"], timer_hz)
+        us = 1e6 / hz if hz else 0.0
+        print("%-16s %10u %10u %10.1f %10u %10.2f %10.2f" %
+              (r["name"], r["count"], r["min"], mean, r["max"], mean * us, r["max"] * us))
+
+    for r in records:
+        if not r["count"]:
+            continue
+        print()
+        print("%s" % r["name"])
+        used = [n for n, c in enumerate(r["hist"]) if c]
+        peak = max(r["hist"])
+        for n in range(used[0], used[-1] + 1):
+            c = r["hist"][n]
+            bar = "#" * ((c * BAR_WIDTH + peak - 1) // peak)
+            print("  %10u .. %-10u %10u %s" % (1 << n if n else 0, (2 << n) - 1, c, bar))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="cycle_prof probe report")
+    parser.add_argument("dump", nargs="?", help="dump file instead of the device")
+    parser.add_argument("--vid", type=lambda s: int(s, 0), default=0x314B)
+    parser.add_argument("--pid", type=lambda s: int(s, 0), default=0xF001)
+    parser.add_argument("--clear", action="store_true", help="restart the probes after reading")
+    parser.add_argument("--save", help="keep the raw dump")
+    args = parser.parse_args()
+
+    if args.dump:
+        with open(args.dump, "rb") as f:
+            data = f.read()
+    else:
+        data = fetch(args.vid, args.pid, args.clear)
+
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(data)
+
+    report(*parse(data))
+
+
+if __name__ == "__main__":
+    main()
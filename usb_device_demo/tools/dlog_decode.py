@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Text of the records a demo built with DLOG_MODE=DLOG_MODE_BINARY sends
+# through dlog_sink(). A record carries the address of its format string,
+# which is looked up in the ELF file of the same build, together with the
+# strings that %s arguments point to.
+#
+#   dlog_decode.py firmware.elf capture.bin
+#   cat /dev/ttyUSB0 | dlog_decode.py firmware.elf -
+#
+# Bytes outside records are skipped up to the next header, and holes in the
+# sequence numbers are reported as lost records.
+
+import argparse
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<II6I")
+HDR_MAGIC = 0xD1
+SEQ_NONE = 0xFFFF
+
+SHF_ALLOC = 0x2
+SHT_PROGBITS = 1
+
+SPEC = re.compile(r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|z|j|t)?([diuxXocspn%])")
+
+
+class Image:
+    """Initialized sections of an ELF32 little endian file, by address."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            data = f.read()
+        if data[:4] != b"\x7fELF" or data[4] != 1 or data[5] != 1:
+            sys.exit("%s: not an ELF32 little endian file" % path)
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            sh = struct.unpack_from("<10I", data, shoff + i * shentsize)
+            sh_type, sh_flags, sh_addr, sh_offset, sh_size = sh[1], sh[2], sh[3], sh[4], sh[5]
+            if sh_type == SHT_PROGBITS and (sh_flags & SHF_ALLOC) and sh_size:
+                self.sections.append((sh_addr, data[sh_offset:sh_offset + sh_size]))
+
+    def string(self, addr):
+        for base, blob in self.sections:
+            if base <= addr < base + len(blob):
+                end = blob.find(b"\0", addr - base)
+                if end < 0:
+                    end = len(blob)
+                return blob[addr - base:end].decode("latin-1")
+        return None
+
+
+def format_record(image, fmt, args):
+    out = []
+    pos = 0
+    argi = 0
+
+    def next_arg():
+        nonlocal argi
+        v = args[argi] if argi < len(args) else 0
+        argi += 1
+        return v
+
+    for m in SPEC.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        pos = m.end()
+        flags, width, prec, _, conv = m.groups()
+        if conv == "%":
+            out.append("%")
+            continue
+        if width == "*":
+            width = str(struct.unpack("<i", struct.pack("<I", next_arg()))[0])
+        if prec == "*":
+            prec = str(next_arg())
+        spec = "%" + flags + (width or "") + ("." + prec if prec is not None else "")
+
+        v = next_arg()
+        if conv in "di":
+            out.append((spec + "d") % struct.unpack("<i", struct.pack("<I", v))[0])
+        elif conv == "u":
+            out.append((spec + "d") % v)
+        elif conv in "xXo":
+            out.append((spec + conv) % v)
+        elif conv == "c":
+            out.append((spec + "c") % chr(v & 0xFF))
+        elif conv == "p":
+            out.append("0x%08x" % v)
+        elif conv == "s":
+            s = image.string(v)
+            out.append((spec + "s") % (s if s is not None else "<0x%08x>" % v))
+        else:
+            out.append(m.group(0))
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(image, stream, out):
+    buf = b""
+    expect = None
+    lost = 0
+
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buf += chunk
+
+        while len(buf) >= RECORD.size:
+            fmt_addr, hdr, *args = RECORD.unpack_from(buf)
+            if (hdr >> 24) != HDR_MAGIC or ((hdr >> 16) & 0xFF) > len(args):
+                # resync on the next header
+                buf = buf[1:]
+                continue
+            fmt = image.string(fmt_addr)
+            if fmt is None:
+                buf = buf[1:]
+                continue
+            buf = buf[RECORD.size:]
+
+            nargs = (hdr >> 16) & 0xFF
+            seq = hdr & 0xFFFF
+            if seq != SEQ_NONE:
+                if expect is not None and seq != expect:
+                    gap = (seq - expect) & 0xFFFF
+                    lost += gap
+                    out.write("-- %u records lost --\n" % gap)
+                expect = (seq + 1) & 0xFFFF
+
+            out.write(format_record(image, fmt, args[:nargs]).replace("\r\n", "\n"))
+            out.flush()
+
+    return lost
+
+
+def main():
+    parser = argparse.ArgumentParser(description="dlog binary record decoder")
+    parser.add_argument("elf", help="firmware image of the capture")
+    parser.add_argument("capture", help="record stream, - for stdin")
+    args = parser.parse_args()
+
+    image = Image(args.elf)
+    if args.capture == "-":
+        lost = decode(image, sys.stdin.buffer, sys.stdout)
+    else:
+        with open(args.capture, "rb") as f:
+            lost = decode(image, f, sys.stdout)
+
+    if lost:
+        print("%u records lost in the capture" % lost, file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
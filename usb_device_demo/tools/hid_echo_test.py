@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Soak test for the custom HID echo of the CDC ACM + HID demo. Writes output
+# reports (ID 0x01) at a fixed rate and checks the echoed input reports
+# (ID 0x02) for gaps and corruption. Linux hidraw only, no dependencies.
+#
+#   hid_echo_test.py /dev/hidraw3 [rate_hz] [seconds]
+#
+# Report: ID, u32 sequence, payload, u32 crc32 of sequence + payload.
+
+import os
+import struct
+import sys
+import threading
+import time
+import zlib
+
+REPORT_SIZE = 64
+BODY_SIZE = REPORT_SIZE - 1
+PAYLOAD_SIZE = BODY_SIZE - 8
+
+
+def make_report(seq):
+    payload = bytes((seq + i) & 0xFF for i in range(PAYLOAD_SIZE))
+    body = struct.pack("<I", seq) + payload
+    return b"\x01" + body + struct.pack("<I", zlib.crc32(body))
+
+
+class Reader(threading.Thread):
+    def __init__(self, fd):
+        super().__init__(daemon=True)
+        self.fd = fd
+        self.received = 0
+        self.lost = 0
+        self.corrupted = 0
+        self.expect = 0
+        self.running = True
+
+    def run(self):
+        while self.running:
+            try:
+                data = os.read(self.fd, REPORT_SIZE)
+            except BlockingIOError:
+                time.sleep(0.0005)
+                continue
+            if len(data) != REPORT_SIZE or data[0] != 0x02:
+                self.corrupted += 1
+                continue
+            body = data[1:1 + BODY_SIZE - 4]
+            crc, = struct.unpack("<I", data[BODY_SIZE - 3:])
+            if zlib.crc32(body) != crc:
+                self.corrupted += 1
+                continue
+            seq, = struct.unpack("<I", body[:4])
+            if seq > self.expect:
+                self.lost += seq - self.expect
+            self.expect = seq + 1
+            self.received += 1
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("usage: hid_echo_test.py /dev/hidrawN [rate_hz] [seconds]")
+        return 2
+
+    rate = int(sys.argv[2]) if len(sys.argv) > 2 else 1000
+    seconds = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+
+    fd = os.open(sys.argv[1], os.O_RDWR | os.O_NONBLOCK)
+    reader = Reader(fd)
+    reader.start()
+
+    sent = 0
+    period = 1.0 / rate
+    t0 = time.monotonic()
+    deadline = t0
+    while time.monotonic() - t0 < seconds:
+        try:
+            os.write(fd, make_report(sent))
+            sent += 1
+        except BlockingIOError:
+            pass
+        deadline += period
+        delay = deadline - time.monotonic()
+        if delay > 0:
+            time.sleep(delay)
+    dt = time.monotonic() - t0
+
+    # let the queued echoes drain
+    time.sleep(0.2)
+    reader.running = False
+    reader.join(1.0)
+    os.close(fd)
+
+    lost = reader.lost + (sent - reader.expect)
+    print("sent %d, received %d, lost %d, corrupted %d" % (sent, reader.received, lost, reader.corrupted))
+    print("%.0f reports/s out, %.0f reports/s in" % (sent / dt, reader.received / dt))
+    return 0 if (lost == 0 and reader.corrupted == 0) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
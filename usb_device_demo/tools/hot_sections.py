@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Hot function list for FIRMWARE_HOT_SECTIONS from a gprof flat profile of
+# the host_sim benchmark (built with -DSIM_GPROF=ON), which runs the same
+# CherryUSB core and class code as the firmware:
+#
+#   ./sim_bench 5 && gprof -b -p sim_bench gmon.out > flat.txt
+#   arm-none-eabi-nm firmware.elf > firmware.nm
+#   hot_sections.py flat.txt --nm firmware.nm --head dcd.txt > cmake/usb-hot-functions.txt
+#
+# Functions come out by call count, most called first. --nm drops the ones
+# the firmware does not have (the simulated DCD, the bench itself), --head
+# puts a hand kept list first, the interrupt handlers and the DCD which the
+# simulation does not run.
+
+import argparse
+import re
+import sys
+
+# %time cumulative self calls self/call total/call name
+FLAT = re.compile(r"^\s*[0-9.]+\s+[0-9.]+\s+[0-9.]+\s+(\d+)\s+.*?\s(\S+)$")
+
+
+def read_names(path):
+    names = []
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].strip()
+            if line:
+                names.append(line)
+    return names
+
+
+def main():
+    parser = argparse.ArgumentParser(description="hot function list from a gprof flat profile")
+    parser.add_argument("flat", help="gprof -b -p output")
+    parser.add_argument("--nm", help="nm output of the firmware, keeps only its functions")
+    parser.add_argument("--head", help="names placed first, one per line")
+    parser.add_argument("--top", type=int, default=32, help="functions taken from the profile")
+    args = parser.parse_args()
+
+    calls = []
+    with open(args.flat) as f:
+        for line in f:
+            m = FLAT.match(line)
+            if m:
+                calls.append((int(m.group(1)), m.group(2)))
+    if not calls:
+        sys.exit("%s: no calls in the profile, was it built with -pg" % args.flat)
+    calls.sort(key=lambda c: -c[0])
+
+    known = None
+    if args.nm:
+        known = set()
+        with open(args.nm) as f:
+            for line in f:
+                fields = line.split()
+                if len(fields) == 3 and fields[1] in "tTwW":
+                    known.add(fields[2].split(".", 1)[0])
+
+    names = read_names(args.head) if args.head else []
+    taken = 0
+    for count, name in calls:
+        if taken == args.top:
+            break
+        if name in names or (known is not None and name not in known):
+            continue
+        names.append(name)
+        taken += 1
+
+    print("# generated by tools/hot_sections.py from %s, most called first" % args.flat)
+    for name in names:
+        print(name)
+
+
+if __name__ == "__main__":
+    main()
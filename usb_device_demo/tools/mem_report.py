@@ -0,0 +1,397 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Flash and RAM per component of a firmware image, from the GNU ld map file
+# and the ELF. Run by the mem-report build target, plain Python 3, no
+# toolchain needed:
+#
+#   mem_report.py firmware.map [--elf firmware.elf] [--top 5]
+#                 [--rules mem_components.txt] [--budget mem-budget.txt]
+#                 [--baseline base.json] [--save firmware_mem.json]
+#
+# Every input section of the map goes to the first rule of the rules file
+# matching its output section and object file. Bytes the linker adds itself,
+# alignment fill and the heap and stack reservation, have an empty object.
+# With LTO the inputs come from ltrans objects, they are traced back to the
+# defining object through the symbols they hold and the cross reference
+# table (-Wl,--cref), what is left (static functions and data) stays "lto".
+#
+# --elf checks the map totals against the section headers and, with --top,
+# lists the largest symbols of each component. --baseline adds the change
+# against an earlier --save (a missing one is skipped, the first run has
+# none), --budget fails the run (exit status 1) when a component exceeds
+# its limit.
+
+import argparse
+import bisect
+import fnmatch
+import json
+import os
+import re
+import struct
+import sys
+
+REGION = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*(\S*)")
+OUT_SECTION = re.compile(r"^(\.\S+|COMMON)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?(.*)$")
+IN_SECTION = re.compile(r"^ (\*fill\*|\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*(.*))?$")
+ADDR_SIZE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*(.*)$")
+SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_.$][\w.$]*)$")
+LOAD = re.compile(r"load address 0x([0-9a-fA-F]+)")
+CREF = re.compile(r"^(\S+)\s+(\S.*)$")
+
+CATEGORIES = ("text", "rodata", "data", "bss", "noncacheable", "stack")
+FLASH_CATEGORIES = ("text", "rodata", "data")
+RAM_CATEGORIES = ("data", "bss", "noncacheable", "stack")
+KNOWN_OUTPUT = {
+    ".rodata": "rodata",
+    ".data": "data",
+    ".ccmram": "data",
+    ".bss": "bss",
+    ".noncacheable": "noncacheable",
+    "._user_heap_stack": "stack",
+}
+
+DEFAULT_RULES = os.path.join(os.path.dirname(os.path.abspath(__file__)), "mem_components.txt")
+
+
+class MapFile:
+    def __init__(self, path):
+        self.regions = []
+        self.outputs = []       # [name, addr, size, load addr or None]
+        self.inputs = []        # [output index, name, addr, size, object, symbols]
+        self.cref = {}
+        self.parse(path)
+
+    def parse(self, path):
+        part = None
+        pending = None
+        cref_sym = None
+
+        with open(path, errors="replace") as f:
+            for line in f:
+                line = line.rstrip("\n")
+                if line.startswith("Memory Configuration"):
+                    part = "memory"
+                    continue
+                if line.startswith("Linker script and memory map"):
+                    part = "script"
+                    continue
+                if line.startswith("Cross Reference Table"):
+                    part = "cref"
+                    continue
+
+                if part == "memory":
+                    m = REGION.match(line)
+                    if m and m.group(1) not in ("Name", "*default*"):
+                        self.regions.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4)))
+                elif part == "script":
+                    pending = self.parse_script(line, pending)
+                elif part == "cref":
+                    cref_sym = self.parse_cref(line, cref_sym)
+
+        if not self.regions:
+            sys.exit("%s: no memory configuration, not a GNU ld map file" % path)
+
+    def parse_script(self, line, pending):
+        if pending is not None:
+            m = ADDR_SIZE.match(line)
+            if m:
+                kind, name = pending
+                if kind == "out":
+                    self.add_output(name, m.group(1), m.group(2), m.group(3))
+                else:
+                    self.add_input(name, m.group(1), m.group(2), m.group(3))
+                return None
+
+        if line and not line[0].isspace():
+            m = OUT_SECTION.match(line)
+            if m is None:
+                return None
+            if m.group(2) is None:
+                return ("out", m.group(1))
+            self.add_output(m.group(1), m.group(2), m.group(3), m.group(4))
+            return None
+
+        m = SYMBOL.match(line)
+        if m:
+            if self.inputs and self.outputs and self.inputs[-1][0] == len(self.outputs) - 1:
+                self.inputs[-1][5].append(m.group(2))
+            return None
+
+        m = IN_SECTION.match(line)
+        if m is None or not self.outputs:
+            return None
+        if m.group(2) is None:
+            return ("in", m.group(1))
+        self.add_input(m.group(1), m.group(2), m.group(3), m.group(4))
+        return None
+
+    def add_output(self, name, addr, size, rest):
+        load = LOAD.search(rest)
+        self.outputs.append([name, int(addr, 16), int(size, 16), int(load.group(1), 16) if load else None])
+
+    def add_input(self, name, addr, size, obj):
+        size = int(size, 16)
+        if size == 0:
+            return
+        obj = "" if name == "*fill*" else obj.strip()
+        self.inputs.append([len(self.outputs) - 1, name, int(addr, 16), size, obj, []])
+
+    def parse_cref(self, line, sym):
+        # the first file defines the symbol, with LTO the first IR object
+        # ("symbol from plugin") does
+        m = CREF.match(line)
+        if m and not line[0].isspace():
+            sym = m.group(1)
+            entry = m.group(2)
+        elif sym is not None and line.strip():
+            entry = line.strip()
+        else:
+            return sym
+        if entry.endswith("(symbol from plugin)"):
+            if sym not in self.cref or not self.cref[sym][1]:
+                self.cref[sym] = (entry[:-len("(symbol from plugin)")].strip(), True)
+        elif sym not in self.cref:
+            self.cref[sym] = (entry, False)
+        return sym
+
+    def region_of(self, addr):
+        for name, origin, length, attr in self.regions:
+            if origin <= addr < origin + length:
+                return name, "w" not in attr
+        return None, False
+
+    def category(self, out):
+        name, addr, _, load = out
+        if name in KNOWN_OUTPUT:
+            return KNOWN_OUTPUT[name]
+        region, readonly = self.region_of(addr)
+        if region is None:
+            return None
+        if readonly:
+            return "text"
+        return "data" if load is not None else "bss"
+
+    def defining_object(self, inp):
+        obj = inp[4]
+        if not obj.endswith(".ltrans.o"):
+            return obj
+        names = list(inp[5])
+        # -ffunction-sections / -fdata-sections name the section after its symbol
+        m = re.match(r"^\.[a-z]+\.(.+)$", inp[1])
+        if m:
+            names.append(m.group(1))
+        for name in names:
+            if name in self.cref and not self.cref[name][0].endswith(".ltrans.o"):
+                return self.cref[name][0]
+        return "lto"
+
+
+class Rules:
+    def __init__(self, path):
+        self.rules = []
+        with open(path) as f:
+            for number, line in enumerate(f, 1):
+                line = line.split("#", 1)[0].strip()
+                if not line:
+                    continue
+                fields = line.split(None, 2)
+                if len(fields) != 3:
+                    sys.exit("%s:%u: expected component, output section glob, object regex" % (path, number))
+                self.rules.append((fields[0], fields[1], re.compile(fields[2])))
+
+    def component(self, section, obj):
+        for name, glob, regex in self.rules:
+            if fnmatch.fnmatchcase(section, glob) and regex.search(obj):
+                return name
+        return "other"
+
+
+def read_elf(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF":
+        sys.exit("%s: not an ELF file" % path)
+    is64 = data[4] == 2
+    end = "<" if data[5] == 1 else ">"
+
+    if is64:
+        shoff, = struct.unpack_from(end + "Q", data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", data, 0x3A)
+        shdr = struct.Struct(end + "IIQQQQIIQQ")
+        sym = struct.Struct(end + "IBBHQQ")
+    else:
+        shoff, = struct.unpack_from(end + "I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(end + "HHH", data, 0x2E)
+        shdr = struct.Struct(end + "IIIIIIIIII")
+        sym = struct.Struct(end + "IIIBBH")
+
+    headers = [shdr.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+
+    def cstr(offset):
+        return data[offset:data.index(b"\0", offset)].decode(errors="replace")
+
+    strtab = headers[shstrndx][4]
+    sections = {}
+    symbols = []
+    for h in headers:
+        name = cstr(strtab + h[0])
+        stype, flags, addr, offset, size, link = h[1], h[2], h[3], h[4], h[5], h[6]
+        if flags & 0x2 and size:
+            sections[name] = (addr, size)
+        if stype != 2:
+            continue
+        names = headers[link][4]
+        for i in range(size // sym.size):
+            fields = sym.unpack_from(data, offset + i * sym.size)
+            if is64:
+                st_name, info, _, shndx, value, st_size = fields
+            else:
+                st_name, value, st_size, info, _, shndx = fields
+            # functions and objects with a size, in a real section
+            if (info & 0xF) in (1, 2) and st_size and 0 < shndx < 0xFF00:
+                symbols.append((value & ~1 if (info & 0xF) == 2 else value, st_size, cstr(names + st_name)))
+    return sections, symbols
+
+
+def read_budget(path):
+    limits = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) != 3:
+                sys.exit("%s:%u: expected component, kind, limit" % (path, number))
+            if fields[1].replace("_growth", "") not in CATEGORIES + ("flash", "ram"):
+                sys.exit("%s:%u: unknown kind %s" % (path, number, fields[1]))
+            limits.append((fields[0], fields[1], int(fields[2], 0), "%s:%u" % (path, number)))
+    return limits
+
+
+def check_budget(limits, components, base):
+    failed = []
+    for comp, kind, limit, where in limits:
+        growth = kind.endswith("_growth")
+        if growth and base is None:
+            continue
+        names = sorted(components) if comp == "*" else [comp]
+        for name in names:
+            if name != "total" and name not in components:
+                continue
+            value = total_of(components, name, kind[:-len("_growth")] if growth else kind)
+            if growth:
+                value -= total_of(base, name, kind[:-len("_growth")]) if name == "total" or name in base else 0
+            if value > limit:
+                failed.append("%s: %s %s %d > %d" % (where, name, kind, value, limit))
+    return failed
+
+
+def total_of(components, name, kind):
+    rows = components.values() if name == "total" else [components[name]]
+    return sum(row[kind] for row in rows)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="flash and RAM per component from the map file and ELF")
+    parser.add_argument("map")
+    parser.add_argument("--elf", help="image, checks the map totals and lists symbols")
+    parser.add_argument("--rules", default=DEFAULT_RULES, help="component rules, tools/mem_components.txt")
+    parser.add_argument("--budget", help="limits per component, exit status 1 when exceeded")
+    parser.add_argument("--baseline", help="report saved by --save, adds the change")
+    parser.add_argument("--save", help="write this report as JSON, a later baseline")
+    parser.add_argument("--top", type=int, default=0, help="largest symbols of each component, needs --elf")
+    args = parser.parse_args()
+
+    limits = read_budget(args.budget) if args.budget else None
+    mapfile = MapFile(args.map)
+    rules = Rules(args.rules)
+    components = {}
+    ranges = []
+
+    def account(name, category, size):
+        row = components.setdefault(name, dict.fromkeys(CATEGORIES, 0))
+        row[category] += size
+
+    per_output = {}
+    for inp in mapfile.inputs:
+        per_output.setdefault(inp[0], []).append(inp)
+
+    for index, out in enumerate(mapfile.outputs):
+        category = mapfile.category(out)
+        if category is None or out[2] == 0:
+            continue
+        used = 0
+        for inp in per_output.get(index, []):
+            name = rules.component(out[0], mapfile.defining_object(inp))
+            account(name, category, inp[3])
+            ranges.append((inp[2], inp[2] + inp[3], name))
+            used += inp[3]
+        if out[2] > used:
+            account(rules.component(out[0], ""), category, out[2] - used)
+
+    for row in components.values():
+        row["flash"] = sum(row[c] for c in FLASH_CATEGORIES)
+        row["ram"] = sum(row[c] for c in RAM_CATEGORIES)
+
+    base = None
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            base = json.load(f)["components"]
+    elif args.baseline:
+        print("no baseline %s yet, growth limits skipped" % args.baseline, file=sys.stderr)
+
+    columns = list(CATEGORIES) + ["flash", "ram"]
+    head = ["component"] + columns + (["flash +/-", "ram +/-"] if base is not None else [])
+    rows = []
+    names = sorted(components, key=lambda n: -(components[n]["flash"] + components[n]["ram"]))
+    for name in names + ["total"]:
+        row = [name] + [str(total_of(components, name, c)) for c in columns]
+        if base is not None:
+            for kind in ("flash", "ram"):
+                old = total_of(base, name, kind) if name == "total" or name in base else 0
+                row.append("%+d" % (total_of(components, name, kind) - old))
+        rows.append(row)
+    if base is not None:
+        for name in sorted(set(base) - set(components)):
+            rows.insert(-1, [name] + ["0"] * len(columns) + ["%+d" % -base[name]["flash"], "%+d" % -base[name]["ram"]])
+
+    widths = [max(len(r[i]) for r in [head] + rows) for i in range(len(head))]
+    for row in [head] + rows:
+        print("  ".join(c.rjust(w) if i else c.ljust(w) for i, (c, w) in enumerate(zip(row, widths))).rstrip())
+
+    if args.elf:
+        sections, symbols = read_elf(args.elf)
+        for out in mapfile.outputs:
+            if out[0] in sections and sections[out[0]][1] != out[2]:
+                print("warning: %s is %u bytes in the map, %u in the ELF" % (out[0], out[2], sections[out[0]][1]),
+                      file=sys.stderr)
+        if args.top:
+            ranges.sort()
+            starts = [r[0] for r in ranges]
+            largest = {}
+            for value, size, name in symbols:
+                i = bisect.bisect_right(starts, value) - 1
+                if i >= 0 and value < ranges[i][1]:
+                    largest.setdefault(ranges[i][2], []).append((size, name))
+            for comp in names:
+                if comp in largest:
+                    top = sorted(largest[comp], reverse=True)[:args.top]
+                    print("%s: %s" % (comp, ", ".join("%s %u" % (n, s) for s, n in top)))
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"map": os.path.abspath(args.map), "components": components}, f, indent=1)
+
+    if limits is not None:
+        failed = check_budget(limits, components, base)
+        for line in failed:
+            print("over budget: " + line, file=sys.stderr)
+        if failed:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
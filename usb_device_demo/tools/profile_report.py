@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Size and speed report of the firmware build profiles (Debug, Speed, Size
+# presets). Every build records its sizes from the map file, the throughput
+# comes from cdc_bench runs against the DEMO_CDC_BENCH build of the profile.
+#
+#   profile_report.py record --profile Speed --map firmware.map -o firmware_profile.json
+#   profile_report.py record --profile Speed --map firmware.map -o firmware_profile.json \
+#       --bench in=in.log --bench out=out.log --bench loop=loop.log
+#   profile_report.py compare build/*/firmware_profile.json
+#
+# Flash counts every output section located in or loaded from a read-only
+# region, RAM every section located in a writable one, heap and stack
+# reservations included. A bench log is the cdc_bench output of one mode,
+# the median MB/s and the worst p99 latency of its runs are kept.
+
+import argparse
+import json
+import re
+import statistics
+import sys
+
+REGION = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s*(\S*)")
+SECTION = re.compile(r"^(\.\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+))?")
+SECTION_CONT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+LOAD = re.compile(r"load address 0x([0-9a-fA-F]+)")
+RUN = re.compile(r"^run \d+: .* ([0-9.]+) MB/s")
+LATENCY = re.compile(r"p99 ([0-9.]+)")
+
+# output sections listed one by one, the others only count in the totals
+LISTED = (".text.usb_hot", ".text", ".rodata", ".data", ".ccmram", ".bss", ".noncacheable", "._user_heap_stack")
+
+
+def parse_map(path):
+    regions = []
+    sections = []
+    part = None
+    pending = None
+
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Memory Configuration"):
+                part = "memory"
+                continue
+            if line.startswith("Linker script and memory map"):
+                part = "script"
+                continue
+            if part == "memory":
+                m = REGION.match(line)
+                if m and m.group(1) not in ("Name", "*default*"):
+                    regions.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16), m.group(4)))
+            elif part == "script":
+                if pending is not None:
+                    m = SECTION_CONT.match(line)
+                    if m:
+                        sections.append((pending, int(m.group(1), 16), int(m.group(2), 16), LOAD.search(line)))
+                    pending = None
+                    continue
+                m = SECTION.match(line)
+                if m is None:
+                    continue
+                if m.group(2) is None:
+                    pending = m.group(1)
+                else:
+                    sections.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16), LOAD.search(line)))
+
+    if not regions:
+        sys.exit("%s: no memory configuration, not a GNU ld map file" % path)
+    return regions, sections
+
+
+def region_of(regions, addr):
+    for name, origin, length, attr in regions:
+        if origin <= addr < origin + length:
+            return name, "w" not in attr
+    return None, False
+
+
+def record(args):
+    regions, sections = parse_map(args.map)
+    flash = 0
+    ram = 0
+    listed = {}
+
+    for name, addr, size, load in sections:
+        if size == 0:
+            continue
+        region, readonly = region_of(regions, addr)
+        if region is None:
+            continue
+        if readonly:
+            flash += size
+        else:
+            ram += size
+            if load and region_of(regions, int(load.group(1), 16))[1]:
+                flash += size
+        if name in LISTED:
+            listed[name] = listed.get(name, 0) + size
+
+    result = {"profile": args.profile, "flash": flash, "ram": ram, "sections": listed, "bench": {}}
+
+    for spec in args.bench or []:
+        mode, _, path = spec.partition("=")
+        if not path:
+            sys.exit("--bench takes mode=file, got %s" % spec)
+        rates = []
+        p99 = 0.0
+        with open(path) as f:
+            for line in f:
+                m = RUN.match(line)
+                if m:
+                    rates.append(float(m.group(1)))
+                m = LATENCY.search(line)
+                if m:
+                    p99 = max(p99, float(m.group(1)))
+        if not rates:
+            sys.exit("%s: no cdc_bench runs" % path)
+        result["bench"][mode] = {"mbps": statistics.median(rates), "p99_us": p99, "runs": len(rates)}
+
+    with open(args.output, "w") as f:
+        json.dump(result, f, indent=1)
+
+    print("%s: flash %u bytes, ram %u bytes%s" % (args.profile, flash, ram,
+          "".join(", %s %.3f MB/s" % (m, b["mbps"]) for m, b in sorted(result["bench"].items()))))
+
+
+def compare(args):
+    records = []
+    for path in args.records:
+        with open(path) as f:
+            records.append(json.load(f))
+
+    names = [n for n in LISTED if any(n in r["sections"] for r in records)]
+    modes = sorted({m for r in records for m in r["bench"]})
+    base = records[0]
+
+    head = ["profile", "flash", "ram"] + names + ["%s MB/s" % m for m in modes] + ["%s p99 us" % m for m in modes]
+    rows = []
+    for r in records:
+        row = [r["profile"],
+               "%u (%+d)" % (r["flash"], r["flash"] - base["flash"]),
+               "%u (%+d)" % (r["ram"], r["ram"] - base["ram"])]
+        row += [str(r["sections"].get(n, "-")) for n in names]
+        row += ["%.3f" % r["bench"][m]["mbps"] if m in r["bench"] else "-" for m in modes]
+        row += ["%.1f" % r["bench"][m]["p99_us"] if m in r["bench"] else "-" for m in modes]
+        rows.append(row)
+
+    widths = [max(len(c) for c in col) for col in zip(head, *rows)]
+    for row in [head] + rows:
+        print("  ".join(c.ljust(w) for c, w in zip(row, widths)).rstrip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description="firmware build profile size and speed report")
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("record", help="sizes of one build, optional cdc_bench logs")
+    p.add_argument("--profile", required=True)
+    p.add_argument("--map", required=True)
+    p.add_argument("--bench", action="append", metavar="MODE=LOG")
+    p.add_argument("-o", "--output", required=True)
+
+    p = sub.add_parser("compare", help="table of recorded profiles, deltas against the first")
+    p.add_argument("records", nargs="+")
+
+    args = parser.parse_args()
+    if args.cmd == "record":
+        record(args)
+    else:
+        compare(args)
+
+
+if __name__ == "__main__":
+    main()
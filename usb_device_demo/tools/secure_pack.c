@@ -0,0 +1,206 @@
+/**
+  * @file    secure_pack.c
+  * @author  LuckkMaker
+  * @brief   Host side packer for the secure upload demo
+  * @attention
+  *
+  * Copyright (c) 2024 LuckkMaker
+  * All rights reserved.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+  * Built from the same sw_crypto.c as the firmware:
+  *
+  *   S=../apm32f407xg/application/source
+  *   cc -O2 -I$S -o secure_pack secure_pack.c $S/sw_crypto.c
+  *
+  *   ./secure_pack pack config.bin frame.bin     encrypt and tag with the demo keys
+  *   ./secure_pack unpack frame.bin config.bin   check the tag and decrypt
+  *
+  * Send frame.bin with tools/secure_send.py.
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sw_crypto.h"
+#include "secure_frame.h"
+
+/* Private variables ---------------------------------------------------------*/
+static const uint8_t enc_key[SECURE_FRAME_KEY_SIZE] = SECURE_FRAME_DEMO_ENC_KEY;
+static const uint8_t mac_key[SECURE_FRAME_KEY_SIZE] = SECURE_FRAME_DEMO_MAC_KEY;
+
+/* External functions --------------------------------------------------------*/
+
+static uint8_t *read_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf;
+    long n;
+
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    buf = malloc((size_t)n + 1);
+    if ((buf == NULL) || (fread(buf, 1, (size_t)n, f) != (size_t)n)) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        free(buf);
+        return NULL;
+    }
+
+    fclose(f);
+    *len = (size_t)n;
+    return buf;
+}
+
+static int write_file(const char *path, const uint8_t *buf, size_t len) {
+    FILE *f = fopen(path, "wb");
+
+    if ((f == NULL) || (fwrite(buf, 1, len, f) != len)) {
+        perror(path);
+        if (f != NULL) {
+            fclose(f);
+        }
+        return -1;
+    }
+
+    return fclose(f);
+}
+
+static int get_nonce(uint8_t nonce[SECURE_FRAME_NONCE_SIZE]) {
+    FILE *f = fopen("/dev/urandom", "rb");
+    size_t n;
+
+    if (f == NULL) {
+        perror("/dev/urandom");
+        return -1;
+    }
+
+    n = fread(nonce, 1, SECURE_FRAME_NONCE_SIZE, f);
+    fclose(f);
+
+    return (n == SECURE_FRAME_NONCE_SIZE) ? 0 : -1;
+}
+
+static int pack(const char *in, const char *out) {
+    struct sw_aes128_ctr ctr;
+    struct sw_hmac_sha256 hmac;
+    uint8_t *payload;
+    uint8_t *frame;
+    size_t len;
+    size_t total;
+    int ret;
+
+    payload = read_file(in, &len);
+    if (payload == NULL) {
+        return -1;
+    }
+
+    total = SECURE_FRAME_HDR_SIZE + len + SECURE_FRAME_TAG_SIZE;
+    frame = calloc(1, total);
+    if (frame == NULL) {
+        free(payload);
+        return -1;
+    }
+
+    secure_frame_put32(&frame[SECURE_FRAME_OFS_MAGIC], SECURE_FRAME_MAGIC);
+    frame[SECURE_FRAME_OFS_VERSION] = SECURE_FRAME_VERSION;
+    secure_frame_put32(&frame[SECURE_FRAME_OFS_LENGTH], (uint32_t)len);
+    if (get_nonce(&frame[SECURE_FRAME_OFS_NONCE]) != 0) {
+        free(payload);
+        free(frame);
+        return -1;
+    }
+
+    sw_aes128_ctr_init(&ctr, enc_key, &frame[SECURE_FRAME_OFS_NONCE]);
+    sw_aes128_ctr_crypt(&ctr, payload, &frame[SECURE_FRAME_HDR_SIZE], len);
+
+    sw_hmac_sha256_init(&hmac, mac_key, sizeof(mac_key));
+    sw_hmac_sha256_update(&hmac, frame, SECURE_FRAME_HDR_SIZE + len);
+    sw_hmac_sha256_final(&hmac, &frame[SECURE_FRAME_HDR_SIZE + len]);
+
+    ret = write_file(out, frame, total);
+    if (ret == 0) {
+        printf("%zu byte payload, %zu byte frame\n", len, total);
+    }
+
+    free(payload);
+    free(frame);
+    return ret;
+}
+
+static int unpack(const char *in, const char *out) {
+    struct sw_aes128_ctr ctr;
+    struct sw_hmac_sha256 hmac;
+    uint8_t mac[SW_SHA256_DIGEST_SIZE];
+    uint8_t *frame;
+    size_t total;
+    uint32_t len;
+    int ret;
+
+    frame = read_file(in, &total);
+    if (frame == NULL) {
+        return -1;
+    }
+
+    if ((total < (SECURE_FRAME_HDR_SIZE + SECURE_FRAME_TAG_SIZE)) ||
+        (secure_frame_get32(&frame[SECURE_FRAME_OFS_MAGIC]) != SECURE_FRAME_MAGIC)) {
+        fprintf(stderr, "%s: bad header\n", in);
+        free(frame);
+        return -1;
+    }
+
+    len = secure_frame_get32(&frame[SECURE_FRAME_OFS_LENGTH]);
+    if (total != (SECURE_FRAME_HDR_SIZE + (size_t)len + SECURE_FRAME_TAG_SIZE)) {
+        fprintf(stderr, "%s: truncated\n", in);
+        free(frame);
+        return -1;
+    }
+
+    sw_hmac_sha256_init(&hmac, mac_key, sizeof(mac_key));
+    sw_hmac_sha256_update(&hmac, frame, SECURE_FRAME_HDR_SIZE + len);
+    sw_hmac_sha256_final(&hmac, mac);
+    if (sw_crypto_memcmp(mac, &frame[SECURE_FRAME_HDR_SIZE + len], SECURE_FRAME_TAG_SIZE) != 0) {
+        fprintf(stderr, "%s: bad tag\n", in);
+        free(frame);
+        return -1;
+    }
+
+    sw_aes128_ctr_init(&ctr, enc_key, &frame[SECURE_FRAME_OFS_NONCE]);
+    sw_aes128_ctr_crypt(&ctr, &frame[SECURE_FRAME_HDR_SIZE], &frame[SECURE_FRAME_HDR_SIZE], len);
+
+    ret = write_file(out, &frame[SECURE_FRAME_HDR_SIZE], len);
+
+    free(frame);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    if ((argc == 4) && (strcmp(argv[1], "pack") == 0)) {
+        return (pack(argv[2], argv[3]) == 0) ? 0 : 1;
+    }
+
+    if ((argc == 4) && (strcmp(argv[1], "unpack") == 0)) {
+        return (unpack(argv[2], argv[3]) == 0) ? 0 : 1;
+    }
+
+    fprintf(stderr, "usage: %s pack|unpack <in> <out>\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+# Copyright (c) 2024 LuckkMaker
+# SPDX-License-Identifier: Apache-2.0
+#
+# Send a frame made by secure_pack to the secure upload demo and print the
+# status. Needs pyusb.
+#
+#   secure_send.py frame.bin
+
+import struct
+import sys
+import time
+
+import usb.core
+
+VID = 0x314B
+PID = 0xF004
+EP_OUT = 0x01
+EP_IN = 0x81
+
+STATUS = {
+    0: "ok",
+    1: "bad header",
+    2: "too long",
+    3: "bad tag",
+    4: "crypto error",
+    5: "truncated",
+}
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: secure_send.py frame.bin")
+        return 2
+
+    with open(sys.argv[1], "rb") as f:
+        frame = f.read()
+
+    dev = usb.core.find(idVendor=VID, idProduct=PID)
+    if dev is None:
+        print("device not found")
+        return 1
+    dev.set_configuration()
+
+    mps = dev[0][(0, 0)][0].wMaxPacketSize
+    t0 = time.monotonic()
+    dev.write(EP_OUT, frame, timeout=10000)
+    if len(frame) % mps == 0:
+        # the device finds the end of a transfer by its short packet
+        dev.write(EP_OUT, b"", timeout=1000)
+    status, length = struct.unpack("<II", bytes(dev.read(EP_IN, 8, timeout=10000)))
+    dt = time.monotonic() - t0
+
+    print("%s, %d bytes, %.1f KB/s" % (STATUS.get(status, status), length, length / 1024 / dt))
+    return 0 if status == 0 else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())